@@ -0,0 +1,313 @@
+#include "BoundsCheck.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <utility>
+#include "RegisterCode.h"
+#include "Superinstructions.h"
+#include "bytecode.h"
+
+bool bounds_check_elimination_enabled() {
+    static const bool enabled = [] {
+        const char* env = std::getenv("JVM_BCE");
+        return !(env && std::strcmp(env, "0") == 0);
+    }();
+    return enabled;
+}
+
+namespace {
+
+// 循环体中操作数栈槽位的来源
+enum Tag : uint8_t {
+    T_OTHER,
+    T_ARRAY, // aload a
+    T_INDEX, // iload i
+};
+
+int16_t read_s2(const std::vector<uint8_t>& code, size_t p) {
+    return (int16_t)((code[p] << 8) | code[p + 1]);
+}
+
+// aload / aload_<n>的局部变量编号，不是这两种指令时返回-1
+int ref_load_index(const std::vector<uint8_t>& code, size_t pc) {
+    if (code[pc] == 0x19) return code[pc + 1];
+    if (code[pc] >= 0x2a && code[pc] <= 0x2d) return code[pc] - 0x2a;
+    return -1;
+}
+
+// 压入非负int常量的指令
+bool pushes_non_negative(const std::vector<uint8_t>& code, size_t pc) {
+    uint8_t op = code[pc];
+    if (op >= 0x03 && op <= 0x08) return true;       // iconst_0 ~ iconst_5
+    if (op == 0x10) return (int8_t)code[pc + 1] >= 0; // bipush
+    if (op == 0x11) return read_s2(code, pc + 1) >= 0; // sipush
+    return false;
+}
+
+// 指令是否写局部变量local（xstore、iinc及其wide形式，long/double占两个槽位）
+bool writes_local(const std::vector<uint8_t>& code, size_t pc, int local) {
+    uint8_t op = code[pc];
+    int index = -1;
+    int width = 1;
+    if (op >= 0x36 && op <= 0x3a) {
+        index = code[pc + 1];
+        width = op == 0x37 || op == 0x39 ? 2 : 1;
+    } else if (op >= 0x3b && op <= 0x4e) {
+        int kind = (op - 0x3b) / 4;
+        index = (op - 0x3b) % 4;
+        width = kind == 1 || kind == 3 ? 2 : 1;
+    } else if (op == 0x84) {
+        index = code[pc + 1];
+    } else if (op == 0xc4) {
+        uint8_t wide_op = code[pc + 1];
+        if (wide_op != 0x84 && (wide_op < 0x36 || wide_op > 0x3a)) return false;
+        index = (code[pc + 2] << 8) | code[pc + 3];
+        width = wide_op == 0x37 || wide_op == 0x39 ? 2 : 1;
+    }
+    return index >= 0 && local >= index && local < index + width;
+}
+
+bool is_branch(uint8_t op) {
+    return (op >= 0x99 && op <= 0xa7) || op == 0xc6 || op == 0xc7;
+}
+
+bool ends_flow(uint8_t op) {
+    return op == 0xa7 || op == 0xaa || op == 0xab || (op >= 0xac && op <= 0xb1) || op == 0xbf;
+}
+
+class LoopAnalysis {
+public:
+    LoopAnalysis(const ClassInfo& cf, const MethodInfo& method) : cf(cf), method(method), code(method.code) {}
+
+    bool scan() {
+        for (size_t pc = 0; pc < code.size(); pc += instruction_length(code, pc)) {
+            uint8_t op = code[pc];
+            if (op == 0xa8 || op == 0xa9 || op == 0xc8 || op == 0xc9) return false; // jsr ret goto_w jsr_w
+            if (is_branch(op)) {
+                edges.emplace_back(pc, (size_t)((int)pc + read_s2(code, pc + 1)));
+            } else if (op == 0xaa || op == 0xab) {
+                const SwitchTable& table = method.switch_at(pc);
+                edges.emplace_back(pc, table.default_target);
+                for (uint32_t target : table.targets) edges.emplace_back(pc, target);
+            }
+            starts.push_back(pc);
+        }
+        return true;
+    }
+
+    // 以goto（starts[k]）为回边的循环，不是可以消除检查的计数循环时返回false
+    bool match(size_t k, CountedLoop& loop) const {
+        size_t back = starts[k];
+        if (code[back] != 0xa7 || k == 0) return false;
+        int32_t header = (int32_t)back + read_s2(code, back + 1);
+        if (header < 0 || (size_t)header >= back) return false;
+        size_t iinc = starts[k - 1];
+        if (code[iinc] != 0x84 || (int8_t)code[iinc + 2] != 1) return false;
+        loop.back = back;
+        loop.iinc = iinc;
+        loop.header = (size_t)header;
+        loop.index = code[iinc + 1];
+        if (int_load_index(code, loop.header) != loop.index) return false;
+        size_t p = loop.header + instruction_length(code, loop.header);
+        loop.array = ref_load_index(code, p);
+        loop.length = -1;
+        if (loop.array >= 0) {
+            p += instruction_length(code, p);
+            if (code[p] != 0xbe) return false; // arraylength
+            p += 1;
+        } else {
+            loop.length = int_load_index(code, p);
+            if (loop.length < 0 || loop.length == loop.index) return false;
+            p += instruction_length(code, p);
+        }
+        if (code[p] != 0xa2) return false; // if_icmpge
+        loop.exit = (size_t)((int)p + read_s2(code, p + 1));
+        if (loop.exit >= loop.header && loop.exit <= back) return false;
+        loop.body = p + 3;
+
+        // 循环前：<非负常量>; istore i，增强for在此之前还有aload a; arraylength; istore n
+        size_t h = index_of(loop.header);
+        if (h < 2 || int_store_index(code, starts[h - 1]) != loop.index || !pushes_non_negative(code, starts[h - 2])) return false;
+        loop.preheader = starts[h - 2];
+        if (loop.length >= 0) {
+            if (h < 5 || int_store_index(code, starts[h - 3]) != loop.length || code[starts[h - 4]] != 0xbe) return false;
+            loop.array = ref_load_index(code, starts[h - 5]);
+            if (loop.array < 0 || loop.array == loop.length) return false;
+            loop.preheader = starts[h - 5];
+        }
+        if (loop.array == loop.index) return false;
+        return single_entry(loop) && invariant(loop);
+    }
+
+    // 标出循环体中数组和下标来自a、i的访问
+    size_t mark(const CountedLoop& loop, std::vector<uint8_t>& table) const {
+        std::map<size_t, std::vector<uint8_t>> states;
+        std::vector<size_t> worklist{loop.body};
+        states[loop.body];
+        while (!worklist.empty()) {
+            size_t pc = worklist.back();
+            worklist.pop_back();
+            std::vector<uint8_t> stack = states[pc];
+            if (!transfer(loop, pc, stack)) return 0;
+            uint8_t op = code[pc];
+            std::vector<size_t> successors;
+            if (!ends_flow(op)) successors.push_back(pc + instruction_length(code, pc));
+            if (is_branch(op)) successors.push_back((size_t)((int)pc + read_s2(code, pc + 1)));
+            if (op == 0xaa || op == 0xab) {
+                const SwitchTable& sw = method.switch_at(pc);
+                successors.push_back(sw.default_target);
+                successors.insert(successors.end(), sw.targets.begin(), sw.targets.end());
+            }
+            for (size_t next : successors) {
+                if (next < loop.body || next >= loop.iinc) continue;
+                auto it = states.find(next);
+                if (it == states.end()) {
+                    states.emplace(next, stack);
+                    worklist.push_back(next);
+                    continue;
+                }
+                std::vector<uint8_t>& old = it->second;
+                if (old.size() != stack.size()) return 0;
+                bool changed = false;
+                for (size_t i = 0; i < stack.size(); ++i) {
+                    if (old[i] != stack[i] && old[i] != T_OTHER) {
+                        old[i] = T_OTHER;
+                        changed = true;
+                    }
+                }
+                if (changed) worklist.push_back(next);
+            }
+        }
+        size_t marked = 0;
+        for (const auto& [pc, stack] : states) {
+            uint8_t op = code[pc];
+            size_t n = stack.size();
+            if (op >= 0x2e && op <= 0x35) {
+                if (n >= 2 && stack[n - 1] == T_INDEX && stack[n - 2] == T_ARRAY) {
+                    table[pc] = SUPER_ARRAY_LOAD_UNCHECKED;
+                    marked++;
+                }
+            } else if (op >= 0x4f && op <= 0x56) {
+                size_t value = op == 0x50 || op == 0x52 ? 2 : 1;
+                if (n >= value + 2 && stack[n - value - 1] == T_INDEX && stack[n - value - 2] == T_ARRAY) {
+                    table[pc] = SUPER_ARRAY_STORE_UNCHECKED;
+                    marked++;
+                }
+            }
+        }
+        return marked;
+    }
+
+    const std::vector<size_t>& instructions() const { return starts; }
+
+private:
+    const ClassInfo& cf;
+    const MethodInfo& method;
+    const std::vector<uint8_t>& code;
+    std::vector<size_t> starts;
+    std::vector<std::pair<size_t, size_t>> edges; // 跳转指令和目标
+
+    size_t index_of(size_t pc) const {
+        return std::lower_bound(starts.begin(), starts.end(), pc) - starts.begin();
+    }
+
+    // 只能从循环前的初始化顺序进入循环头，只能从循环头进入循环体
+    bool single_entry(const CountedLoop& loop) const {
+        for (const auto& [from, to] : edges) {
+            bool inside = from >= loop.header && from <= loop.back;
+            if (to > loop.preheader && to < loop.header) return false;
+            if (to >= loop.header && to <= loop.back && !inside) return false;
+        }
+        for (const ExceptionTable& entry : method.exception_table) {
+            if (entry.handler_pc > loop.preheader && entry.handler_pc <= loop.back) return false;
+        }
+        return true;
+    }
+
+    // 循环中除iinc i 1以外不写i、a、n
+    bool invariant(const CountedLoop& loop) const {
+        for (size_t k = index_of(loop.header); k < starts.size() && starts[k] <= loop.back; ++k) {
+            size_t pc = starts[k];
+            if (pc != loop.iinc && writes_local(code, pc, loop.index)) return false;
+            if (writes_local(code, pc, loop.array)) return false;
+            if (loop.length >= 0 && writes_local(code, pc, loop.length)) return false;
+        }
+        return true;
+    }
+
+    bool transfer(const CountedLoop& loop, size_t pc, std::vector<uint8_t>& stack) const {
+        auto pop = [&stack]() -> uint8_t {
+            if (stack.empty()) return T_OTHER; // 进入循环体前已在栈上的值
+            uint8_t tag = stack.back();
+            stack.pop_back();
+            return tag;
+        };
+        switch (code[pc]) {
+        case 0x59: { // dup
+            uint8_t v = pop();
+            stack.insert(stack.end(), {v, v});
+            return true;
+        }
+        case 0x5a: { // dup_x1
+            uint8_t v1 = pop(), v2 = pop();
+            stack.insert(stack.end(), {v1, v2, v1});
+            return true;
+        }
+        case 0x5c: { // dup2
+            uint8_t v1 = pop(), v2 = pop();
+            stack.insert(stack.end(), {v2, v1, v2, v1});
+            return true;
+        }
+        case 0x5f: { // swap
+            uint8_t v1 = pop(), v2 = pop();
+            stack.insert(stack.end(), {v1, v2});
+            return true;
+        }
+        default:
+            break;
+        }
+        if (ref_load_index(code, pc) == loop.array) {
+            stack.push_back(T_ARRAY);
+            return true;
+        }
+        if (int_load_index(code, pc) == loop.index) {
+            stack.push_back(T_INDEX);
+            return true;
+        }
+        int pops, pushes;
+        if (!stack_effect(cf, code, pc, pops, pushes)) return false;
+        while (pops-- > 0) pop();
+        stack.insert(stack.end(), (size_t)pushes, T_OTHER);
+        return true;
+    }
+};
+
+} // namespace
+
+std::vector<CountedLoop> find_counted_loops(const ClassInfo& cf, const MethodInfo& method) {
+    std::vector<CountedLoop> loops;
+    LoopAnalysis analysis(cf, method);
+    if (!analysis.scan()) return loops;
+    for (size_t k = 0; k < analysis.instructions().size(); ++k) {
+        CountedLoop loop;
+        if (analysis.match(k, loop)) loops.push_back(loop);
+    }
+    return loops;
+}
+
+size_t eliminate_bounds_checks(const ClassInfo& cf, const MethodInfo& method, std::vector<uint8_t>& table) {
+    LoopAnalysis analysis(cf, method);
+    if (!analysis.scan()) return 0;
+    size_t marked = 0;
+    for (size_t k = 0; k < analysis.instructions().size(); ++k) {
+        CountedLoop loop;
+        if (!analysis.match(k, loop)) continue;
+        if (table.empty()) table.assign(method.code.size(), SUPER_NONE);
+        marked += analysis.mark(loop, table);
+    }
+    if (marked == 0 && std::find_if(table.begin(), table.end(), [](uint8_t op) { return op != SUPER_NONE; }) == table.end()) {
+        table.clear();
+    }
+    return marked;
+}
@@ -0,0 +1,34 @@
+#ifndef BOUNDSCHECK_H
+#define BOUNDSCHECK_H
+#include <cstdint>
+#include <vector>
+#include "runtime.h"
+
+// 计数循环的数组越界检查消除：方法链接时识别以下形式的循环
+//   <非负常量>; istore i; H: iload i; aload a; arraylength; if_icmpge E; ...; iinc i 1; goto H
+//   aload a; arraylength; istore n; <非负常量>; istore i; H: iload i; iload n; if_icmpge E; ...; iinc i 1; goto H（增强for）
+// 循环体内不写i、a、n，也没有从循环外跳入循环体或异常处理器入口时，循环头的比较一次证明了
+// 整个循环体内a非null且0 <= i < a.length。循环体中数组和下标分别来自aload a、iload i的xaload/xastore
+// 在超级指令表中标为SUPER_ARRAY_LOAD_UNCHECKED/SUPER_ARRAY_STORE_UNCHECKED，解释执行时不再检查下标。
+// JVM_BCE=0关闭
+bool bounds_check_elimination_enabled();
+
+struct CountedLoop {
+    size_t preheader; // 初始化i（增强for还有n）的第一条指令
+    size_t header;    // H
+    size_t body;      // 循环头比较之后的第一条指令
+    size_t iinc;      // iinc i 1
+    size_t back;      // goto H
+    size_t exit;      // E
+    int index;        // i
+    int array;        // a
+    int length;       // n，循环头直接比较arraylength时为-1
+};
+
+// 方法中所有满足上述条件的计数循环，按回边位置排序
+std::vector<CountedLoop> find_counted_loops(const ClassInfo& cf, const MethodInfo& method);
+
+// 在table（与code等长的超级指令表，空时按需创建）中标出可以不检查下标的数组访问，返回标出的条数
+size_t eliminate_bounds_checks(const ClassInfo& cf, const MethodInfo& method, std::vector<uint8_t>& table);
+
+#endif // BOUNDSCHECK_H
@@ -1,11 +1,32 @@
 #include "ClassLoader.h"
+#include "NativeMethods.h"
+#include "Superinstructions.h"
+#include "BoundsCheck.h"
+#include "TypeCheck.h"
+#include "Verifier.h"
 #include <stdexcept>
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <unordered_map>
 
 ClassLoader::ClassLoader(const std::vector<std::string>& dirs)
     : search_dirs(dirs) {
+    for (auto& bucket : class_table) {
+        bucket.store(nullptr, std::memory_order_relaxed);
     }
+}
+
+ClassLoader::~ClassLoader() {
+    for (auto& bucket : class_table) {
+        ClassEntry* entry = bucket.load(std::memory_order_relaxed);
+        while (entry) {
+            ClassEntry* next = entry->next;
+            delete entry;
+            entry = next;
+        }
+    }
+}
 
 void ClassLoader::set_search_dirs(const std::vector<std::string>& dirs) {
     search_dirs = dirs;
@@ -24,7 +45,7 @@ void ClassLoader::print_search_dirs() {
 }
 
 // class_name 形如 java/io/PrintStream
-std::string ClassLoader::find_class_file(const std::string& class_name) {
+std::string ClassLoader::locate_class_file(const std::string& class_name) {
     std::string relpath = class_name + ".class";
     for (const auto& dir : search_dirs) {
         std::string fullpath = dir.empty() ? relpath : (dir + "/" + relpath);
@@ -34,37 +55,365 @@ std::string ClassLoader::find_class_file(const std::string& class_name) {
     // 兼容：如果没设置目录，尝试当前目录
     std::ifstream in(relpath, std::ios::binary);
     if (in.is_open()) return relpath;
-    throw std::runtime_error("Class file not found in search dirs: " + relpath);
+    return "";
 }
 
-ClassInfo& ClassLoader::load_class(const std::string& class_name, LoadClassCallback loaded_callback) {
-    auto it = class_table.find(class_name);
-    if (it != class_table.end()) return it->second;
+std::string ClassLoader::find_class_file(const std::string& class_name) {
+    std::string path = locate_class_file(class_name);
+    if (path.empty()) throw std::runtime_error("Class file not found in search dirs: " + class_name + ".class");
+    return path;
+}
+
+ClassLoader::ClassEntry* ClassLoader::find_or_insert_entry(const std::string& class_name) {
+    std::atomic<ClassEntry*>& bucket = class_table[std::hash<std::string>{}(class_name) % TABLE_BUCKETS];
+    ClassEntry* head = bucket.load(std::memory_order_acquire);
+    for (ClassEntry* e = head; e; e = e->next) {
+        if (e->name == class_name) return e;
+    }
+    ClassEntry* entry = new ClassEntry(class_name);
+    // 数组类型在发布前关联元素类型，其他线程看到表项时这些字段已经填好
+    if (entry->klass.is_array()) {
+        const std::string element = class_name.substr(1);
+        if (element[0] == '[') {
+            entry->klass.element = &klass(element);
+        } else if (element[0] == 'L') {
+            entry->klass.element = &klass(element.substr(1, element.size() - 2));
+        }
+        entry->klass.super = &klass("java/lang/Object");
+    }
+    while (true) {
+        entry->next = head;
+        if (bucket.compare_exchange_weak(head, entry, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return entry;
+        }
+        // 表头已变化：检查新插入的表项中是否已有同名类
+        for (ClassEntry* e = head; e != entry->next; e = e->next) {
+            if (e->name == class_name) {
+                delete entry;
+                return e;
+            }
+        }
+    }
+}
+
+const Klass& ClassLoader::klass(const std::string& name) {
+    return find_or_insert_entry(name)->klass;
+}
+
+ClassInfo* ClassLoader::define_if_present(ClassEntry& entry) {
+    if (ClassInfo* cf = entry.info.load(std::memory_order_acquire)) return cf;
+    if (entry.klass.is_array() || entry.no_class_file.load(std::memory_order_relaxed)) return nullptr;
+    if (locate_class_file(entry.name).empty()) {
+        entry.no_class_file.store(true, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &define_class(entry);
+}
+
+const Klass& ClassLoader::defined_klass(const std::string& name) {
+    ClassEntry* entry = find_or_insert_entry(name);
+    define_if_present(*entry);
+    return entry->klass;
+}
+
+const Klass& ClassLoader::array_klass(const Klass& element) {
+    if (const Klass* array = element.array.load(std::memory_order_acquire)) return *array;
+    const Klass& array = klass(element.is_array() ? "[" + element.name : "[L" + element.name + ";");
+    element.array.store(&array, std::memory_order_release);
+    return array;
+}
+
+ClassInfo* ClassLoader::find_loaded_class(const std::string& class_name) const {
+    const std::atomic<ClassEntry*>& bucket = class_table[std::hash<std::string>{}(class_name) % TABLE_BUCKETS];
+    for (ClassEntry* e = bucket.load(std::memory_order_acquire); e; e = e->next) {
+        if (e->name != class_name) continue;
+        ClassInfo* cf = e->info.load(std::memory_order_acquire);
+        if (cf && cf->init_state.load(std::memory_order_acquire) == ClassInitState::INITIALIZED) return cf;
+        return nullptr;
+    }
+    return nullptr;
+}
+
+// 为静态字段分配槽位（JVMS §5.4.2准备阶段），初值都是0；ConstantValue在类初始化时写入
+static void layout_static_fields(ClassInfo& cf) {
+    size_t count = 0;
+    for (auto& field : cf.fields) {
+        if ((field.access_flags & ACC_STATIC) == 0) continue;
+        field.slot = (uint16_t)count;
+        field.width = (field.descriptor == "J" || field.descriptor == "D") ? 2 : 1;
+        count += field.width;
+    }
+    cf.static_slots.resize(count);
+    for (auto& field : cf.fields) {
+        if ((field.access_flags & ACC_STATIC) != 0) field.static_value = &cf.static_slots[field.slot];
+    }
+    cf.resolved_static_fields.resize(cf.constant_pool.size());
+    cf.resolved_static_methods.resize(cf.constant_pool.size());
+    cf.resolved_fields.resize(cf.constant_pool.size());
+    cf.resolved_classes.resize(cf.constant_pool.size());
+}
+
+// 实例字段排在父类的字段之后，并据此生成类型中的实例模板。在类发布前进行，父类先递归解析（不初始化），
+// 这样父类的<clinit>创建子类对象时子类的模板已经可用。父类没有class文件时视为没有实例字段
+void ClassLoader::layout_instance_fields(ClassInfo& cf) {
+    size_t count = 0;
+    if (cf.super_class != 0) {
+        ClassEntry* super_entry = find_or_insert_entry(cf.constant_pool.get_class_name(cf.super_class));
+        if (define_if_present(*super_entry)) count = super_entry->klass.field_slots;
+        cf.klass->super = &super_entry->klass;
+    }
+    for (auto& field : cf.fields) {
+        if ((field.access_flags & ACC_STATIC) != 0) continue;
+        field.slot = (uint16_t)count;
+        field.width = (field.descriptor == "J" || field.descriptor == "D") ? 2 : 1;
+        count += field.width;
+    }
+    cf.klass->field_slots = (uint32_t)count;
+    cf.klass->instance_size = sizeof(JVMObject) + count * sizeof(SlotT);
+}
+
+// 没有JDK类文件时使用的常见异常类的父类
+static const std::unordered_map<std::string, std::string> builtin_exception_supers = {
+    {"java/lang/Throwable", "java/lang/Object"},
+    {"java/lang/Exception", "java/lang/Throwable"},
+    {"java/lang/Error", "java/lang/Throwable"},
+    {"java/lang/VirtualMachineError", "java/lang/Error"},
+    {"java/lang/OutOfMemoryError", "java/lang/VirtualMachineError"},
+    {"java/lang/LinkageError", "java/lang/Error"},
+    {"java/lang/VerifyError", "java/lang/LinkageError"},
+    {"java/lang/ExceptionInInitializerError", "java/lang/LinkageError"},
+    {"java/lang/NoClassDefFoundError", "java/lang/LinkageError"},
+    {"java/lang/IncompatibleClassChangeError", "java/lang/LinkageError"},
+    {"java/lang/ClassCircularityError", "java/lang/LinkageError"},
+    {"java/lang/RuntimeException", "java/lang/Exception"},
+    {"java/lang/NullPointerException", "java/lang/RuntimeException"},
+    {"java/lang/ArithmeticException", "java/lang/RuntimeException"},
+    {"java/lang/IndexOutOfBoundsException", "java/lang/RuntimeException"},
+    {"java/lang/ArrayIndexOutOfBoundsException", "java/lang/IndexOutOfBoundsException"},
+    {"java/lang/NegativeArraySizeException", "java/lang/RuntimeException"},
+    {"java/lang/ClassCastException", "java/lang/RuntimeException"},
+    {"java/lang/ArrayStoreException", "java/lang/RuntimeException"},
+    {"java/lang/IllegalMonitorStateException", "java/lang/RuntimeException"},
+    {"java/lang/IllegalArgumentException", "java/lang/RuntimeException"},
+};
 
+// 主父类表从父类复制，再加上本类；secondary_supers是父类的加上各接口的（去重），
+// 接口、深度超过主父类表的类和没有class文件的类把自己放进secondary_supers
+void ClassLoader::link_supers_slow(Klass& klass) {
+    std::lock_guard<std::recursive_mutex> lock(supers_mutex);
+    if (klass.supers_linked.load(std::memory_order_relaxed)) return;
+    // 接口的继承关系有环时，递归会回到还没填完的类型
+    if (std::find(linking_supers.begin(), linking_supers.end(), &klass) != linking_supers.end()) {
+        fmt::print("[exception] {} is its own superinterface\n", klass.name);
+        throw JavaRuntimeError("java/lang/ClassCircularityError");
+    }
+    const Klass* super = nullptr;
+    std::vector<const Klass*> interfaces;
+    const ClassInfo* cf = nullptr;
+    if (klass.is_array()) {
+        super = &this->klass("java/lang/Object");
+        if (klass.element) link_supers(*klass.element);
+        interfaces = {&this->klass("java/lang/Cloneable"), &this->klass("java/io/Serializable")};
+    } else {
+        cf = define_if_present(*find_or_insert_entry(klass.name));
+        if (cf) {
+            klass.is_interface = (cf->access_flags & ACC_INTERFACE) != 0;
+            if (cf->super_class != 0) super = &this->klass(cf->constant_pool.get_class_name(cf->super_class));
+            for (ConstIdxT idx : cf->interfaces) interfaces.push_back(&this->klass(cf->constant_pool.get_class_name(idx)));
+        } else if (klass.name != "java/lang/Object") {
+            auto it = builtin_exception_supers.find(klass.name);
+            super = &this->klass(it != builtin_exception_supers.end() ? it->second : "java/lang/Object");
+        }
+    }
+    auto add_secondary = [&](const Klass* k) {
+        if (std::find(klass.secondary_supers.begin(), klass.secondary_supers.end(), k) == klass.secondary_supers.end()) {
+            klass.secondary_supers.push_back(k);
+        }
+    };
+    if (!klass.super) klass.super = super; // 没有class文件的类在这里才知道父类
+    linking_supers.push_back(&klass);
+    try {
+        if (super) {
+            link_supers(*super);
+            klass.depth = super->depth + 1;
+            std::copy(std::begin(super->primary_supers), std::end(super->primary_supers), std::begin(klass.primary_supers));
+            klass.secondary_supers = super->secondary_supers;
+        }
+        for (const Klass* itf : interfaces) {
+            link_supers(*itf);
+            for (const Klass* k : itf->secondary_supers) add_secondary(k);
+        }
+    } catch (...) {
+        linking_supers.pop_back();
+        throw;
+    }
+    linking_supers.pop_back();
+    klass.primary = cf && !klass.is_interface && klass.depth < Klass::DISPLAY_SIZE;
+    if (klass.depth < Klass::DISPLAY_SIZE && !klass.is_interface) klass.primary_supers[klass.depth] = &klass;
+    if (!klass.primary && !klass.is_array()) add_secondary(&klass);
+    klass.supers_linked.store(true, std::memory_order_release);
+}
+
+// 在该类的加载锁下解析class文件，其他类的加载不受影响。
+// 解析时父类递归解析，同一线程再次请求正在解析的类说明继承关系有环，不能等待自己持有的锁
+ClassInfo& ClassLoader::define_class(ClassEntry& entry) {
+    if (entry.define_thread.load(std::memory_order_acquire) == std::this_thread::get_id()) {
+        fmt::print("[exception] {} is its own superclass\n", entry.name);
+        throw JavaRuntimeError("java/lang/ClassCircularityError");
+    }
+    std::lock_guard<std::mutex> lock(entry.load_mutex);
+    if (ClassInfo* loaded = entry.info.load(std::memory_order_acquire)) return *loaded;
+
+    const std::string& class_name = entry.name;
     fmt::print("ClassLoader searching for {}\n", class_name);
     std::string filename = find_class_file(class_name);
     fmt::print("ClassFileParser running on {}\n", filename);
-    std::optional<ClassInfo> cf_opt = parser.parse(filename);
-    if (!cf_opt) {
+    std::unique_ptr<ClassInfo> cf = parser.parse(filename);
+    if (!cf) {
         throw std::runtime_error("Invalid class file");
     }
-    ClassInfo &cf = cf_opt.value();
-    fmt::print("Version: {}.{}\n", cf.majorVer, cf.minorVer);
+    fmt::print("Version: {}.{}\n", cf->majorVer, cf->minorVer);
     fmt::print("Method List:\n");
-    for (const auto& method : cf.methods) {
-        fmt::print("  Name: {}, Descriptor: {}, codesize:{}, max_stack:{}, max_locals:{}\n", method.name, method.descriptor, method.code.size(), method.max_stack, method.max_locals);
+    for (const auto& method : cf->methods) {
+        fmt::print("  Name: {}, Descriptor: {}, Code attribute: {} bytes\n", method.name, method.descriptor, method.code_attribute.size());
     }
     fmt::print("{} loaded successfully\n", filename);
 
-    // 递归加载父类（除Object外）
-    if (cf.super_class != 0) {
-        std::string super_name = cf.constant_pool.get_class_name(cf.super_class);
-        if (super_name != "java/lang/Object") {
-            load_class(super_name, loaded_callback);
+    // 字节码验证推迟到方法第一次链接，与链接共用一次Code属性解码；这里只按验证缓存决定是否需要验证
+    if (Verifier::needs_verification(*cf)) {
+        for (const auto& method : cf->methods) {
+            if (method.has_code) ++cf->unverified_methods;
+        }
+        if (cf->unverified_methods == 0) Verifier::class_verified(*cf);
+    } else if (Verifier::enabled()) {
+        fmt::print("{} found in verification cache, skipped verification\n", class_name);
+    }
+
+    layout_static_fields(*cf);
+    cf->klass = &entry.klass;
+    // 父类递归解析期间记下本线程，继承关系有环时再次请求本类会在开头发现
+    entry.define_thread.store(std::this_thread::get_id(), std::memory_order_release);
+    try {
+        layout_instance_fields(*cf);
+    } catch (...) {
+        entry.define_thread.store(std::thread::id(), std::memory_order_release);
+        throw;
+    }
+    entry.define_thread.store(std::thread::id(), std::memory_order_release);
+
+    // 为native方法绑定实现，调用时不再按名字查表
+    for (auto& method : cf->methods) {
+        method.owner = cf.get();
+        if ((method.access_flags & ACC_NATIVE) != 0) {
+            method.native_func = find_native(class_name, method.name, method.descriptor, (method.access_flags & ACC_STATIC) != 0);
+        }
+    }
+
+    entry.klass.info = cf.get();
+    entry.owned = std::move(cf);
+    entry.info.store(entry.owned.get(), std::memory_order_release);
+    return *entry.owned;
+}
+
+// 方法第一次被解析时才解码Code属性，并生成switch跳转表和超级指令表，没有调用过的方法不占用这些内存
+void ClassLoader::link_method(MethodInfo& method) {
+    if (method.linked.load(std::memory_order_acquire)) return;
+    // 链接时的分析（越界检查消除、向量化）可能较慢，只锁方法所属的类，其他类的方法可以同时链接
+    std::lock_guard<std::mutex> lock(method.owner->link_mutex);
+    if (method.linked.load(std::memory_order_relaxed)) return;
+    if (method.has_code) {
+        const ClassInfo& owner = *method.owner;
+        if (owner.unverified_methods != 0) {
+            // 验证失败时方法保持未链接，再次调用时重新解码并报告同样的错误
+            Verifier::verify_method(*this, owner, method);
+            if (--owner.unverified_methods == 0) {
+                Verifier::class_verified(owner);
+                fmt::print("{} verified\n", owner.constant_pool.get_class_name(owner.this_class));
+            }
+        } else {
+            ClassFileParser::parse_code(method);
+        }
+        std::vector<uint8_t>().swap(method.code_attribute);
+        method.has_code = false;
+        method.switch_tables = decode_switch_tables(method.code);
+        if (superinstructions_enabled()) {
+            method.superinstructions = find_superinstructions(method.code);
+        }
+        if (bounds_check_elimination_enabled() && method.owner) {
+            if (size_t n = eliminate_bounds_checks(*method.owner, method, method.superinstructions)) {
+                fmt::print("[bce] {}.{}{}: {} array accesses without bounds checks\n",
+                           method.owner->constant_pool.get_class_name(method.owner->this_class), method.name, method.descriptor, n);
+            }
+        }
+        method.type_check_sites = find_type_check_sites(method.code);
+        if (vectorization_enabled() && method.owner) {
+            method.vector_loops = find_vector_loops(*method.owner, method, method.superinstructions);
+            if (!method.vector_loops.empty()) {
+                fmt::print("[vector] {}.{}{}: {} loops vectorized ({})\n",
+                           method.owner->constant_pool.get_class_name(method.owner->this_class), method.name, method.descriptor,
+                           method.vector_loops.size(), vector_isa());
+            }
+        }
+    }
+    method.linked.store(true, std::memory_order_release);
+}
+
+// 类初始化（JVMS §5.5）：同一时刻只有一个线程执行<clinit>，
+// 其他线程只在该类的init_cv上等待；同一线程的递归请求直接返回
+void ClassLoader::initialize_class(ClassInfo& cf, const std::string& class_name, const LoadClassCallback& loaded_callback) {
+    {
+        std::unique_lock<std::mutex> lock(cf.init_mutex);
+        while (true) {
+            ClassInitState state = cf.init_state.load(std::memory_order_acquire);
+            if (state == ClassInitState::INITIALIZED) return;
+            if (state == ClassInitState::ERRONEOUS) {
+                fmt::print("[exception] {} is in erroneous state\n", class_name);
+                throw JavaRuntimeError("java/lang/NoClassDefFoundError");
+            }
+            if (state == ClassInitState::BEING_INITIALIZED) {
+                if (cf.init_thread == std::this_thread::get_id()) return;
+                cf.init_cv.wait(lock);
+                continue;
+            }
+            cf.init_state.store(ClassInitState::BEING_INITIALIZED, std::memory_order_release);
+            cf.init_thread = std::this_thread::get_id();
+            break;
         }
     }
 
-    auto [inserted, _] = class_table.emplace(class_name, std::move(cf));
-    loaded_callback(class_name);
-    return inserted->second;
-} 
\ No newline at end of file
+    try {
+        // 先初始化父类（除Object外），实例字段已在解析时布局好。没有class文件的父类（内置的异常类等）不需要初始化
+        if (cf.super_class != 0) {
+            std::string super_name = cf.constant_pool.get_class_name(cf.super_class);
+            if (super_name != "java/lang/Object" && define_if_present(*find_or_insert_entry(super_name))) {
+                load_class(super_name, loaded_callback);
+            }
+        }
+        link_supers(*cf.klass);
+        loaded_callback(cf);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(cf.init_mutex);
+        cf.init_state.store(ClassInitState::ERRONEOUS, std::memory_order_release);
+        cf.init_thread = std::thread::id();
+        cf.init_cv.notify_all();
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(cf.init_mutex);
+    cf.init_state.store(ClassInitState::INITIALIZED, std::memory_order_release);
+    cf.init_thread = std::thread::id();
+    cf.init_cv.notify_all();
+}
+
+ClassInfo& ClassLoader::load_class(const std::string& class_name, LoadClassCallback loaded_callback) {
+    ClassEntry* entry = find_or_insert_entry(class_name);
+    ClassInfo* cf = entry->info.load(std::memory_order_acquire);
+    if (cf && cf->init_state.load(std::memory_order_acquire) == ClassInitState::INITIALIZED) {
+        return *cf;
+    }
+    if (!cf) {
+        cf = &define_class(*entry);
+    }
+    initialize_class(*cf, class_name, loaded_callback);
+    return *cf;
+}
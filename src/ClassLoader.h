@@ -1,28 +1,78 @@
 #ifndef CLASSLOADER_H
 #define CLASSLOADER_H
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <functional>
 #include "classFileParser.h"
 #include "classFileParser_types.h"
 
-using LoadClassCallback = std::function<void(const std::string& loaded_class_name)>;
+// 类初始化回调：执行loaded_class自身的<clinit>
+using LoadClassCallback = std::function<void(ClassInfo& loaded_class)>;
 class ClassLoader {
 public:
     ClassLoader(const std::vector<std::string>& dirs = {});
+    ~ClassLoader();
+    ClassLoader(const ClassLoader&) = delete;
+    ClassLoader& operator=(const ClassLoader&) = delete;
     // 设置查找目录
     void set_search_dirs(const std::vector<std::string>& dirs);
     // 添加单个目录
     void add_search_dir(const std::string& dir);
     void print_search_dirs();
-    // 加载并返回指定类，已加载则直接返回
+    // 加载并初始化指定类，已初始化则直接返回。
+    // 已初始化类的查找不加锁；加载和初始化只锁住对应的类
     ClassInfo& load_class(const std::string& class_name, LoadClassCallback loaded_callback);
+    // 只查找已初始化的类，不触发加载，未找到返回nullptr
+    ClassInfo* find_loaded_class(const std::string& class_name) const;
+    // 解码并验证方法的Code属性（只在第一次调用时进行），执行方法前必须先链接
+    void link_method(MethodInfo& method);
+    // 类名（数组为描述符）对应的运行时类型，不触发加载；数组类型的元素类型和父类在返回前已填好
+    const Klass& klass(const std::string& name);
+    // 以element为元素的数组类型
+    const Klass& array_klass(const Klass& element);
+    // 同klass()，但有class文件时先解析该类（不初始化），返回时实例模板已按实例字段布局好，可以用来分配对象
+    const Klass& defined_klass(const std::string& name);
+    // 填好子类型检查用的父类型（TypeCheck.h）。需要时加载（不初始化）父类和接口，没有class文件的类按内置的异常父类表
+    // 或视为Object的直接子类；已经填好时只读一个原子变量
+    void link_supers(const Klass& klass) {
+        if (!klass.supers_linked.load(std::memory_order_acquire)) link_supers_slow(const_cast<Klass&>(klass));
+    }
 private:
-    std::map<std::string, ClassInfo> class_table;
+    // 类表项：插入后不再删除，info在类解析完成后发布。数组类型只有klass，不会被加载
+    struct ClassEntry {
+        std::string name;
+        std::atomic<ClassInfo*> info{nullptr};
+        std::unique_ptr<ClassInfo> owned;
+        std::mutex load_mutex; // 该类的加载锁
+        std::atomic<std::thread::id> define_thread{}; // 持有加载锁、正在解析该类的线程
+        std::atomic<bool> no_class_file{false}; // 已确认没有class文件，不再查找
+        ClassEntry* next = nullptr;
+        Klass klass;
+        explicit ClassEntry(const std::string& name) : name(name), klass(name) {}
+    };
+    // 固定桶数的并发哈希表，桶内为只增不删的链表，CAS插入表头
+    static constexpr size_t TABLE_BUCKETS = 4096;
+    std::atomic<ClassEntry*> class_table[TABLE_BUCKETS];
     ClassFileParser parser;
+    std::recursive_mutex supers_mutex; // 保护所有类型的父类型填写，父类型递归填写时重入
+    std::vector<const Klass*> linking_supers; // 正在填写父类型的类型，由supers_mutex保护
 
     std::vector<std::string> search_dirs;
     std::string find_class_file(const std::string& class_name);
+    // 找不到时返回空串
+    std::string locate_class_file(const std::string& class_name);
+    void link_supers_slow(Klass& klass);
+    // 有class文件时解析该类，否则返回nullptr
+    ClassInfo* define_if_present(ClassEntry& entry);
+    void layout_instance_fields(ClassInfo& cf);
+    ClassEntry* find_or_insert_entry(const std::string& class_name);
+    ClassInfo& define_class(ClassEntry& entry);
+    void initialize_class(ClassInfo& cf, const std::string& class_name, const LoadClassCallback& loaded_callback);
 };
 
-#endif // CLASSLOADER_H 
\ No newline at end of file
+#endif // CLASSLOADER_H 
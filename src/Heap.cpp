@@ -0,0 +1,66 @@
+#include "Heap.h"
+#include <type_traits>
+
+thread_local ThreadAllocBuffer Heap::tlab;
+
+Heap::Heap() : chunks(new std::atomic<Slot*>[MAX_CHUNKS]), top(TLAB_SIZE) {
+    // 句柄0~TLAB_SIZE-1不分配给任何线程，其中0表示null
+    for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+    Slot* first = new Slot[CHUNK_SIZE]();
+    chunks[0].store(first, std::memory_order_release);
+}
+
+// 对象（包括数组的元素）都在blocks中，不需要逐个析构
+static_assert(std::is_trivially_destructible_v<JVMArray>, "heap objects are freed with their blocks");
+
+Heap::~Heap() {
+    for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+        Slot* chunk = chunks[i].load(std::memory_order_relaxed);
+        if (!chunk) continue;
+        delete[] chunk;
+    }
+}
+
+// 切换到本堆时丢弃缓冲中另一个堆的句柄和内存
+static void claim(ThreadAllocBuffer& buf, const Heap* heap) {
+    if (buf.heap == heap) return;
+    buf = ThreadAllocBuffer{};
+    buf.heap = heap;
+}
+
+void Heap::refill_tlab(ThreadAllocBuffer& buf) {
+    size_t start = top.fetch_add(TLAB_SIZE, std::memory_order_acq_rel);
+    size_t chunk_idx = start >> CHUNK_BITS;
+    if (chunk_idx >= MAX_CHUNKS) {
+        throw std::runtime_error("Heap exhausted: out of object handles");
+    }
+    if (!chunks[chunk_idx].load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        if (!chunks[chunk_idx].load(std::memory_order_relaxed)) {
+            chunks[chunk_idx].store(new Slot[CHUNK_SIZE](), std::memory_order_release);
+        }
+    }
+    claim(buf, this);
+    buf.next = static_cast<RefT>(start);
+    buf.end = static_cast<RefT>(start + TLAB_SIZE);
+}
+
+char* Heap::new_block(size_t bytes) {
+    char* block = new (std::nothrow) char[bytes]();
+    if (!block) throw JavaRuntimeError("java/lang/OutOfMemoryError");
+    std::lock_guard<std::mutex> lock(block_mutex);
+    blocks.emplace_back(block);
+    return block;
+}
+
+// TLAB剩余空间不够时申请新的TLAB，剩余部分不再使用；大于TLAB四分之一的对象单独占一块，不替换当前TLAB
+void* Heap::allocate_memory_slow(size_t bytes) {
+    if (bytes > TLAB_BYTES / 4) return new_block(bytes);
+    char* block = new_block(TLAB_BYTES);
+    claim(tlab, this);
+    tlab.top = block + bytes;
+    tlab.limit = block + TLAB_BYTES;
+    return block;
+}
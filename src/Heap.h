@@ -0,0 +1,100 @@
+#ifndef HEAP_H
+#define HEAP_H
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "runtime.h"
+#include "TrapHandler.h"
+
+class Heap;
+
+// 线程本地分配缓冲：[next, end) 是当前线程独占的空闲句柄，[top, limit) 是独占的已清零对象内存
+struct ThreadAllocBuffer {
+    const Heap* heap = nullptr;
+    RefT next = 0;
+    RefT end = 0;
+    char* top = nullptr;
+    char* limit = nullptr;
+};
+
+// 堆：对象引用是句柄表下标，句柄0保留为null。
+// 每个线程从全局句柄空间和对象内存成块申请TLAB（线程本地分配缓冲），块内分配只需移动指针，不需要加锁。
+// 对象直接构造在TLAB的内存中，堆析构时只调用析构函数，内存随块一起释放
+class Heap {
+public:
+    static constexpr size_t CHUNK_BITS = 12;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS; // 每个句柄块4096项
+    static constexpr size_t MAX_CHUNKS = size_t(1) << 16;
+    static constexpr size_t TLAB_SIZE = 256; // 每次为线程申请的句柄数，整除CHUNK_SIZE
+    static_assert(CHUNK_SIZE % TLAB_SIZE == 0, "TLAB must not straddle handle chunks");
+    static constexpr size_t TLAB_BYTES = 64 * 1024; // 每次为线程申请的对象内存
+    static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+    Heap();
+    ~Heap();
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    // 在当前线程的TLAB中构造T，extra_bytes是紧跟在对象后面的已清零内存（实例字段槽位），返回句柄
+    template <typename T, typename... Args>
+    RefT make(size_t extra_bytes, Args&&... args) {
+        T* obj = new (allocate_memory(sizeof(T) + extra_bytes)) T(std::forward<Args>(args)...);
+        return install(obj);
+    }
+
+    // 按类型中的实例模板分配对象：移动TLAB指针，写入对象头
+    RefT make_instance(const Klass& klass) {
+        return install(new (allocate_memory(klass.instance_size)) JVMObject(&klass));
+    }
+
+    // 不比较null：句柄0的槽位是空指针，TrapHandler::probe读取对象头时落在0地址的保护页上，
+    // 由TrapHandler转换为NullPointerException（隐式null检查）。
+    // 陷入点必须是这里的读操作，不能在之后的成员访问中：noexcept函数内联后抛出的异常会直接terminate，
+    // 而且只有TrapHandler登记过的检查指令处的陷入才会被转换
+    JVMObject& get(RefT ref) const {
+        JVMObject* obj = chunks[ref >> CHUNK_BITS].load(std::memory_order_acquire)[ref & (CHUNK_SIZE - 1)].load(std::memory_order_acquire);
+        TrapHandler::probe(obj);
+        return *obj;
+    }
+
+private:
+    using Slot = std::atomic<JVMObject*>;
+    std::unique_ptr<std::atomic<Slot*>[]> chunks;
+    std::atomic<size_t> top; // 下一个未分配给任何TLAB的句柄
+    std::mutex chunk_mutex;
+    std::vector<std::unique_ptr<char[]>> blocks; // 所有对象内存块，由block_mutex保护
+    std::mutex block_mutex;
+
+    static thread_local ThreadAllocBuffer tlab;
+
+    void* allocate_memory(size_t bytes) {
+        bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        ThreadAllocBuffer& buf = tlab;
+        if (buf.heap == this && size_t(buf.limit - buf.top) >= bytes) {
+            void* mem = buf.top;
+            buf.top += bytes;
+            return mem;
+        }
+        return allocate_memory_slow(bytes);
+    }
+
+    RefT install(JVMObject* obj) {
+        ThreadAllocBuffer& buf = tlab;
+        if (buf.heap != this || buf.next == buf.end) {
+            refill_tlab(buf);
+        }
+        RefT ref = buf.next++;
+        chunks[ref >> CHUNK_BITS].load(std::memory_order_acquire)[ref & (CHUNK_SIZE - 1)].store(obj, std::memory_order_release);
+        return ref;
+    }
+
+    void* allocate_memory_slow(size_t bytes);
+    void refill_tlab(ThreadAllocBuffer& tlab);
+    char* new_block(size_t bytes);
+};
+
+#endif // HEAP_H
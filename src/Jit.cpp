@@ -0,0 +1,711 @@
+#include "Jit.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <fmt/core.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "bytecode.h"
+#include "OptimizingCompiler.h"
+#include "Superinstructions.h"
+#include "interpreter.h"
+#include "x86Assembler.h"
+
+static constexpr size_t CODE_CACHE_SIZE = 64 << 20;
+
+// 编译代码回调解释器执行bci处的一条指令，返回非0表示有待抛出的异常
+static uint32_t jit_fallback(JitFrameState* st, uint32_t bci) {
+    auto& stack = st->frame->operand_stack.stack;
+    stack.resize(st->sp);
+    try {
+        st->interp->interpret_one(*st->context, *st->frame, bci);
+    } catch (...) {
+        st->pending = std::current_exception();
+    }
+    st->sp = stack.size();
+    stack.resize(std::max<size_t>(st->frame->method_info.max_stack, st->sp));
+    st->stack = stack.data();
+    return st->pending ? 1 : 0;
+}
+
+// 向量化循环的循环头：条件满足时由SIMD核执行完剩余的迭代，之后的循环头比较直接退出循环
+static void jit_vector_loop(JitFrameState* st, uint32_t bci) {
+    run_vector_loop(st->frame->method_info.vector_loop_at(bci), *st->frame, *st->interp);
+}
+
+void JitCode::run(JitFrameState& state, size_t bci) const {
+    using Entry = void (*)(JitFrameState*, const void*);
+    Entry entry = reinterpret_cast<Entry>(const_cast<uint8_t*>(code));
+    entry(&state, code + bci_offsets[bci]);
+}
+
+Jit::Jit() {
+    const char* flag = std::getenv("JVM_JIT");
+    if (flag && std::string(flag) == "0") {
+        enabled_ = false;
+        return;
+    }
+    const char* opt = std::getenv("JVM_OPT");
+    if (opt && std::string(opt) == "0") {
+        opt_enabled_ = false;
+    }
+    const char* threshold = std::getenv("JVM_JIT_THRESHOLD");
+    if (threshold) {
+        invocation_threshold_ = (uint32_t)std::strtoul(threshold, nullptr, 10);
+        backedge_threshold_ = invocation_threshold_ * 10;
+    }
+#if defined(__x86_64__)
+    // 代码缓存不同时可写可执行：映射为可读写，每段代码复制完后所在的页改为只读可执行
+    void* p = mmap(nullptr, CODE_CACHE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        fmt::print("[jit] cannot allocate code cache, JIT disabled\n");
+        enabled_ = false;
+        return;
+    }
+    cache_base = static_cast<uint8_t*>(p);
+    cache_size = CODE_CACHE_SIZE;
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+#else
+    enabled_ = false;
+#endif
+}
+
+Jit::~Jit() {
+    if (cache_base) {
+        munmap(cache_base, cache_size);
+    }
+}
+
+#if defined(__x86_64__)
+
+namespace {
+
+using namespace x64;
+
+// 寄存器分配：局部变量表基址、操作数栈基址、栈顶指针（指向下一个空闲槽位）、JitFrameState
+constexpr Reg LOCALS = RBX;
+constexpr Reg STACK = R12;
+constexpr Reg TOP = R13;
+constexpr Reg STATE = R14;
+
+// 栈顶第k个槽位（k从1开始）相对TOP的偏移
+constexpr int32_t slot(int k) { return -4 * k; }
+constexpr int32_t local(size_t idx) { return (int32_t)(4 * idx); }
+
+class TemplateCompiler {
+public:
+    TemplateCompiler(const MethodInfo& method, uint32_t osr_threshold) : method(method), code(method.code), osr_threshold(osr_threshold) {}
+
+    bool compile(JitCode& out);
+    const std::vector<uint8_t>& machine_code() const { return a.buf; }
+
+private:
+    const MethodInfo& method;
+    const std::vector<uint8_t>& code;
+    Assembler a;
+    size_t exit_stub = 0;
+    std::vector<std::pair<size_t, uint32_t>> branch_fixups; // (rel32位置, 目标bci)
+    std::vector<std::pair<size_t, uint32_t>> exit_fixups;   // (rel32位置, 退出bci)，在方法末尾生成退出桩
+    std::vector<std::pair<size_t, uint32_t>> backedge_fixups; // 向后的条件跳转，在方法末尾生成计数桩
+    uint32_t cur_bci = 0;
+    uint32_t osr_threshold; // 回边计数等于该值时在循环头退出到解释器，由解释器OSR进入第二层代码；0表示不退出
+
+    void emit_prologue();
+    void emit_exit(uint32_t bci) { a.mov32_imm(RAX, bci); a.patch_rel32(a.jmp(), exit_stub); }
+    void emit_fallback(uint32_t bci);
+    void emit_vector_loop(uint32_t bci);
+    void push_int_imm(int32_t v) { a.store32_imm(TOP, 0, v); a.add64_imm(TOP, 4); }
+    void load_long(Reg dst, int k) { a.load64(dst, TOP, slot(k)); a.swap_halves(dst); }
+    void store_long(int k, Reg src) { a.swap_halves(src); a.store64(TOP, slot(k), src); }
+    // 回边先累加method.backedge_count再跳转，供第二层编译判断循环热度
+    void branch(Cond cc, uint32_t target) {
+        if (target <= cur_bci) backedge_fixups.push_back({a.jcc(cc), target});
+        else branch_fixups.push_back({a.jcc(cc), target});
+    }
+    void jump(uint32_t target) {
+        if (target <= cur_bci) count_backedge(target);
+        branch_fixups.push_back({a.jmp(), target});
+    }
+    void count_backedge(uint32_t target) {
+        a.mov64_imm(RAX, reinterpret_cast<uint64_t>(&method.backedge_count));
+        a.add_mem_imm32(RAX, 0, 1);
+        if (osr_threshold) {
+            a.cmp_mem_imm32(RAX, 0, (int32_t)osr_threshold);
+            exit_fixups.push_back({a.jcc(CC_E), target});
+        }
+    }
+    bool emit_instruction(uint32_t bci);
+    void emit_switch(const SwitchTable& table);
+    void emit_switch_range(const std::vector<int32_t>& keys, const std::vector<uint32_t>& targets, size_t lo, size_t hi, uint32_t default_target);
+    void emit_int_div(uint32_t bci, bool rem);
+    void emit_long_div(uint32_t bci, bool rem);
+};
+
+void TemplateCompiler::emit_prologue() {
+    // void entry(JitFrameState* state, const void* target)
+    a.push(RBP);
+    a.push(RBX);
+    a.push(R12);
+    a.push(R13);
+    a.push(R14);
+    a.push(R15);
+    a.sub64_imm(RSP, 8); // 保持调用辅助函数时16字节对齐
+    a.mov64(STATE, RDI);
+    a.load64(LOCALS, STATE, offsetof(JitFrameState, locals));
+    a.load64(STACK, STATE, offsetof(JitFrameState, stack));
+    a.load64(TOP, STATE, offsetof(JitFrameState, sp));
+    a.shift64_imm(4, TOP, 2);
+    a.alu64(0x01, TOP, STACK);
+    a.jmp(RSI);
+
+    // 退出桩：eax为解释器继续执行的bci
+    exit_stub = a.pos();
+    a.op_mem({0x89}, false, RAX, STATE, offsetof(JitFrameState, bci));
+    a.mov64(RAX, TOP);
+    a.alu64(0x29, RAX, STACK);
+    a.shift64_imm(5, RAX, 2);
+    a.store64(STATE, offsetof(JitFrameState, sp), RAX);
+    a.add64_imm(RSP, 8);
+    a.pop(R15);
+    a.pop(R14);
+    a.pop(R13);
+    a.pop(R12);
+    a.pop(RBX);
+    a.pop(RBP);
+    a.ret();
+}
+
+void TemplateCompiler::emit_fallback(uint32_t bci) {
+    a.mov64(RAX, TOP);
+    a.alu64(0x29, RAX, STACK);
+    a.shift64_imm(5, RAX, 2);
+    a.store64(STATE, offsetof(JitFrameState, sp), RAX);
+    a.mov64(RDI, STATE);
+    a.mov32_imm(RSI, bci);
+    a.mov64_imm(RAX, reinterpret_cast<uint64_t>(&jit_fallback));
+    a.call(RAX);
+    // 操作数栈可能被重新分配，重新加载基址和栈顶
+    a.load64(STACK, STATE, offsetof(JitFrameState, stack));
+    a.load64(TOP, STATE, offsetof(JitFrameState, sp));
+    a.shift64_imm(4, TOP, 2);
+    a.alu64(0x01, TOP, STACK);
+    a.test32(RAX, RAX);
+    exit_fixups.push_back({a.jcc(CC_NE), bci});
+}
+
+// 只修改局部变量和数组元素，不需要同步操作数栈
+void TemplateCompiler::emit_vector_loop(uint32_t bci) {
+    a.mov64(RDI, STATE);
+    a.mov32_imm(RSI, bci);
+    a.mov64_imm(RAX, reinterpret_cast<uint64_t>(&jit_vector_loop));
+    a.call(RAX);
+}
+
+// switch：键在eax中，对升序的键生成二分比较树，叶子上逐个比较
+void TemplateCompiler::emit_switch(const SwitchTable& table) {
+    a.sub64_imm(TOP, 4);
+    a.load32(RAX, TOP, 0);
+    std::vector<int32_t> keys = table.keys;
+    std::vector<uint32_t> targets = table.targets;
+    if (table.dense) {
+        // 跳转表中跳到default的空位不需要比较
+        keys.clear();
+        targets.clear();
+        for (size_t i = 0; i < table.targets.size(); ++i) {
+            if (table.targets[i] == table.default_target) continue;
+            keys.push_back((int32_t)((int64_t)table.low + (int64_t)i));
+            targets.push_back(table.targets[i]);
+        }
+    }
+    emit_switch_range(keys, targets, 0, keys.size(), table.default_target);
+}
+
+void TemplateCompiler::emit_switch_range(const std::vector<int32_t>& keys, const std::vector<uint32_t>& targets, size_t lo, size_t hi, uint32_t default_target) {
+    if (hi - lo <= 3) {
+        for (size_t i = lo; i < hi; ++i) {
+            a.cmp32_imm(RAX, keys[i]);
+            branch(CC_E, targets[i]);
+        }
+        jump(default_target);
+        return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    a.cmp32_imm(RAX, keys[mid]);
+    size_t less = a.jcc(CC_L);
+    emit_switch_range(keys, targets, mid, hi, default_target);
+    a.patch_rel32(less, a.pos());
+    emit_switch_range(keys, targets, lo, mid, default_target);
+}
+
+// idiv/irem：除数为0时退出到解释器处理；除数为-1时单独处理，避免INT_MIN / -1触发硬件异常
+void TemplateCompiler::emit_int_div(uint32_t bci, bool rem) {
+    a.load32(RCX, TOP, slot(1));
+    a.test32(RCX, RCX);
+    exit_fixups.push_back({a.jcc(CC_E), bci});
+    a.sub64_imm(TOP, 4);
+    a.load32(RAX, TOP, slot(1));
+    a.cmp32_imm8(RCX, -1);
+    size_t not_minus_one = a.jcc(CC_NE);
+    if (rem) {
+        a.store32_imm(TOP, slot(1), 0);
+    } else {
+        a.neg_mem32(TOP, slot(1));
+    }
+    size_t done = a.jmp();
+    a.patch_rel32(not_minus_one, a.pos());
+    a.cdq();
+    a.idiv32(RCX);
+    a.store32(TOP, slot(1), rem ? RDX : RAX);
+    a.patch_rel32(done, a.pos());
+}
+
+void TemplateCompiler::emit_long_div(uint32_t bci, bool rem) {
+    load_long(RCX, 2);
+    a.test64(RCX, RCX);
+    exit_fixups.push_back({a.jcc(CC_E), bci});
+    a.sub64_imm(TOP, 8);
+    load_long(RAX, 2);
+    a.cmp64_imm8(RCX, -1);
+    size_t not_minus_one = a.jcc(CC_NE);
+    if (rem) {
+        a.alu64(0x31, RAX, RAX);
+    } else {
+        a.neg64(RAX);
+    }
+    size_t done = a.jmp();
+    a.patch_rel32(not_minus_one, a.pos());
+    a.cqo();
+    a.idiv64(RCX);
+    if (rem) a.mov64(RAX, RDX);
+    a.patch_rel32(done, a.pos());
+    store_long(2, RAX);
+}
+
+static int16_t read_s2(const std::vector<uint8_t>& code, size_t pc) {
+    return (int16_t)((code[pc] << 8) | code[pc + 1]);
+}
+
+// 生成一条指令的模板，返回false表示方法无法编译
+bool TemplateCompiler::emit_instruction(uint32_t bci) {
+    uint8_t op = code[bci];
+    switch (op) {
+    case 0x00: // nop
+        return true;
+    case 0x01: // aconst_null
+        push_int_imm(NULL_REF);
+        return true;
+    case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07: case 0x08: // iconst_<i>
+        push_int_imm((int32_t)op - 0x03);
+        return true;
+    case 0x09: case 0x0a: // lconst_<l>
+        a.store32_imm(TOP, 0, 0);
+        a.store32_imm(TOP, 4, op - 0x09);
+        a.add64_imm(TOP, 8);
+        return true;
+    case 0x10: // bipush
+        push_int_imm((int8_t)code[bci + 1]);
+        return true;
+    case 0x11: // sipush
+        push_int_imm(read_s2(code, bci + 1));
+        return true;
+    case 0x15: case 0x17: case 0x19: // iload fload aload
+    case 0x1a: case 0x1b: case 0x1c: case 0x1d: case 0x22: case 0x23: case 0x24: case 0x25: case 0x2a: case 0x2b: case 0x2c: case 0x2d: {
+        size_t idx = op <= 0x19 ? code[bci + 1] : (op - 0x1a) % 4;
+        a.load32(RAX, LOCALS, local(idx));
+        a.store32(TOP, 0, RAX);
+        a.add64_imm(TOP, 4);
+        return true;
+    }
+    case 0x16: case 0x18: // lload dload
+    case 0x1e: case 0x1f: case 0x20: case 0x21: case 0x26: case 0x27: case 0x28: case 0x29: {
+        size_t idx = op <= 0x18 ? code[bci + 1] : (op - 0x1e) % 4;
+        a.load64(RAX, LOCALS, local(idx)); // 局部变量表与操作数栈的64位布局相同，直接复制
+        a.store64(TOP, 0, RAX);
+        a.add64_imm(TOP, 8);
+        return true;
+    }
+    case 0x36: case 0x38: case 0x3a: // istore fstore astore
+    case 0x3b: case 0x3c: case 0x3d: case 0x3e: case 0x43: case 0x44: case 0x45: case 0x46: case 0x4b: case 0x4c: case 0x4d: case 0x4e: {
+        size_t idx = op <= 0x3a ? code[bci + 1] : (op - 0x3b) % 4;
+        a.sub64_imm(TOP, 4);
+        a.load32(RAX, TOP, 0);
+        a.store32(LOCALS, local(idx), RAX);
+        return true;
+    }
+    case 0x37: case 0x39: // lstore dstore
+    case 0x3f: case 0x40: case 0x41: case 0x42: case 0x47: case 0x48: case 0x49: case 0x4a: {
+        size_t idx = op <= 0x39 ? code[bci + 1] : (op - 0x3f) % 4;
+        a.sub64_imm(TOP, 8);
+        a.load64(RAX, TOP, 0);
+        a.store64(LOCALS, local(idx), RAX);
+        return true;
+    }
+    case 0x57: // pop
+        a.sub64_imm(TOP, 4);
+        return true;
+    case 0x58: // pop2
+        a.sub64_imm(TOP, 8);
+        return true;
+    case 0x59: // dup
+        a.load32(RAX, TOP, slot(1));
+        a.store32(TOP, 0, RAX);
+        a.add64_imm(TOP, 4);
+        return true;
+    case 0x5a: // dup_x1: v2 v1 -> v1 v2 v1
+        a.load32(RAX, TOP, slot(1));
+        a.load32(RCX, TOP, slot(2));
+        a.store32(TOP, slot(2), RAX);
+        a.store32(TOP, slot(1), RCX);
+        a.store32(TOP, 0, RAX);
+        a.add64_imm(TOP, 4);
+        return true;
+    case 0x5b: // dup_x2: v3 v2 v1 -> v1 v3 v2 v1
+        a.load32(RAX, TOP, slot(1));
+        a.load32(RCX, TOP, slot(2));
+        a.load32(RDX, TOP, slot(3));
+        a.store32(TOP, slot(3), RAX);
+        a.store32(TOP, slot(2), RDX);
+        a.store32(TOP, slot(1), RCX);
+        a.store32(TOP, 0, RAX);
+        a.add64_imm(TOP, 4);
+        return true;
+    case 0x5c: // dup2
+        a.load64(RAX, TOP, slot(2));
+        a.store64(TOP, 0, RAX);
+        a.add64_imm(TOP, 8);
+        return true;
+    case 0x5d: // dup2_x1: v3 [v2 v1] -> [v2 v1] v3 [v2 v1]
+        a.load64(RAX, TOP, slot(2));
+        a.load32(RCX, TOP, slot(3));
+        a.store64(TOP, slot(3), RAX);
+        a.store32(TOP, slot(1), RCX);
+        a.store64(TOP, 0, RAX);
+        a.add64_imm(TOP, 8);
+        return true;
+    case 0x5e: // dup2_x2: [v4 v3] [v2 v1] -> [v2 v1] [v4 v3] [v2 v1]
+        a.load64(RAX, TOP, slot(2));
+        a.load64(RCX, TOP, slot(4));
+        a.store64(TOP, slot(4), RAX);
+        a.store64(TOP, slot(2), RCX);
+        a.store64(TOP, 0, RAX);
+        a.add64_imm(TOP, 8);
+        return true;
+    case 0x5f: // swap
+        a.load32(RAX, TOP, slot(1));
+        a.load32(RCX, TOP, slot(2));
+        a.store32(TOP, slot(2), RAX);
+        a.store32(TOP, slot(1), RCX);
+        return true;
+    case 0x60: case 0x64: case 0x7e: case 0x80: case 0x82: { // iadd isub iand ior ixor
+        uint8_t alu = op == 0x60 ? 0x01 : op == 0x64 ? 0x29 : op == 0x7e ? 0x21 : op == 0x80 ? 0x09 : 0x31;
+        a.sub64_imm(TOP, 4);
+        a.load32(RCX, TOP, 0);
+        a.alu32_mem_reg(alu, TOP, slot(1), RCX);
+        return true;
+    }
+    case 0x68: // imul
+        a.sub64_imm(TOP, 4);
+        a.load32(RAX, TOP, slot(1));
+        a.load32(RCX, TOP, 0);
+        a.imul32(RAX, RCX);
+        a.store32(TOP, slot(1), RAX);
+        return true;
+    case 0x6c: case 0x70: // idiv irem
+        emit_int_div(bci, op == 0x70);
+        return true;
+    case 0x74: // ineg
+        a.neg_mem32(TOP, slot(1));
+        return true;
+    case 0x78: case 0x7a: case 0x7c: // ishl ishr iushr，硬件按低5位取移位数，与Java一致
+        a.sub64_imm(TOP, 4);
+        a.load32(RCX, TOP, 0);
+        a.shift_mem32_cl(op == 0x78 ? 4 : op == 0x7a ? 7 : 5, TOP, slot(1));
+        return true;
+    case 0x61: case 0x65: case 0x69: case 0x7f: case 0x81: case 0x83: { // ladd lsub lmul land lor lxor
+        load_long(RCX, 2);
+        a.sub64_imm(TOP, 8);
+        load_long(RAX, 2);
+        if (op == 0x69) {
+            a.imul64(RAX, RCX);
+        } else {
+            a.alu64(op == 0x61 ? 0x01 : op == 0x65 ? 0x29 : op == 0x7f ? 0x21 : op == 0x81 ? 0x09 : 0x31, RAX, RCX);
+        }
+        store_long(2, RAX);
+        return true;
+    }
+    case 0x6d: case 0x71: // ldiv lrem
+        emit_long_div(bci, op == 0x71);
+        return true;
+    case 0x75: // lneg
+        load_long(RAX, 2);
+        a.neg64(RAX);
+        store_long(2, RAX);
+        return true;
+    case 0x79: case 0x7b: case 0x7d: // lshl lshr lushr，移位数为int，硬件按低6位取
+        a.sub64_imm(TOP, 4);
+        a.load32(RCX, TOP, 0);
+        load_long(RAX, 2);
+        a.shift64_cl(op == 0x79 ? 4 : op == 0x7b ? 7 : 5, RAX);
+        store_long(2, RAX);
+        return true;
+    case 0x84: // iinc
+        a.add_mem_imm32(LOCALS, local(code[bci + 1]), (int8_t)code[bci + 2]);
+        return true;
+    case 0x85: // i2l
+        a.load32(RAX, TOP, slot(1));
+        a.movsxd(RAX, RAX);
+        a.add64_imm(TOP, 4);
+        store_long(2, RAX);
+        return true;
+    case 0x88: // l2i：取低位槽位
+        a.load32(RAX, TOP, slot(1));
+        a.sub64_imm(TOP, 4);
+        a.store32(TOP, slot(1), RAX);
+        return true;
+    case 0x91: // i2b
+        a.movsx8_mem(RAX, TOP, slot(1));
+        a.store32(TOP, slot(1), RAX);
+        return true;
+    case 0x92: // i2c
+        a.movzx16_mem(RAX, TOP, slot(1));
+        a.store32(TOP, slot(1), RAX);
+        return true;
+    case 0x93: // i2s
+        a.movsx16_mem(RAX, TOP, slot(1));
+        a.store32(TOP, slot(1), RAX);
+        return true;
+    case 0x94: // lcmp
+        load_long(RCX, 2);
+        load_long(RAX, 4);
+        a.sub64_imm(TOP, 12);
+        a.cmp64(RAX, RCX);
+        a.setcc(CC_G, RDX);
+        a.setcc(CC_L, RAX);
+        a.movzx8(RDX, RDX);
+        a.movzx8(RAX, RAX);
+        a.alu64(0x29, RDX, RAX);
+        a.store32(TOP, slot(1), RDX);
+        return true;
+    case 0x99: case 0x9a: case 0x9b: case 0x9c: case 0x9d: case 0x9e: // if<cond>
+    case 0xc6: case 0xc7: { // ifnull ifnonnull
+        static const Cond conds[] = {CC_E, CC_NE, CC_L, CC_GE, CC_G, CC_LE};
+        Cond cc = op == 0xc6 ? CC_E : op == 0xc7 ? CC_NE : conds[op - 0x99];
+        a.sub64_imm(TOP, 4);
+        a.cmp_mem_imm8(TOP, 0, 0);
+        branch(cc, bci + read_s2(code, bci + 1));
+        return true;
+    }
+    case 0x9f: case 0xa0: case 0xa1: case 0xa2: case 0xa3: case 0xa4: // if_icmp<cond>
+    case 0xa5: case 0xa6: { // if_acmpeq if_acmpne
+        static const Cond conds[] = {CC_E, CC_NE, CC_L, CC_GE, CC_G, CC_LE, CC_E, CC_NE};
+        a.sub64_imm(TOP, 8);
+        a.load32(RAX, TOP, 0);
+        a.cmp32_mem(RAX, TOP, 4);
+        branch(conds[op - 0x9f], bci + read_s2(code, bci + 1));
+        return true;
+    }
+    case 0xa7: // goto
+        jump(bci + read_s2(code, bci + 1));
+        return true;
+    case 0xc8: { // goto_w
+        int32_t offset = (int32_t)(((uint32_t)code[bci + 1] << 24) | ((uint32_t)code[bci + 2] << 16) | ((uint32_t)code[bci + 3] << 8) | code[bci + 4]);
+        jump((uint32_t)(bci + offset));
+        return true;
+    }
+    case 0xaa: case 0xab: // tableswitch lookupswitch
+        emit_switch(method.switch_at(bci));
+        return true;
+    // 返回、任意跳转以及未实现的指令退出到解释器
+    case 0xa8: case 0xa9: // jsr ret
+    case 0xac: case 0xad: case 0xae: case 0xaf: case 0xb0: case 0xb1: // xreturn return
+    case 0xbf: case 0xc4: case 0xc9: case 0xca: case 0xfe: case 0xff: // athrow wide jsr_w breakpoint impdep
+        emit_exit(bci);
+        return true;
+    default:
+        if (op > 0xca) {
+            return false;
+        }
+        // 其余指令（浮点运算、数组、字段、对象、方法调用等）回调解释器执行
+        emit_fallback(bci);
+        return true;
+    }
+}
+
+bool TemplateCompiler::compile(JitCode& out) {
+    emit_prologue();
+    out.bci_offsets.assign(code.size(), JitCode::NO_ENTRY);
+    size_t bci = 0;
+    while (bci < code.size()) {
+        size_t len = instruction_length(code, bci);
+        if (bci + len > code.size()) return false;
+        out.bci_offsets[bci] = (uint32_t)a.pos();
+        cur_bci = (uint32_t)bci;
+        if (!method.superinstructions.empty() && method.superinstructions[bci] == SUPER_VECTOR_LOOP) {
+            emit_vector_loop((uint32_t)bci);
+        }
+        if (!emit_instruction((uint32_t)bci)) return false;
+        bci += len;
+    }
+    // 执行越过方法末尾是非法字节码，交给解释器报错
+    emit_exit((uint32_t)code.size());
+    for (const auto& [at, target] : backedge_fixups) {
+        a.patch_rel32(at, a.pos());
+        count_backedge(target);
+        branch_fixups.push_back({a.jmp(), target});
+    }
+    for (const auto& [at, target] : branch_fixups) {
+        if (target >= code.size() || out.bci_offsets[target] == JitCode::NO_ENTRY) return false;
+        a.patch_rel32(at, out.bci_offsets[target]);
+    }
+    for (const auto& [at, target] : exit_fixups) {
+        a.patch_rel32(at, a.pos());
+        emit_exit(target);
+    }
+    return true;
+}
+
+} // namespace
+
+void Jit::compile(const ClassInfo& class_info, const MethodInfo& method) {
+    std::lock_guard<std::mutex> lock(compile_mutex);
+    if (method.jit_code.load(std::memory_order_acquire) || method.jit_failed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const std::string& class_name = class_info.constant_pool.get_class_name(class_info.this_class);
+    auto jit_code = std::make_unique<JitCode>();
+    TemplateCompiler compiler(method, opt_enabled_ ? backedge_threshold_ * 10 : 0);
+    if (!compiler.compile(*jit_code)) {
+        fmt::print("[jit] cannot compile {}.{}{}\n", class_name, method.name, method.descriptor);
+        method.jit_failed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    const std::vector<uint8_t>& machine_code = compiler.machine_code();
+    const uint8_t* dest = install(machine_code);
+    if (!dest) {
+        fmt::print("[jit] code cache full, cannot compile {}.{}{}\n", class_name, method.name, method.descriptor);
+        method.jit_failed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    jit_code->code = dest;
+    jit_code->size = machine_code.size();
+    fmt::print("[jit] compiled {}.{}{}: {} bytes of bytecode -> {} bytes\n", class_name, method.name, method.descriptor, method.code.size(), machine_code.size());
+    method.jit_code.store(jit_code.get(), std::memory_order_release);
+    compiled.push_back(std::move(jit_code));
+}
+
+void Jit::compile_optimized(const ClassInfo& class_info, const MethodInfo& method, const ClassLoader& class_loader) {
+    std::lock_guard<std::mutex> lock(compile_mutex);
+    if (method.opt_code.load(std::memory_order_acquire) || method.opt_failed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const std::string& class_name = class_info.constant_pool.get_class_name(class_info.this_class);
+    OptimizedCode optimized;
+    std::string reason;
+    if (!::compile_optimized(class_info, method, class_loader, OSR_NONE, optimized, reason)) {
+        fmt::print("[jit] tier 2 cannot compile {}.{}{}: {}\n", class_name, method.name, method.descriptor, reason);
+        method.opt_failed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    const uint8_t* dest = install(optimized.machine_code);
+    if (!dest) {
+        fmt::print("[jit] code cache full, cannot compile {}.{}{}\n", class_name, method.name, method.descriptor);
+        method.opt_failed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    auto opt_code = std::make_unique<JitCode>();
+    opt_code->code = dest;
+    opt_code->size = optimized.machine_code.size();
+    opt_code->bci_offsets.assign(1, 0); // 只有方法入口
+    fmt::print("[jit] tier 2 compiled {}.{}{}: {} IR values, {} spilled, {} calls inlined, {} allocations scalar-replaced -> {} bytes\n",
+               class_name, method.name, method.descriptor, optimized.ir_values, optimized.spill_slots, optimized.inlined,
+               optimized.scalar_replaced, optimized.machine_code.size());
+    method.opt_code.store(opt_code.get(), std::memory_order_release);
+    compiled.push_back(std::move(opt_code));
+}
+
+const JitCode* Jit::compile_osr(const ClassInfo& class_info, const MethodInfo& method, uint32_t bci, const ClassLoader& class_loader) {
+    std::lock_guard<std::mutex> lock(compile_mutex);
+    auto key = std::make_pair(&method, bci);
+    auto it = osr_codes.find(key);
+    if (it != osr_codes.end()) {
+        return it->second;
+    }
+    const std::string& class_name = class_info.constant_pool.get_class_name(class_info.this_class);
+    osr_codes[key] = nullptr;
+    OptimizedCode optimized;
+    std::string reason;
+    if (!::compile_optimized(class_info, method, class_loader, bci, optimized, reason)) {
+        fmt::print("[jit] tier 2 cannot compile {}.{}{} for OSR at {}: {}\n", class_name, method.name, method.descriptor, bci, reason);
+        return nullptr;
+    }
+    const uint8_t* dest = install(optimized.machine_code);
+    if (!dest) {
+        fmt::print("[jit] code cache full, cannot compile {}.{}{}\n", class_name, method.name, method.descriptor);
+        return nullptr;
+    }
+    auto osr_code = std::make_unique<JitCode>();
+    osr_code->code = dest;
+    osr_code->size = optimized.machine_code.size();
+    osr_code->bci_offsets.assign(method.code.size(), JitCode::NO_ENTRY);
+    osr_code->bci_offsets[bci] = 0; // 只有循环头
+    fmt::print("[jit] tier 2 compiled {}.{}{} for OSR at {}: {} IR values, {} spilled, {} calls inlined, {} allocations scalar-replaced -> {} bytes\n",
+               class_name, method.name, method.descriptor, bci, optimized.ir_values, optimized.spill_slots, optimized.inlined,
+               optimized.scalar_replaced, optimized.machine_code.size());
+    osr_codes[key] = osr_code.get();
+    compiled.push_back(std::move(osr_code));
+    return osr_codes[key];
+}
+
+// 每段代码从新的页开始，改为可执行后不再写入：其他线程可能正在执行同一页上已安装的代码，不能再改回可写
+const uint8_t* Jit::install(const std::vector<uint8_t>& machine_code) {
+    size_t size = (machine_code.size() + page_size - 1) & ~(page_size - 1);
+    if (cache_used + size > cache_size) {
+        return nullptr;
+    }
+    uint8_t* dest = cache_base + cache_used;
+    std::memcpy(dest, machine_code.data(), machine_code.size());
+    if (mprotect(dest, size, PROT_READ | PROT_EXEC) != 0) {
+        fmt::print("[jit] cannot make code executable\n");
+        return nullptr;
+    }
+    cache_used += size;
+    return dest;
+}
+
+#else
+
+void Jit::compile(const ClassInfo&, const MethodInfo& method) {
+    method.jit_failed.store(true, std::memory_order_relaxed);
+}
+
+void Jit::compile_optimized(const ClassInfo&, const MethodInfo& method, const ClassLoader&) {
+    method.opt_failed.store(true, std::memory_order_relaxed);
+}
+
+const JitCode* Jit::compile_osr(const ClassInfo&, const MethodInfo&, uint32_t, const ClassLoader&) {
+    return nullptr;
+}
+
+const uint8_t* Jit::install(const std::vector<uint8_t>&) {
+    return nullptr;
+}
+
+#endif
+
+const JitCode* Jit::osr_entry(const ClassInfo& class_info, const MethodInfo& method, uint32_t bci,
+                              const ClassLoader& class_loader, uint32_t backedges) {
+    if (opt_enabled_ && backedges >= backedge_threshold_ * 10) {
+        if (const JitCode* osr_code = compile_osr(class_info, method, bci, class_loader)) {
+            return osr_code;
+        }
+    }
+    const JitCode* jit_code = method.jit_code.load(std::memory_order_acquire);
+    if (!jit_code && !method.jit_failed.load(std::memory_order_relaxed)) {
+        compile(class_info, method);
+        jit_code = method.jit_code.load(std::memory_order_acquire);
+    }
+    return jit_code;
+}
@@ -0,0 +1,91 @@
+#ifndef JIT_H
+#define JIT_H
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "runtime.h"
+
+// 模板JIT：方法的调用次数或回边次数超过阈值后，把字节码逐条翻译成固定的x86-64机器码模板。
+// 编译代码直接操作解释器Frame的局部变量表和操作数栈（布局相同），因此两种执行方式可以在任意指令边界切换：
+//   - 解释器在方法入口（pc==0）发现已编译时转入编译代码
+//   - 解释器中回边次数超过阈值时在循环头转入编译代码（栈上替换，OSR）
+//   - 没有模板的指令（字段、对象、方法调用等）由编译代码回调解释器执行这一条，调用的方法在解释器中执行直到返回
+//   - 返回指令和暂不支持的控制流指令（jsr/ret、athrow等）退出到解释器，从该指令继续解释执行
+// 只支持x86-64，其他平台上compile总是失败，解释器照常执行。
+// 调用/回边次数再超过10倍阈值后，由优化编译器（OptimizingCompiler.h）重新编译为第二层代码。
+
+class Interpreter;
+class ClassLoader;
+
+// 编译代码与解释器之间交换的状态
+struct JitFrameState {
+    SlotT* locals;   // Frame::local_vars.vars.data()
+    SlotT* stack;    // Frame::operand_stack.stack.data()，已扩展到max_stack
+    uint64_t sp;     // 操作数栈当前深度（槽位数）
+    uint32_t bci;    // 退出时：解释器继续执行的指令位置
+    Frame* frame;
+    JVMContext* context;
+    Interpreter* interp;
+    std::exception_ptr pending; // 回调解释器时抛出的异常，退出编译代码后重新抛出
+};
+
+struct JitCode {
+    const uint8_t* code;
+    size_t size;
+    std::vector<uint32_t> bci_offsets; // 每条指令对应的机器码偏移，非指令起始处为NO_ENTRY
+    static constexpr uint32_t NO_ENTRY = UINT32_MAX;
+
+    // 从bci处进入编译代码，返回时state.bci/state.sp为解释器继续执行的位置
+    void run(JitFrameState& state, size_t bci) const;
+};
+
+class Jit {
+public:
+    Jit();
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    // 由环境变量JVM_JIT=0关闭；JVM_JIT_THRESHOLD设置调用次数阈值，回边阈值为其10倍
+    bool enabled() const { return enabled_; }
+    uint32_t invocation_threshold() const { return invocation_threshold_; }
+    uint32_t backedge_threshold() const { return backedge_threshold_; }
+    // 第二层：JVM_OPT=0关闭
+    bool should_optimize(const MethodInfo& method, uint32_t invocations) const {
+        return opt_enabled_ && !method.opt_failed.load(std::memory_order_relaxed) &&
+               (invocations >= invocation_threshold_ * 10 || method.backedge_count.load(std::memory_order_relaxed) >= backedge_threshold_ * 10);
+    }
+
+    // 编译方法并发布到method.jit_code，失败时设置method.jit_failed，之后不再尝试
+    void compile(const ClassInfo& class_info, const MethodInfo& method);
+    // 用优化编译器编译并发布到method.opt_code，失败时设置method.opt_failed
+    void compile_optimized(const ClassInfo& class_info, const MethodInfo& method, const ClassLoader& class_loader);
+    // 回边计数达到阈值后，返回可以从循环头bci进入的代码：回边再超过10倍阈值时优先用第二层的OSR代码，
+    // 否则用模板代码（与解释器Frame布局相同，每条指令都可以进入），都没有时返回nullptr
+    const JitCode* osr_entry(const ClassInfo& class_info, const MethodInfo& method, uint32_t bci,
+                             const ClassLoader& class_loader, uint32_t backedges);
+
+private:
+    bool enabled_ = true;
+    bool opt_enabled_ = true;
+    uint32_t invocation_threshold_ = 1000;
+    uint32_t backedge_threshold_ = 10000;
+    std::mutex compile_mutex;
+    uint8_t* cache_base = nullptr; // 代码缓存，只追加，已安装的代码所在的页只读可执行
+    size_t cache_size = 0;
+    size_t cache_used = 0; // 按页对齐
+    size_t page_size = 4096;
+    std::vector<std::unique_ptr<JitCode>> compiled;
+    std::map<std::pair<const MethodInfo*, uint32_t>, const JitCode*> osr_codes; // 第二层OSR代码，编译失败为nullptr
+
+    const JitCode* compile_osr(const ClassInfo& class_info, const MethodInfo& method, uint32_t bci, const ClassLoader& class_loader);
+
+    // 把机器码复制到代码缓存并改为可执行，缓存已满时返回nullptr
+    const uint8_t* install(const std::vector<uint8_t>& machine_code);
+};
+
+#endif // JIT_H
@@ -1,79 +1,140 @@
 #include "NativeMethods.h"
+#include "interpreter.h"
+#include "ObjectMonitor.h"
 #include <map>
 #include <tuple>
 #include <fmt/core.h>
+#include <chrono>
+#include <thread>
 
-static std::map<std::tuple<std::string, std::string, std::string>, NativeMethodFunc> native_table;
+struct NativeEntry {
+    NativeMethodFunc func;
+    bool is_static;
+};
 
-void register_native(const std::string& class_name, const std::string& method_name, const std::string& descriptor, NativeMethodFunc func) {
-    native_table[{class_name, method_name, descriptor}] = func;
+static std::map<std::tuple<std::string, std::string, std::string>, NativeEntry> native_table;
+
+void register_native(const std::string& class_name, const std::string& method_name, const std::string& descriptor,
+                     bool is_static, size_t arg_slots, NativeMethodFunc func) {
+    size_t expected = count_method_arg_slots(descriptor) + (is_static ? 0 : 1);
+    if (arg_slots != expected) {
+        fmt::print("register_native: {}.{}{} takes {} arg slots but the C++ function takes {}\n",
+                   class_name, method_name, descriptor, expected, arg_slots);
+        exit(1);
+    }
+    native_table[{class_name, method_name, descriptor}] = {func, is_static};
 }
 
-NativeMethodFunc find_native(const std::string& class_name, const std::string& method_name, const std::string& descriptor) {
+NativeMethodFunc find_native(const std::string& class_name, const std::string& method_name, const std::string& descriptor, bool is_static) {
     auto it = native_table.find({class_name, method_name, descriptor});
-    if (it != native_table.end()) return it->second;
+    if (it != native_table.end() && it->second.is_static == is_static) return it->second.func;
     return nullptr;
 }
 
 // hashCode: 返回对象引用本身作为hash
-std::optional<SlotT> Object_hashCode(Frame& frame, Interpreter&) {
-    RefT objref = frame.local_vars.get_ref(0);
-    frame.operand_stack.push(objref);
+IntT Object_hashCode(Interpreter&, RefT objref) {
     fmt::print("Object_hashCode {}\n", objref);
-    return {};
+    return static_cast<IntT>(objref);
 }
 
-// getClass: 返回Class对象引用
-std::optional<SlotT> Object_getClass(Frame& frame, Interpreter& interp) {
-    // 获取 this 指针
-    RefT objref = frame.local_vars.get_ref(0);
-    fmt::print("Object_getClass {}\n", objref);
-    // // 获取对象的类名
-    // const JVMObject& obj = interp.get_object(objref);
-    // std::string class_name = obj.class_name;
-
-    // 创建一个 java/lang/Class 对象
-    int class_obj_ref = interp.new_object("java/lang/Class");
-    JVMObject& class_obj = interp.get_object(class_obj_ref);
-    class_obj.class_name = "java/lang/Class";
-    // 存储原始类名，便于反射
-    // class_obj.fields["name"] = class_name;
-
-    // 压入操作数栈
-    return class_obj_ref;
+// getClass: 每个类型只有一个Class对象，第一次调用时创建并记在类型中，同一类型的对象返回同一个引用
+RefT Object_getClass(Interpreter& interp, RefT objref) {
+    const Klass& klass = *interp.get_object(objref).klass;
+    RefT mirror = interp.class_mirror(klass);
+    fmt::print("Object_getClass {} => {} ({})\n", objref, mirror, klass.name);
+    return mirror;
 }
 
 // clone: 返回自身克隆
-std::optional<SlotT> Object_clone(Frame& frame, Interpreter& interp) {
-    RefT objref = frame.local_vars.get_ref(0);
-    RefT new_obj_ref = interp.shallow_clone_object(objref); 
-    frame.operand_stack.push(objref);
+RefT Object_clone(Interpreter& interp, RefT objref) {
+    RefT new_obj_ref = interp.shallow_clone_object(objref);
     fmt::print("Object_clone {} {}\n", objref, new_obj_ref);
-    return {};
+    return new_obj_ref;
 }
 
-std::optional<SlotT> Object_registerNatives(Frame& frame, Interpreter& interp) {
-    RefT objref = frame.local_vars.get_ref(0);
-    fmt::print("Object_registerNatives {}\n", objref);
+// registerNatives: 静态方法，无参数
+void Object_registerNatives(Interpreter&) {
+    fmt::print("Object_registerNatives\n");
     // todo
-    return {};
 }
 
-// // notify/notifyAll/wait: 先做空实现
-// std::optional<SlotT> Object_notify(Frame&, Interpreter& interp) { return {}; }
-// std::optional<SlotT> Object_notifyAll(Frame&, Interpreter& interp) { return {}; }
-// std::optional<SlotT> Object_wait(Frame&, Interpreter& interp) { return {}; }
+// notify/notifyAll/wait: 当前线程必须持有对象的锁
+void Object_notify(Interpreter& interp, RefT objref) {
+    if (!monitor_notify(interp.get_object(objref), false)) {
+        throw JavaRuntimeError("java/lang/IllegalMonitorStateException");
+    }
+}
+
+void Object_notifyAll(Interpreter& interp, RefT objref) {
+    if (!monitor_notify(interp.get_object(objref), true)) {
+        throw JavaRuntimeError("java/lang/IllegalMonitorStateException");
+    }
+}
+
+// wait(long): 0表示一直等到被notify
+void Object_wait(Interpreter& interp, RefT objref, LongT millis) {
+    if (millis < 0) {
+        throw JavaRuntimeError("java/lang/IllegalArgumentException");
+    }
+    if (!monitor_wait(interp.get_object(objref), millis)) {
+        throw JavaRuntimeError("java/lang/IllegalMonitorStateException");
+    }
+}
+
+void Thread_registerNatives(Interpreter&) {
+    fmt::print("Thread_registerNatives\n");
+}
+
+// start0: 在新的OS线程中执行该Thread对象的run()
+void Thread_start0(Interpreter& interp, RefT self) {
+    interp.start_thread(self);
+}
+
+bool Thread_isAlive(Interpreter& interp, RefT self) {
+    return interp.is_thread_alive(self);
+}
+
+RefT Thread_currentThread(Interpreter& interp) {
+    return interp.current_thread();
+}
+
+void Thread_yield(Interpreter&) {
+    std::this_thread::yield();
+}
+
+void Thread_sleep(Interpreter&, LongT millis) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+}
+
+// nanoTime: 单调时钟，只用于计算时间间隔
+LongT System_nanoTime(Interpreter&) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// fillInStackTrace(int): Throwable构造时调用，只记录各帧的方法和pc，getStackTrace时才格式化
+RefT Throwable_fillInStackTrace(Interpreter& interp, RefT self, IntT) {
+    interp.fill_in_stack_trace(*JVMContext::current, self);
+    return self;
+}
 
 // 注册所有内置native方法
 void register_builtin_natives() {
-    register_native("java/lang/Object", "hashCode", "()I", Object_hashCode);
-    register_native("java/lang/Object", "getClass", "()Ljava/lang/Class;", Object_getClass);
-    register_native("java/lang/Object", "clone", "()Ljava/lang/Object;", Object_clone);
-    // register_native("java/lang/Object", "notify", "()V", Object_notify);
-    // register_native("java/lang/Object", "notifyAll", "()V", Object_notifyAll);
-    // register_native("java/lang/Object", "wait", "()V", Object_wait);
-    // register_native("java/lang/Object", "wait", "(J)V", Object_wait);
-    // register_native("java/lang/Object", "wait", "(JI)V", Object_wait);
-    register_native("java/lang/Object", "registerNatives", "()V", Object_registerNatives);
-    register_native("java/lang/System", "registerNatives", "()V", Object_registerNatives);
-}
\ No newline at end of file
+    REGISTER_NATIVE("java/lang/Object", "hashCode", "()I", Object_hashCode);
+    REGISTER_NATIVE("java/lang/Object", "getClass", "()Ljava/lang/Class;", Object_getClass);
+    REGISTER_NATIVE("java/lang/Object", "clone", "()Ljava/lang/Object;", Object_clone);
+    REGISTER_NATIVE("java/lang/Object", "notify", "()V", Object_notify);
+    REGISTER_NATIVE("java/lang/Object", "notifyAll", "()V", Object_notifyAll);
+    // wait()和wait(JI)在JDK中由Java代码实现，最终调用wait(J)（JDK 17起为wait0(J)）
+    REGISTER_NATIVE("java/lang/Object", "wait", "(J)V", Object_wait);
+    REGISTER_NATIVE("java/lang/Object", "wait0", "(J)V", Object_wait);
+    REGISTER_STATIC_NATIVE("java/lang/Object", "registerNatives", "()V", Object_registerNatives);
+    REGISTER_STATIC_NATIVE("java/lang/System", "registerNatives", "()V", Object_registerNatives);
+    REGISTER_STATIC_NATIVE("java/lang/System", "nanoTime", "()J", System_nanoTime);
+    REGISTER_STATIC_NATIVE("java/lang/Thread", "registerNatives", "()V", Thread_registerNatives);
+    REGISTER_NATIVE("java/lang/Thread", "start0", "()V", Thread_start0);
+    REGISTER_NATIVE("java/lang/Thread", "isAlive", "()Z", Thread_isAlive);
+    REGISTER_STATIC_NATIVE("java/lang/Thread", "currentThread", "()Ljava/lang/Thread;", Thread_currentThread);
+    REGISTER_STATIC_NATIVE("java/lang/Thread", "yield", "()V", Thread_yield);
+    REGISTER_STATIC_NATIVE("java/lang/Thread", "sleep", "(J)V", Thread_sleep);
+    REGISTER_NATIVE("java/lang/Throwable", "fillInStackTrace", "(I)Ljava/lang/Throwable;", Throwable_fillInStackTrace);
+}
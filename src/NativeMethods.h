@@ -1,15 +1,88 @@
 #ifndef NATIVEMETHODS_H
 #define NATIVEMETHODS_H
 #include <string>
-#include <functional>
 #include <map>
 #include <vector>
+#include <type_traits>
+#include <utility>
+#include <fmt/core.h>
 #include "runtime.h"
-#include "interpreter.h"
 
-using NativeMethodFunc = std::function<std::optional<SlotT>(Frame&, Interpreter&)>;
 void register_builtin_natives();
-void register_native(const std::string& class_name, const std::string& method_name, const std::string& descriptor, NativeMethodFunc func);
-NativeMethodFunc find_native(const std::string& class_name, const std::string& method_name, const std::string& descriptor);
+// 注册时检查C++函数的参数槽位数与描述符（实例方法加上接收者）一致，不一致是JVM自身的错误，直接退出
+void register_native(const std::string& class_name, const std::string& method_name, const std::string& descriptor,
+                     bool is_static, size_t arg_slots, NativeMethodFunc func);
+// 只返回静态/实例与注册时一致的实现，否则返回nullptr
+NativeMethodFunc find_native(const std::string& class_name, const std::string& method_name, const std::string& descriptor, bool is_static);
 
-#endif
\ No newline at end of file
+// C++参数类型与槽位的对应：long/double占两个槽位，其余占一个
+template <typename T> struct NativeArgTraits;
+template <> struct NativeArgTraits<IntT> {
+    static constexpr size_t width = 1;
+    static IntT read(const NativeArgs& a, size_t i) { return a.get_int(i); }
+};
+template <> struct NativeArgTraits<SlotT> {
+    static constexpr size_t width = 1;
+    static SlotT read(const NativeArgs& a, size_t i) { return a[i]; }
+};
+template <> struct NativeArgTraits<LongT> {
+    static constexpr size_t width = 2;
+    static LongT read(const NativeArgs& a, size_t i) { return a.get_long(i); }
+};
+template <> struct NativeArgTraits<FloatT> {
+    static constexpr size_t width = 1;
+    static FloatT read(const NativeArgs& a, size_t i) { return a.get_float(i); }
+};
+template <> struct NativeArgTraits<DoubleT> {
+    static constexpr size_t width = 2;
+    static DoubleT read(const NativeArgs& a, size_t i) { return a.get_double(i); }
+};
+template <> struct NativeArgTraits<bool> {
+    static constexpr size_t width = 1;
+    static bool read(const NativeArgs& a, size_t i) { return a[i] != 0; }
+};
+
+inline NativeValue to_native_value(IntT v) { return NativeValue::of_int(v); }
+inline NativeValue to_native_value(SlotT v) { return NativeValue::of_slot(v); }
+inline NativeValue to_native_value(LongT v) { return NativeValue::of_long(v); }
+inline NativeValue to_native_value(FloatT v) { return NativeValue::of_float(v); }
+inline NativeValue to_native_value(DoubleT v) { return NativeValue::of_double(v); }
+inline NativeValue to_native_value(bool v) { return NativeValue::of_int(v ? 1 : 0); }
+
+// 由形如 R f(Interpreter&, Args...) 的C++函数在编译期生成NativeMethodFunc胶水代码
+template <auto Fn> struct NativeGlue;
+template <typename R, typename... Args, R (*Fn)(Interpreter&, Args...)>
+struct NativeGlue<Fn> {
+    static constexpr size_t arg_slots = (size_t(0) + ... + NativeArgTraits<Args>::width);
+
+    // 槽位数已在注册时与描述符核对过，调用时不再检查
+    static NativeValue invoke(NativeArgs args, Interpreter& interp) {
+        return call(args, interp, std::index_sequence_for<Args...>{});
+    }
+private:
+    template <size_t I>
+    static constexpr size_t offset_of() {
+        constexpr size_t widths[] = {NativeArgTraits<Args>::width..., 0};
+        size_t off = 0;
+        for (size_t k = 0; k < I; ++k) off += widths[k];
+        return off;
+    }
+    template <size_t... I>
+    static NativeValue call(const NativeArgs& args, Interpreter& interp, std::index_sequence<I...>) {
+        if constexpr (std::is_void_v<R>) {
+            Fn(interp, NativeArgTraits<Args>::read(args, offset_of<I>())...);
+            return NativeValue::none();
+        } else {
+            return to_native_value(Fn(interp, NativeArgTraits<Args>::read(args, offset_of<I>())...));
+        }
+    }
+};
+
+// 用法：REGISTER_NATIVE("java/lang/Object", "hashCode", "()I", Object_hashCode)
+// 其中 IntT Object_hashCode(Interpreter&, RefT self)；静态方法用REGISTER_STATIC_NATIVE，没有接收者参数
+#define REGISTER_NATIVE(class_name, method_name, descriptor, fn) \
+    register_native(class_name, method_name, descriptor, false, NativeGlue<&fn>::arg_slots, &NativeGlue<&fn>::invoke)
+#define REGISTER_STATIC_NATIVE(class_name, method_name, descriptor, fn) \
+    register_native(class_name, method_name, descriptor, true, NativeGlue<&fn>::arg_slots, &NativeGlue<&fn>::invoke)
+
+#endif
@@ -0,0 +1,174 @@
+#include "ObjectMonitor.h"
+#include <chrono>
+#include <thread>
+
+static constexpr uintptr_t LOCK_TAG_MASK = 0b11;
+static constexpr uintptr_t THIN_TAG = 0b01;
+static constexpr uintptr_t FAT_TAG = 0b10;
+static constexpr uintptr_t INFLATING = 0b11;
+static constexpr uintptr_t RECURSION_ONE = uintptr_t(1) << 2;
+static constexpr uintptr_t RECURSION_MAX = (uintptr_t(1) << 30) - 1;
+static constexpr int SPIN_LIMIT = 64; // 竞争时膨胀前的自旋次数
+
+static uintptr_t thin_word(uint32_t owner) { return (uintptr_t(owner) << 32) | THIN_TAG; }
+static uint32_t thin_owner(uintptr_t word) { return static_cast<uint32_t>(word >> 32); }
+static uintptr_t thin_recursions(uintptr_t word) { return (word >> 2) & RECURSION_MAX; }
+static bool is_thin(uintptr_t word) { return (word & LOCK_TAG_MASK) == THIN_TAG; }
+static bool is_fat(uintptr_t word) { return (word & LOCK_TAG_MASK) == FAT_TAG; }
+static ObjectMonitor* fat_monitor(uintptr_t word) { return reinterpret_cast<ObjectMonitor*>(word & ~LOCK_TAG_MASK); }
+
+uint32_t monitor_thread_id() {
+    static std::atomic<uint32_t> next_id{1};
+    static thread_local uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void ObjectMonitor::enter(uint32_t tid) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (owner == tid) {
+        ++count;
+        return;
+    }
+    entry_cv.wait(lock, [this] { return owner == 0; });
+    owner = tid;
+    count = 1;
+}
+
+bool ObjectMonitor::exit(uint32_t tid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (owner != tid) return false;
+    if (--count == 0) {
+        owner = 0;
+        entry_cv.notify_one();
+    }
+    return true;
+}
+
+bool ObjectMonitor::wait(uint32_t tid, LongT millis) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (owner != tid) return false;
+    // 完全释放锁，被唤醒后恢复原来的重入次数
+    uint32_t saved_count = count;
+    owner = 0;
+    count = 0;
+    entry_cv.notify_one();
+    if (millis == 0) {
+        wait_cv.wait(lock);
+    } else {
+        wait_cv.wait_for(lock, std::chrono::milliseconds(millis));
+    }
+    entry_cv.wait(lock, [this] { return owner == 0; });
+    owner = tid;
+    count = saved_count;
+    return true;
+}
+
+bool ObjectMonitor::notify(uint32_t tid, bool all) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (owner != tid) return false;
+    if (all) {
+        wait_cv.notify_all();
+    } else {
+        wait_cv.notify_one();
+    }
+    return true;
+}
+
+// 把observed状态的锁字膨胀为重量锁。锁字已被其他线程改变时返回false，由调用者重试
+static bool inflate(JVMObject& obj, uintptr_t observed) {
+    if (!obj.lock_word.compare_exchange_strong(observed, INFLATING, std::memory_order_acquire)) {
+        return false;
+    }
+    ObjectMonitor* monitor = is_thin(observed)
+        ? new ObjectMonitor(thin_owner(observed), static_cast<uint32_t>(thin_recursions(observed) + 1))
+        : new ObjectMonitor(0, 0);
+    // 没有GC，膨胀后的ObjectMonitor随对象一直存在
+    obj.lock_word.store(reinterpret_cast<uintptr_t>(monitor) | FAT_TAG, std::memory_order_release);
+    return true;
+}
+
+// 返回对象的重量锁，必要时先膨胀
+static ObjectMonitor* inflated_monitor(JVMObject& obj) {
+    while (true) {
+        uintptr_t word = obj.lock_word.load(std::memory_order_acquire);
+        if (is_fat(word)) return fat_monitor(word);
+        if (word == INFLATING) {
+            std::this_thread::yield();
+            continue;
+        }
+        inflate(obj, word);
+    }
+}
+
+void monitor_enter(JVMObject& obj) {
+    uint32_t tid = monitor_thread_id();
+    int spins = 0;
+    while (true) {
+        uintptr_t word = obj.lock_word.load(std::memory_order_acquire);
+        if (word == 0) {
+            if (obj.lock_word.compare_exchange_weak(word, thin_word(tid), std::memory_order_acquire)) return;
+            continue;
+        }
+        if (is_thin(word)) {
+            if (thin_owner(word) == tid) {
+                if (thin_recursions(word) == RECURSION_MAX) {
+                    inflate(obj, word);
+                } else if (obj.lock_word.compare_exchange_weak(word, word + RECURSION_ONE, std::memory_order_acquire)) {
+                    return;
+                }
+                continue;
+            }
+            // 被其他线程持有：短暂自旋后膨胀
+            if (++spins < SPIN_LIMIT) {
+                std::this_thread::yield();
+            } else {
+                inflate(obj, word);
+            }
+            continue;
+        }
+        if (word == INFLATING) {
+            std::this_thread::yield();
+            continue;
+        }
+        fat_monitor(word)->enter(tid);
+        return;
+    }
+}
+
+bool monitor_exit(JVMObject& obj) {
+    uint32_t tid = monitor_thread_id();
+    while (true) {
+        uintptr_t word = obj.lock_word.load(std::memory_order_acquire);
+        if (is_thin(word)) {
+            if (thin_owner(word) != tid) return false;
+            uintptr_t released = thin_recursions(word) == 0 ? 0 : word - RECURSION_ONE;
+            if (obj.lock_word.compare_exchange_weak(word, released, std::memory_order_release)) return true;
+            continue; // 其他线程正在膨胀
+        }
+        if (word == INFLATING) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (is_fat(word)) return fat_monitor(word)->exit(tid);
+        return false;
+    }
+}
+
+static bool owned_by_current_thread(uintptr_t word, uint32_t tid) {
+    return !(is_thin(word) && thin_owner(word) != tid) && word != 0;
+}
+
+bool monitor_wait(JVMObject& obj, LongT millis) {
+    uint32_t tid = monitor_thread_id();
+    if (!owned_by_current_thread(obj.lock_word.load(std::memory_order_acquire), tid)) return false;
+    return inflated_monitor(obj)->wait(tid, millis);
+}
+
+bool monitor_notify(JVMObject& obj, bool all) {
+    uint32_t tid = monitor_thread_id();
+    uintptr_t word = obj.lock_word.load(std::memory_order_acquire);
+    if (!owned_by_current_thread(word, tid)) return false;
+    // 轻量锁意味着没有线程在wait（wait会先膨胀），notify无事可做
+    if (is_thin(word)) return true;
+    return inflated_monitor(obj)->notify(tid, all);
+}
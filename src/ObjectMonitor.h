@@ -0,0 +1,44 @@
+#ifndef OBJECTMONITOR_H
+#define OBJECTMONITOR_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include "runtime.h"
+
+// 对象头中的锁字（JVMObject::lock_word）编码：
+//   0                                  未加锁
+//   owner<<32 | recursions<<2 | 0b01   轻量锁（thin lock），recursions为重入次数（不含第一次）
+//   0b11                               正在膨胀，其他线程自旋等待
+//   ObjectMonitor* | 0b10              重量锁（fat monitor）
+// 无竞争时加解锁只是一次CAS，出现竞争或wait/notify时膨胀为ObjectMonitor
+static_assert(sizeof(uintptr_t) == 8, "lock word layout assumes 64-bit pointers");
+
+// 重量锁：互斥量+条件变量，记录持有者和重入次数
+class ObjectMonitor {
+public:
+    ObjectMonitor(uint32_t owner, uint32_t count) : owner(owner), count(count) {}
+    void enter(uint32_t tid);
+    // 非持有者调用时返回false
+    bool exit(uint32_t tid);
+    // millis为0表示无限等待；非持有者调用时返回false
+    bool wait(uint32_t tid, LongT millis);
+    bool notify(uint32_t tid, bool all);
+private:
+    std::mutex mutex;
+    std::condition_variable entry_cv; // 等待获取锁的线程
+    std::condition_variable wait_cv;  // Object.wait中的线程
+    uint32_t owner; // 0表示无持有者
+    uint32_t count; // 持有者的加锁次数
+};
+
+// 当前线程的锁标识（从1开始）
+uint32_t monitor_thread_id();
+
+void monitor_enter(JVMObject& obj);
+// 当前线程未持有锁时返回false（IllegalMonitorStateException）
+bool monitor_exit(JVMObject& obj);
+bool monitor_wait(JVMObject& obj, LongT millis);
+bool monitor_notify(JVMObject& obj, bool all);
+
+#endif // OBJECTMONITOR_H
@@ -0,0 +1,1920 @@
+#include "OptimizingCompiler.h"
+
+#if defined(__x86_64__)
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include "ClassLoader.h"
+#include "Jit.h"
+#include "bytecode.h"
+#include "x86Assembler.h"
+
+namespace {
+
+using namespace x64;
+
+constexpr size_t MAX_INLINE_SIZE = 64;  // 可内联方法的最大字节码长度
+constexpr size_t MAX_INLINE_DEPTH = 3;
+constexpr size_t MAX_IR_VALUES = 20000;
+
+// Ref是标量替换的对象的引用（Op::New），只出现在局部变量、操作数栈和内联的参数中，不生成代码
+enum class Type : uint8_t { Int, Long, Ref };
+enum class Op : uint8_t { Const, Param, StackParam, Phi, New, Add, Sub, Mul, Div, Rem, Neg, Shl, Shr, Ushr, And, Or, Xor, I2L, L2I, I2B, I2C, I2S, LCmp };
+
+struct Block;
+struct FrameState;
+
+struct Value {
+    int id = 0;
+    Op op;
+    Type type;
+    int64_t imm = 0;          // Const的值，Param的局部变量下标，StackParam的操作数栈槽位，New的对象编号
+    std::vector<Value*> args; // Phi的参数与所在块的preds一一对应
+    Block* block = nullptr;   // Const不属于任何块，使用处直接生成立即数
+    Value* forward = nullptr; // 被删除的值指向替代它的值
+    bool conflict = false;    // 合并点两侧类型不同的phi，只要不被使用就是合法的字节码
+    bool checked = false;     // Div/Rem的除数可能为0，为0时去优化
+    FrameState* state = nullptr;
+    // 寄存器分配
+    int pos = 0;
+    int from = INT_MAX, to = -1;
+    int reg = -1;
+    int spill = -1;
+};
+
+// 去优化时写回解释器Frame的状态；long占两个槽位，第二个槽位为nullptr
+struct FrameState {
+    uint32_t bci;
+    std::vector<Value*> locals;
+    std::vector<Value*> stack;
+};
+
+enum class Term : uint8_t { None, Goto, If, Return, Exit };
+
+struct Block {
+    int id = 0;
+    std::vector<Value*> phis;
+    std::vector<Value*> insts;
+    Term term = Term::None;
+    Cond cond = CC_E;
+    Value* lhs = nullptr; // If：lhs cond rhs时跳转到succs[0]；Return：返回值，void方法为nullptr
+    Value* rhs = nullptr;
+    uint32_t bci = 0;     // Return：返回指令的位置
+    FrameState* state = nullptr; // Exit：退出到解释器时的状态
+    std::vector<Block*> succs;
+    std::vector<Block*> preds;
+    // 分析结果
+    int rpo = -1;
+    Block* idom = nullptr;
+    std::vector<Block*> dom_children;
+    int start = 0, end = 0;
+};
+
+struct Bailout {
+    std::string reason;
+};
+
+Value* resolve(Value* v) {
+    while (v && v->forward) v = v->forward;
+    return v;
+}
+
+bool is_const(const Value* v) { return v->op == Op::Const; }
+
+bool is_virtual(const Value* v) { return v && v->type == Type::Ref; }
+
+// 入口处从Frame读取的值
+bool is_param(const Value* v) { return v->op == Op::Param || v->op == Op::StackParam; }
+
+// 没有副作用、可以删除、合并和外提的运算；除数可能为0的除法会去优化，不能移动
+bool is_pure(const Value* v) {
+    switch (v->op) {
+    case Op::Const: case Op::Param: case Op::StackParam: case Op::Phi: case Op::New:
+        return false;
+    case Op::Div: case Op::Rem:
+        return !v->checked;
+    default:
+        return true;
+    }
+}
+
+bool is_commutative(Op op) {
+    return op == Op::Add || op == Op::Mul || op == Op::And || op == Op::Or || op == Op::Xor;
+}
+
+// 按Java语义计算常量运算，除数为0时不折叠
+bool fold(Op op, Type type, const std::vector<Value*>& args, int64_t& result) {
+    for (Value* a : args) {
+        if (!is_const(a)) return false;
+    }
+    int64_t x = args.empty() ? 0 : args[0]->imm;
+    int64_t y = args.size() > 1 ? args[1]->imm : 0;
+    if (type == Type::Int && op != Op::L2I && op != Op::LCmp) {
+        int32_t a = (int32_t)x, b = (int32_t)y;
+        uint32_t ua = (uint32_t)a, ub = (uint32_t)b;
+        switch (op) {
+        case Op::Add: result = (int32_t)(ua + ub); return true;
+        case Op::Sub: result = (int32_t)(ua - ub); return true;
+        case Op::Mul: result = (int32_t)(ua * ub); return true;
+        case Op::Div:
+            if (b == 0) return false;
+            result = b == -1 ? (int32_t)(0u - ua) : a / b;
+            return true;
+        case Op::Rem:
+            if (b == 0) return false;
+            result = b == -1 ? 0 : a % b;
+            return true;
+        case Op::Neg: result = (int32_t)(0u - ua); return true;
+        case Op::Shl: result = (int32_t)(ua << (b & 31)); return true;
+        case Op::Shr: result = a >> (b & 31); return true;
+        case Op::Ushr: result = (int32_t)(ua >> (b & 31)); return true;
+        case Op::And: result = a & b; return true;
+        case Op::Or: result = a | b; return true;
+        case Op::Xor: result = a ^ b; return true;
+        case Op::I2B: result = (int8_t)a; return true;
+        case Op::I2C: result = (uint16_t)a; return true;
+        case Op::I2S: result = (int16_t)a; return true;
+        default: return false;
+        }
+    }
+    uint64_t ux = (uint64_t)x, uy = (uint64_t)y;
+    switch (op) {
+    case Op::L2I: result = (int32_t)x; return true;
+    case Op::I2L: result = (int64_t)(int32_t)x; return true;
+    case Op::LCmp: result = x < y ? -1 : (x > y ? 1 : 0); return true;
+    case Op::Add: result = (int64_t)(ux + uy); return true;
+    case Op::Sub: result = (int64_t)(ux - uy); return true;
+    case Op::Mul: result = (int64_t)(ux * uy); return true;
+    case Op::Div:
+        if (y == 0) return false;
+        result = y == -1 ? (int64_t)(0 - ux) : x / y;
+        return true;
+    case Op::Rem:
+        if (y == 0) return false;
+        result = y == -1 ? 0 : x % y;
+        return true;
+    case Op::Neg: result = (int64_t)(0 - ux); return true;
+    case Op::Shl: result = (int64_t)(ux << (y & 63)); return true;
+    case Op::Shr: result = x >> (y & 63); return true;
+    case Op::Ushr: result = (int64_t)(ux >> (y & 63)); return true;
+    case Op::And: result = x & y; return true;
+    case Op::Or: result = x | y; return true;
+    case Op::Xor: result = x ^ y; return true;
+    default: return false;
+    }
+}
+
+struct Graph {
+    std::vector<std::unique_ptr<Value>> values;
+    std::vector<std::unique_ptr<Block>> blocks;
+    std::vector<std::unique_ptr<FrameState>> states;
+    std::map<std::pair<Type, int64_t>, Value*> constants;
+    Block* entry = nullptr;
+
+    Value* make(Op op, Type type, std::vector<Value*> args = {}, int64_t imm = 0) {
+        if (values.size() >= MAX_IR_VALUES) throw Bailout{"method too large"};
+        auto v = std::make_unique<Value>();
+        v->id = (int)values.size();
+        v->op = op;
+        v->type = type;
+        v->args = std::move(args);
+        v->imm = imm;
+        values.push_back(std::move(v));
+        return values.back().get();
+    }
+    Value* constant(Type type, int64_t imm) {
+        if (type == Type::Int) imm = (int32_t)imm;
+        Value*& c = constants[{type, imm}];
+        if (!c) c = make(Op::Const, type, {}, imm);
+        return c;
+    }
+    FrameState* new_state(FrameState state) {
+        states.push_back(std::make_unique<FrameState>(std::move(state)));
+        return states.back().get();
+    }
+    Block* new_block() {
+        blocks.push_back(std::make_unique<Block>());
+        blocks.back()->id = (int)blocks.size() - 1;
+        return blocks.back().get();
+    }
+    static void link(Block* from, Block* to) {
+        from->succs.push_back(to);
+        to->preds.push_back(from);
+    }
+};
+
+// 方法描述符中每个参数槽位的类型：'I'为int类，'J'为long（第二个槽位为0），'X'为不支持的类型
+std::vector<char> parse_arg_slots(const std::string& desc, char& ret) {
+    std::vector<char> slots;
+    size_t i = 1;
+    for (; i < desc.size() && desc[i] != ')'; ++i) {
+        char c = desc[i];
+        if (c == '[' || c == 'L') {
+            while (desc[i] == '[') ++i;
+            if (desc[i] == 'L') {
+                while (desc[i] != ';') ++i;
+            }
+            slots.push_back('X');
+        } else if (c == 'J') {
+            slots.push_back('J');
+            slots.push_back(0);
+        } else if (c == 'D') {
+            slots.push_back('X');
+            slots.push_back(0);
+        } else if (c == 'F') {
+            slots.push_back('X');
+        } else {
+            slots.push_back('I'); // I Z B C S
+        }
+    }
+    char r = i + 1 < desc.size() ? desc[i + 1] : 'V';
+    ret = (r == 'Z' || r == 'B' || r == 'C' || r == 'S') ? 'I' : r;
+    return slots;
+}
+
+int16_t read_s2(const std::vector<uint8_t>& code, size_t pc) {
+    return (int16_t)((code[pc] << 8) | code[pc + 1]);
+}
+
+uint16_t read_u2(const std::vector<uint8_t>& code, size_t pc) {
+    return (uint16_t)((code[pc] << 8) | code[pc + 1]);
+}
+
+// 从字节码构造SSA：按逆后序处理基本块，有多个前驱的块为每个槽位建phi，之后删除平凡phi。
+// 构造的同时做逃逸分析：new不分配对象，得到一个虚拟对象，它的int字段和局部变量一样作为SSA值跟踪（标量替换）。
+// 虚拟对象只能被aload/astore、栈操作、getfield/putfield和内联的调用（构造函数、确定接收者类型的invokevirtual、
+// invokestatic的参数）使用；其他使用（存入字段或数组、返回、比较、活跃时退出到解释器等）都是逃逸，放弃编译
+class Builder {
+public:
+    Builder(Graph& g, const ClassLoader& loader) : g(g), loader(loader) {}
+
+    size_t inlined = 0;
+    size_t scalar_replaced = 0;
+
+    void build(const ClassInfo& cls, const MethodInfo& method, uint32_t osr_bci) {
+        g.entry = g.new_block();
+        char ret;
+        std::vector<char> arg_slots = parse_arg_slots(method.descriptor, ret);
+        if (!(method.access_flags & ACC_STATIC)) arg_slots.insert(arg_slots.begin(), 'X');
+        Slots locals(method.max_locals, nullptr);
+        for (size_t i = 0; i < arg_slots.size() && i < locals.size(); ++i) {
+            if (arg_slots[i] != 'I' && arg_slots[i] != 'J') continue;
+            Value* p = g.make(Op::Param, arg_slots[i] == 'J' ? Type::Long : Type::Int, {}, (int64_t)i);
+            p->block = g.entry;
+            g.entry->insts.push_back(p);
+            locals[i] = p;
+        }
+        std::vector<const MethodInfo*> inline_stack{&method};
+        this->osr_bci = osr_bci;
+        parse_method(cls, method, g.entry, locals, {}, nullptr, inline_stack);
+        if (osr_bci != OSR_NONE) add_osr_entry();
+    }
+
+private:
+    using Slots = std::vector<Value*>;
+
+    // 内联方法的一个返回点：返回值和返回时虚拟对象的字段
+    struct ReturnSite {
+        Block* block;
+        Value* value;
+        Slots fields;
+    };
+    using Returns = std::vector<ReturnSite>;
+
+    struct BytecodeBlock {
+        uint32_t start = 0, end = 0;
+        std::vector<size_t> succs;
+        int preds = 0;
+        bool reachable = false;
+        bool started = false;
+        Block* ir = nullptr;
+        Slots locals, stack, fields;
+        std::vector<bool> live_in, live_out; // 局部变量槽位的活跃性
+    };
+
+    // 标量替换的对象：实例字段（按声明的类区分，子类遮蔽的父类同名字段各占一个下标）到fields下标的映射
+    struct VirtualObject {
+        std::string class_name;
+        std::map<const FieldInfo*, size_t> field_slots;
+    };
+
+    Graph& g;
+    const ClassLoader& loader;
+    std::vector<VirtualObject> objects;
+    size_t field_count = 0; // 所有虚拟对象的字段数，即fields的长度
+    // OSR：循环头的块和进入该块时各槽位的phi
+    uint32_t osr_bci = OSR_NONE;
+    Block* osr_header = nullptr;
+    Slots osr_locals, osr_stack, osr_fields;
+
+    // OSR入口：从解释器Frame读取循环头处活跃的局部变量和操作数栈，作为循环头phi的一个新前驱。
+    // 方法入口到循环头的路径此后不可达，由优化器删除。
+    // 循环头处活跃的虚拟对象在解释器中是真实的对象，无法从Frame读取，放弃编译；失效对象的字段不会被使用
+    void add_osr_entry() {
+        if (!osr_header) throw Bailout{"OSR target is not a loop header"};
+        Block* osr = g.new_block();
+        osr->term = Term::Goto;
+        auto read_slots = [&](const Slots& phis, Op op) {
+            for (size_t i = 0; i < phis.size(); ++i) {
+                Value* phi = phis[i];
+                if (!phi) continue;
+                if (is_virtual(phi)) throw Bailout{"scalar-replaced object live at the OSR entry"};
+                Value* p = g.make(op, phi->type, {}, (int64_t)i);
+                p->block = osr;
+                osr->insts.push_back(p);
+                phi->args.push_back(p);
+            }
+        };
+        read_slots(osr_locals, Op::Param);
+        read_slots(osr_stack, Op::StackParam);
+        for (Value* phi : osr_fields) {
+            if (!phi || phi->op != Op::Phi) continue;
+            phi->conflict = true;
+            phi->args.push_back(phi);
+        }
+        Graph::link(osr, osr_header);
+        g.entry = osr;
+    }
+
+    // 能编译的指令；ldc只支持int常量，ldc2_w只支持long常量
+    static bool supported(const ClassInfo& cls, const std::vector<uint8_t>& code, size_t bci) {
+        uint8_t op = code[bci];
+        if (op == 0x12 || op == 0x13) {
+            return cls.constant_pool[op == 0x12 ? code[bci + 1] : read_u2(code, bci + 1)].tag == ConstantType::INTEGER;
+        }
+        if (op == 0x14) {
+            return cls.constant_pool[read_u2(code, bci + 1)].tag == ConstantType::LONG;
+        }
+        switch (op) {
+        case 0x00: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07: case 0x08: case 0x09: case 0x0a:
+        case 0x10: case 0x11: case 0x12: case 0x13: case 0x14: case 0x15: case 0x16:
+        case 0x1a: case 0x1b: case 0x1c: case 0x1d: case 0x1e: case 0x1f: case 0x20: case 0x21:
+        case 0x36: case 0x37: case 0x3b: case 0x3c: case 0x3d: case 0x3e: case 0x3f: case 0x40: case 0x41: case 0x42:
+        case 0x57: case 0x58: case 0x59: case 0x5a: case 0x5b: case 0x5c: case 0x5d: case 0x5e: case 0x5f:
+        case 0x60: case 0x61: case 0x64: case 0x65: case 0x68: case 0x69: case 0x6c: case 0x6d: case 0x70: case 0x71:
+        case 0x74: case 0x75: case 0x78: case 0x79: case 0x7a: case 0x7b: case 0x7c: case 0x7d:
+        case 0x7e: case 0x7f: case 0x80: case 0x81: case 0x82: case 0x83: case 0x84: case 0x85: case 0x88:
+        case 0x91: case 0x92: case 0x93: case 0x94:
+        case 0x99: case 0x9a: case 0x9b: case 0x9c: case 0x9d: case 0x9e:
+        case 0x9f: case 0xa0: case 0xa1: case 0xa2: case 0xa3: case 0xa4: case 0xa7:
+        case 0xac: case 0xad: case 0xb1: case 0xb8: case 0xc8:
+        // 对象相关的指令：操作数不是虚拟对象时放弃编译或退出到解释器
+        case 0x19: case 0x2a: case 0x2b: case 0x2c: case 0x2d: case 0x3a: case 0x4b: case 0x4c: case 0x4d: case 0x4e:
+        case 0xb4: case 0xb5: case 0xb6: case 0xb7: case 0xbb:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool is_branch(uint8_t op) { return (op >= 0x99 && op <= 0xa7) || op == 0xc8; }
+    static bool is_return(uint8_t op) { return op == 0xac || op == 0xad || op == 0xb1; }
+
+    static uint32_t branch_target(const std::vector<uint8_t>& code, uint32_t bci) {
+        if (code[bci] == 0xc8) {
+            int32_t offset = (int32_t)(((uint32_t)code[bci + 1] << 24) | ((uint32_t)code[bci + 2] << 16) | ((uint32_t)code[bci + 3] << 8) | code[bci + 4]);
+            return (uint32_t)(bci + offset);
+        }
+        return (uint32_t)(bci + read_s2(code, bci + 1));
+    }
+
+    // 划分基本块，不支持的指令放弃编译。
+    // OSR编译时外层方法中不支持的指令作为退出点结束所在的块，执行到时退出到解释器（循环之后的代码常常如此）
+    std::vector<BytecodeBlock> find_blocks(const ClassInfo& cls, const std::vector<uint8_t>& code, bool allow_exits) {
+        std::set<uint32_t> leaders{0};
+        std::vector<bool> is_start(code.size() + 1, false);
+        size_t bci = 0;
+        while (bci < code.size()) {
+            uint8_t op = code[bci];
+            size_t len = instruction_length(code, bci);
+            if (bci + len > code.size()) throw Bailout{"truncated bytecode"};
+            is_start[bci] = true;
+            if (!supported(cls, code, bci)) {
+                if (!allow_exits) throw Bailout{std::string("unsupported opcode ") + opcode_name(op)};
+                leaders.insert((uint32_t)(bci + len));
+            } else if (is_branch(op)) {
+                leaders.insert(branch_target(code, (uint32_t)bci));
+                leaders.insert((uint32_t)(bci + len));
+            } else if (is_return(op)) {
+                leaders.insert((uint32_t)(bci + len));
+            }
+            bci += len;
+        }
+        std::vector<BytecodeBlock> blocks;
+        for (uint32_t leader : leaders) {
+            if (leader >= code.size()) continue;
+            if (!is_start[leader]) throw Bailout{"branch into the middle of an instruction"};
+            BytecodeBlock b;
+            b.start = leader;
+            blocks.push_back(b);
+        }
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            blocks[i].end = i + 1 < blocks.size() ? blocks[i + 1].start : (uint32_t)code.size();
+        }
+        auto index_of = [&](uint32_t target) -> size_t {
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                if (blocks[i].start == target) return i;
+            }
+            throw Bailout{"control flow falls off the end of the method"};
+        };
+        for (auto& b : blocks) {
+            uint32_t last = b.start;
+            for (uint32_t pc = b.start; pc < b.end; pc += (uint32_t)instruction_length(code, pc)) last = pc;
+            uint8_t op = code[last];
+            if (!supported(cls, code, last)) {
+                continue;
+            } else if (is_branch(op)) {
+                b.succs.push_back(index_of(branch_target(code, last)));
+                if (op != 0xa7 && op != 0xc8) b.succs.push_back(index_of(b.end));
+            } else if (!is_return(op)) {
+                b.succs.push_back(index_of(b.end));
+            }
+        }
+        return blocks;
+    }
+
+    // 局部变量活跃性的逐条指令传递（从后往前）。不支持的指令由解释器执行，看作使用所有局部变量
+    static void transfer(const ClassInfo& cls, const std::vector<uint8_t>& code, uint32_t pc, std::vector<bool>& live) {
+        uint8_t op = code[pc];
+        auto set = [&](size_t idx, bool wide, bool value) {
+            for (size_t k = idx; k < idx + (wide ? 2 : 1) && k < live.size(); ++k) live[k] = value;
+        };
+        if (!supported(cls, code, pc)) {
+            live.assign(live.size(), true);
+        } else if (op >= 0x15 && op <= 0x19) {
+            set(code[pc + 1], op == 0x16 || op == 0x18, true);
+        } else if (op >= 0x1a && op <= 0x2d) {
+            int kind = (op - 0x1a) / 4;
+            set((op - 0x1a) % 4, kind == 1 || kind == 3, true);
+        } else if (op >= 0x36 && op <= 0x3a) {
+            set(code[pc + 1], op == 0x37 || op == 0x39, false);
+        } else if (op >= 0x3b && op <= 0x4e) {
+            int kind = (op - 0x3b) / 4;
+            set((op - 0x3b) % 4, kind == 1 || kind == 3, false);
+        } else if (op == 0x84) {
+            set(code[pc + 1], false, true);
+        }
+    }
+
+    // 执行pc处的指令之前活跃的局部变量。有异常表时处理器可能读取任何局部变量，都看作活跃
+    static std::vector<bool> live_before(const ClassInfo& cls, const MethodInfo& method, const BytecodeBlock& bb, uint32_t pc) {
+        std::vector<bool> live = bb.live_out;
+        if (!method.exception_table.empty()) return live;
+        std::vector<uint32_t> pcs;
+        for (uint32_t p = pc; p < bb.end; p += (uint32_t)instruction_length(method.code, p)) pcs.push_back(p);
+        for (auto it = pcs.rbegin(); it != pcs.rend(); ++it) transfer(cls, method.code, *it, live);
+        return live;
+    }
+
+    // 基本块入口和出口处局部变量的活跃性，用于丢弃已失效的虚拟对象引用
+    static void compute_liveness(const ClassInfo& cls, const MethodInfo& method, std::vector<BytecodeBlock>& blocks) {
+        bool all = !method.exception_table.empty();
+        for (auto& b : blocks) {
+            b.live_in.assign(method.max_locals, all);
+            b.live_out.assign(method.max_locals, all);
+        }
+        if (all) return;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = blocks.size(); i-- > 0;) {
+                BytecodeBlock& b = blocks[i];
+                for (size_t s : b.succs) {
+                    for (size_t k = 0; k < b.live_out.size(); ++k) {
+                        if (blocks[s].live_in[k] && !b.live_out[k]) b.live_out[k] = true;
+                    }
+                }
+                std::vector<bool> in = live_before(cls, method, b, b.start);
+                if (in != b.live_in) {
+                    b.live_in = std::move(in);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // 退出到解释器和去优化时写回Frame的状态。虚拟对象没有分配，已失效的槽位直接丢弃，仍活跃说明对象逃逸
+    FrameState* frame_state(uint32_t pc, Slots locals, Slots stack, const std::vector<bool>& live) {
+        for (size_t i = 0; i < locals.size(); ++i) {
+            if (!is_virtual(locals[i])) continue;
+            if (i >= live.size() || live[i]) throw Bailout{"scalar-replaced object live at an exit to the interpreter"};
+            locals[i] = nullptr;
+        }
+        if (std::any_of(stack.begin(), stack.end(), is_virtual)) throw Bailout{"scalar-replaced object live at an exit to the interpreter"};
+        return g.new_state(FrameState{pc, std::move(locals), std::move(stack)});
+    }
+
+    // 分配虚拟对象：实例字段（含父类）都从0开始，只跟踪int类字段，访问其他字段时放弃编译
+    Value* allocate(const std::string& class_name, Slots& fields) {
+        const ClassInfo* c = loader.find_loaded_class(class_name);
+        if (!c) throw Bailout{"class not initialized: " + class_name};
+        VirtualObject obj{class_name, {}};
+        while (c) {
+            for (const FieldInfo& f : c->fields) {
+                if (f.access_flags & ACC_STATIC) continue;
+                char t = f.descriptor[0];
+                if (t != 'I' && t != 'Z' && t != 'B' && t != 'C' && t != 'S') continue;
+                obj.field_slots.emplace(&f, field_count++);
+            }
+            c = c->super_class ? loader.find_loaded_class(c->constant_pool.get_class_name(c->super_class)) : nullptr;
+        }
+        fields.resize(field_count, nullptr);
+        for (auto& [field, slot] : obj.field_slots) fields[slot] = g.constant(Type::Int, 0);
+        objects.push_back(std::move(obj));
+        scalar_replaced++;
+        Value* ref = g.make(Op::New, Type::Ref, {}, (int64_t)objects.size() - 1);
+        return ref;
+    }
+
+    // 与Interpreter::resolve_field相同：从字段引用中的类开始依次在父类中查找，找到的字段决定对象中的下标
+    size_t field_slot(const Value* ref, const ClassInfo& cls, uint16_t index) {
+        const VirtualObject& obj = objects[ref->imm];
+        const ConstantPoolInfo& fieldref = cls.constant_pool[index];
+        const std::string& class_name = cls.constant_pool.get_class_name(fieldref.fieldref_class_index);
+        auto [name, desc] = cls.constant_pool.get_name_and_type(fieldref.fieldref_name_type_index);
+        const FieldInfo* field = nullptr;
+        for (const ClassInfo* c = loader.find_loaded_class(class_name); c && !field;
+             c = c->super_class ? loader.find_loaded_class(c->constant_pool.get_class_name(c->super_class)) : nullptr) {
+            for (const FieldInfo& f : c->fields) {
+                if ((f.access_flags & ACC_STATIC) == 0 && f.name == name && f.descriptor == desc) {
+                    field = &f;
+                    break;
+                }
+            }
+        }
+        auto it = obj.field_slots.find(field);
+        if (it == obj.field_slots.end()) throw Bailout{"unsupported field " + class_name + "." + name};
+        return it->second;
+    }
+
+    // 经过from -> to的边把状态传给目标块。
+    // 虚拟对象的引用不建phi：目标块入口处已失效的槽位丢弃，仍活跃的槽位在每条边上必须是同一个对象
+    void connect(Block* from, BytecodeBlock& to, const Slots& in_locals, const Slots& stack, const Slots& in_fields) {
+        Graph::link(from, to.ir);
+        Slots locals = in_locals;
+        for (size_t i = 0; i < locals.size(); ++i) {
+            if (is_virtual(locals[i]) && !to.live_in[i]) locals[i] = nullptr;
+        }
+        Slots fields = in_fields;
+        fields.resize(field_count, nullptr);
+        if (to.preds == 1) {
+            to.locals = locals;
+            to.stack = stack;
+            to.fields = fields;
+            to.started = true;
+            return;
+        }
+        if (!to.started) {
+            to.started = true;
+            auto make_phis = [&](const Slots& in, Slots& out) {
+                out.assign(in.size(), nullptr);
+                for (size_t i = 0; i < in.size(); ++i) {
+                    if (!in[i] || is_virtual(in[i])) {
+                        out[i] = in[i];
+                        continue;
+                    }
+                    Value* phi = g.make(Op::Phi, in[i]->type, {in[i]});
+                    phi->block = to.ir;
+                    to.ir->phis.push_back(phi);
+                    out[i] = phi;
+                }
+            };
+            make_phis(locals, to.locals);
+            make_phis(stack, to.stack);
+            make_phis(fields, to.fields);
+            return;
+        }
+        if (stack.size() != to.stack.size()) throw Bailout{"inconsistent stack depth"};
+        // 目标块建立之后才分配的对象的字段在目标块中不可见，不需要传递
+        auto add_args = [](const Slots& in, const Slots& phis) {
+            for (size_t i = 0; i < phis.size(); ++i) {
+                Value* phi = phis[i];
+                Value* v = i < in.size() ? in[i] : nullptr;
+                if (is_virtual(phi) || is_virtual(v)) {
+                    if (phi != v) throw Bailout{"different objects merge at a branch target"};
+                    continue;
+                }
+                if (!phi) continue;
+                if (!v || v->type != phi->type) {
+                    phi->conflict = true;
+                    phi->args.push_back(phi);
+                } else {
+                    phi->args.push_back(v);
+                }
+            }
+        };
+        add_args(locals, to.locals);
+        add_args(stack, to.stack);
+        add_args(fields, to.fields);
+    }
+
+    void parse_method(const ClassInfo& cls, const MethodInfo& method, Block* entry, const Slots& entry_locals,
+                      const Slots& entry_fields, Returns* returns, std::vector<const MethodInfo*>& inline_stack) {
+        const std::vector<uint8_t>& code = method.code;
+        if (code.empty()) throw Bailout{"empty method"};
+        bool allow_exits = returns == nullptr && osr_bci != OSR_NONE;
+        std::vector<BytecodeBlock> blocks = find_blocks(cls, code, allow_exits);
+        compute_liveness(cls, method, blocks);
+
+        // 逆后序
+        std::vector<size_t> order;
+        {
+            std::vector<int> state(blocks.size(), 0);
+            std::vector<std::pair<size_t, size_t>> work{{0, 0}};
+            state[0] = 1;
+            while (!work.empty()) {
+                auto& [b, next] = work.back();
+                if (next < blocks[b].succs.size()) {
+                    size_t s = blocks[b].succs[next++];
+                    if (state[s] == 0) {
+                        state[s] = 1;
+                        work.push_back({s, 0});
+                    }
+                } else {
+                    order.push_back(b);
+                    work.pop_back();
+                }
+            }
+            std::reverse(order.begin(), order.end());
+        }
+        for (size_t b : order) {
+            blocks[b].reachable = true;
+            blocks[b].ir = g.new_block();
+        }
+        blocks[0].preds = 1;
+        for (size_t b : order) {
+            for (size_t s : blocks[b].succs) blocks[s].preds++;
+        }
+        entry->term = Term::Goto;
+        connect(entry, blocks[0], entry_locals, {}, entry_fields);
+
+        for (size_t b : order) {
+            BytecodeBlock& bb = blocks[b];
+            if (!bb.started) {
+                // 前驱都在对象指令处退出到解释器
+                if (allow_exits) continue;
+                throw Bailout{"irreducible control flow"};
+            }
+            Block* cur = bb.ir;
+            Slots locals = bb.locals;
+            Slots stack = bb.stack;
+            Slots fields = bb.fields;
+            bool terminated = false;
+
+            auto push = [&](Value* v) {
+                stack.push_back(v);
+                if (v->type == Type::Long) stack.push_back(nullptr);
+            };
+            auto pop_slot = [&]() -> Value* {
+                if (stack.empty()) throw Bailout{"stack underflow"};
+                Value* v = stack.back();
+                stack.pop_back();
+                return v;
+            };
+            auto pop = [&](Type type) -> Value* {
+                if (type == Type::Long) pop_slot();
+                Value* v = pop_slot();
+                if (!v || v->type != type) throw Bailout{"unsupported operand type"};
+                return v;
+            };
+            auto load_local = [&](size_t idx, Type type) {
+                if (idx >= locals.size() || !locals[idx] || locals[idx]->type != type) throw Bailout{"unsupported local type"};
+                push(locals[idx]);
+            };
+            auto store_local = [&](size_t idx, Value* v) {
+                size_t width = v->type == Type::Long ? 2 : 1;
+                if (idx + width > locals.size()) throw Bailout{"local index out of range"};
+                // 覆盖long的后半个槽位时前半个也失效
+                if (idx > 0 && locals[idx - 1] && locals[idx - 1]->type == Type::Long) locals[idx - 1] = nullptr;
+                locals[idx] = v;
+                if (width == 2) locals[idx + 1] = nullptr;
+            };
+            auto emit = [&](Op op, Type type, std::vector<Value*> args) -> Value* {
+                int64_t folded;
+                if (fold(op, type, args, folded)) return g.constant(type, folded);
+                Value* v = g.make(op, type, std::move(args));
+                v->block = cur;
+                cur->insts.push_back(v);
+                return v;
+            };
+            auto binary = [&](Op op, Type type) {
+                Value* b2 = pop(op == Op::Shl || op == Op::Shr || op == Op::Ushr ? Type::Int : type);
+                Value* a1 = pop(type);
+                push(emit(op, type, {a1, b2}));
+            };
+            auto connect_to = [&](uint32_t target) {
+                for (auto& t : blocks) {
+                    if (t.start == target) {
+                        connect(cur, t, locals, stack, fields);
+                        return;
+                    }
+                }
+                throw Bailout{"invalid branch target"};
+            };
+            // 操作数不是虚拟对象的对象指令：OSR编译的外层方法中退出到解释器，否则放弃编译
+            auto exit_at = [&](uint32_t at, const char* reason) {
+                if (!allow_exits) throw Bailout{reason};
+                cur->term = Term::Exit;
+                cur->state = frame_state(at, locals, stack, live_before(cls, method, bb, at));
+                terminated = true;
+            };
+            // 调用的接收者（invokestatic为nullptr）
+            auto receiver = [&](uint8_t call, uint16_t idx) -> Value* {
+                if (call == 0xb8) return nullptr;
+                auto [name, desc] = cls.constant_pool.get_name_and_type(cls.constant_pool[idx].methodref_name_type_index);
+                char ret;
+                size_t args = parse_arg_slots(desc, ret).size();
+                return stack.size() > args ? stack[stack.size() - args - 1] : nullptr;
+            };
+
+            uint32_t pc = bb.start;
+            while (pc < bb.end && !terminated) {
+                uint8_t op = code[pc];
+                size_t len = instruction_length(code, pc);
+                switch (op) {
+                case 0x00: // nop
+                    break;
+                case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07: case 0x08: // iconst_<i>
+                    push(g.constant(Type::Int, (int)op - 0x03));
+                    break;
+                case 0x09: case 0x0a: // lconst_<l>
+                    push(g.constant(Type::Long, op - 0x09));
+                    break;
+                case 0x10: // bipush
+                    push(g.constant(Type::Int, (int8_t)code[pc + 1]));
+                    break;
+                case 0x11: // sipush
+                    push(g.constant(Type::Int, read_s2(code, pc + 1)));
+                    break;
+                case 0x12: case 0x13: { // ldc ldc_w
+                    size_t idx = op == 0x12 ? code[pc + 1] : read_u2(code, pc + 1);
+                    push(g.constant(Type::Int, (int32_t)cls.constant_pool[idx].integerOrFloat));
+                    break;
+                }
+                case 0x14: { // ldc2_w
+                    const ConstantPoolInfo& cpe = cls.constant_pool[read_u2(code, pc + 1)];
+                    push(g.constant(Type::Long, (int64_t)(((uint64_t)cpe.longOrDouble_high_bytes << 32) | cpe.longOrDouble_low_bytes)));
+                    break;
+                }
+                case 0x15: load_local(code[pc + 1], Type::Int); break; // iload
+                case 0x16: load_local(code[pc + 1], Type::Long); break; // lload
+                case 0x1a: case 0x1b: case 0x1c: case 0x1d: load_local(op - 0x1a, Type::Int); break;
+                case 0x1e: case 0x1f: case 0x20: case 0x21: load_local(op - 0x1e, Type::Long); break;
+                case 0x36: store_local(code[pc + 1], pop(Type::Int)); break; // istore
+                case 0x37: store_local(code[pc + 1], pop(Type::Long)); break; // lstore
+                case 0x3b: case 0x3c: case 0x3d: case 0x3e: store_local(op - 0x3b, pop(Type::Int)); break;
+                case 0x3f: case 0x40: case 0x41: case 0x42: store_local(op - 0x3f, pop(Type::Long)); break;
+                // 栈操作按槽位搬运，long的两个槽位保持相邻
+                case 0x57: pop_slot(); break; // pop
+                case 0x58: pop_slot(); pop_slot(); break; // pop2
+                case 0x59: { Value* v1 = pop_slot(); stack.insert(stack.end(), {v1, v1}); break; } // dup
+                case 0x5a: { Value* v1 = pop_slot(); Value* v2 = pop_slot(); stack.insert(stack.end(), {v1, v2, v1}); break; } // dup_x1
+                case 0x5b: { // dup_x2
+                    Value* v1 = pop_slot(); Value* v2 = pop_slot(); Value* v3 = pop_slot();
+                    stack.insert(stack.end(), {v1, v3, v2, v1});
+                    break;
+                }
+                case 0x5c: { Value* v1 = pop_slot(); Value* v2 = pop_slot(); stack.insert(stack.end(), {v2, v1, v2, v1}); break; } // dup2
+                case 0x5d: { // dup2_x1
+                    Value* v1 = pop_slot(); Value* v2 = pop_slot(); Value* v3 = pop_slot();
+                    stack.insert(stack.end(), {v2, v1, v3, v2, v1});
+                    break;
+                }
+                case 0x5e: { // dup2_x2
+                    Value* v1 = pop_slot(); Value* v2 = pop_slot(); Value* v3 = pop_slot(); Value* v4 = pop_slot();
+                    stack.insert(stack.end(), {v2, v1, v4, v3, v2, v1});
+                    break;
+                }
+                case 0x5f: { Value* v1 = pop_slot(); Value* v2 = pop_slot(); stack.insert(stack.end(), {v1, v2}); break; } // swap
+                case 0x60: binary(Op::Add, Type::Int); break;
+                case 0x61: binary(Op::Add, Type::Long); break;
+                case 0x64: binary(Op::Sub, Type::Int); break;
+                case 0x65: binary(Op::Sub, Type::Long); break;
+                case 0x68: binary(Op::Mul, Type::Int); break;
+                case 0x69: binary(Op::Mul, Type::Long); break;
+                case 0x6c: case 0x6d: case 0x70: case 0x71: { // idiv ldiv irem lrem
+                    Type type = (op == 0x6c || op == 0x70) ? Type::Int : Type::Long;
+                    Op kind = op <= 0x6d ? Op::Div : Op::Rem;
+                    Slots stack_before = stack;
+                    Value* divisor = pop(type);
+                    Value* dividend = pop(type);
+                    int64_t folded;
+                    if (fold(kind, type, {dividend, divisor}, folded)) {
+                        push(g.constant(type, folded));
+                        break;
+                    }
+                    Value* v = g.make(kind, type, {dividend, divisor});
+                    v->block = cur;
+                    if (!is_const(divisor) || divisor->imm == 0) {
+                        // 内联的方法没有自己的解释器Frame，无法在其中去优化
+                        if (returns) throw Bailout{"division by a non-constant in an inlined method"};
+                        v->checked = true;
+                        v->state = frame_state(pc, locals, std::move(stack_before), live_before(cls, method, bb, pc));
+                    }
+                    cur->insts.push_back(v);
+                    push(v);
+                    break;
+                }
+                case 0x74: push(emit(Op::Neg, Type::Int, {pop(Type::Int)})); break;
+                case 0x75: push(emit(Op::Neg, Type::Long, {pop(Type::Long)})); break;
+                case 0x78: binary(Op::Shl, Type::Int); break;
+                case 0x79: binary(Op::Shl, Type::Long); break;
+                case 0x7a: binary(Op::Shr, Type::Int); break;
+                case 0x7b: binary(Op::Shr, Type::Long); break;
+                case 0x7c: binary(Op::Ushr, Type::Int); break;
+                case 0x7d: binary(Op::Ushr, Type::Long); break;
+                case 0x7e: binary(Op::And, Type::Int); break;
+                case 0x7f: binary(Op::And, Type::Long); break;
+                case 0x80: binary(Op::Or, Type::Int); break;
+                case 0x81: binary(Op::Or, Type::Long); break;
+                case 0x82: binary(Op::Xor, Type::Int); break;
+                case 0x83: binary(Op::Xor, Type::Long); break;
+                case 0x84: { // iinc
+                    size_t idx = code[pc + 1];
+                    if (idx >= locals.size() || !locals[idx] || locals[idx]->type != Type::Int) throw Bailout{"unsupported local type"};
+                    store_local(idx, emit(Op::Add, Type::Int, {locals[idx], g.constant(Type::Int, (int8_t)code[pc + 2])}));
+                    break;
+                }
+                case 0x85: push(emit(Op::I2L, Type::Long, {pop(Type::Int)})); break;
+                case 0x88: push(emit(Op::L2I, Type::Int, {pop(Type::Long)})); break;
+                case 0x91: push(emit(Op::I2B, Type::Int, {pop(Type::Int)})); break;
+                case 0x92: push(emit(Op::I2C, Type::Int, {pop(Type::Int)})); break;
+                case 0x93: push(emit(Op::I2S, Type::Int, {pop(Type::Int)})); break;
+                case 0x94: { // lcmp
+                    Value* b2 = pop(Type::Long);
+                    Value* a1 = pop(Type::Long);
+                    push(emit(Op::LCmp, Type::Int, {a1, b2}));
+                    break;
+                }
+                case 0x99: case 0x9a: case 0x9b: case 0x9c: case 0x9d: case 0x9e: // if<cond>
+                case 0x9f: case 0xa0: case 0xa1: case 0xa2: case 0xa3: case 0xa4: { // if_icmp<cond>
+                    static const Cond conds[] = {CC_E, CC_NE, CC_L, CC_GE, CC_G, CC_LE};
+                    bool icmp = op >= 0x9f;
+                    Value* rhs = icmp ? pop(Type::Int) : g.constant(Type::Int, 0);
+                    Value* lhs = pop(Type::Int);
+                    cur->term = Term::If;
+                    cur->cond = conds[icmp ? op - 0x9f : op - 0x99];
+                    cur->lhs = lhs;
+                    cur->rhs = rhs;
+                    connect_to(branch_target(code, pc));
+                    connect_to((uint32_t)(pc + len));
+                    terminated = true;
+                    break;
+                }
+                case 0xa7: case 0xc8: // goto goto_w
+                    cur->term = Term::Goto;
+                    connect_to(branch_target(code, pc));
+                    terminated = true;
+                    break;
+                case 0xac: case 0xad: case 0xb1: { // ireturn lreturn return
+                    Value* v = op == 0xb1 ? nullptr : pop(op == 0xac ? Type::Int : Type::Long);
+                    if (returns) {
+                        returns->push_back({cur, v, fields});
+                        cur->term = Term::Goto;
+                    } else {
+                        cur->term = Term::Return;
+                        cur->lhs = v;
+                        cur->bci = pc;
+                    }
+                    terminated = true;
+                    break;
+                }
+                case 0x19: case 0x2a: case 0x2b: case 0x2c: case 0x2d: { // aload
+                    size_t idx = op == 0x19 ? code[pc + 1] : op - 0x2a;
+                    if (idx >= locals.size() || !is_virtual(locals[idx])) {
+                        exit_at(pc, "aload of an object not allocated in the method");
+                        break;
+                    }
+                    push(locals[idx]);
+                    break;
+                }
+                case 0x3a: case 0x4b: case 0x4c: case 0x4d: case 0x4e: // astore
+                    if (stack.empty() || !is_virtual(stack.back())) {
+                        exit_at(pc, "astore of an object not allocated in the method");
+                        break;
+                    }
+                    store_local(op == 0x3a ? code[pc + 1] : op - 0x4b, pop_slot());
+                    break;
+                case 0xbb: // new
+                    push(allocate(cls.constant_pool.get_class_name(read_u2(code, pc + 1)), fields));
+                    break;
+                case 0xb4: case 0xb5: { // getfield putfield
+                    size_t depth = op == 0xb4 ? 1 : 2;
+                    Value* obj = stack.size() >= depth ? stack[stack.size() - depth] : nullptr;
+                    if (!is_virtual(obj)) {
+                        exit_at(pc, "field access on an object not allocated in the method");
+                        break;
+                    }
+                    size_t slot = field_slot(obj, cls, read_u2(code, pc + 1));
+                    if (slot >= fields.size()) throw Bailout{"object fields not available"};
+                    if (op == 0xb4) {
+                        pop_slot();
+                        push(fields[slot]);
+                    } else {
+                        fields[slot] = pop(Type::Int);
+                        pop_slot();
+                    }
+                    break;
+                }
+                case 0xb6: case 0xb7: { // invokevirtual invokespecial
+                    uint16_t idx = read_u2(code, pc + 1);
+                    if (!is_virtual(receiver(op, idx))) {
+                        exit_at(pc, "call on an object not allocated in the method");
+                        break;
+                    }
+                    cur = inline_call(cls, op, idx, cur, stack, fields, inline_stack);
+                    break;
+                }
+                case 0xb8: // invokestatic
+                    cur = inline_call(cls, op, read_u2(code, pc + 1), cur, stack, fields, inline_stack);
+                    break;
+                default: // 不支持的指令：写回Frame后退出到解释器，由解释器从这条指令继续
+                    cur->term = Term::Exit;
+                    cur->state = frame_state(pc, locals, stack, live_before(cls, method, bb, pc));
+                    terminated = true;
+                    break;
+                }
+                pc += (uint32_t)len;
+            }
+            if (!terminated) {
+                cur->term = Term::Goto;
+                connect_to(bb.end);
+            }
+        }
+        if (!returns && osr_bci != OSR_NONE) {
+            for (auto& bb : blocks) {
+                if (bb.start == osr_bci && bb.started && bb.preds > 1) {
+                    osr_header = bb.ir;
+                    osr_locals = bb.locals;
+                    osr_stack = bb.stack;
+                    osr_fields = bb.fields;
+                }
+            }
+        }
+    }
+
+    // 内联调用，返回调用点之后的代码所在的块。invokestatic按符号引用解析；
+    // invokespecial/invokevirtual的接收者是虚拟对象，类型确定，从它的类（invokespecial为引用的类）向上查找方法
+    Block* inline_call(const ClassInfo& cls, uint8_t call, uint16_t idx, Block* cur, Slots& stack, Slots& fields,
+                       std::vector<const MethodInfo*>& inline_stack) {
+        const ConstantPoolInfo& ref = cls.constant_pool[idx];
+        if (ref.tag != ConstantType::METHOD_REF) throw Bailout{"unsupported call target"};
+        const std::string& class_name = cls.constant_pool.get_class_name(ref.methodref_class_index);
+        auto [name, desc] = cls.constant_pool.get_name_and_type(ref.methodref_name_type_index);
+        std::string callee_name = class_name + "." + name + desc;
+        char ret;
+        std::vector<char> arg_slots = parse_arg_slots(desc, ret);
+        if (call != 0xb8) arg_slots.insert(arg_slots.begin(), 'X');
+        if (stack.size() < arg_slots.size()) throw Bailout{"bad call site"};
+        // Object的构造函数什么也不做
+        if (call == 0xb7 && name == "<init>" && class_name == "java/lang/Object") {
+            stack.resize(stack.size() - arg_slots.size());
+            return cur;
+        }
+        // 只内联已初始化的类中执行过的方法，保证内联后不会跳过<clinit>
+        const std::string& start = call == 0xb6 ? objects[stack[stack.size() - arg_slots.size()]->imm].class_name : class_name;
+        const ClassInfo* callee_cls = loader.find_loaded_class(start);
+        if (!callee_cls) throw Bailout{"callee class not initialized: " + callee_name};
+        const MethodInfo* callee = nullptr;
+        while (callee_cls && !callee) {
+            for (const MethodInfo& m : callee_cls->methods) {
+                if (m.name == name && m.descriptor == desc) callee = &m;
+            }
+            if (!callee && call != 0xb8 && callee_cls->super_class) {
+                callee_cls = loader.find_loaded_class(callee_cls->constant_pool.get_class_name(callee_cls->super_class));
+            } else if (!callee) {
+                callee_cls = nullptr;
+            }
+        }
+        bool is_static = callee && (callee->access_flags & ACC_STATIC);
+        // 同步方法的加解锁在解释器的帧上进行，不内联
+        if (!callee || is_static != (call == 0xb8) || (callee->access_flags & (ACC_NATIVE | ACC_ABSTRACT | ACC_SYNCHRONIZED))) {
+            throw Bailout{"cannot inline " + callee_name};
+        }
+        if (callee->code.size() > MAX_INLINE_SIZE) throw Bailout{"callee too large: " + callee_name};
+        if (callee->invocation_count.load(std::memory_order_relaxed) == 0) throw Bailout{"callee never executed: " + callee_name};
+        if (inline_stack.size() > MAX_INLINE_DEPTH) throw Bailout{"inlining too deep: " + callee_name};
+        if (std::find(inline_stack.begin(), inline_stack.end(), callee) != inline_stack.end()) throw Bailout{"recursive call: " + callee_name};
+
+        if (callee->max_locals < arg_slots.size()) throw Bailout{"bad call site"};
+        Slots callee_locals(callee->max_locals, nullptr);
+        std::copy(stack.end() - arg_slots.size(), stack.end(), callee_locals.begin());
+        stack.resize(stack.size() - arg_slots.size());
+
+        Block* callee_entry = g.new_block();
+        cur->term = Term::Goto;
+        Graph::link(cur, callee_entry);
+        Returns sites;
+        inline_stack.push_back(callee);
+        parse_method(*callee_cls, *callee, callee_entry, callee_locals, fields, &sites, inline_stack);
+        inline_stack.pop_back();
+        if (sites.empty()) throw Bailout{"callee never returns: " + callee_name};
+        inlined++;
+
+        Block* cont = g.new_block();
+        for (auto& site : sites) Graph::link(site.block, cont);
+        // 被调用者可能修改虚拟对象的字段，各返回点的字段在调用点之后合并
+        auto merge = [&](auto value_of) -> Value* {
+            Value* first = value_of(sites[0]);
+            bool same = true;
+            for (auto& site : sites) {
+                Value* v = value_of(site);
+                if (!v || !first || v->type != first->type) return nullptr;
+                same = same && v == first;
+            }
+            if (same) return first;
+            Value* phi = g.make(Op::Phi, first->type);
+            phi->block = cont;
+            for (auto& site : sites) phi->args.push_back(value_of(site));
+            cont->phis.push_back(phi);
+            return phi;
+        };
+        fields.assign(field_count, nullptr);
+        for (size_t i = 0; i < field_count; ++i) {
+            fields[i] = merge([&](const ReturnSite& site) { return i < site.fields.size() ? site.fields[i] : nullptr; });
+        }
+        if (ret == 'I' || ret == 'J') {
+            Value* result = merge([](const ReturnSite& site) { return site.value; });
+            stack.push_back(result);
+            if (result->type == Type::Long) stack.push_back(nullptr);
+        } else if (ret != 'V') {
+            throw Bailout{"unsupported return type: " + callee_name};
+        }
+        return cont;
+    }
+};
+
+class Optimizer {
+public:
+    explicit Optimizer(Graph& g) : g(g) {}
+
+    std::vector<Block*> rpo;
+
+    void run() {
+        compute_rpo();
+        remove_unreachable_preds();
+        simplify_phis();
+        resolve_all();
+        split_critical_edges();
+        compute_rpo();
+        compute_dominators();
+        fold_constants();
+        gvn();
+        resolve_all();
+        licm();
+        eliminate_dead_code();
+    }
+
+private:
+    Graph& g;
+
+    template <typename F>
+    void for_each_use(Block* b, F&& f) {
+        for (Value* phi : b->phis) {
+            for (Value*& a : phi->args) f(a);
+        }
+        for (Value* v : b->insts) {
+            for (Value*& a : v->args) f(a);
+            if (v->state) {
+                for (Value*& s : v->state->locals) f(s);
+                for (Value*& s : v->state->stack) f(s);
+            }
+        }
+        if (b->lhs) f(b->lhs);
+        if (b->rhs) f(b->rhs);
+        if (b->state) {
+            for (Value*& s : b->state->locals) f(s);
+            for (Value*& s : b->state->stack) f(s);
+        }
+    }
+
+    void resolve_all() {
+        for (auto& b : g.blocks) {
+            for_each_use(b.get(), [](Value*& v) { v = resolve(v); });
+            auto dead = [](Value* v) { return v->forward != nullptr; };
+            b->phis.erase(std::remove_if(b->phis.begin(), b->phis.end(), dead), b->phis.end());
+            b->insts.erase(std::remove_if(b->insts.begin(), b->insts.end(), dead), b->insts.end());
+        }
+    }
+
+    // 参数（除自身外）都相同的phi用该值替代
+    void simplify_phis() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& b : g.blocks) {
+                for (Value* phi : b->phis) {
+                    if (phi->forward || phi->conflict) continue;
+                    Value* same = nullptr;
+                    bool trivial = true;
+                    for (Value* a : phi->args) {
+                        a = resolve(a);
+                        if (a == phi || a == same) continue;
+                        if (same) {
+                            trivial = false;
+                            break;
+                        }
+                        same = a;
+                    }
+                    if (trivial && same) {
+                        phi->forward = same;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // OSR编译时方法入口到循环头的路径不可达，删除这些前驱和对应的phi参数
+    void remove_unreachable_preds() {
+        for (Block* b : rpo) {
+            for (size_t k = b->preds.size(); k-- > 0;) {
+                if (b->preds[k]->rpo >= 0) continue;
+                b->preds.erase(b->preds.begin() + k);
+                for (Value* phi : b->phis) phi->args.erase(phi->args.begin() + k);
+            }
+        }
+    }
+
+    // 拆分关键边，phi的并行复制放在只有一个后继的前驱块末尾
+    void split_critical_edges() {
+        std::vector<Block*> blocks = rpo;
+        for (Block* b : blocks) {
+            if (b->succs.size() < 2) continue;
+            for (Block*& s : b->succs) {
+                if (s->preds.size() < 2) continue;
+                Block* mid = g.new_block();
+                mid->term = Term::Goto;
+                mid->succs.push_back(s);
+                mid->preds.push_back(b);
+                *std::find(s->preds.begin(), s->preds.end(), b) = mid;
+                s = mid;
+            }
+        }
+    }
+
+    void compute_rpo() {
+        std::vector<Block*> post;
+        std::vector<bool> seen(g.blocks.size(), false);
+        std::vector<std::pair<Block*, size_t>> work{{g.entry, 0}};
+        seen[g.entry->id] = true;
+        while (!work.empty()) {
+            auto& [b, next] = work.back();
+            if (next < b->succs.size()) {
+                Block* s = b->succs[next++];
+                if (!seen[s->id]) {
+                    seen[s->id] = true;
+                    work.push_back({s, 0});
+                }
+            } else {
+                post.push_back(b);
+                work.pop_back();
+            }
+        }
+        rpo.assign(post.rbegin(), post.rend());
+        for (size_t i = 0; i < rpo.size(); ++i) rpo[i]->rpo = (int)i;
+    }
+
+    // Cooper-Harvey-Kennedy迭代算法
+    void compute_dominators() {
+        auto intersect = [](Block* a, Block* b) {
+            while (a != b) {
+                while (a->rpo > b->rpo) a = a->idom;
+                while (b->rpo > a->rpo) b = b->idom;
+            }
+            return a;
+        };
+        g.entry->idom = g.entry;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (Block* b : rpo) {
+                if (b == g.entry) continue;
+                Block* idom = nullptr;
+                for (Block* p : b->preds) {
+                    if (!p->idom) continue;
+                    idom = idom ? intersect(p, idom) : p;
+                }
+                if (idom != b->idom) {
+                    b->idom = idom;
+                    changed = true;
+                }
+            }
+        }
+        for (Block* b : rpo) {
+            if (b != g.entry) b->idom->dom_children.push_back(b);
+        }
+    }
+
+    static bool dominates(Block* a, Block* b) {
+        while (true) {
+            if (a == b) return true;
+            if (b->idom == b) return false;
+            b = b->idom;
+        }
+    }
+
+    // phi简化后可能出现新的常量参数
+    void fold_constants() {
+        for (Block* b : rpo) {
+            for (Value* v : b->insts) {
+                for (Value*& a : v->args) a = resolve(a);
+                int64_t folded;
+                if (!is_param(v) && fold(v->op, v->type, v->args, folded)) v->forward = g.constant(v->type, folded);
+            }
+        }
+        resolve_all();
+    }
+
+    // 沿支配树的全局值编号：支配者中已有相同运算时直接复用
+    void gvn() {
+        using Key = std::tuple<Op, Type, Value*, Value*>;
+        std::map<Key, Value*> table;
+        std::vector<std::pair<Block*, size_t>> work{{g.entry, 0}};
+        std::vector<std::vector<Key>> scopes(1);
+        auto enter = [&](Block* b) {
+            for (Value* v : b->insts) {
+                for (Value*& a : v->args) a = resolve(a);
+                if (!is_pure(v)) continue;
+                Value* x = v->args[0];
+                Value* y = v->args.size() > 1 ? v->args[1] : nullptr;
+                if (y && is_commutative(v->op) && y->id < x->id) std::swap(x, y);
+                Key key{v->op, v->type, x, y};
+                auto it = table.find(key);
+                if (it != table.end()) {
+                    v->forward = it->second;
+                } else {
+                    table.emplace(key, v);
+                    scopes.back().push_back(key);
+                }
+            }
+        };
+        enter(g.entry);
+        while (!work.empty()) {
+            auto& [b, next] = work.back();
+            if (next < b->dom_children.size()) {
+                Block* child = b->dom_children[next++];
+                scopes.emplace_back();
+                enter(child);
+                work.push_back({child, 0});
+            } else {
+                for (const Key& k : scopes.back()) table.erase(k);
+                scopes.pop_back();
+                work.pop_back();
+            }
+        }
+    }
+
+    // 循环不变量外提：参数都在循环外定义的纯运算移到循环前置块，内层循环先处理
+    void licm() {
+        struct Loop {
+            Block* header;
+            Block* preheader;
+            std::vector<bool> body;
+            size_t size;
+        };
+        std::vector<Loop> loops;
+        for (Block* h : rpo) {
+            std::vector<Block*> latches;
+            for (Block* p : h->preds) {
+                if (p->rpo >= 0 && dominates(h, p)) latches.push_back(p);
+            }
+            if (latches.empty()) continue;
+            Loop loop{h, nullptr, std::vector<bool>(g.blocks.size(), false), 1};
+            loop.body[h->id] = true;
+            std::vector<Block*> work = latches;
+            while (!work.empty()) {
+                Block* b = work.back();
+                work.pop_back();
+                if (loop.body[b->id]) continue;
+                // 每次迭代都可能退出到解释器，不如留给模板代码
+                if (b->term == Term::Exit) throw Bailout{"unsupported instruction inside a loop"};
+                loop.body[b->id] = true;
+                loop.size++;
+                for (Block* p : b->preds) work.push_back(p);
+            }
+            for (Block* p : h->preds) {
+                if (loop.body[p->id]) continue;
+                if (loop.preheader) {
+                    loop.preheader = nullptr;
+                    break;
+                }
+                loop.preheader = p;
+            }
+            if (loop.preheader && loop.preheader->succs.size() == 1) loops.push_back(std::move(loop));
+        }
+        std::sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) { return a.size < b.size; });
+        for (Loop& loop : loops) {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (Block* b : rpo) {
+                    if (!loop.body[b->id]) continue;
+                    for (size_t i = 0; i < b->insts.size();) {
+                        Value* v = b->insts[i];
+                        bool invariant = is_pure(v) && std::all_of(v->args.begin(), v->args.end(), [&](Value* a) {
+                            return is_const(a) || !loop.body[a->block->id];
+                        });
+                        if (!invariant) {
+                            ++i;
+                            continue;
+                        }
+                        b->insts.erase(b->insts.begin() + i);
+                        v->block = loop.preheader;
+                        loop.preheader->insts.push_back(v);
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // 从分支条件、返回值、可能去优化的除法和退出状态出发标记活跃值，其余删除。
+    // 类型冲突的phi只能出现在去优化状态中（对应的槽位已经失效），从状态中去掉；被真正使用则放弃编译
+    void eliminate_dead_code() {
+        std::vector<bool> poisoned(g.values.size(), false);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (Block* b : rpo) {
+                for (Value* v : b->phis) {
+                    if (poisoned[v->id]) continue;
+                    bool bad = v->conflict || std::any_of(v->args.begin(), v->args.end(), [&](Value* a) { return poisoned[a->id]; });
+                    if (bad) {
+                        poisoned[v->id] = true;
+                        changed = true;
+                    }
+                }
+                for (Value* v : b->insts) {
+                    if (!poisoned[v->id] && std::any_of(v->args.begin(), v->args.end(), [&](Value* a) { return poisoned[a->id]; })) {
+                        poisoned[v->id] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        std::vector<bool> live(g.values.size(), false);
+        std::vector<Value*> work;
+        auto mark = [&](Value* v) {
+            if (v && !live[v->id]) {
+                if (poisoned[v->id]) throw Bailout{"value of conflicting types used after merge"};
+                live[v->id] = true;
+                work.push_back(v);
+            }
+        };
+        for (Block* b : rpo) {
+            mark(b->lhs);
+            mark(b->rhs);
+            if (b->state) {
+                for (Value*& s : b->state->locals) if (s && poisoned[s->id]) s = nullptr;
+                for (Value*& s : b->state->stack) if (s && poisoned[s->id]) s = nullptr;
+                for (Value* s : b->state->locals) mark(s);
+                for (Value* s : b->state->stack) mark(s);
+            }
+            for (Value* v : b->insts) {
+                if (is_pure(v) || is_param(v)) continue;
+                mark(v);
+                if (v->state) {
+                    for (Value*& s : v->state->locals) if (s && poisoned[s->id]) s = nullptr;
+                    for (Value*& s : v->state->stack) if (s && poisoned[s->id]) s = nullptr;
+                }
+            }
+        }
+        while (!work.empty()) {
+            Value* v = work.back();
+            work.pop_back();
+            for (Value* a : v->args) mark(a);
+            if (v->state) {
+                for (Value* s : v->state->locals) mark(s);
+                for (Value* s : v->state->stack) mark(s);
+            }
+        }
+        for (Block* b : rpo) {
+            auto dead = [&](Value* v) { return !live[v->id]; };
+            b->phis.erase(std::remove_if(b->phis.begin(), b->phis.end(), dead), b->phis.end());
+            b->insts.erase(std::remove_if(b->insts.begin(), b->insts.end(), dead), b->insts.end());
+        }
+    }
+};
+
+// 线性扫描寄存器分配和代码生成。
+// 每个值只有一个区间（覆盖它的定义、所有使用和活跃的块），要么整个生命期在一个寄存器中，要么在栈上的溢出槽。
+// RAX/RCX/RDX是生成运算时的临时寄存器，R14保存JitFrameState，其余通用寄存器参与分配。
+class CodeGen {
+public:
+    CodeGen(Graph& g, const std::vector<Block*>& order) : g(g), order(order) {}
+
+    size_t spill_slots = 0;
+    size_t ir_values = 0;
+
+    std::vector<uint8_t> generate() {
+        allocate();
+        emit();
+        return std::move(a.buf);
+    }
+
+private:
+    static constexpr Reg STATE = R14;
+    static constexpr Reg ALLOCATABLE[] = {RBX, RSI, RDI, R8, R9, R10, R11, R12, R13, R15};
+
+    Graph& g;
+    const std::vector<Block*>& order;
+    std::vector<Value*> values; // 参与分配的值，按id编号
+    Assembler a;
+    size_t frame_size = 0;
+    std::vector<size_t> block_pos;
+    std::vector<std::pair<size_t, Block*>> jump_fixups;
+    std::vector<std::pair<size_t, FrameState*>> deopt_fixups;
+    std::vector<size_t> exit_fixups;
+
+    template <typename F>
+    void for_each_inst_use(Value* v, F&& f) {
+        for (Value* a : v->args) f(a);
+        if (v->state) {
+            for (Value* s : v->state->locals) if (s) f(s);
+            for (Value* s : v->state->stack) if (s) f(s);
+        }
+    }
+
+    // 退出块在块末尾写回状态中的值
+    template <typename F>
+    void for_each_exit_use(Block* b, F&& f) {
+        if (!b->state) return;
+        for (Value* s : b->state->locals) if (s) f(s);
+        for (Value* s : b->state->stack) if (s) f(s);
+    }
+
+    void allocate() {
+        // 编号和线性位置
+        int pos = 0;
+        for (Block* b : order) {
+            b->start = pos;
+            pos += 2;
+            for (Value* v : b->phis) {
+                v->id = (int)values.size();
+                v->pos = b->start;
+                values.push_back(v);
+            }
+            for (Value* v : b->insts) {
+                v->id = (int)values.size();
+                v->pos = pos;
+                pos += 2;
+                values.push_back(v);
+            }
+            b->end = pos;
+            pos += 2;
+        }
+        ir_values = values.size();
+
+        // 活跃变量分析
+        size_t n = values.size();
+        std::vector<std::vector<bool>> live_in(g.blocks.size(), std::vector<bool>(n, false));
+        std::vector<std::vector<bool>> live_out(g.blocks.size(), std::vector<bool>(n, false));
+        auto mark = [](std::vector<bool>& set, Value* v, bool on) {
+            if (v && !is_const(v)) set[v->id] = on;
+        };
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                Block* b = *it;
+                std::vector<bool> live(n, false);
+                for (Block* s : b->succs) {
+                    for (size_t i = 0; i < n; ++i) if (live_in[s->id][i]) live[i] = true;
+                    size_t k = std::find(s->preds.begin(), s->preds.end(), b) - s->preds.begin();
+                    for (Value* phi : s->phis) mark(live, phi->args[k], true);
+                }
+                live_out[b->id] = live;
+                mark(live, b->lhs, true);
+                mark(live, b->rhs, true);
+                for_each_exit_use(b, [&](Value* u) { mark(live, u, true); });
+                for (auto vi = b->insts.rbegin(); vi != b->insts.rend(); ++vi) {
+                    mark(live, *vi, false);
+                    for_each_inst_use(*vi, [&](Value* u) { mark(live, u, true); });
+                }
+                for (Value* phi : b->phis) mark(live, phi, false);
+                if (live != live_in[b->id]) {
+                    live_in[b->id] = std::move(live);
+                    changed = true;
+                }
+            }
+        }
+
+        // 区间
+        auto extend = [](Value* v, int p) {
+            if (!v || is_const(v)) return;
+            v->from = std::min(v->from, p);
+            v->to = std::max(v->to, p);
+        };
+        for (Value* v : values) extend(v, v->pos);
+        for (Block* b : order) {
+            for (size_t i = 0; i < n; ++i) {
+                if (live_in[b->id][i]) extend(values[i], b->start);
+                if (live_out[b->id][i]) extend(values[i], b->end);
+            }
+            for (Value* v : b->insts) for_each_inst_use(v, [&](Value* u) { extend(u, v->pos); });
+            extend(b->lhs, b->end);
+            extend(b->rhs, b->end);
+            for_each_exit_use(b, [&](Value* u) { extend(u, b->end); });
+            for (Value* phi : b->phis) {
+                // phi在前驱块末尾被赋值
+                for (size_t k = 0; k < b->preds.size(); ++k) {
+                    extend(phi->args[k], b->preds[k]->end);
+                    extend(phi, b->preds[k]->end);
+                }
+            }
+        }
+
+        // 线性扫描
+        std::vector<Value*> intervals = values;
+        std::sort(intervals.begin(), intervals.end(), [](Value* x, Value* y) {
+            return x->from != y->from ? x->from < y->from : x->id < y->id;
+        });
+        std::vector<Value*> active;
+        std::vector<Reg> free_regs(std::begin(ALLOCATABLE), std::end(ALLOCATABLE));
+        std::reverse(free_regs.begin(), free_regs.end());
+        for (Value* cur : intervals) {
+            for (size_t i = 0; i < active.size();) {
+                if (active[i]->to < cur->from) {
+                    free_regs.push_back((Reg)active[i]->reg);
+                    active.erase(active.begin() + i);
+                } else {
+                    ++i;
+                }
+            }
+            if (!free_regs.empty()) {
+                cur->reg = free_regs.back();
+                free_regs.pop_back();
+                active.push_back(cur);
+                continue;
+            }
+            auto victim = std::max_element(active.begin(), active.end(), [](Value* x, Value* y) { return x->to < y->to; });
+            if ((*victim)->to > cur->to) {
+                cur->reg = (*victim)->reg;
+                (*victim)->reg = -1;
+                (*victim)->spill = (int)spill_slots++;
+                *victim = cur;
+            } else {
+                cur->spill = (int)spill_slots++;
+            }
+        }
+        frame_size = spill_slots * 8;
+        if (frame_size % 16 == 0) frame_size += 8; // 入口处rsp+8对齐，6次push后保持16字节对齐
+    }
+
+    int32_t spill_offset(const Value* v) const { return (int32_t)(8 * v->spill); }
+
+    void load(Reg dst, Value* v) {
+        if (is_const(v)) {
+            if (v->type == Type::Int) a.mov32_imm(dst, (uint32_t)v->imm);
+            else a.mov64_imm(dst, (uint64_t)v->imm);
+        } else if (v->reg >= 0) {
+            if (v->reg != dst) a.mov64(dst, (Reg)v->reg);
+        } else {
+            a.load64(dst, RSP, spill_offset(v));
+        }
+    }
+
+    void store(Value* v, Reg src) {
+        if (v->reg >= 0) {
+            if (v->reg != src) a.mov64((Reg)v->reg, src);
+        } else {
+            a.store64(RSP, spill_offset(v), src);
+        }
+    }
+
+    // 值所在的寄存器；不在寄存器中时加载到scratch
+    Reg operand(Value* v, Reg scratch) {
+        if (!is_const(v) && v->reg >= 0) return (Reg)v->reg;
+        load(scratch, v);
+        return scratch;
+    }
+
+    void emit_prologue() {
+        a.push(RBP);
+        a.push(RBX);
+        a.push(R12);
+        a.push(R13);
+        a.push(R14);
+        a.push(R15);
+        a.sub64_imm(RSP, (int32_t)frame_size);
+        a.mov64(STATE, RDI);
+    }
+
+    void emit_epilogue() {
+        a.add64_imm(RSP, (int32_t)frame_size);
+        a.pop(R15);
+        a.pop(R14);
+        a.pop(R13);
+        a.pop(R12);
+        a.pop(RBX);
+        a.pop(RBP);
+        a.ret();
+    }
+
+    void emit_inst(Value* v) {
+        bool wide = v->type == Type::Long;
+        switch (v->op) {
+        case Op::Param: case Op::StackParam:
+            a.load64(RDX, STATE, v->op == Op::Param ? offsetof(JitFrameState, locals) : offsetof(JitFrameState, stack));
+            if (wide) {
+                a.load64(RAX, RDX, (int32_t)(4 * v->imm));
+                a.swap_halves(RAX);
+            } else {
+                a.load32(RAX, RDX, (int32_t)(4 * v->imm));
+            }
+            store(v, RAX);
+            return;
+        case Op::Add: case Op::Sub: case Op::And: case Op::Or: case Op::Xor: case Op::Mul: {
+            Value* x = v->args[0];
+            Value* y = v->args[1];
+            Reg dst = (v->reg >= 0 && (is_const(y) || y->reg != v->reg)) ? (Reg)v->reg : RAX;
+            load(dst, x);
+            Reg src = operand(y, RCX);
+            if (v->op == Op::Mul) {
+                wide ? a.imul64(dst, src) : a.imul32(dst, src);
+            } else {
+                uint8_t alu = v->op == Op::Add ? 0x01 : v->op == Op::Sub ? 0x29 : v->op == Op::And ? 0x21 : v->op == Op::Or ? 0x09 : 0x31;
+                wide ? a.alu64(alu, dst, src) : a.alu32(alu, dst, src);
+            }
+            store(v, dst);
+            return;
+        }
+        case Op::Shl: case Op::Shr: case Op::Ushr: {
+            // 硬件按低5/6位取移位数，与Java一致
+            load(RCX, v->args[1]);
+            load(RAX, v->args[0]);
+            int ext = v->op == Op::Shl ? 4 : v->op == Op::Shr ? 7 : 5;
+            wide ? a.shift64_cl(ext, RAX) : a.shift32_cl(ext, RAX);
+            store(v, RAX);
+            return;
+        }
+        case Op::Neg:
+            load(RAX, v->args[0]);
+            wide ? a.neg64(RAX) : a.neg32(RAX);
+            store(v, RAX);
+            return;
+        case Op::Div: case Op::Rem:
+            emit_div(v);
+            return;
+        case Op::I2L:
+            load(RAX, v->args[0]);
+            a.movsxd(RAX, RAX);
+            store(v, RAX);
+            return;
+        case Op::L2I: // int只使用低32位
+            load(RAX, v->args[0]);
+            store(v, RAX);
+            return;
+        case Op::I2B: case Op::I2C: case Op::I2S:
+            load(RAX, v->args[0]);
+            if (v->op == Op::I2B) a.movsx8(RAX, RAX);
+            else if (v->op == Op::I2C) a.movzx16(RAX, RAX);
+            else a.movsx16(RAX, RAX);
+            store(v, RAX);
+            return;
+        case Op::LCmp:
+            load(RAX, v->args[0]);
+            load(RCX, v->args[1]);
+            a.cmp64(RAX, RCX);
+            a.setcc(CC_G, RDX);
+            a.setcc(CC_L, RAX);
+            a.movzx8(RDX, RDX);
+            a.movzx8(RAX, RAX);
+            a.alu32(0x29, RDX, RAX);
+            store(v, RDX);
+            return;
+        default:
+            throw Bailout{"unexpected IR"};
+        }
+    }
+
+    // 除数为0时去优化；除数为-1时单独处理，避免最小值除以-1触发硬件异常
+    void emit_div(Value* v) {
+        bool wide = v->type == Type::Long;
+        bool rem = v->op == Op::Rem;
+        Value* divisor = v->args[1];
+        load(RCX, divisor);
+        if (v->checked) {
+            wide ? a.test64(RCX, RCX) : a.test32(RCX, RCX);
+            deopt_fixups.push_back({a.jcc(CC_E), v->state});
+        }
+        bool maybe_minus_one = !is_const(divisor) || divisor->imm == -1;
+        size_t not_minus_one = 0, done = 0;
+        if (maybe_minus_one) {
+            wide ? a.cmp64_imm8(RCX, -1) : a.cmp32_imm8(RCX, -1);
+            not_minus_one = a.jcc(CC_NE);
+            if (rem) {
+                a.alu32(0x31, RAX, RAX);
+            } else {
+                load(RAX, v->args[0]);
+                wide ? a.neg64(RAX) : a.neg32(RAX);
+            }
+            store(v, RAX);
+            done = a.jmp();
+            a.patch_rel32(not_minus_one, a.pos());
+        }
+        load(RAX, v->args[0]);
+        if (wide) {
+            a.cqo();
+            a.idiv64(RCX);
+        } else {
+            a.cdq();
+            a.idiv32(RCX);
+        }
+        store(v, rem ? RDX : RAX);
+        if (maybe_minus_one) a.patch_rel32(done, a.pos());
+    }
+
+    // 槽位编码：寄存器号，溢出槽为100+槽号，常量为-1，临时寄存器RDX为-2
+    static constexpr int LOC_CONST = -1;
+    static constexpr int LOC_TEMP = -2;
+    static int location(const Value* v) {
+        if (is_const(v)) return LOC_CONST;
+        return v->reg >= 0 ? v->reg : 100 + v->spill;
+    }
+
+    void load_location(Reg dst, int loc, Value* v) {
+        if (loc == LOC_CONST) load(dst, v);
+        else if (loc == LOC_TEMP) a.mov64(dst, RDX);
+        else if (loc < 100) { if (loc != dst) a.mov64(dst, (Reg)loc); }
+        else a.load64(dst, RSP, 8 * (loc - 100));
+    }
+
+    // 进入succ前的phi并行复制
+    void emit_phi_moves(Block* b, Block* succ) {
+        struct Move {
+            int src;
+            Value* src_value;
+            Value* dst;
+        };
+        size_t k = std::find(succ->preds.begin(), succ->preds.end(), b) - succ->preds.begin();
+        std::vector<Move> moves;
+        for (Value* phi : succ->phis) {
+            Value* src = phi->args[k];
+            if (location(src) != location(phi)) moves.push_back({location(src), src, phi});
+        }
+        while (!moves.empty()) {
+            bool progress = false;
+            for (size_t i = 0; i < moves.size(); ++i) {
+                int dst = location(moves[i].dst);
+                bool blocked = std::any_of(moves.begin(), moves.end(), [&](const Move& m) { return m.src == dst; });
+                if (blocked) continue;
+                const Move& m = moves[i];
+                if (m.dst->reg >= 0) {
+                    load_location((Reg)m.dst->reg, m.src, m.src_value);
+                } else {
+                    load_location(RAX, m.src, m.src_value);
+                    store(m.dst, RAX);
+                }
+                moves.erase(moves.begin() + i);
+                progress = true;
+                break;
+            }
+            if (progress) continue;
+            // 循环依赖：把第一个目标的当前内容保存到RDX，读它的复制改为读RDX
+            int dst = location(moves[0].dst);
+            load_location(RDX, dst, nullptr);
+            for (Move& m : moves) {
+                if (m.src == dst) m.src = LOC_TEMP;
+            }
+        }
+    }
+
+    void emit_jump(Block* target, Block* next) {
+        if (target != next) jump_fixups.push_back({a.jmp(), target});
+    }
+
+    void emit_terminator(Block* b, Block* next) {
+        switch (b->term) {
+        case Term::Goto:
+            emit_phi_moves(b, b->succs[0]);
+            emit_jump(b->succs[0], next);
+            return;
+        case Term::If: {
+            Reg lhs = operand(b->lhs, RAX);
+            if (is_const(b->rhs) && b->rhs->imm >= -128 && b->rhs->imm <= 127) {
+                a.cmp32_imm8(lhs, (int8_t)b->rhs->imm);
+            } else {
+                a.cmp32(lhs, operand(b->rhs, RCX));
+            }
+            if (b->succs[0] == next) {
+                // 跳转目标紧随其后时反转条件（条件码最低位取反）
+                jump_fixups.push_back({a.jcc((Cond)(b->cond ^ 1)), b->succs[1]});
+            } else {
+                jump_fixups.push_back({a.jcc(b->cond), b->succs[0]});
+                emit_jump(b->succs[1], next);
+            }
+            return;
+        }
+        case Term::Return: {
+            // 返回值写到操作数栈底，由解释器执行返回指令
+            size_t width = 0;
+            if (b->lhs) {
+                a.load64(RDX, STATE, offsetof(JitFrameState, stack));
+                load(RAX, b->lhs);
+                if (b->lhs->type == Type::Long) {
+                    a.swap_halves(RAX);
+                    a.store64(RDX, 0, RAX);
+                    width = 2;
+                } else {
+                    a.store32(RDX, 0, RAX);
+                    width = 1;
+                }
+            }
+            a.mov32_imm(RAX, (uint32_t)width);
+            a.store64(STATE, offsetof(JitFrameState, sp), RAX);
+            a.mov32_imm(RAX, b->bci);
+            a.store32(STATE, offsetof(JitFrameState, bci), RAX);
+            exit_fixups.push_back(a.jmp());
+            return;
+        }
+        case Term::Exit:
+            emit_deopt(*b->state);
+            return;
+        default:
+            throw Bailout{"unterminated block"};
+        }
+    }
+
+    // 去优化：把指令处的局部变量和操作数栈写回Frame，解释器从该指令重新执行
+    void emit_deopt(const FrameState& state) {
+        auto write_slots = [&](const std::vector<Value*>& slots, size_t field) {
+            a.load64(RDX, STATE, (int32_t)field);
+            for (size_t i = 0; i < slots.size(); ++i) {
+                Value* v = slots[i];
+                if (!v) continue;
+                load(RAX, v);
+                if (v->type == Type::Long) {
+                    a.swap_halves(RAX);
+                    a.store64(RDX, (int32_t)(4 * i), RAX);
+                } else {
+                    a.store32(RDX, (int32_t)(4 * i), RAX);
+                }
+            }
+        };
+        write_slots(state.locals, offsetof(JitFrameState, locals));
+        write_slots(state.stack, offsetof(JitFrameState, stack));
+        a.mov32_imm(RAX, (uint32_t)state.stack.size());
+        a.store64(STATE, offsetof(JitFrameState, sp), RAX);
+        a.mov32_imm(RAX, state.bci);
+        a.store32(STATE, offsetof(JitFrameState, bci), RAX);
+        exit_fixups.push_back(a.jmp());
+    }
+
+    void emit() {
+        emit_prologue();
+        block_pos.assign(g.blocks.size(), 0);
+        for (size_t i = 0; i < order.size(); ++i) {
+            Block* b = order[i];
+            block_pos[b->id] = a.pos();
+            for (Value* v : b->insts) emit_inst(v);
+            emit_terminator(b, i + 1 < order.size() ? order[i + 1] : nullptr);
+        }
+        for (const auto& [at, state] : deopt_fixups) {
+            a.patch_rel32(at, a.pos());
+            emit_deopt(*state);
+        }
+        size_t exit = a.pos();
+        emit_epilogue();
+        for (const auto& [at, target] : jump_fixups) a.patch_rel32(at, block_pos[target->id]);
+        for (size_t at : exit_fixups) a.patch_rel32(at, exit);
+    }
+};
+
+} // namespace
+
+bool compile_optimized(const ClassInfo& class_info, const MethodInfo& method, const ClassLoader& class_loader,
+                       uint32_t osr_bci, OptimizedCode& out, std::string& reason) {
+    try {
+        Graph g;
+        Builder builder(g, class_loader);
+        builder.build(class_info, method, osr_bci);
+        Optimizer optimizer(g);
+        optimizer.run();
+        CodeGen codegen(g, optimizer.rpo);
+        out.machine_code = codegen.generate();
+        out.ir_values = codegen.ir_values;
+        out.spill_slots = codegen.spill_slots;
+        out.inlined = builder.inlined;
+        out.scalar_replaced = builder.scalar_replaced;
+        return true;
+    } catch (const Bailout& e) {
+        reason = e.reason;
+        return false;
+    }
+}
+
+#else
+
+bool compile_optimized(const ClassInfo&, const MethodInfo&, const ClassLoader&, uint32_t, OptimizedCode&, std::string& reason) {
+    reason = "unsupported platform";
+    return false;
+}
+
+#endif
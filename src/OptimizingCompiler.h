@@ -0,0 +1,34 @@
+#ifndef OPTIMIZINGCOMPILER_H
+#define OPTIMIZINGCOMPILER_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "runtime.h"
+
+// 第二层优化编译器：把热点方法的字节码构造成SSA形式的IR，内联已执行过的小静态方法，
+// 做常量折叠、GVN、循环不变量外提和死代码删除，再用线性扫描分配寄存器，生成的循环把值保存在寄存器中。
+// 只支持int/long运算、条件跳转和可内联的invokestatic，其他方法保留模板JIT的代码。
+// 不逃逸的new做标量替换：对象不分配，int字段作为SSA值，构造函数和接收者是这种对象的调用直接内联。
+// 生成代码的入口与模板JIT相同（void entry(JitFrameState*, const void*)），但只能在bci 0、操作数栈为空时进入；
+// 退出时把返回值写到操作数栈，state.bci指向返回指令，由解释器完成返回。
+// 除数可能为0的除法在除数为0时去优化：把该指令处的局部变量和操作数栈写回Frame，由解释器重新执行。
+// 指定osr_bci时生成栈上替换（OSR）代码：入口改为循环头osr_bci，从Frame读取该处的局部变量和操作数栈。
+// OSR代码中循环外的不支持指令不会导致编译失败，执行到时写回Frame并退出到解释器。
+
+class ClassLoader;
+
+struct OptimizedCode {
+    std::vector<uint8_t> machine_code;
+    size_t ir_values = 0;   // 优化后的IR指令数
+    size_t spill_slots = 0; // 寄存器分配溢出的值
+    size_t inlined = 0;     // 内联的调用点
+    size_t scalar_replaced = 0; // 标量替换的分配点
+};
+
+constexpr uint32_t OSR_NONE = UINT32_MAX;
+
+// 编译失败时返回false，reason为原因
+bool compile_optimized(const ClassInfo& class_info, const MethodInfo& method, const ClassLoader& class_loader,
+                       uint32_t osr_bci, OptimizedCode& out, std::string& reason);
+
+#endif // OPTIMIZINGCOMPILER_H
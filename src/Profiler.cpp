@@ -0,0 +1,236 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fmt/core.h>
+#include "bytecode.h"
+#include "runtime.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Profiler {
+
+bool enabled = false;
+
+static inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct MethodStats {
+    uint64_t calls = 0;
+    uint64_t inclusive = 0;
+    uint64_t exclusive = 0;
+};
+
+// 各线程结束时合并到这里；有意不析构，保证在atexit报告时仍然有效
+struct GlobalProfile {
+    std::mutex mutex;
+    uint64_t opcode_counts[256] = {};
+    std::map<uint32_t, uint64_t> sequences; // 操作码序列 -> 次数，见sequence_key
+    std::map<std::string, MethodStats> methods;
+    std::map<std::string, uint64_t> folded; // 调用栈（分号分隔） -> 不含子调用的周期数
+};
+
+static GlobalProfile& global_profile() {
+    static GlobalProfile* profile = new GlobalProfile();
+    return *profile;
+}
+
+// 调用上下文树节点，保存名字而不是MethodInfo指针，线程退出时类可能已经卸载
+struct ContextNode {
+    std::string name;
+    ContextNode* parent = nullptr;
+    std::vector<std::unique_ptr<ContextNode>> children;
+    const MethodInfo* method = nullptr;
+    MethodStats stats;
+
+    ContextNode* child(const ClassInfo& class_info, const MethodInfo& m) {
+        for (auto& c : children) {
+            if (c->method == &m) return c.get();
+        }
+        auto node = std::make_unique<ContextNode>();
+        node->name = class_info.constant_pool.get_class_name(class_info.this_class) + "." + m.name + m.descriptor;
+        node->parent = this;
+        node->method = &m;
+        children.push_back(std::move(node));
+        return children.back().get();
+    }
+};
+
+struct Activation {
+    ContextNode* node;
+    uint64_t start;
+    uint64_t child_cycles;
+};
+
+// 连续执行的2~3条指令编码为(长度<<24)|操作码...，作为超级指令的候选
+static uint32_t sequence_key(uint32_t history, uint32_t len) {
+    return (len << 24) | (history & ((1u << (8 * len)) - 1));
+}
+
+// 跳转、返回和方法调用之后的指令与前面不相邻，不能合并
+static bool ends_sequence(uint8_t op) {
+    return (op >= 0x99 && op <= 0xb1) || (op >= 0xb6 && op <= 0xba) || op == 0xbf || (op >= 0xc6 && op <= 0xc9);
+}
+
+struct ThreadProfile {
+    uint64_t opcode_counts[256] = {};
+    uint32_t history = 0;     // 最近执行的操作码，低字节为最新
+    uint32_t history_len = 0;
+    std::unordered_map<uint32_t, uint64_t> sequences;
+    ContextNode root;
+    std::vector<Activation> stack;
+
+    ThreadProfile() {
+        stack.reserve(64);
+    }
+    ~ThreadProfile() {
+        merge();
+    }
+
+    void merge() {
+        GlobalProfile& global = global_profile();
+        std::lock_guard<std::mutex> lock(global.mutex);
+        for (int i = 0; i < 256; ++i) {
+            global.opcode_counts[i] += opcode_counts[i];
+        }
+        for (const auto& [key, count] : sequences) global.sequences[key] += count;
+        std::string path;
+        merge_node(global, root, path);
+    }
+
+    void merge_node(GlobalProfile& global, const ContextNode& node, std::string& path) {
+        for (const auto& child : node.children) {
+            size_t saved = path.size();
+            if (!path.empty()) path += ';';
+            path += child->name;
+            MethodStats& m = global.methods[child->name];
+            m.calls += child->stats.calls;
+            m.inclusive += child->stats.inclusive;
+            m.exclusive += child->stats.exclusive;
+            if (child->stats.exclusive) global.folded[path] += child->stats.exclusive;
+            merge_node(global, *child, path);
+            path.resize(saved);
+        }
+    }
+};
+
+static ThreadProfile& thread_profile() {
+    static thread_local ThreadProfile profile;
+    return profile;
+}
+
+void record_opcode(uint8_t opcode) {
+    ThreadProfile& tp = thread_profile();
+    tp.opcode_counts[opcode]++;
+    tp.history = (tp.history << 8) | opcode;
+    tp.history_len = std::min(tp.history_len + 1, 3u);
+    for (uint32_t len = 2; len <= tp.history_len; ++len) {
+        tp.sequences[sequence_key(tp.history, len)]++;
+    }
+    if (ends_sequence(opcode)) tp.history_len = 0;
+}
+
+void enter_method(const ClassInfo& class_info, const MethodInfo& method) {
+    ThreadProfile& tp = thread_profile();
+    ContextNode* parent = tp.stack.empty() ? &tp.root : tp.stack.back().node;
+    ContextNode* node = parent->child(class_info, method);
+    node->stats.calls++;
+    tp.history_len = 0;
+    tp.stack.push_back({node, read_cycles(), 0});
+}
+
+void exit_method() {
+    ThreadProfile& tp = thread_profile();
+    tp.history_len = 0;
+    if (tp.stack.empty()) return;
+    Activation act = tp.stack.back();
+    tp.stack.pop_back();
+    uint64_t inclusive = read_cycles() - act.start;
+    act.node->stats.inclusive += inclusive;
+    act.node->stats.exclusive += inclusive - std::min(inclusive, act.child_cycles);
+    if (!tp.stack.empty()) {
+        tp.stack.back().child_cycles += inclusive;
+    }
+}
+
+static void dump_report() {
+    GlobalProfile& global = global_profile();
+    std::lock_guard<std::mutex> lock(global.mutex);
+
+    std::vector<std::pair<std::string, MethodStats>> methods(global.methods.begin(), global.methods.end());
+    std::sort(methods.begin(), methods.end(), [](const auto& a, const auto& b) {
+        return a.second.exclusive > b.second.exclusive;
+    });
+    uint64_t total = 0;
+    for (const auto& [name, stats] : methods) total += stats.exclusive;
+    fmt::print(stderr, "\n===== JVM profile: methods (sorted by exclusive cycles) =====\n");
+    fmt::print(stderr, "{:>7} {:>12} {:>16} {:>16}  {}\n", "excl%", "calls", "inclusive", "exclusive", "method");
+    for (const auto& [name, stats] : methods) {
+        double pct = total ? 100.0 * stats.exclusive / total : 0.0;
+        fmt::print(stderr, "{:>6.2f}% {:>12} {:>16} {:>16}  {}\n", pct, stats.calls, stats.inclusive, stats.exclusive, name);
+    }
+
+    std::vector<std::pair<uint64_t, int>> opcodes;
+    uint64_t total_ops = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (global.opcode_counts[i]) opcodes.push_back({global.opcode_counts[i], i});
+        total_ops += global.opcode_counts[i];
+    }
+    std::sort(opcodes.rbegin(), opcodes.rend());
+    fmt::print(stderr, "===== JVM profile: opcodes (sorted by count, total {}) =====\n", total_ops);
+    for (const auto& [count, op] : opcodes) {
+        fmt::print(stderr, "{:>6.2f}% {:>12}  0x{:02x} {}\n", 100.0 * count / total_ops, count, op, opcode_name(op));
+    }
+
+    // 出现最多的相邻指令序列，是超级指令（Superinstructions.h）的候选
+    std::vector<std::pair<uint64_t, uint32_t>> sequences;
+    for (const auto& [key, count] : global.sequences) sequences.push_back({count, key});
+    std::sort(sequences.rbegin(), sequences.rend());
+    if (sequences.size() > 30) sequences.resize(30);
+    fmt::print(stderr, "===== JVM profile: opcode sequences (superinstruction candidates) =====\n");
+    for (const auto& [count, key] : sequences) {
+        uint32_t len = key >> 24;
+        std::string names;
+        for (uint32_t i = len; i-- > 0;) {
+            if (!names.empty()) names += "; ";
+            names += opcode_name((key >> (8 * i)) & 0xff);
+        }
+        fmt::print(stderr, "{:>6.2f}% {:>12}  {}\n", total_ops ? 100.0 * count / total_ops : 0.0, count, names);
+    }
+
+    const char* folded_path = std::getenv("JVM_PROFILE_FOLDED");
+    if (!folded_path) folded_path = "jvm_profile.folded";
+    FILE* out = std::fopen(folded_path, "w");
+    if (!out) {
+        fmt::print(stderr, "cannot write folded stacks to {}\n", folded_path);
+        return;
+    }
+    for (const auto& [stack, cycles] : global.folded) {
+        fmt::print(out, "{} {}\n", stack, cycles);
+    }
+    std::fclose(out);
+    fmt::print(stderr, "folded stacks written to {}\n", folded_path);
+}
+
+void init() {
+    if (!std::getenv("JVM_PROFILE")) return;
+    enabled = true;
+    global_profile();
+    // 主线程的thread_local数据在atexit回调之前析构并合并
+    std::atexit(dump_report);
+}
+
+} // namespace Profiler
@@ -0,0 +1,30 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <cstdint>
+
+struct ClassInfo;
+struct MethodInfo;
+
+// 字节码级性能统计：每个操作码的执行次数、每个方法的调用次数和含/不含子调用的周期数（rdtsc）。
+// 以-DJVM_PROFILING=ON编译后，设置环境变量JVM_PROFILE启用；
+// 退出时输出按开销排序的报告（含出现最多的相邻操作码序列，用于挑选超级指令），并把火焰图使用的folded stack写入JVM_PROFILE_FOLDED（默认jvm_profile.folded）。
+// 未编译进来时下面的宏全部为空，没有任何开销。
+namespace Profiler {
+    extern bool enabled;
+    void init();
+    void record_opcode(uint8_t opcode);
+    void enter_method(const ClassInfo& class_info, const MethodInfo& method);
+    void exit_method();
+}
+
+#ifdef JVM_PROFILING
+#define PROFILE_OPCODE(opcode) do { if (Profiler::enabled) Profiler::record_opcode(opcode); } while (0)
+#define PROFILE_METHOD_ENTER(class_info, method) do { if (Profiler::enabled) Profiler::enter_method(class_info, method); } while (0)
+#define PROFILE_METHOD_EXIT() do { if (Profiler::enabled) Profiler::exit_method(); } while (0)
+#else
+#define PROFILE_OPCODE(opcode) ((void)0)
+#define PROFILE_METHOD_ENTER(class_info, method) ((void)0)
+#define PROFILE_METHOD_EXIT() ((void)0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,522 @@
+#include "RegisterCode.h"
+#include <algorithm>
+#include <map>
+#include "Superinstructions.h"
+#include "bytecode.h"
+
+namespace {
+
+struct Failure {
+    std::string reason;
+};
+
+uint16_t read_u2(const std::vector<uint8_t>& code, size_t p) {
+    return (uint16_t)((code[p] << 8) | code[p + 1]);
+}
+
+int32_t branch_target(const std::vector<uint8_t>& code, size_t bci) {
+    if (code[bci] == 0xc8) { // goto_w
+        return (int32_t)bci + (int32_t)(((uint32_t)code[bci + 1] << 24) | ((uint32_t)code[bci + 2] << 16) | ((uint32_t)code[bci + 3] << 8) | code[bci + 4]);
+    }
+    return (int32_t)bci + (int16_t)read_u2(code, bci + 1);
+}
+
+bool is_branch(uint8_t op) {
+    return (op >= 0x99 && op <= 0xa7) || op == 0xc6 || op == 0xc7 || op == 0xc8;
+}
+
+// 之后的指令不可能顺序执行到
+bool ends_flow(uint8_t op) {
+    return op == 0xa7 || op == 0xc8 || op == 0xaa || op == 0xab || (op >= 0xac && op <= 0xb1) || op == 0xbf;
+}
+
+size_t type_slots(char c) {
+    return c == 'J' || c == 'D' ? 2 : c == 'V' ? 0 : 1;
+}
+
+// 方法描述符的参数和返回值占用的槽位数
+void method_slots(const std::string& desc, int& args, int& ret) {
+    args = 0;
+    size_t i = 1;
+    while (i < desc.size() && desc[i] != ')') {
+        char c = desc[i];
+        while (desc[i] == '[') ++i;
+        if (desc[i] == 'L') {
+            while (desc[i] != ';') ++i;
+        }
+        args += (int)type_slots(c);
+        ++i;
+    }
+    ret = i + 1 < desc.size() ? (int)type_slots(desc[i + 1]) : 0;
+}
+
+const std::string& ref_descriptor(const ClassInfo& cls, uint16_t idx, bool field) {
+    const ConstantPoolInfo& ref = cls.constant_pool[idx];
+    const ConstantPoolInfo& nat = cls.constant_pool[field ? ref.fieldref_name_type_index : ref.methodref_name_type_index];
+    return cls.constant_pool[nat.descriptor_index].utf8_str;
+}
+
+} // namespace
+
+bool stack_effect(const ClassInfo& cls, const std::vector<uint8_t>& code, size_t bci, int& pops, int& pushes) {
+    uint8_t op = code[bci];
+    pops = pushes = 0;
+    if (op == 0x00 || op == 0x84 || op == 0xa7 || op == 0xc8 || op == 0xb1) return true;  // nop iinc goto goto_w return
+    if (op == 0x01 || (op >= 0x02 && op <= 0x08) || (op >= 0x0b && op <= 0x0d) || op == 0x10 || op == 0x11 || op == 0x12 || op == 0x13) {
+        pushes = 1;
+        return true;
+    }
+    if (op == 0x09 || op == 0x0a || op == 0x0e || op == 0x0f || op == 0x14) {
+        pushes = 2;
+        return true;
+    }
+    if (op >= 0x15 && op <= 0x19) { pushes = (op == 0x16 || op == 0x18) ? 2 : 1; return true; }
+    if (op >= 0x1a && op <= 0x2d) { pushes = ((op - 0x1a) / 4 == 1 || (op - 0x1a) / 4 == 3) ? 2 : 1; return true; }
+    if (op >= 0x2e && op <= 0x35) { pops = 2; pushes = (op == 0x2f || op == 0x31) ? 2 : 1; return true; }
+    if (op >= 0x36 && op <= 0x3a) { pops = (op == 0x37 || op == 0x39) ? 2 : 1; return true; }
+    if (op >= 0x3b && op <= 0x4e) { pops = ((op - 0x3b) / 4 == 1 || (op - 0x3b) / 4 == 3) ? 2 : 1; return true; }
+    if (op >= 0x4f && op <= 0x56) { pops = (op == 0x50 || op == 0x52) ? 4 : 3; return true; }
+    switch (op) {
+    case 0x57: pops = 1; return true;                // pop
+    case 0x58: pops = 2; return true;                // pop2
+    case 0x59: pops = 1; pushes = 2; return true;    // dup
+    case 0x5a: pops = 2; pushes = 3; return true;    // dup_x1
+    case 0x5b: pops = 3; pushes = 4; return true;    // dup_x2
+    case 0x5c: pops = 2; pushes = 4; return true;    // dup2
+    case 0x5d: pops = 3; pushes = 5; return true;    // dup2_x1
+    case 0x5e: pops = 4; pushes = 6; return true;    // dup2_x2
+    case 0x5f: pops = 2; pushes = 2; return true;    // swap
+    default: break;
+    }
+    if (op >= 0x60 && op <= 0x73) { // 四则运算，按i/l/f/d交替
+        bool wide = (op - 0x60) % 2 == 1;
+        pops = wide ? 4 : 2;
+        pushes = wide ? 2 : 1;
+        return true;
+    }
+    if (op >= 0x74 && op <= 0x77) { pops = pushes = (op == 0x75 || op == 0x77) ? 2 : 1; return true; }
+    if (op >= 0x78 && op <= 0x7d) { bool l = op % 2 == 1; pops = l ? 3 : 2; pushes = l ? 2 : 1; return true; }
+    if (op >= 0x7e && op <= 0x83) { bool l = op % 2 == 1; pops = l ? 4 : 2; pushes = l ? 2 : 1; return true; }
+    if (op >= 0x85 && op <= 0x93) {
+        // 转换指令的源和目标类型
+        static const char from[] = "iiilllfffdddiii";
+        static const char to[] = "lfdifdildilfbcs";
+        pops = from[op - 0x85] == 'l' || from[op - 0x85] == 'd' ? 2 : 1;
+        pushes = to[op - 0x85] == 'l' || to[op - 0x85] == 'd' ? 2 : 1;
+        return true;
+    }
+    switch (op) {
+    case 0x94: pops = 4; pushes = 1; return true;             // lcmp
+    case 0x95: case 0x96: pops = 2; pushes = 1; return true;  // fcmpl fcmpg
+    case 0x97: case 0x98: pops = 4; pushes = 1; return true;  // dcmpl dcmpg
+    case 0x99: case 0x9a: case 0x9b: case 0x9c: case 0x9d: case 0x9e: case 0xc6: case 0xc7:
+        pops = 1; return true;
+    case 0x9f: case 0xa0: case 0xa1: case 0xa2: case 0xa3: case 0xa4: case 0xa5: case 0xa6:
+        pops = 2; return true;
+    case 0xaa: case 0xab: pops = 1; return true;                        // tableswitch lookupswitch
+    case 0xac: case 0xae: case 0xb0: case 0xbf: pops = 1; return true;  // ireturn freturn areturn athrow
+    case 0xad: case 0xaf: pops = 2; return true;                        // lreturn dreturn
+    case 0xb2: pushes = (int)type_slots(ref_descriptor(cls, read_u2(code, bci + 1), true)[0]); return true;  // getstatic
+    case 0xb3: pops = (int)type_slots(ref_descriptor(cls, read_u2(code, bci + 1), true)[0]); return true;    // putstatic
+    case 0xb4: pops = 1; pushes = (int)type_slots(ref_descriptor(cls, read_u2(code, bci + 1), true)[0]); return true;
+    case 0xb5: pops = 1 + (int)type_slots(ref_descriptor(cls, read_u2(code, bci + 1), true)[0]); return true;
+    case 0xb6: case 0xb7: case 0xb8: case 0xb9: { // invokevirtual invokespecial invokestatic invokeinterface
+        method_slots(ref_descriptor(cls, read_u2(code, bci + 1), false), pops, pushes);
+        if (op != 0xb8) pops++;
+        return true;
+    }
+    case 0xbb: pushes = 1; return true;                                        // new
+    case 0xbc: case 0xbd: case 0xbe: case 0xc0: case 0xc1: pops = pushes = 1; return true;  // newarray anewarray arraylength checkcast instanceof
+    case 0xc2: case 0xc3: pops = 1; return true;                               // monitorenter monitorexit
+    case 0xc5: pops = code[bci + 3]; pushes = 1; return true;                  // multianewarray
+    default:
+        return false;
+    }
+}
+
+namespace {
+
+// 翻译成寄存器指令的字节码，其余退出到解释器。ldc只翻译int/float常量，ldc2_w只翻译long/double常量
+bool translatable(const ClassInfo& cls, const MethodInfo& method, size_t bci) {
+    const std::vector<uint8_t>& code = method.code;
+    // 向量化循环的循环头由解释器执行，以便进入SIMD核
+    if (!method.superinstructions.empty() && method.superinstructions[bci] == SUPER_VECTOR_LOOP) return false;
+    uint8_t op = code[bci];
+    if (op == 0x12 || op == 0x13) {
+        uint8_t tag = cls.constant_pool[op == 0x12 ? code[bci + 1] : read_u2(code, bci + 1)].tag;
+        return tag == ConstantType::INTEGER || tag == ConstantType::FLOAT;
+    }
+    if (op == 0x14) {
+        uint8_t tag = cls.constant_pool[read_u2(code, bci + 1)].tag;
+        return tag == ConstantType::LONG || tag == ConstantType::DOUBLE;
+    }
+    if (op == 0x00 || (op >= 0x02 && op <= 0x11) || (op >= 0x15 && op <= 0x2d) || (op >= 0x36 && op <= 0x4e)) return true;
+    switch (op) {
+    case 0x57: case 0x58: case 0x59: case 0x5c:                              // pop pop2 dup dup2
+    case 0x60: case 0x61: case 0x64: case 0x65: case 0x68: case 0x69:        // add sub mul
+    case 0x6c: case 0x6d: case 0x70: case 0x71:                              // div rem
+    case 0x74: case 0x75: case 0x78: case 0x79: case 0x7a: case 0x7b: case 0x7c: case 0x7d:
+    case 0x7e: case 0x7f: case 0x80: case 0x81: case 0x82: case 0x83:
+    case 0x84: case 0x85: case 0x88: case 0x91: case 0x92: case 0x93: case 0x94:
+    case 0xa7: case 0xc6: case 0xc7: case 0xc8:
+        return true;
+    default:
+        return op >= 0x99 && op <= 0xa6;
+    }
+}
+
+class Translator {
+public:
+    Translator(const ClassInfo& cls, const MethodInfo& method)
+        : cls(cls), method(method), code(method.code), L(method.max_locals), S(method.max_stack) {}
+
+    std::unique_ptr<RegisterCode> run() {
+        if (code.empty()) throw Failure{"empty method"};
+        analyze();
+        out = std::make_unique<RegisterCode>();
+        out->num_locals = L;
+        out->num_stack = S;
+        out->entries.assign(code.size(), RegisterCode::NO_ENTRY);
+        out->entry_depth.assign(code.size(), 0);
+        block_index.assign(code.size(), RegisterCode::NO_ENTRY);
+        translate();
+        for (auto& [at, target] : branch_fixups) out->insts[at].imm = (int32_t)block_index[target];
+        size_t num_regs = (size_t)L + S + out->constants.size();
+        if (num_regs > UINT16_MAX) throw Failure{"too many registers"};
+        out->num_regs = (uint16_t)num_regs;
+        return std::move(out);
+    }
+
+private:
+    const ClassInfo& cls;
+    const MethodInfo& method;
+    const std::vector<uint8_t>& code;
+    uint16_t L, S;
+    std::vector<int> depths;  // 指令执行前的操作数栈深度，不可达为-1
+    std::vector<bool> leader;
+    std::unique_ptr<RegisterCode> out;
+    std::vector<uint16_t> vs; // 模拟的操作数栈：每个槽位的值所在的寄存器
+    size_t block_start = 0;   // 当前基本块的第一条寄存器指令
+    std::map<int32_t, uint16_t> int_consts;
+    std::map<int64_t, uint16_t> long_consts;
+    std::vector<std::pair<size_t, uint32_t>> branch_fixups;
+    std::vector<uint32_t> block_index; // 基本块起点的bci -> 第一条寄存器指令
+
+    // 栈深度分析，同时找出基本块的起点
+    void analyze() {
+        depths.assign(code.size(), -1);
+        leader.assign(code.size(), false);
+        leader[0] = true;
+        depths[0] = 0;
+        std::vector<size_t> work{0};
+        auto flow = [&](int64_t target, int depth) {
+            if (target < 0 || (size_t)target >= code.size()) throw Failure{"branch target out of range"};
+            if (depths[target] < 0) {
+                depths[target] = depth;
+                work.push_back((size_t)target);
+            } else if (depths[target] != depth) {
+                throw Failure{"inconsistent stack depth"};
+            }
+        };
+        // 异常处理器入口：操作数栈上只有异常对象
+        for (const auto& entry : method.exception_table) {
+            flow(entry.handler_pc, 1);
+            leader[entry.handler_pc] = true;
+        }
+        while (!work.empty()) {
+            size_t bci = work.back();
+            work.pop_back();
+            uint8_t op = code[bci];
+            int pops, pushes;
+            if (!stack_effect(cls, code, bci, pops, pushes)) throw Failure{std::string("unsupported opcode ") + opcode_name(op)};
+            size_t next = bci + instruction_length(code, bci);
+            if (next > code.size()) throw Failure{"truncated bytecode"};
+            int depth = depths[bci];
+            if (depth < pops) throw Failure{"operand stack underflow"};
+            depth = depth - pops + pushes;
+            if (depth > S) throw Failure{"operand stack overflow"};
+            if (is_branch(op)) {
+                int32_t target = branch_target(code, bci);
+                flow(target, depth);
+                leader[target] = true;
+            }
+            if (op == 0xaa || op == 0xab) {
+                // switch由解释器执行，各个目标都是入口
+                const SwitchTable& table = method.switch_at(bci);
+                flow(table.default_target, depth);
+                leader[table.default_target] = true;
+                for (uint32_t target : table.targets) {
+                    flow(target, depth);
+                    leader[target] = true;
+                }
+            }
+            if (is_branch(op) || ends_flow(op) || !translatable(cls, method, bci)) {
+                if (next < code.size()) leader[next] = true;
+            }
+            if (!ends_flow(op)) flow((int64_t)next, depth);
+        }
+    }
+
+    uint16_t stack_reg(size_t i) const { return (uint16_t)(L + i); }
+    bool is_stack_reg(uint16_t r) const { return r >= L && r < L + S; }
+
+    uint16_t const_int(int32_t v) {
+        auto it = int_consts.find(v);
+        if (it != int_consts.end()) return it->second;
+        uint16_t r = (uint16_t)(L + S + out->constants.size());
+        out->constants.push_back((SlotT)v);
+        int_consts[v] = r;
+        return r;
+    }
+    uint16_t const_long(int64_t v) {
+        auto it = long_consts.find(v);
+        if (it != long_consts.end()) return it->second;
+        uint16_t r = (uint16_t)(L + S + out->constants.size());
+        out->constants.push_back((SlotT)((uint64_t)v >> 32));
+        out->constants.push_back((SlotT)(uint64_t)v);
+        long_consts[v] = r;
+        return r;
+    }
+
+    RInst& emit(ROp op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0) {
+        RInst inst{};
+        inst.op = op;
+        inst.a = a;
+        inst.b = b;
+        inst.c = c;
+        out->insts.push_back(inst);
+        return out->insts.back();
+    }
+
+    void materialize(size_t i) {
+        if (vs[i] != stack_reg(i)) {
+            emit(ROp::Mov, stack_reg(i), vs[i]);
+            vs[i] = stack_reg(i);
+        }
+    }
+    void materialize_all() {
+        for (size_t i = 0; i < vs.size(); ++i) materialize(i);
+    }
+    // 局部变量[x, x+width)被改写前，先写回引用它们的栈槽位
+    void materialize_aliases(uint16_t x, size_t width) {
+        for (size_t i = 0; i < vs.size(); ++i) {
+            if (vs[i] >= x && vs[i] < x + width) materialize(i);
+        }
+    }
+
+    void push(uint16_t r, size_t width) {
+        vs.push_back(r);
+        if (width == 2) vs.push_back((uint16_t)(r + 1));
+    }
+    uint16_t pop(size_t width) {
+        if (vs.size() < width) throw Failure{"operand stack underflow"};
+        uint16_t r = vs[vs.size() - width];
+        if (width == 2 && vs.back() != r + 1) throw Failure{"split long value"};
+        vs.resize(vs.size() - width);
+        return r;
+    }
+
+    // 结果写到操作数栈新的栈顶
+    void define(ROp op, size_t width, uint16_t b, uint16_t c = 0) {
+        uint16_t dst = stack_reg(vs.size());
+        emit(op, dst, b, c);
+        push(dst, width);
+    }
+    void binary(ROp op, size_t width) {
+        uint16_t c = pop(width);
+        uint16_t b = pop(width);
+        define(op, width, b, c);
+    }
+    // 除数为0时退出到解释器，所以操作数先写回栈槽位，退出时的状态就是指令执行前的状态
+    void checked_binary(ROp op, size_t width, uint32_t bci) {
+        materialize_all();
+        uint16_t depth = (uint16_t)vs.size();
+        binary(op, width);
+        out->insts.back().bci = bci;
+        out->insts.back().depth = depth;
+    }
+
+    static bool defines(ROp op) { return op <= ROp::LCmp; }
+
+    void store_local(uint16_t x, size_t width) {
+        if (x + width > L) throw Failure{"local index out of range"};
+        uint16_t src = pop(width);
+        bool aliased = std::any_of(vs.begin(), vs.end(), [&](uint16_t r) { return r >= x && r < x + width; });
+        // 刚算出的栈顶值直接写到局部变量
+        if (!aliased && src == stack_reg(vs.size()) && out->insts.size() > block_start &&
+            defines(out->insts.back().op) && out->insts.back().a == src) {
+            out->insts.back().a = x;
+            return;
+        }
+        materialize_aliases(x, width);
+        for (size_t i = 0; i < width; ++i) emit(ROp::Mov, (uint16_t)(x + i), (uint16_t)(src + i));
+    }
+    void load_local(uint16_t x, size_t width) {
+        if (x + width > L) throw Failure{"local index out of range"};
+        push(x, width);
+    }
+
+    void branch(ROp op, uint8_t cond, uint16_t b, uint16_t c, size_t bci) {
+        materialize_all();
+        int32_t target = branch_target(code, bci);
+        RInst& inst = emit(op, 0, b, c);
+        inst.cond = cond;
+        inst.bci = (uint32_t)bci;
+        inst.backward = target <= (int32_t)bci;
+        inst.target = (uint32_t)target;
+        branch_fixups.push_back({out->insts.size() - 1, (uint32_t)target});
+    }
+
+    void exit_at(size_t bci) {
+        materialize_all();
+        RInst& inst = emit(ROp::Exit);
+        inst.bci = (uint32_t)bci;
+        inst.depth = (uint16_t)vs.size();
+    }
+
+    void translate() {
+        bool open = false; // 上一条指令会顺序执行到当前指令
+        for (size_t bci = 0; bci < code.size(); bci += instruction_length(code, bci)) {
+            if (depths[bci] < 0) {
+                open = false;
+                continue;
+            }
+            if (leader[bci]) {
+                if (open) materialize_all();
+                vs.clear();
+                for (int i = 0; i < depths[bci]; ++i) vs.push_back(stack_reg(i));
+                out->entries[bci] = block_index[bci] = (uint32_t)out->insts.size();
+                out->entry_depth[bci] = (uint16_t)depths[bci];
+                block_start = out->insts.size();
+            }
+            uint8_t op = code[bci];
+            open = !ends_flow(op);
+            if (!translatable(cls, method, bci)) {
+                // 解释器直接执行这条指令，不从这里进入
+                out->entries[bci] = RegisterCode::NO_ENTRY;
+                exit_at(bci);
+                open = false;
+                continue;
+            }
+            out->translated++;
+            translate_one(op, bci);
+        }
+    }
+
+    void translate_one(uint8_t op, size_t bci) {
+        if (op >= 0x02 && op <= 0x08) return push(const_int(op - 0x03), 1);                // iconst_<i>
+        if (op >= 0x0b && op <= 0x0d) return push(const_int(op == 0x0b ? 0 : op == 0x0c ? 0x3f800000 : 0x40000000), 1); // fconst_<f>
+        if (op == 0x09 || op == 0x0a) return push(const_long(op - 0x09), 2);               // lconst_<l>
+        if (op == 0x0e || op == 0x0f) return push(const_long(op == 0x0e ? 0 : 0x3ff0000000000000LL), 2); // dconst_<d>
+        if (op >= 0x15 && op <= 0x19) return load_local(code[bci + 1], op == 0x16 || op == 0x18 ? 2 : 1);
+        if (op >= 0x1a && op <= 0x2d) {
+            int kind = (op - 0x1a) / 4;
+            return load_local((uint16_t)((op - 0x1a) % 4), kind == 1 || kind == 3 ? 2 : 1);
+        }
+        if (op >= 0x36 && op <= 0x3a) return store_local(code[bci + 1], op == 0x37 || op == 0x39 ? 2 : 1);
+        if (op >= 0x3b && op <= 0x4e) {
+            int kind = (op - 0x3b) / 4;
+            return store_local((uint16_t)((op - 0x3b) % 4), kind == 1 || kind == 3 ? 2 : 1);
+        }
+        if (op >= 0x99 && op <= 0x9e) {
+            uint16_t v = pop(1);
+            return branch(ROp::If, (uint8_t)(op - 0x99), v, const_int(0), bci);
+        }
+        if (op >= 0x9f && op <= 0xa6) {
+            uint16_t v2 = pop(1);
+            uint16_t v1 = pop(1);
+            return branch(ROp::If, (uint8_t)(op <= 0xa4 ? op - 0x9f : op - 0xa5), v1, v2, bci);
+        }
+        switch (op) {
+        case 0x00: return;
+        case 0x10: return push(const_int((int8_t)code[bci + 1]), 1);
+        case 0x11: return push(const_int((int16_t)read_u2(code, bci + 1)), 1);
+        case 0x12: case 0x13: // ldc ldc_w
+            return push(const_int((int32_t)cls.constant_pool[op == 0x12 ? code[bci + 1] : read_u2(code, bci + 1)].integerOrFloat), 1);
+        case 0x14: { // ldc2_w
+            const ConstantPoolInfo& c = cls.constant_pool[read_u2(code, bci + 1)];
+            return push(const_long((int64_t)(((uint64_t)c.longOrDouble_high_bytes << 32) | c.longOrDouble_low_bytes)), 2);
+        }
+        case 0x57: pop(1); return;
+        case 0x58: pop(2); return;
+        case 0x59: case 0x5c: { // dup dup2：栈槽位复制到新的栈顶，局部变量和常量只复制来源
+            size_t width = op == 0x59 ? 1 : 2;
+            if (vs.size() < width) throw Failure{"operand stack underflow"};
+            size_t base = vs.size() - width;
+            for (size_t i = 0; i < width; ++i) {
+                uint16_t r = vs[base + i];
+                if (is_stack_reg(r)) {
+                    emit(ROp::Mov, stack_reg(vs.size()), r);
+                    vs.push_back(stack_reg(vs.size()));
+                } else {
+                    vs.push_back(r);
+                }
+            }
+            return;
+        }
+        case 0x60: return binary(ROp::IAdd, 1);
+        case 0x61: return binary(ROp::LAdd, 2);
+        case 0x64: return binary(ROp::ISub, 1);
+        case 0x65: return binary(ROp::LSub, 2);
+        case 0x68: return binary(ROp::IMul, 1);
+        case 0x69: return binary(ROp::LMul, 2);
+        case 0x6c: return checked_binary(ROp::IDiv, 1, (uint32_t)bci);
+        case 0x6d: return checked_binary(ROp::LDiv, 2, (uint32_t)bci);
+        case 0x70: return checked_binary(ROp::IRem, 1, (uint32_t)bci);
+        case 0x71: return checked_binary(ROp::LRem, 2, (uint32_t)bci);
+        case 0x74: return define(ROp::INeg, 1, pop(1));
+        case 0x75: return define(ROp::LNeg, 2, pop(2));
+        case 0x78: case 0x7a: case 0x7c: {
+            uint16_t c = pop(1);
+            uint16_t b = pop(1);
+            return define(op == 0x78 ? ROp::IShl : op == 0x7a ? ROp::IShr : ROp::IUshr, 1, b, c);
+        }
+        case 0x79: case 0x7b: case 0x7d: {
+            uint16_t c = pop(1);
+            uint16_t b = pop(2);
+            return define(op == 0x79 ? ROp::LShl : op == 0x7b ? ROp::LShr : ROp::LUshr, 2, b, c);
+        }
+        case 0x7e: return binary(ROp::IAnd, 1);
+        case 0x7f: return binary(ROp::LAnd, 2);
+        case 0x80: return binary(ROp::IOr, 1);
+        case 0x81: return binary(ROp::LOr, 2);
+        case 0x82: return binary(ROp::IXor, 1);
+        case 0x83: return binary(ROp::LXor, 2);
+        case 0x84: { // iinc
+            uint16_t x = code[bci + 1];
+            if (x >= L) throw Failure{"local index out of range"};
+            materialize_aliases(x, 1);
+            emit(ROp::IInc, x).imm = (int8_t)code[bci + 2];
+            return;
+        }
+        case 0x85: return define(ROp::I2L, 2, pop(1));
+        case 0x88: return define(ROp::L2I, 1, pop(2));
+        case 0x91: return define(ROp::I2B, 1, pop(1));
+        case 0x92: return define(ROp::I2C, 1, pop(1));
+        case 0x93: return define(ROp::I2S, 1, pop(1));
+        case 0x94: {
+            uint16_t c = pop(2);
+            uint16_t b = pop(2);
+            return define(ROp::LCmp, 1, b, c);
+        }
+        case 0xa7: case 0xc8: return branch(ROp::Goto, 0, 0, 0, bci);
+        case 0xc6: case 0xc7: { // ifnull ifnonnull：null引用为0
+            uint16_t v = pop(1);
+            return branch(ROp::If, op == 0xc6 ? RC_EQ : RC_NE, v, const_int((int32_t)NULL_REF), bci);
+        }
+        default:
+            throw Failure{std::string("untranslated opcode ") + opcode_name(op)};
+        }
+    }
+};
+
+} // namespace
+
+std::unique_ptr<RegisterCode> translate_register_code(const ClassInfo& class_info, const MethodInfo& method, std::string& reason) {
+    try {
+        return Translator(class_info, method).run();
+    } catch (const Failure& f) {
+        reason = f.reason;
+        return nullptr;
+    }
+}
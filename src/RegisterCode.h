@@ -0,0 +1,68 @@
+#ifndef REGISTERCODE_H
+#define REGISTERCODE_H
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "runtime.h"
+
+// 寄存器形式的内部字节码（JVM_REGVM=1启用）：把栈式字节码翻译成三地址指令，
+// 局部变量、操作数栈的每个位置和常量都是平坦寄存器数组中的虚拟寄存器：
+//   [0, max_locals)                      局部变量
+//   [max_locals, max_locals+max_stack)   操作数栈第i个槽位
+//   [max_locals+max_stack, num_regs)     常量
+// 翻译时模拟操作数栈，load/常量只记下来源寄存器，由使用它的运算直接读取，
+// 结果尽量直接写到目标局部变量，iload x; iload y; iadd; istore z只剩一条add。
+// 只翻译int/long运算、局部变量、常量和条件跳转，其他指令（字段、对象、调用、返回等）退出到解释器执行这一条，
+// 下一条指令是新的入口；在基本块边界和退出处操作数栈都已写回对应的寄存器，所以可以与解释器Frame互相转换。
+// long占两个寄存器，高32位在前，与Frame的槽位布局相同。
+
+enum class ROp : uint8_t {
+    Mov,
+    IAdd, ISub, IMul, IDiv, IRem, IAnd, IOr, IXor, IShl, IShr, IUshr, INeg,
+    LAdd, LSub, LMul, LDiv, LRem, LAnd, LOr, LXor, LShl, LShr, LUshr, LNeg,
+    I2L, L2I, I2B, I2C, I2S, LCmp,
+    IInc,  // a += imm
+    If,    // if (b <cond> c) goto imm，比较int
+    Goto,  // goto imm
+    Exit,  // 退出到解释器，从bci处继续，操作数栈深度depth
+};
+
+// 条件码与if<cond>的顺序相同
+enum RCond : uint8_t { RC_EQ, RC_NE, RC_LT, RC_GE, RC_GT, RC_LE };
+
+struct RInst {
+    ROp op;
+    uint8_t cond = 0;
+    bool backward = false; // 跳转到前面的指令（回边）
+    uint16_t a = 0;        // 目标寄存器
+    uint16_t b = 0, c = 0; // 源寄存器
+    uint16_t depth = 0;    // Exit和除法：该指令处的操作数栈深度
+    int32_t imm = 0;       // IInc的增量；跳转目标（指令下标）
+    uint32_t bci = 0;      // 对应的字节码位置，除数为0时从这里退出
+    uint32_t target = 0;   // 跳转目标的bci，回边计数达到阈值时从这里退出
+};
+
+struct RegisterCode {
+    uint16_t num_locals = 0;
+    uint16_t num_stack = 0;
+    uint16_t num_regs = 0;
+    std::vector<SlotT> constants;        // 常量寄存器的初值
+    std::vector<RInst> insts;
+    std::vector<uint32_t> entries;       // 每个bci对应的入口指令下标，不能从该处进入时为NO_ENTRY
+    std::vector<uint16_t> entry_depth;   // 入口处的操作数栈深度
+    size_t translated = 0;               // 翻译成寄存器指令的字节码条数
+    static constexpr uint32_t NO_ENTRY = UINT32_MAX;
+
+    bool can_enter(size_t bci, size_t sp) const {
+        return bci < entries.size() && entries[bci] != NO_ENTRY && entry_depth[bci] == sp;
+    }
+};
+
+// 指令弹出和压入的槽位数，无法静态确定（jsr/ret、wide、invokedynamic）时返回false
+bool stack_effect(const ClassInfo& cls, const std::vector<uint8_t>& code, size_t bci, int& pops, int& pushes);
+
+// 翻译失败（jsr/ret、wide等）时返回nullptr，reason为原因
+std::unique_ptr<RegisterCode> translate_register_code(const ClassInfo& class_info, const MethodInfo& method, std::string& reason);
+
+#endif // REGISTERCODE_H
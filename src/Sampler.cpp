@@ -0,0 +1,321 @@
+#include "Sampler.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <csignal>
+#include <pthread.h>
+#include <sys/time.h>
+#include <fmt/core.h>
+#include "runtime.h"
+
+namespace Sampler {
+
+constexpr size_t MAX_SAMPLE_FRAMES = 64; // 每个样本最多记录的栈深度（从栈顶开始）
+constexpr size_t RING_SIZE = 4096;       // 2的幂
+
+struct SampleFrame {
+    const ClassInfo* class_info;
+    const MethodInfo* method_info;
+    uint32_t bci;
+};
+
+struct Sample {
+    uint32_t depth;
+    SampleFrame frames[MAX_SAMPLE_FRAMES]; // frames[0]为栈顶
+};
+
+// 有界MPSC环形缓冲（Vyukov）：各线程的信号处理函数并发写入，后台线程独自读取。
+// 每个槽位的seq表示槽位状态：seq==pos可写，seq==pos+1可读。只用无锁原子操作，可在信号处理函数中使用
+struct RingSlot {
+    std::atomic<size_t> seq;
+    Sample sample;
+};
+
+static RingSlot ring[RING_SIZE];
+static std::atomic<size_t> ring_head{0};
+static size_t ring_tail = 0; // 只由消费线程访问
+static std::atomic<uint64_t> dropped{0};
+static std::atomic<bool> sampling{false};
+
+static int sample_hz = 0;
+static std::string output_path;
+static std::thread drain_thread;
+static std::atomic<bool> stopping{false};
+static std::chrono::steady_clock::time_point start_time;
+
+static_assert(std::atomic<size_t>::is_always_lock_free, "ring buffer must be lock-free to be used from a signal handler");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shadow stack depth must be lock-free");
+
+static void on_sigprof(int) {
+    if (!sampling.load(std::memory_order_relaxed)) return;
+    int saved_errno = errno;
+    uint32_t depth = shadow_stack.depth.load(std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_acquire);
+    if (depth == 0) { // 线程不在执行Java代码
+        errno = saved_errno;
+        return;
+    }
+    size_t pos = ring_head.load(std::memory_order_relaxed);
+    RingSlot* slot;
+    for (;;) {
+        slot = &ring[pos & (RING_SIZE - 1)];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        if (seq == pos) {
+            if (ring_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (seq < pos) { // 缓冲已满，丢弃样本
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            errno = saved_errno;
+            return;
+        } else {
+            pos = ring_head.load(std::memory_order_relaxed);
+        }
+    }
+    uint32_t visible = std::min(depth, SHADOW_STACK_DEPTH);
+    uint32_t n = 0;
+    for (uint32_t i = visible; i > 0 && n < MAX_SAMPLE_FRAMES; --i) {
+        const ShadowFrame& f = shadow_stack.frames[i - 1];
+        slot->sample.frames[n++] = {f.class_info, f.method_info, static_cast<uint32_t>(*f.pc)};
+    }
+    slot->sample.depth = n;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    errno = saved_errno;
+}
+
+// ---------- 聚合 ----------
+
+using LocationKey = std::tuple<const ClassInfo*, const MethodInfo*, uint32_t>;
+
+static std::map<LocationKey, uint64_t> location_ids;
+static std::map<std::vector<uint64_t>, uint64_t> stack_counts; // location id序列（栈顶在前） -> 样本数
+static uint64_t total_samples = 0;
+
+static uint64_t location_id(const SampleFrame& f) {
+    auto key = LocationKey{f.class_info, f.method_info, f.bci};
+    auto iter = location_ids.find(key);
+    if (iter != location_ids.end()) return iter->second;
+    uint64_t id = location_ids.size() + 1;
+    location_ids.emplace(key, id);
+    return id;
+}
+
+static void drain() {
+    for (;;) {
+        RingSlot& slot = ring[ring_tail & (RING_SIZE - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != ring_tail + 1) return;
+        std::vector<uint64_t> stack;
+        stack.reserve(slot.sample.depth);
+        for (uint32_t i = 0; i < slot.sample.depth; ++i) {
+            stack.push_back(location_id(slot.sample.frames[i]));
+        }
+        slot.seq.store(ring_tail + RING_SIZE, std::memory_order_release);
+        ++ring_tail;
+        stack_counts[std::move(stack)]++;
+        ++total_samples;
+    }
+}
+
+static void drain_loop() {
+    // 消费线程自身不接收SIGPROF
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    while (!stopping.load(std::memory_order_acquire)) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    drain();
+}
+
+static std::string method_name(const ClassInfo& class_info, const MethodInfo& method) {
+    return class_info.constant_pool.get_class_name(class_info.this_class) + "." + method.name;
+}
+
+// ---------- pprof（profile.proto，未压缩） ----------
+
+class ProtoWriter {
+public:
+    std::string buf;
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            buf.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        buf.push_back(static_cast<char>(v));
+    }
+    void tag(uint32_t field, uint32_t wire_type) { varint((uint64_t(field) << 3) | wire_type); }
+    void field_varint(uint32_t field, uint64_t v) { tag(field, 0); varint(v); }
+    void field_bytes(uint32_t field, const std::string& bytes) {
+        tag(field, 2);
+        varint(bytes.size());
+        buf += bytes;
+    }
+    void field_packed(uint32_t field, const std::vector<uint64_t>& values) {
+        ProtoWriter inner;
+        for (uint64_t v : values) inner.varint(v);
+        field_bytes(field, inner.buf);
+    }
+};
+
+static std::string encode_pprof() {
+    std::vector<std::string> strings{""};
+    std::map<std::string, uint64_t> string_ids{{"", 0}};
+    auto intern = [&](const std::string& s) {
+        auto [iter, inserted] = string_ids.emplace(s, strings.size());
+        if (inserted) strings.push_back(s);
+        return iter->second;
+    };
+    auto value_type = [&](const std::string& type, const std::string& unit) {
+        ProtoWriter vt;
+        vt.field_varint(1, intern(type));
+        vt.field_varint(2, intern(unit));
+        return vt.buf;
+    };
+    uint64_t period = 1000000000ull / sample_hz;
+
+    ProtoWriter profile;
+    profile.field_bytes(1, value_type("samples", "count"));
+    profile.field_bytes(1, value_type("cpu", "nanoseconds"));
+    for (const auto& [stack, count] : stack_counts) {
+        ProtoWriter sample;
+        sample.field_packed(1, stack);
+        sample.field_packed(2, {count, count * period});
+        profile.field_bytes(2, sample.buf);
+    }
+    // 每个方法一个Function，每个(方法, bci)一个Location，bci作为行号
+    std::map<const MethodInfo*, uint64_t> function_ids;
+    std::vector<std::pair<const ClassInfo*, const MethodInfo*>> functions;
+    for (const auto& [key, id] : location_ids) {
+        const auto& [class_info, method_info, bci] = key;
+        auto [iter, inserted] = function_ids.emplace(method_info, functions.size() + 1);
+        if (inserted) functions.push_back({class_info, method_info});
+        ProtoWriter line;
+        line.field_varint(1, iter->second);
+        line.field_varint(2, bci);
+        ProtoWriter location;
+        location.field_varint(1, id);
+        location.field_bytes(4, line.buf);
+        profile.field_bytes(4, location.buf);
+    }
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const auto& [class_info, method_info] = functions[i];
+        ProtoWriter function;
+        function.field_varint(1, i + 1);
+        function.field_varint(2, intern(method_name(*class_info, *method_info)));
+        function.field_varint(3, intern(method_name(*class_info, *method_info) + method_info->descriptor));
+        function.field_varint(4, intern(class_info->constant_pool.get_class_name(class_info->this_class)));
+        profile.field_bytes(5, function.buf);
+    }
+    // string_table必须在所有intern之后写出
+    auto duration = std::chrono::steady_clock::now() - start_time;
+    profile.field_varint(10, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    profile.field_bytes(11, value_type("cpu", "nanoseconds"));
+    profile.field_varint(12, period);
+    for (const auto& s : strings) {
+        profile.field_bytes(6, s);
+    }
+    return profile.buf;
+}
+
+static void print_report() {
+    std::map<const MethodInfo*, std::pair<uint64_t, uint64_t>> method_counts; // self, total
+    std::map<const MethodInfo*, const ClassInfo*> method_classes;
+    std::map<LocationKey, uint64_t> hot_bcis;
+    std::vector<LocationKey> keys(location_ids.size() + 1);
+    for (const auto& [key, id] : location_ids) keys[id] = key;
+    for (const auto& [stack, count] : stack_counts) {
+        std::set<const MethodInfo*> seen; // 递归调用只计一次total
+        for (size_t i = 0; i < stack.size(); ++i) {
+            const auto& key = keys[stack[i]];
+            const MethodInfo* m = std::get<1>(key);
+            method_classes[m] = std::get<0>(key);
+            if (i == 0) {
+                method_counts[m].first += count;
+                hot_bcis[key] += count;
+            }
+            if (seen.insert(m).second) method_counts[m].second += count;
+        }
+    }
+
+    fmt::print(stderr, "\n===== JVM sampling profile: {} samples at {} Hz, {} dropped =====\n", total_samples, sample_hz, dropped.load());
+    if (total_samples == 0) return;
+    std::vector<std::pair<const MethodInfo*, std::pair<uint64_t, uint64_t>>> methods(method_counts.begin(), method_counts.end());
+    std::sort(methods.begin(), methods.end(), [](const auto& a, const auto& b) {
+        return a.second.first != b.second.first ? a.second.first > b.second.first : a.second.second > b.second.second;
+    });
+    fmt::print(stderr, "{:>7} {:>7}  {}\n", "self%", "total%", "method");
+    for (const auto& [m, counts] : methods) {
+        fmt::print(stderr, "{:>6.2f}% {:>6.2f}%  {}{}\n", 100.0 * counts.first / total_samples, 100.0 * counts.second / total_samples,
+                   method_name(*method_classes[m], *m), m->descriptor);
+    }
+    std::vector<std::pair<uint64_t, LocationKey>> bcis;
+    for (const auto& [key, count] : hot_bcis) bcis.push_back({count, key});
+    std::sort(bcis.begin(), bcis.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    if (bcis.size() > 20) bcis.resize(20);
+    fmt::print(stderr, "----- hottest bytecode indexes -----\n");
+    for (const auto& [count, key] : bcis) {
+        const auto& [class_info, method_info, bci] = key;
+        fmt::print(stderr, "{:>6.2f}%  {}@{}\n", 100.0 * count / total_samples, method_name(*class_info, *method_info), bci);
+    }
+}
+
+void start(int hz, const char* path) {
+    if (hz <= 0 || sampling.load()) return;
+    sample_hz = std::min(hz, 10000);
+    output_path = path;
+    for (size_t i = 0; i < RING_SIZE; ++i) {
+        ring[i].seq.store(i, std::memory_order_relaxed);
+    }
+    start_time = std::chrono::steady_clock::now();
+    drain_thread = std::thread(drain_loop);
+
+    struct sigaction sa {};
+    sa.sa_handler = on_sigprof;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &sa, nullptr);
+    sampling.store(true, std::memory_order_release);
+
+    // ITIMER_PROF按进程CPU时间计时，信号投递给正在运行的线程，忙的线程被采样得更多
+    struct itimerval timer {};
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 1000000 / sample_hz;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void start_from_env() {
+    const char* hz = std::getenv("JVM_SAMPLE_HZ");
+    if (!hz) return;
+    const char* path = std::getenv("JVM_SAMPLE_OUT");
+    start(std::atoi(hz), path ? path : "jvm_samples.pb");
+}
+
+void stop() {
+    if (!sampling.exchange(false)) return;
+    struct itimerval timer {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    stopping.store(true, std::memory_order_release);
+    drain_thread.join();
+
+    print_report();
+    FILE* out = std::fopen(output_path.c_str(), "wb");
+    if (!out) {
+        fmt::print(stderr, "cannot write pprof profile to {}\n", output_path);
+        return;
+    }
+    std::string data = encode_pprof();
+    std::fwrite(data.data(), 1, data.size(), out);
+    std::fclose(out);
+    fmt::print(stderr, "pprof profile written to {}\n", output_path);
+}
+
+} // namespace Sampler
@@ -0,0 +1,54 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct ClassInfo;
+struct MethodInfo;
+
+// 采样分析器：SIGPROF定时中断当前线程，信号处理函数只读取本线程的影子栈并写入无锁环形缓冲，
+// 后台线程把样本聚合成按方法/字节码位置的热点报告，并输出pprof格式文件。
+// std::stack<Frame>入栈时可能重新分配内部结构，信号处理函数中遍历它不安全，
+// 所以JVMContext在压栈/出栈时同步维护一个定长的影子栈（只存指针，没有分配）。
+namespace Sampler {
+
+struct ShadowFrame {
+    const ClassInfo* class_info;
+    const MethodInfo* method_info;
+    const size_t* pc; // 指向Frame::pc，Frame在std::stack（deque）中的地址在出栈前不变
+};
+
+constexpr uint32_t SHADOW_STACK_DEPTH = 1024;
+
+// 每个OS线程一个，只由本线程写；信号处理函数在同一线程上读，所以只需要信号栅栏
+struct ShadowStack {
+    ShadowFrame frames[SHADOW_STACK_DEPTH];
+    std::atomic<uint32_t> depth;
+};
+
+inline thread_local ShadowStack shadow_stack;
+
+inline void shadow_push(const ClassInfo& class_info, const MethodInfo& method_info, const size_t* pc) {
+    uint32_t d = shadow_stack.depth.load(std::memory_order_relaxed);
+    if (d < SHADOW_STACK_DEPTH) {
+        shadow_stack.frames[d] = {&class_info, &method_info, pc};
+    }
+    std::atomic_signal_fence(std::memory_order_release);
+    shadow_stack.depth.store(d + 1, std::memory_order_relaxed);
+}
+
+inline void shadow_pop() {
+    shadow_stack.depth.store(shadow_stack.depth.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_release);
+}
+
+// 按环境变量JVM_SAMPLE_HZ启动（未设置则不启动），输出写入JVM_SAMPLE_OUT（默认jvm_samples.pb）
+void start_from_env();
+void start(int hz, const char* output_path);
+// 停止采样，输出报告和pprof文件；可重复调用
+void stop();
+
+} // namespace Sampler
+
+#endif // SAMPLER_H
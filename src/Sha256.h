@@ -0,0 +1,10 @@
+#ifndef SHA256_H
+#define SHA256_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// SHA-256（FIPS 180-4），用作验证缓存中class文件内容的键，返回64个小写十六进制字符
+std::string sha256_hex(const uint8_t* data, size_t len);
+
+#endif // SHA256_H
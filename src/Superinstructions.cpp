@@ -0,0 +1,54 @@
+#include "Superinstructions.h"
+#include <cstdlib>
+#include <cstring>
+#include "Profiler.h"
+#include "bytecode.h"
+
+bool superinstructions_enabled() {
+    static const bool enabled = [] {
+        const char* env = std::getenv("JVM_SUPERINSTRUCTIONS");
+        return !(env && std::strcmp(env, "0") == 0) && !Profiler::enabled;
+    }();
+    return enabled;
+}
+
+static bool is_int_op(uint8_t op) {
+    switch (op) {
+    case 0x60: case 0x64: case 0x68: case 0x7e: case 0x80: case 0x82: // iadd isub imul iand ior ixor
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 从bci开始匹配，返回超级指令编号
+static SuperOp match(const std::vector<uint8_t>& code, size_t bci) {
+    size_t n = code.size();
+    switch (code[bci]) {
+    case 0x2a: // aload_0
+        return bci + 1 < n && code[bci + 1] == 0xb4 ? SUPER_ALOAD_0_GETFIELD : SUPER_NONE;
+    case 0x84: // iinc
+        return bci + 3 < n && code[bci + 3] == 0xa7 ? SUPER_IINC_GOTO : SUPER_NONE;
+    default:
+        break;
+    }
+    if (int_load_index(code, bci) < 0) return SUPER_NONE;
+    size_t second = bci + instruction_length(code, bci);
+    if (second >= n || int_load_index(code, second) < 0) return SUPER_NONE;
+    size_t third = second + instruction_length(code, second);
+    if (third >= n) return SUPER_NONE;
+    if (code[third] >= 0x9f && code[third] <= 0xa4) return SUPER_ILOAD_ILOAD_IF_ICMP;
+    if (is_int_op(code[third]) && third + 1 < n && int_store_index(code, third + 1) >= 0) return SUPER_ILOAD_ILOAD_IOP_ISTORE;
+    return SUPER_NONE;
+}
+
+std::vector<uint8_t> find_superinstructions(const std::vector<uint8_t>& code) {
+    std::vector<uint8_t> table(code.size(), SUPER_NONE);
+    bool found = false;
+    for (size_t bci = 0; bci < code.size(); bci += instruction_length(code, bci)) {
+        table[bci] = match(code, bci);
+        found |= table[bci] != SUPER_NONE;
+    }
+    if (!found) table.clear();
+    return table;
+}
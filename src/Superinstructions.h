@@ -0,0 +1,43 @@
+#ifndef SUPERINSTRUCTIONS_H
+#define SUPERINSTRUCTIONS_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 超级指令：把解释执行的循环中最常见的字节码序列合并为一次分派。
+// 序列按JVM_PROFILE报告中的操作码序列统计选出；类加载时扫描方法字节码，
+// 在序列起始bci处记下超级指令编号（MethodInfo::superinstructions，与code等长，0表示没有）。
+// 原字节码不改写，编译器照常读取；跳转到序列中间时从该处逐条解释，结果相同。
+// JVM_SUPERINSTRUCTIONS=0关闭，启用JVM_PROFILE时也关闭，以免操作码统计漏掉被合并的指令。
+enum SuperOp : uint8_t {
+    SUPER_NONE = 0,
+    SUPER_ILOAD_ILOAD_IOP_ISTORE, // iload x; iload y; iadd/isub/imul/iand/ior/ixor; istore z
+    SUPER_ILOAD_ILOAD_IF_ICMP,    // iload x; iload y; if_icmp<cond>
+    SUPER_ALOAD_0_GETFIELD,       // aload_0; getfield
+    SUPER_IINC_GOTO,              // iinc; goto
+    SUPER_ARRAY_LOAD_UNCHECKED,   // 不检查下标的xaload（BoundsCheck.h）
+    SUPER_ARRAY_STORE_UNCHECKED,  // 不检查下标的xastore（BoundsCheck.h）
+    SUPER_VECTOR_LOOP,            // 向量化循环的循环头（Vectorizer.h）
+    SUPER_COUNT,
+};
+
+bool superinstructions_enabled();
+
+// 返回与code等长的超级指令表，没有可合并的序列时返回空表
+std::vector<uint8_t> find_superinstructions(const std::vector<uint8_t>& code);
+
+// iload / iload_<n>的局部变量编号，不是这两种指令时返回-1
+inline int int_load_index(const std::vector<uint8_t>& code, size_t pc) {
+    if (code[pc] == 0x15) return code[pc + 1];
+    if (code[pc] >= 0x1a && code[pc] <= 0x1d) return code[pc] - 0x1a;
+    return -1;
+}
+
+// istore / istore_<n>的局部变量编号，不是这两种指令时返回-1
+inline int int_store_index(const std::vector<uint8_t>& code, size_t pc) {
+    if (code[pc] == 0x36) return code[pc + 1];
+    if (code[pc] >= 0x3b && code[pc] <= 0x3e) return code[pc] - 0x3b;
+    return -1;
+}
+
+#endif // SUPERINSTRUCTIONS_H
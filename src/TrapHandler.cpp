@@ -0,0 +1,89 @@
+#include "TrapHandler.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <vector>
+#include <ucontext.h>
+#include "runtime.h"
+
+// 隐式检查点表，链接器为其生成__start_/__stop_符号；每项是陷入指令相对表项自身的偏移
+extern "C" const int32_t __start_jvm_implicit_checks[] __attribute__((weak));
+extern "C" const int32_t __stop_jvm_implicit_checks[] __attribute__((weak));
+
+namespace TrapHandler {
+
+// null引用读取的是0地址，故障地址超出保护页说明对象指针本身有误，不是null访问
+static constexpr uintptr_t NULL_GUARD_SIZE = 4096;
+
+// 隐式检查指令的地址，install时排好序，处理函数中只读
+static std::vector<uintptr_t> check_sites;
+
+void throw_null_pointer() {
+    throw JavaRuntimeError("java/lang/NullPointerException");
+}
+
+void throw_division_by_zero() {
+    throw JavaRuntimeError("java/lang/ArithmeticException");
+}
+
+static struct sigaction previous_segv;
+static struct sigaction previous_fpe;
+
+// 出错指令的地址，不支持的平台返回0（不转换任何陷入）
+static uintptr_t fault_pc(void* context) {
+    const auto* uc = static_cast<const ucontext_t*>(context);
+#if defined(__x86_64__)
+    return static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+    return static_cast<uintptr_t>(uc->uc_mcontext.pc);
+#else
+    (void)uc;
+    return 0;
+#endif
+}
+
+static bool in_implicit_check(uintptr_t pc) {
+    return std::binary_search(check_sites.begin(), check_sites.end(), pc);
+}
+
+// 交给安装前的处理函数；原来是默认处理（或忽略，同步产生的故障无法忽略）时恢复默认处理，
+// 返回后重新执行出错的指令，按默认方式终止进程
+static void chain(int sig, siginfo_t* info, void* context) {
+    const struct sigaction& previous = sig == SIGSEGV ? previous_segv : previous_fpe;
+    if (previous.sa_flags & SA_SIGINFO) {
+        previous.sa_sigaction(sig, info, context);
+    } else if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN) {
+        previous.sa_handler(sig);
+    } else {
+        signal(sig, SIG_DFL);
+    }
+}
+
+static void on_trap(int sig, siginfo_t* info, void* context) {
+    // 只转换Java线程上隐式检查点处的陷入，其他故障（JVM自身的代码出错）不是Java异常
+    if (JVMContext::current && in_implicit_check(fault_pc(context))) {
+        if (sig == SIGFPE && info->si_code == FPE_INTDIV) {
+            throw_division_by_zero();
+        }
+        if (sig == SIGSEGV && reinterpret_cast<uintptr_t>(info->si_addr) < NULL_GUARD_SIZE) {
+            throw_null_pointer();
+        }
+    }
+    chain(sig, info, context);
+}
+
+void install() {
+    for (const int32_t* entry = __start_jvm_implicit_checks; entry != __stop_jvm_implicit_checks; ++entry) {
+        check_sites.push_back(reinterpret_cast<uintptr_t>(entry) + *entry);
+    }
+    std::sort(check_sites.begin(), check_sites.end());
+    struct sigaction sa {};
+    sa.sa_sigaction = on_trap;
+    sigemptyset(&sa.sa_mask);
+    // 抛出异常离开处理函数时不经过sigreturn，SA_NODEFER使处理期间不屏蔽该信号，之后可以再次陷入
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigaction(SIGSEGV, &sa, &previous_segv);
+    sigaction(SIGFPE, &sa, &previous_fpe);
+}
+
+} // namespace TrapHandler
@@ -0,0 +1,80 @@
+#ifndef TRAPHANDLER_H
+#define TRAPHANDLER_H
+#include <cstdint>
+
+// 隐式检查：null访问和整数除零不在字节码处理函数中显式检查，而是由硬件陷阱发现：
+//   - null引用（句柄0）在句柄表中对应空指针，Heap::get读取对象头时访问0地址，
+//     落在进程最低处不映射的保护页上（Linux的vm.mmap_min_addr），产生SIGSEGV
+//   - x86-64上整数除以0产生SIGFPE（INT_MIN/-1也会陷入，idiv/irem对-1单独处理）
+// 可能陷入的读操作和除法由下面的内联函数用内联汇编生成，每条指令的地址记入jvm_implicit_checks段
+// （相对表项自身的32位偏移，不需要重定位），install时整理成有序表。
+// 信号处理函数确认当前线程正在执行Java代码、且出错的pc在表中后，直接从处理函数抛出JavaRuntimeError
+// （程序以-fnon-call-exceptions编译，volatile内联汇编和访存指令都可以抛出C++异常），
+// Interpreter::run再按抛出时各帧的pc查找异常处理器，得到的字节码位置就是出错的那条指令。
+// 编译代码不访问对象，除法前也有显式检查，不会在编译代码中陷入。
+// 其他位置的SIGSEGV/SIGFPE（JVM自身或本地库的错误）交给安装前的处理函数。
+// 其他平台上这些函数退化为显式比较。
+#if defined(__x86_64__)
+#define TRAP_HANDLER_SITE(insn) \
+    "1: " insn "\n\t.pushsection jvm_implicit_checks,\"a?\"\n\t.balign 4\n\t.long 1b - .\n\t.popsection"
+#endif
+
+namespace TrapHandler {
+
+// 安装SIGSEGV/SIGFPE处理函数，main启动时调用一次
+void install();
+
+[[noreturn]] void throw_null_pointer();
+[[noreturn]] void throw_division_by_zero();
+
+// 读取对象头的第一个字节，obj为空指针（null引用）时陷入
+inline void probe(const void* obj) {
+#if defined(__x86_64__)
+    asm volatile(TRAP_HANDLER_SITE("cmpb $0, %0") : : "m"(*static_cast<const char*>(obj)) : "cc");
+#else
+    if (!obj) throw_null_pointer();
+#endif
+}
+
+// 整数除法和取余，除数为0时陷入；除数为-1由调用者处理
+inline int32_t divide(int32_t a, int32_t b, int32_t* rem = nullptr) {
+    int32_t q, r;
+#if defined(__x86_64__)
+    asm volatile("cltd\n\t" TRAP_HANDLER_SITE("idivl %3") : "=a"(q), "=&d"(r) : "0"(a), "r"(b) : "cc");
+#else
+    if (b == 0) throw_division_by_zero();
+    q = a / b;
+    r = a % b;
+#endif
+    if (rem) *rem = r;
+    return q;
+}
+
+inline int64_t divide(int64_t a, int64_t b, int64_t* rem = nullptr) {
+    int64_t q, r;
+#if defined(__x86_64__)
+    asm volatile("cqto\n\t" TRAP_HANDLER_SITE("idivq %3") : "=a"(q), "=&d"(r) : "0"(a), "r"(b) : "cc");
+#else
+    if (b == 0) throw_division_by_zero();
+    q = a / b;
+    r = a % b;
+#endif
+    if (rem) *rem = r;
+    return q;
+}
+
+inline int32_t remainder(int32_t a, int32_t b) {
+    int32_t r;
+    divide(a, b, &r);
+    return r;
+}
+
+inline int64_t remainder(int64_t a, int64_t b) {
+    int64_t r;
+    divide(a, b, &r);
+    return r;
+}
+
+} // namespace TrapHandler
+
+#endif // TRAPHANDLER_H
@@ -0,0 +1,30 @@
+#include "TypeCheck.h"
+#include "bytecode.h"
+
+bool is_subtype_slow(const Klass& s, const Klass& t) {
+    if (s.secondary_super_cache.load(std::memory_order_relaxed) == &t) return true;
+    bool found = false;
+    for (const Klass* k : s.secondary_supers) {
+        if (k == &t) {
+            found = true;
+            break;
+        }
+    }
+    // [LA;是[LB;的子类型当且仅当A是B的子类型；基本类型数组只与自身相同，已在快速路径比较过
+    if (!found && s.is_array() && t.is_array() && s.element && t.element) {
+        found = is_subtype_of(*s.element, *t.element);
+    }
+    if (found) s.secondary_super_cache.store(&t, std::memory_order_relaxed);
+    return found;
+}
+
+std::vector<TypeCheckSite> find_type_check_sites(const std::vector<uint8_t>& code) {
+    std::vector<TypeCheckSite> sites;
+    for (size_t pc = 0; pc < code.size(); pc += instruction_length(code, pc)) {
+        if (code[pc] == 0xc0 || code[pc] == 0xc1) {
+            sites.emplace_back();
+            sites.back().bci = (uint32_t)pc;
+        }
+    }
+    return sites;
+}
@@ -0,0 +1,22 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+#include <vector>
+#include "runtime.h"
+
+// checkcast/instanceof和异常处理器匹配的子类型检查，s和t都必须已经ClassLoader::link_supers：
+// - t是primary的类时，s是t的子类当且仅当s.primary_supers[t.depth] == &t，只需一次读取和比较
+// - 其余情况（接口、很深的类、没有class文件的类、数组）先比较s的secondary_super_cache，
+//   再线性查找s.secondary_supers，找到后记入缓存；数组按元素类型协变
+// 每个checkcast/instanceof调用点还记住上一次通过检查的对象类型，同一类型再次经过时不做任何查找
+bool is_subtype_slow(const Klass& s, const Klass& t);
+
+inline bool is_subtype_of(const Klass& s, const Klass& t) {
+    if (&s == &t) return true;
+    if (t.primary) return s.primary_supers[t.depth] == &t;
+    return is_subtype_slow(s, t);
+}
+
+// 方法中所有的checkcast/instanceof，按bci升序
+std::vector<TypeCheckSite> find_type_check_sites(const std::vector<uint8_t>& code);
+
+#endif // TYPECHECK_H
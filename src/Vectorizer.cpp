@@ -0,0 +1,584 @@
+#include "Vectorizer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "BoundsCheck.h"
+#include "Superinstructions.h"
+#include "interpreter.h"
+
+bool vectorization_enabled() {
+    static const bool enabled = [] {
+        const char* env = std::getenv("JVM_VECTORIZE");
+        return !(env && std::strcmp(env, "0") == 0);
+    }();
+    return enabled;
+}
+
+namespace {
+
+// ---------------- 识别 ----------------
+
+// 循环体求值时操作数栈上的符号值
+struct Node {
+    enum Kind : uint8_t { ARRAYREF, INDEX, ELEMENT, LOCAL, CONST, BIN } kind;
+    VecType type = VecType::Int;
+    int local = -1;    // ARRAYREF/ELEMENT：数组所在的局部变量；LOCAL：局部变量
+    uint64_t bits = 0; // CONST
+    VecOp op = VecOp::None;
+    int lhs = -1, rhs = -1; // BIN的操作数（nodes下标）
+};
+
+size_t type_width(VecType type) {
+    return type == VecType::Long || type == VecType::Double ? 2 : 1;
+}
+
+// xload / xload_<n>：kind为IJFDA之一
+bool local_load(const std::vector<uint8_t>& code, size_t pc, char& kind, int& local) {
+    static const char kinds[] = "IJFDA";
+    uint8_t op = code[pc];
+    if (op >= 0x15 && op <= 0x19) {
+        kind = kinds[op - 0x15];
+        local = code[pc + 1];
+        return true;
+    }
+    if (op >= 0x1a && op <= 0x2d) {
+        kind = kinds[(op - 0x1a) / 4];
+        local = (op - 0x1a) % 4;
+        return true;
+    }
+    return false;
+}
+
+// xstore / xstore_<n>
+bool local_store(const std::vector<uint8_t>& code, size_t pc, char& kind, int& local) {
+    static const char kinds[] = "IJFDA";
+    uint8_t op = code[pc];
+    if (op >= 0x36 && op <= 0x3a) {
+        kind = kinds[op - 0x36];
+        local = code[pc + 1];
+        return true;
+    }
+    if (op >= 0x3b && op <= 0x4e) {
+        kind = kinds[(op - 0x3b) / 4];
+        local = (op - 0x3b) % 4;
+        return true;
+    }
+    return false;
+}
+
+VecType kind_type(char kind) {
+    switch (kind) {
+    case 'J': return VecType::Long;
+    case 'F': return VecType::Float;
+    case 'D': return VecType::Double;
+    default: return VecType::Int;
+    }
+}
+
+uint64_t float_bits(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof u);
+    return u;
+}
+
+uint64_t double_bits(double d) {
+    uint64_t u;
+    std::memcpy(&u, &d, sizeof u);
+    return u;
+}
+
+// 压入常量的指令
+bool constant(const ClassInfo& cf, const std::vector<uint8_t>& code, size_t pc, Node& node) {
+    uint8_t op = code[pc];
+    node.kind = Node::CONST;
+    if (op >= 0x02 && op <= 0x08) { node.type = VecType::Int; node.bits = (uint32_t)(op - 0x03); return true; } // iconst_<i>
+    if (op == 0x09 || op == 0x0a) { node.type = VecType::Long; node.bits = op - 0x09; return true; }           // lconst_<l>
+    if (op >= 0x0b && op <= 0x0d) { node.type = VecType::Float; node.bits = float_bits((float)(op - 0x0b)); return true; }
+    if (op == 0x0e || op == 0x0f) { node.type = VecType::Double; node.bits = double_bits((double)(op - 0x0e)); return true; }
+    if (op == 0x10) { node.type = VecType::Int; node.bits = (uint32_t)(int32_t)(int8_t)code[pc + 1]; return true; }
+    if (op == 0x11) { node.type = VecType::Int; node.bits = (uint32_t)(int32_t)(int16_t)((code[pc + 1] << 8) | code[pc + 2]); return true; }
+    if (op == 0x12 || op == 0x13 || op == 0x14) { // ldc ldc_w ldc2_w
+        uint16_t idx = op == 0x12 ? code[pc + 1] : (uint16_t)((code[pc + 1] << 8) | code[pc + 2]);
+        const ConstantPoolInfo& info = cf.constant_pool[idx];
+        switch (info.tag) {
+        case ConstantType::INTEGER: node.type = VecType::Int; node.bits = info.integerOrFloat; return op != 0x14;
+        case ConstantType::FLOAT: node.type = VecType::Float; node.bits = info.integerOrFloat; return op != 0x14;
+        case ConstantType::LONG: case ConstantType::DOUBLE:
+            node.type = info.tag == ConstantType::LONG ? VecType::Long : VecType::Double;
+            node.bits = ((uint64_t)info.longOrDouble_high_bytes << 32) | info.longOrDouble_low_bytes;
+            return op == 0x14;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+// 可以向量化的二元运算；整数除法可能抛出ArithmeticException，不在其中
+bool binary(uint8_t op, VecType& type, VecOp& vop) {
+    static const VecType types[] = {VecType::Int, VecType::Long, VecType::Float, VecType::Double};
+    static const VecOp arith[] = {VecOp::Add, VecOp::Sub, VecOp::Mul, VecOp::Div};
+    static const VecOp logic[] = {VecOp::And, VecOp::Or, VecOp::Xor};
+    if (op >= 0x60 && op <= 0x6f) {
+        type = types[(op - 0x60) % 4];
+        vop = arith[(op - 0x60) / 4];
+        return vop != VecOp::Div || type == VecType::Float || type == VecType::Double;
+    }
+    if (op >= 0x7e && op <= 0x83) {
+        type = types[(op - 0x7e) % 2];
+        vop = logic[(op - 0x7e) / 2];
+        return true;
+    }
+    return false;
+}
+
+class Matcher {
+public:
+    Matcher(const ClassInfo& cf, const std::vector<uint8_t>& code, const CountedLoop& counted)
+        : cf(cf), code(code), counted(counted) {}
+
+    // 循环体恰好是一条映射或归约语句时填写out
+    bool match(VectorLoop& out) {
+        int element_node = -1;
+        for (size_t pc = counted.body; pc < counted.iinc; pc += instruction_length(code, pc)) {
+            size_t next = pc + instruction_length(code, pc);
+            bool last = next == counted.iinc;
+            uint8_t op = code[pc];
+            char kind;
+            int local;
+            Node node{};
+            VecType type;
+            VecOp vop;
+            if (local_load(code, pc, kind, local)) {
+                if (kind == 'A') {
+                    push(Node{Node::ARRAYREF, VecType::Int, local});
+                } else if (kind == 'I' && local == counted.index) {
+                    push(Node{Node::INDEX});
+                } else if (local == out.element_local && element_node >= 0) {
+                    if (nodes[element_node].type != kind_type(kind)) return false;
+                    stack.push_back(element_node);
+                } else {
+                    push(Node{Node::LOCAL, kind_type(kind), local});
+                }
+            } else if (constant(cf, code, pc, node)) {
+                push(node);
+            } else if (op >= 0x2e && op <= 0x31) { // iaload laload faload daload
+                int index, array;
+                if (!pop(index) || !pop(array)) return false;
+                if (nodes[index].kind != Node::INDEX || nodes[array].kind != Node::ARRAYREF) return false;
+                push(Node{Node::ELEMENT, (VecType)(op - 0x2e), nodes[array].local});
+            } else if (op == 0x5c) { // dup2：d[i] op= x
+                size_t n = stack.size();
+                if (n < 2 || nodes[stack[n - 2]].kind != Node::ARRAYREF || nodes[stack[n - 1]].kind != Node::INDEX) return false;
+                stack.push_back(stack[n - 2]);
+                stack.push_back(stack[n - 1]);
+            } else if (binary(op, type, vop)) {
+                int rhs, lhs;
+                if (!pop(rhs) || !pop(lhs)) return false;
+                if (nodes[lhs].type != type || nodes[rhs].type != type) return false;
+                node.kind = Node::BIN;
+                node.type = type;
+                node.op = vop;
+                node.lhs = lhs;
+                node.rhs = rhs;
+                push(node);
+            } else if (op >= 0x4f && op <= 0x52) { // iastore lastore fastore dastore
+                int value, index, array;
+                if (!pop(value) || !pop(index) || !pop(array) || !last || !stack.empty()) return false;
+                if (nodes[index].kind != Node::INDEX || nodes[array].kind != Node::ARRAYREF) return false;
+                out.type = (VecType)(op - 0x4f);
+                out.reduction = false;
+                out.target = nodes[array].local;
+                return nodes[value].type == out.type && expression(value, out);
+            } else if (local_store(code, pc, kind, local) && kind != 'A') {
+                int value;
+                if (!pop(value) || !stack.empty()) return false;
+                const Node& v = nodes[value];
+                if (!last) {
+                    // 增强for：x = b[i]
+                    if (v.kind != Node::ELEMENT || element_node >= 0 || v.type != kind_type(kind) || local == counted.index) return false;
+                    element_node = value;
+                    out.element_local = local;
+                    out.element_array = v.local;
+                    continue;
+                }
+                return reduction(value, kind_type(kind), local, out);
+            } else {
+                return false;
+            }
+        }
+        return false;
+    }
+
+private:
+    const ClassInfo& cf;
+    const std::vector<uint8_t>& code;
+    const CountedLoop& counted;
+    std::vector<Node> nodes;
+    std::vector<int> stack;
+
+    void push(const Node& node) {
+        nodes.push_back(node);
+        stack.push_back((int)nodes.size() - 1);
+    }
+
+    bool pop(int& node) {
+        if (stack.empty()) return false;
+        node = stack.back();
+        stack.pop_back();
+        return true;
+    }
+
+    // s = s <combine> e 或 s = e <combine> s（减法只能是前者）
+    bool reduction(int value, VecType type, int local, VectorLoop& out) {
+        const Node& v = nodes[value];
+        if (type != VecType::Int && type != VecType::Long) return false;
+        if (v.kind != Node::BIN || v.type != type || v.op == VecOp::Mul) return false;
+        auto is_acc = [&](int n) { return nodes[n].kind == Node::LOCAL && nodes[n].local == local; };
+        int e;
+        if (is_acc(v.lhs)) e = v.rhs;
+        else if (is_acc(v.rhs) && v.op != VecOp::Sub) e = v.lhs;
+        else return false;
+        out.type = type;
+        out.reduction = true;
+        out.target = local;
+        out.combine = v.op;
+        return expression(e, out);
+    }
+
+    bool expression(int n, VectorLoop& out) {
+        const Node& e = nodes[n];
+        if (e.type != out.type) return false;
+        if (e.kind != Node::BIN) {
+            out.op = VecOp::None;
+            return operand(n, out.lhs);
+        }
+        out.op = e.op;
+        return operand(e.lhs, out.lhs) && operand(e.rhs, out.rhs);
+    }
+
+    bool overlaps(int a, size_t wa, int b, size_t wb) const {
+        return b >= 0 && a < b + (int)wb && b < a + (int)wa;
+    }
+
+    bool operand(int n, VecOperand& out) const {
+        const Node& node = nodes[n];
+        switch (node.kind) {
+        case Node::ELEMENT:
+            out.kind = VecOperand::ELEMENT;
+            out.local = node.local;
+            return true;
+        case Node::CONST:
+            out.kind = VecOperand::CONST;
+            out.bits = node.bits;
+            return true;
+        case Node::LOCAL: {
+            // 循环中不变：不能是i、累加的s和增强for的元素变量
+            size_t w = type_width(node.type);
+            if (overlaps(node.local, w, counted.index, 1)) return false;
+            out.kind = VecOperand::LOCAL;
+            out.local = node.local;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+};
+
+// 局部变量操作数不能与循环中写入的局部变量重叠
+bool invariant_operands(const VectorLoop& loop) {
+    size_t w = type_width(loop.type);
+    for (const VecOperand* o : {&loop.lhs, &loop.rhs}) {
+        if (o->kind != VecOperand::LOCAL) continue;
+        if (loop.reduction && o->local < loop.target + (int)w && loop.target < o->local + (int)w) return false;
+        if (loop.element_local >= 0 && o->local < loop.element_local + (int)w && loop.element_local < o->local + (int)w) return false;
+    }
+    return !loop.reduction || loop.element_local != loop.target;
+}
+
+// ---------------- SIMD核 ----------------
+
+struct Operand {
+    const SlotT* array = nullptr; // nullptr表示广播bits
+    uint64_t bits = 0;
+};
+
+struct KernelArgs {
+    VecType type;
+    VecOp op;
+    Operand lhs, rhs;
+    SlotT* dst = nullptr; // 映射的目标数组，归约时为nullptr
+    VecOp combine = VecOp::None;
+    uint64_t total = 0;   // 归约：e在[from, to)上按combine合并的结果
+    size_t from = 0, to = 0;
+};
+
+// 以下函数都强制内联到按指令集编译的kernel_*中，不存在以向量为参数或返回值的实际调用。
+// 编译器在文件末尾实例化模板时才给出-Wpsabi警告，因此不恢复该警告
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// V是T的向量（或T本身，用于剩余不足一个向量的元素）。32位元素占一个槽位；
+// 64位元素占两个槽位，高32位在前，与小端机器上的内存布局相反，装入后交换两半
+template <typename V, typename T>
+struct Lanes {
+    static constexpr size_t N = sizeof(V) / sizeof(T);
+    static constexpr size_t W = sizeof(T) / sizeof(SlotT);
+
+    [[gnu::always_inline]] static inline V swap_halves(V v) {
+        if constexpr (W == 1) {
+            return v;
+        } else {
+            typedef uint64_t U __attribute__((vector_size(sizeof(V))));
+            U u;
+            std::memcpy(&u, &v, sizeof v);
+            u = (u << 32) | (u >> 32);
+            std::memcpy(&v, &u, sizeof v);
+            return v;
+        }
+    }
+    [[gnu::always_inline]] static inline V load(const SlotT* p) {
+        V v;
+        std::memcpy(&v, p, sizeof v);
+        return swap_halves(v);
+    }
+    [[gnu::always_inline]] static inline void store(SlotT* p, V v) {
+        v = swap_halves(v);
+        std::memcpy(p, &v, sizeof v);
+    }
+    [[gnu::always_inline]] static inline V splat(uint64_t bits) {
+        T x;
+        std::memcpy(&x, &bits, sizeof x);
+        if constexpr (N == 1) {
+            return x;
+        } else {
+            V v;
+            for (size_t l = 0; l < N; ++l) v[l] = x;
+            return v;
+        }
+    }
+    [[gnu::always_inline]] static inline V apply(VecOp op, V a, V b) {
+        switch (op) {
+        case VecOp::Add: return a + b;
+        case VecOp::Sub: return a - b;
+        case VecOp::Mul: return a * b;
+        default: break;
+        }
+        if constexpr (std::is_integral_v<T>) {
+            switch (op) {
+            case VecOp::And: return a & b;
+            case VecOp::Or: return a | b;
+            case VecOp::Xor: return a ^ b;
+            default: break;
+            }
+        } else {
+            if (op == VecOp::Div) return a / b;
+        }
+        return a;
+    }
+    [[gnu::always_inline]] static inline V operand(const Operand& o, V broadcast, size_t i) {
+        return o.array ? load(o.array + i * W) : broadcast;
+    }
+    [[gnu::always_inline]] static inline size_t map(const KernelArgs& k, size_t i) {
+        V x = splat(k.lhs.bits), y = splat(k.rhs.bits);
+        for (; i + N <= k.to; i += N) {
+            V r = operand(k.lhs, x, i);
+            if (k.op != VecOp::None) r = apply(k.op, r, operand(k.rhs, y, i));
+            store(k.dst + i * W, r);
+        }
+        return i;
+    }
+    // 减法的各项先相加，最后从s中减去
+    [[gnu::always_inline]] static inline size_t reduce(const KernelArgs& k, size_t i, T& total) {
+        VecOp combine = k.combine == VecOp::Sub ? VecOp::Add : k.combine;
+        V x = splat(k.lhs.bits), y = splat(k.rhs.bits);
+        V acc = splat(combine == VecOp::And ? ~uint64_t(0) : 0);
+        for (; i + N <= k.to; i += N) {
+            V r = operand(k.lhs, x, i);
+            if (k.op != VecOp::None) r = apply(k.op, r, operand(k.rhs, y, i));
+            acc = apply(combine, acc, r);
+        }
+        T lanes[N];
+        std::memcpy(lanes, &acc, sizeof acc);
+        for (size_t l = 0; l < N; ++l) total = Lanes<T, T>::apply(combine, total, lanes[l]);
+        return i;
+    }
+};
+
+template <typename V, typename T>
+[[gnu::always_inline]] inline void run_typed(KernelArgs& k) {
+    if (k.dst) {
+        size_t i = Lanes<V, T>::map(k, k.from);
+        Lanes<T, T>::map(k, i);
+        return;
+    }
+    T total = k.combine == VecOp::And ? (T)~uint64_t(0) : 0;
+    size_t i = Lanes<V, T>::reduce(k, k.from, total);
+    Lanes<T, T>::reduce(k, i, total);
+    k.total = total;
+}
+
+template <typename VI, typename VL, typename VF, typename VD>
+[[gnu::always_inline]] inline void run_kernel(KernelArgs& k) {
+    switch (k.type) {
+    case VecType::Int: run_typed<VI, uint32_t>(k); break;
+    case VecType::Long: run_typed<VL, uint64_t>(k); break;
+    case VecType::Float: run_typed<VF, float>(k); break;
+    case VecType::Double: run_typed<VD, double>(k); break;
+    }
+}
+
+void kernel_scalar(KernelArgs& k) {
+    run_kernel<uint32_t, uint64_t, float, double>(k);
+}
+
+#if defined(__x86_64__)
+typedef uint32_t v8u __attribute__((vector_size(32)));
+typedef uint64_t v4ul __attribute__((vector_size(32)));
+typedef float v8f __attribute__((vector_size(32)));
+typedef double v4d __attribute__((vector_size(32)));
+typedef uint32_t v4u __attribute__((vector_size(16)));
+typedef uint64_t v2ul __attribute__((vector_size(16)));
+typedef float v4f __attribute__((vector_size(16)));
+typedef double v2d __attribute__((vector_size(16)));
+
+__attribute__((target("avx2"))) void kernel_avx2(KernelArgs& k) {
+    run_kernel<v8u, v4ul, v8f, v4d>(k);
+}
+
+__attribute__((target("sse4.1"))) void kernel_sse4(KernelArgs& k) {
+    run_kernel<v4u, v2ul, v4f, v2d>(k);
+}
+#endif
+
+struct Isa {
+    const char* name;
+    void (*kernel)(KernelArgs&);
+};
+
+const Isa& selected_isa() {
+    static const Isa isa = [] {
+        const char* env = std::getenv("JVM_VECTOR_ISA");
+        std::string limit = env ? env : "";
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (limit != "sse4" && limit != "scalar" && __builtin_cpu_supports("avx2")) return Isa{"avx2", kernel_avx2};
+        if (limit != "scalar" && __builtin_cpu_supports("sse4.1")) return Isa{"sse4.1", kernel_sse4};
+#endif
+        return Isa{"scalar", kernel_scalar};
+    }();
+    return isa;
+}
+
+uint64_t read_local(const SlotT* locals, int local, size_t width) {
+    return width == 2 ? ((uint64_t)locals[local] << 32) | locals[local + 1] : locals[local];
+}
+
+void write_local(SlotT* locals, int local, size_t width, uint64_t bits) {
+    if (width == 2) {
+        locals[local] = (SlotT)(bits >> 32);
+        locals[local + 1] = (SlotT)bits;
+    } else {
+        locals[local] = (SlotT)bits;
+    }
+}
+
+} // namespace
+
+const char* vector_isa() {
+    return selected_isa().name;
+}
+
+std::vector<VectorLoop> find_vector_loops(const ClassInfo& cf, const MethodInfo& method, std::vector<uint8_t>& table) {
+    std::vector<VectorLoop> loops;
+    for (const CountedLoop& counted : find_counted_loops(cf, method)) {
+        VectorLoop loop;
+        Matcher matcher(cf, method.code, counted);
+        if (!matcher.match(loop) || !invariant_operands(loop)) continue;
+        loop.header = (uint32_t)counted.header;
+        loop.index = counted.index;
+        if (counted.length >= 0) loop.bound_length = counted.length;
+        else loop.bound_array = counted.array;
+        if (table.empty()) table.assign(method.code.size(), SUPER_NONE);
+        loop.replaced = table[loop.header];
+        table[loop.header] = SUPER_VECTOR_LOOP;
+        loops.push_back(loop);
+    }
+    std::sort(loops.begin(), loops.end(), [](const VectorLoop& a, const VectorLoop& b) { return a.header < b.header; });
+    return loops;
+}
+
+bool run_vector_loop(const VectorLoop& loop, Frame& frame, Interpreter& interp) {
+    SlotT* locals = frame.local_vars.vars.data();
+    IntT from = (IntT)locals[loop.index];
+    if (from < 0) return false;
+    IntT to;
+    if (loop.bound_array >= 0) {
+        RefT ref = locals[loop.bound_array];
+        if (ref == NULL_REF) return false;
+        to = (IntT)interp.get_array(ref).len;
+    } else {
+        to = (IntT)locals[loop.bound_length];
+    }
+    if (to <= from) return false;
+    size_t width = type_width(loop.type);
+    // 用到的数组都必须非null且覆盖[from, to)，否则由解释器在出错的那次迭代抛出异常
+    auto elements = [&](int local, SlotT*& elems) {
+        RefT ref = locals[local];
+        if (ref == NULL_REF) return false;
+        JVMArray& arr = interp.get_array(ref);
+        if (arr.len < (size_t)to || arr.element_width_slots != width) return false;
+        elems = arr.elems();
+        return true;
+    };
+    KernelArgs k;
+    k.type = loop.type;
+    k.op = loop.op;
+    k.from = (size_t)from;
+    k.to = (size_t)to;
+    for (auto [src, dst] : {std::make_pair(&loop.lhs, &k.lhs), std::make_pair(&loop.rhs, &k.rhs)}) {
+        SlotT* elems = nullptr;
+        switch (src->kind) {
+        case VecOperand::ELEMENT:
+            if (!elements(src->local, elems)) return false;
+            dst->array = elems;
+            break;
+        case VecOperand::LOCAL:
+            dst->bits = read_local(locals, src->local, width);
+            break;
+        default:
+            dst->bits = src->bits;
+            break;
+        }
+    }
+    SlotT* last = nullptr;
+    if (loop.element_local >= 0 && !elements(loop.element_array, last)) return false;
+    if (loop.reduction) {
+        k.combine = loop.combine;
+    } else if (!elements(loop.target, k.dst)) {
+        return false;
+    }
+    selected_isa().kernel(k);
+    if (loop.reduction) {
+        uint64_t s = read_local(locals, loop.target, width);
+        uint64_t t = k.total;
+        switch (loop.combine) {
+        case VecOp::Add: s += t; break;
+        case VecOp::Sub: s -= t; break;
+        case VecOp::And: s &= t; break;
+        case VecOp::Or: s |= t; break;
+        default: s ^= t; break;
+        }
+        write_local(locals, loop.target, width, s);
+    }
+    if (last) {
+        // 增强for的元素变量保存最后一次迭代的元素
+        write_local(locals, loop.element_local, width, read_local(last + (size_t)(to - 1) * width, 0, width));
+    }
+    locals[loop.index] = (SlotT)to;
+    return true;
+}
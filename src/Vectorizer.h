@@ -0,0 +1,59 @@
+#ifndef VECTORIZER_H
+#define VECTORIZER_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 简单数组循环的自动向量化：在计数循环（BoundsCheck.h）中识别循环体只有一条语句的
+//   映射  d[i] = x [op y]          int[] long[] float[] double[]
+//   归约  s = s <op> (x [op y])    int long，s为局部变量，<op>为+ - & | ^
+// 其中x、y是同一下标的数组元素b[i]、循环中不变的局部变量或常量，op为+ - * / & | ^（按类型可用）。
+// 增强for先把元素存入局部变量再使用的形式也能识别。
+// 这些循环在循环头标为SUPER_VECTOR_LOOP，执行到循环头时检查各数组非null且长度不小于上界，
+// 然后由SIMD核一次算完剩余的迭代，把i设为上界，再执行原来的循环头比较退出循环。检查不通过时照常逐条解释执行。
+// SIMD核按运行时检测的CPU特性选择AVX2、SSE4.1或标量实现，long/double先交换槽位中的高低两半再运算。
+// float/double的归约按Java语义必须依次相加，改变求和顺序会改变结果，因此不向量化。
+// JVM_VECTORIZE=0关闭；JVM_VECTOR_ISA=sse4/scalar限制使用的指令集
+struct ClassInfo;
+struct MethodInfo;
+struct Frame;
+class Interpreter;
+
+enum class VecType : uint8_t { Int, Long, Float, Double };
+enum class VecOp : uint8_t { None, Add, Sub, Mul, Div, And, Or, Xor };
+
+// 操作数：b[i]、局部变量或常量
+struct VecOperand {
+    enum Kind : uint8_t { NONE, ELEMENT, LOCAL, CONST } kind = NONE;
+    int local = -1;    // ELEMENT：数组所在的局部变量；LOCAL：局部变量
+    uint64_t bits = 0; // CONST：位模式，int/float在低32位
+};
+
+struct VectorLoop {
+    uint32_t header = 0;
+    uint8_t replaced = 0;     // 循环头原来的超级指令
+    int index = -1;           // i
+    int bound_array = -1;     // 循环头比较a.length时的a
+    int bound_length = -1;    // 循环头比较局部变量n时的n
+    VecType type = VecType::Int;
+    bool reduction = false;
+    int target = -1;          // 映射：目标数组d所在的局部变量；归约：s
+    VecOp combine = VecOp::None; // 归约：s = s <combine> e
+    int element_local = -1;   // 增强for中保存当前元素的局部变量，循环结束后为最后一个元素
+    int element_array = -1;   // element_local来自的数组
+    VecOp op = VecOp::None;   // e = lhs op rhs，None时e = lhs
+    VecOperand lhs, rhs;
+};
+
+bool vectorization_enabled();
+
+// 当前使用的SIMD指令集："avx2"、"sse4.1"或"scalar"
+const char* vector_isa();
+
+// 找出方法中可以向量化的循环，在table（超级指令表，空时按需创建）的循环头处标SUPER_VECTOR_LOOP
+std::vector<VectorLoop> find_vector_loops(const ClassInfo& cf, const MethodInfo& method, std::vector<uint8_t>& table);
+
+// 在循环头执行剩余的迭代，返回false表示条件不满足（数组为null、长度不足等），需要逐条解释执行
+bool run_vector_loop(const VectorLoop& loop, Frame& frame, Interpreter& interp);
+
+#endif // VECTORIZER_H
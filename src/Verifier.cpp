@@ -0,0 +1,1014 @@
+#include "Verifier.h"
+#include "classFileParser.h"
+#include "ClassLoader.h"
+#include "TypeCheck.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Verifier {
+
+namespace {
+
+// 验证用的类型。long/double在局部变量和操作数栈上都占两个槽位，第二个槽位为LONG2/DOUBLE2；
+// boolean/byte/char/short都按INT处理。引用类型有null（NULLREF）、某个类或数组类型的对象（REF，klass为该类型），
+// 以及还没有调用<init>的对象：new创建的（UNINIT，bci为new指令的位置）和<init>中的this（UNINIT_THIS）。
+// klass为空的REF表示任意已初始化的引用，用于只要求引用的指令（aload/astore、ifnull、monitorenter等）
+struct VType {
+    enum Tag : uint8_t { TOP, INT, FLOAT, LONG, LONG2, DOUBLE, DOUBLE2, NULLREF, REF, UNINIT, UNINIT_THIS };
+    Tag tag = TOP;
+    const Klass* klass = nullptr;
+    uint32_t bci = 0;
+    constexpr VType(Tag tag = TOP) : tag(tag) {}
+    static VType ref(const Klass& klass) {
+        VType t(REF);
+        t.klass = &klass;
+        return t;
+    }
+    static VType uninit(uint32_t bci) {
+        VType t(UNINIT);
+        t.bci = bci;
+        return t;
+    }
+    bool operator==(const VType& o) const { return tag == o.tag && klass == o.klass && bci == o.bci; }
+    bool operator!=(const VType& o) const { return !(*this == o); }
+};
+
+bool is_reference(VType t) { return t.tag >= VType::NULLREF; }
+bool is_uninitialized(VType t) { return t.tag == VType::UNINIT || t.tag == VType::UNINIT_THIS; }
+bool is_array(VType t) { return t.tag == VType::REF && t.klass && t.klass->is_array(); }
+
+struct VerifyError {
+    std::string message;
+};
+
+struct State {
+    std::vector<VType> locals;
+    std::vector<VType> stack;
+};
+
+bool is_second_half(VType t) { return t == VType::LONG2 || t == VType::DOUBLE2; }
+bool is_wide(VType t) { return t == VType::LONG || t == VType::DOUBLE; }
+VType second_half(VType t) { return t == VType::LONG ? VType::LONG2 : VType::DOUBLE2; }
+
+VType letter_type(char c) {
+    switch (c) {
+    case 'I': return VType::INT;
+    case 'J': return VType::LONG;
+    case 'F': return VType::FLOAT;
+    case 'D': return VType::DOUBLE;
+    default: return VType::REF;
+    }
+}
+
+// 操作数栈效果固定的指令："弹出>压入"，I/J/F/D/A分别表示int/long/float/double/引用，弹出的类型按从栈底到栈顶的顺序
+struct Signatures {
+    const char* sig[256] = {};
+    Signatures() {
+        sig[0x00] = ">";
+        sig[0x01] = ">A";
+        for (int op = 0x02; op <= 0x08; ++op) sig[op] = ">I";
+        sig[0x09] = sig[0x0a] = ">J";
+        sig[0x0b] = sig[0x0c] = sig[0x0d] = ">F";
+        sig[0x0e] = sig[0x0f] = ">D";
+        sig[0x10] = sig[0x11] = ">I";
+        sig[0x2e] = "AI>I"; sig[0x2f] = "AI>J"; sig[0x30] = "AI>F"; sig[0x31] = "AI>D";
+        sig[0x32] = "AI>A"; sig[0x33] = sig[0x34] = sig[0x35] = "AI>I";
+        sig[0x4f] = "AII>"; sig[0x50] = "AIJ>"; sig[0x51] = "AIF>"; sig[0x52] = "AID>";
+        sig[0x53] = "AIA>"; sig[0x54] = sig[0x55] = sig[0x56] = "AII>";
+        // iadd ~ drem按int/long/float/double循环
+        static const char* const binary[4] = {"II>I", "JJ>J", "FF>F", "DD>D"};
+        static const char* const unary[4] = {"I>I", "J>J", "F>F", "D>D"};
+        for (int op = 0x60; op <= 0x73; ++op) sig[op] = binary[(op - 0x60) % 4];
+        for (int op = 0x74; op <= 0x77; ++op) sig[op] = unary[op - 0x74];
+        for (int op = 0x78; op <= 0x7d; ++op) sig[op] = (op % 2 == 0) ? "II>I" : "JI>J"; // 移位
+        for (int op = 0x7e; op <= 0x83; ++op) sig[op] = (op % 2 == 0) ? "II>I" : "JJ>J"; // 位运算
+        sig[0x85] = "I>J"; sig[0x86] = "I>F"; sig[0x87] = "I>D";
+        sig[0x88] = "J>I"; sig[0x89] = "J>F"; sig[0x8a] = "J>D";
+        sig[0x8b] = "F>I"; sig[0x8c] = "F>J"; sig[0x8d] = "F>D";
+        sig[0x8e] = "D>I"; sig[0x8f] = "D>J"; sig[0x90] = "D>F";
+        sig[0x91] = sig[0x92] = sig[0x93] = "I>I";
+        sig[0x94] = "JJ>I"; sig[0x95] = sig[0x96] = "FF>I"; sig[0x97] = sig[0x98] = "DD>I";
+        for (int op = 0x99; op <= 0x9e; ++op) sig[op] = "I>";
+        for (int op = 0x9f; op <= 0xa4; ++op) sig[op] = "II>";
+        sig[0xa5] = sig[0xa6] = "AA>";
+        sig[0xa7] = sig[0xc8] = ">";
+        sig[0xaa] = sig[0xab] = "I>";
+        sig[0xac] = "I>"; sig[0xad] = "J>"; sig[0xae] = "F>"; sig[0xaf] = "D>"; sig[0xb0] = "A>"; sig[0xb1] = ">";
+        sig[0xbb] = ">A"; sig[0xbc] = sig[0xbd] = "I>A"; sig[0xbe] = "A>I"; sig[0xbf] = "A>";
+        sig[0xc0] = "A>A"; sig[0xc1] = "A>I"; sig[0xc2] = sig[0xc3] = "A>";
+        sig[0xc6] = sig[0xc7] = "A>";
+    }
+};
+
+const Signatures signatures;
+
+// xaload/xastore（去掉aaload/aastore后按操作码顺序）对应的基本类型数组，baload/bastore也接受[Z
+const char* const primitive_arrays[8] = {"[I", "[J", "[F", "[D", nullptr, "[B", "[C", "[S"};
+
+// 方法描述符：参数类型和返回类型，void返回时returns_void为true
+struct MethodType {
+    std::vector<VType> args;
+    VType ret;
+    bool returns_void = false;
+};
+
+class MethodVerifier {
+public:
+    MethodVerifier(ClassLoader& loader, const ClassInfo& cf, const MethodInfo& method, std::vector<uint8_t> stack_map)
+        : loader(loader), object(loader.klass("java/lang/Object")), cf(cf), cp(cf.constant_pool), method(method), code(method.code),
+          stack_map(std::move(stack_map)), this_type(VType::ref(*cf.klass)) {}
+
+    void verify() {
+        if (code.empty() || code.size() > 65535) fail(0, "invalid code length");
+        if (!parse_method_type(method.descriptor, own_type)) fail(0, "malformed method descriptor");
+        if (method.name == "<init>" && !own_type.returns_void) fail(0, "<init> must return void");
+        check_structure();
+        decode_stack_map();
+        if (has_subroutines) return;
+        run_dataflow();
+    }
+
+private:
+    ClassLoader& loader;
+    const Klass& object;
+    const ClassInfo& cf;
+    const ConstantPool& cp;
+    const MethodInfo& method;
+    const std::vector<uint8_t>& code;
+    std::vector<uint8_t> stack_map;
+    VType this_type;
+    MethodType own_type;
+    std::vector<bool> starts;
+    bool has_subroutines = false;
+    std::unordered_map<uint32_t, State> frames;
+    std::vector<State> in;
+    std::vector<bool> reached;
+    std::vector<bool> queued;
+    std::vector<uint32_t> worklist;
+
+    [[noreturn]] void fail(size_t bci, const std::string& what) const {
+        throw VerifyError{fmt::format("bci {}: {}", bci, what)};
+    }
+
+    uint8_t u1(size_t p) const { return code[p]; }
+    uint16_t u2(size_t p) const { return (uint16_t)((code[p] << 8) | code[p + 1]); }
+    int16_t s2(size_t p) const { return (int16_t)u2(p); }
+    int32_t s4(size_t p) const { return (int32_t)(((uint32_t)u2(p) << 16) | u2(p + 2)); }
+
+    // 不越界地计算指令长度，非法操作码或截断的指令报错
+    size_t safe_length(size_t pc) const {
+        uint8_t op = code[pc];
+        if (op > 0xc9 || (signatures.sig[op] == nullptr && !is_special(op))) {
+            fail(pc, fmt::format("illegal opcode 0x{:x}", op));
+        }
+        if (op == 0xaa || op == 0xab) {
+            size_t p = (pc + 4) & ~size_t(3);
+            if (p + (op == 0xaa ? 12 : 8) > code.size()) fail(pc, "truncated switch");
+            if (op == 0xaa && s4(p + 4) > s4(p + 8)) fail(pc, "tableswitch low > high");
+            if (op == 0xab && s4(p + 4) < 0) fail(pc, "negative lookupswitch npairs");
+        }
+        if (op == 0xc4) {
+            if (pc + 1 >= code.size()) fail(pc, "truncated wide");
+            uint8_t inner = code[pc + 1];
+            bool ok = (inner >= 0x15 && inner <= 0x19) || (inner >= 0x36 && inner <= 0x3a) || inner == 0x84 || inner == 0xa9;
+            if (!ok) fail(pc, fmt::format("illegal wide opcode 0x{:x}", inner));
+        }
+        size_t len = instruction_length(code, pc);
+        if (pc + len > code.size()) fail(pc, "instruction runs past the end of code");
+        return len;
+    }
+
+    static bool is_special(uint8_t op) {
+        return (op >= 0x12 && op <= 0x2d) || (op >= 0x36 && op <= 0x4e) || (op >= 0x57 && op <= 0x5f) ||
+               op == 0x84 || op == 0xa8 || op == 0xa9 || (op >= 0xb2 && op <= 0xba) || op == 0xc4 || op == 0xc5 || op == 0xc9;
+    }
+
+    void check_target(size_t pc, int64_t target) const {
+        if (target < 0 || (size_t)target >= code.size() || !starts[(size_t)target]) {
+            fail(pc, fmt::format("branch target {} is not an instruction", target));
+        }
+    }
+
+    // 跳转目标（不含顺序执行的下一条指令）
+    std::vector<uint32_t> branch_targets(size_t pc) const {
+        uint8_t op = code[pc];
+        if ((op >= 0x99 && op <= 0xa8) || op == 0xc6 || op == 0xc7) return {(uint32_t)(pc + s2(pc + 1))};
+        if (op == 0xc8 || op == 0xc9) return {(uint32_t)(pc + s4(pc + 1))};
+        if (op == 0xaa || op == 0xab) return switch_targets(pc);
+        return {};
+    }
+
+    // default在前，之后是各个case的目标
+    std::vector<uint32_t> switch_targets(size_t pc) const {
+        size_t p = (pc + 4) & ~size_t(3);
+        std::vector<uint32_t> targets{(uint32_t)(pc + s4(p))};
+        if (code[pc] == 0xaa) {
+            int64_t n = (int64_t)s4(p + 8) - s4(p + 4) + 1;
+            for (int64_t i = 0; i < n; ++i) targets.push_back((uint32_t)(pc + s4(p + 12 + 4 * i)));
+        } else {
+            int32_t npairs = s4(p + 4);
+            for (int32_t i = 0; i < npairs; ++i) {
+                if (i > 0 && s4(p + 8 + 8 * i) <= s4(p + 8 * i)) fail(pc, "lookupswitch keys not sorted");
+                targets.push_back((uint32_t)(pc + s4(p + 12 + 8 * i)));
+            }
+        }
+        return targets;
+    }
+
+    // 指令边界、跳转目标和异常表
+    void check_structure() {
+        starts.assign(code.size(), false);
+        for (size_t pc = 0; pc < code.size(); pc += safe_length(pc)) {
+            starts[pc] = true;
+            if (code[pc] == 0xa8 || code[pc] == 0xa9 || code[pc] == 0xc9 || (code[pc] == 0xc4 && code[pc + 1] == 0xa9)) {
+                has_subroutines = true;
+            }
+        }
+        if (has_subroutines && cf.majorVer >= 51) fail(0, "jsr/ret in a class file of version 51 or later");
+        for (size_t pc = 0; pc < code.size(); pc += instruction_length(code, pc)) {
+            for (uint32_t target : branch_targets(pc)) check_target(pc, (int32_t)target);
+        }
+        for (const auto& entry : method.exception_table) {
+            if (entry.start_pc >= entry.end_pc || entry.end_pc > code.size() || !starts[entry.start_pc] ||
+                (entry.end_pc < code.size() && !starts[entry.end_pc])) {
+                fail(entry.start_pc, "invalid exception table range");
+            }
+            check_target(entry.start_pc, entry.handler_pc);
+            if (entry.catch_type != 0) cp_entry(entry.handler_pc, entry.catch_type, ConstantType::CLASS);
+        }
+        if (!method.exception_table.empty() && method.max_stack < 1) fail(0, "max_stack too small for an exception handler");
+    }
+
+    // 解析描述符中从p开始的一个字段类型，p移到下一个类型；格式错误返回false
+    bool parse_field_type(const std::string& desc, size_t& p, VType& type) const {
+        size_t start = p;
+        while (p < desc.size() && desc[p] == '[') ++p;
+        if (p >= desc.size()) return false;
+        char c = desc[p++];
+        if (c == 'L') {
+            size_t semi = desc.find(';', p);
+            if (semi == std::string::npos || semi == p) return false;
+            type = VType::ref(loader.klass(start == p - 1 ? desc.substr(p, semi - p) : desc.substr(start, semi + 1 - start)));
+            p = semi + 1;
+            return true;
+        }
+        if (std::string("ICSJFDBZ").find(c) == std::string::npos) return false;
+        if (start == p - 1) {
+            type = letter_type(c == 'B' || c == 'C' || c == 'S' || c == 'Z' ? 'I' : c);
+        } else {
+            type = VType::ref(loader.klass(desc.substr(start, p - start)));
+        }
+        return true;
+    }
+
+    bool parse_method_type(const std::string& desc, MethodType& mt) const {
+        if (desc.empty() || desc[0] != '(') return false;
+        size_t p = 1;
+        while (p < desc.size() && desc[p] != ')') {
+            VType t;
+            if (!parse_field_type(desc, p, t)) return false;
+            mt.args.push_back(t);
+        }
+        if (p >= desc.size()) return false;
+        ++p;
+        if (p + 1 == desc.size() && desc[p] == 'V') {
+            mt.returns_void = true;
+            return true;
+        }
+        return parse_field_type(desc, p, mt.ret) && p == desc.size();
+    }
+
+    // 常量池中的类名（数组为描述符）对应的类型
+    VType class_name_type(size_t pc, const std::string& name) const {
+        if (name.empty() || name[0] != '[') return VType::ref(loader.klass(name));
+        size_t p = 0;
+        VType t;
+        if (!parse_field_type(name, p, t) || p != name.size() || !is_array(t)) fail(pc, "malformed array class name " + name);
+        return t;
+    }
+
+    // 类型s的值能否用在需要类型t的地方（JVMS §4.10.1.2）：数组按元素类型协变，接口与Object一样接受任何对象，
+    // 其余的类沿父类链判断，需要时加载（不初始化）这些类
+    bool is_assignable(const Klass& s, const Klass& t) const {
+        if (&s == &t || &t == &object) return true;
+        if (t.is_array()) {
+            return s.is_array() && s.element && t.element && is_assignable(*s.element, *t.element);
+        }
+        loader.link_supers(t);
+        if (t.is_interface) return true;
+        if (s.is_array()) return false;
+        loader.link_supers(s);
+        return is_subtype_of(s, t);
+    }
+
+    // 两个类型的最小公共父类型：沿a的父类链找到第一个b的父类；接口按Object处理，元素为引用的数组按元素合并
+    const Klass& common_super(const Klass& a, const Klass& b) const {
+        if (&a == &b) return a;
+        if (a.is_array() || b.is_array()) {
+            if (a.is_array() && b.is_array() && a.element && b.element) return loader.array_klass(common_super(*a.element, *b.element));
+            return object;
+        }
+        loader.link_supers(a);
+        loader.link_supers(b);
+        if (a.is_interface || b.is_interface) return object;
+        for (const Klass* k = &a; k; k = k->super) {
+            if (is_subtype_of(b, *k)) return *k;
+        }
+        return object;
+    }
+
+    // 两个引用类型合并后的类型：null与任何已初始化的引用合并为后者，未初始化的对象只与自身相同，不能合并时返回TOP
+    VType join_reference(VType a, VType b) const {
+        if (a == b) return a;
+        if (is_uninitialized(a) || is_uninitialized(b)) return VType::TOP;
+        if (b == VType::NULLREF) return a;
+        if (a == VType::NULLREF) return b;
+        if (!a.klass || !b.klass) return VType::REF;
+        return VType::ref(common_super(*a.klass, *b.klass));
+    }
+
+    bool assignable(VType from, VType to) const {
+        if (from == to) return true;
+        if (to.tag != VType::REF || (from.tag != VType::REF && from.tag != VType::NULLREF)) return false;
+        if (!to.klass || from.tag == VType::NULLREF) return true;
+        return from.klass && is_assignable(*from.klass, *to.klass);
+    }
+
+    const ConstantPoolInfo& cp_entry(size_t pc, uint16_t index, uint8_t tag, uint8_t alt_tag = 0) const {
+        if (index == 0 || index >= cp.size() || (cp[index].tag != tag && (alt_tag == 0 || cp[index].tag != alt_tag))) {
+            fail(pc, fmt::format("bad constant pool index {}", index));
+        }
+        return cp[index];
+    }
+
+    const std::string& cp_utf8(size_t pc, uint16_t index) const {
+        return cp_entry(pc, index, ConstantType::UTF8).utf8_str;
+    }
+
+    // 字段引用或方法引用的描述符
+    const std::string& member_descriptor(size_t pc, uint16_t name_type_index) const {
+        return cp_utf8(pc, cp_entry(pc, name_type_index, ConstantType::NAME_AND_TYPE).descriptor_index);
+    }
+
+    const std::string& member_name(size_t pc, uint16_t name_type_index) const {
+        return cp_utf8(pc, cp_entry(pc, name_type_index, ConstantType::NAME_AND_TYPE).name_index);
+    }
+
+    // 方法入口的状态：this和参数，其余局部变量为TOP。<init>中的this在调用父类或本类的<init>之前是UNINIT_THIS
+    State entry_state() const {
+        State s;
+        s.locals.assign(method.max_locals, VType::TOP);
+        size_t i = 0;
+        auto put = [&](VType t) {
+            if (i + (is_wide(t) ? 2 : 1) > s.locals.size()) fail(0, "arguments exceed max_locals");
+            s.locals[i++] = t;
+            if (is_wide(t)) s.locals[i++] = second_half(t);
+        };
+        if ((method.access_flags & ACC_STATIC) == 0) {
+            put(method.name == "<init>" && cf.klass->name != "java/lang/Object" ? VType(VType::UNINIT_THIS) : this_type);
+        }
+        for (VType t : own_type.args) put(t);
+        return s;
+    }
+
+    // 解码StackMapTable（JVMS §4.7.4），帧中的局部变量先按验证类型（long/double占一项）记录，再展开成槽位
+    void decode_stack_map() {
+        if (stack_map.empty()) return;
+        size_t p = 0;
+        auto need = [&](size_t n) {
+            if (p + n > stack_map.size()) fail(0, "truncated StackMapTable");
+        };
+        auto r1 = [&]() { need(1); return stack_map[p++]; };
+        auto r2 = [&]() {
+            need(2);
+            uint16_t v = (uint16_t)((stack_map[p] << 8) | stack_map[p + 1]);
+            p += 2;
+            return v;
+        };
+        auto read_type = [&]() -> VType {
+            uint8_t tag = r1();
+            switch (tag) {
+            case 0: return VType::TOP;
+            case 1: return VType::INT;
+            case 2: return VType::FLOAT;
+            case 3: return VType::DOUBLE;
+            case 4: return VType::LONG;
+            case 5: return VType::NULLREF;
+            case 6: return VType::UNINIT_THIS;
+            case 7: return class_type(0, r2());
+            case 8: {
+                uint16_t offset = r2();
+                if (offset >= code.size() || !starts[offset] || code[offset] != 0xbb) fail(0, fmt::format("uninitialized type at {} is not a new instruction", offset));
+                return VType::uninit(offset);
+            }
+            default: fail(0, fmt::format("invalid verification type tag {}", tag));
+            }
+        };
+        auto expand = [&](const std::vector<VType>& types, size_t limit, const char* what) {
+            std::vector<VType> slots;
+            for (VType t : types) {
+                slots.push_back(t);
+                if (is_wide(t)) slots.push_back(second_half(t));
+            }
+            if (slots.size() > limit) fail(0, fmt::format("stack map frame exceeds {}", what));
+            return slots;
+        };
+
+        std::vector<VType> locals;
+        {
+            State entry = entry_state();
+            for (size_t i = 0; i < entry.locals.size(); ++i) {
+                if (entry.locals[i] != VType::TOP && !is_second_half(entry.locals[i])) locals.push_back(entry.locals[i]);
+            }
+        }
+        uint16_t count = r2();
+        int64_t bci = -1;
+        for (uint16_t n = 0; n < count; ++n) {
+            uint8_t type = r1();
+            uint16_t delta;
+            std::vector<VType> stack;
+            if (type < 64) {
+                delta = type;
+            } else if (type < 128) {
+                delta = type - 64;
+                stack.push_back(read_type());
+            } else if (type == 247) {
+                delta = r2();
+                stack.push_back(read_type());
+            } else if (type >= 248 && type <= 250) {
+                delta = r2();
+                size_t k = 251 - type;
+                if (k > locals.size()) fail(0, "chop frame removes too many locals");
+                locals.resize(locals.size() - k);
+            } else if (type == 251) {
+                delta = r2();
+            } else if (type >= 252 && type <= 254) {
+                delta = r2();
+                for (int k = 0; k < type - 251; ++k) locals.push_back(read_type());
+            } else if (type == 255) {
+                delta = r2();
+                locals.clear();
+                uint16_t nlocals = r2();
+                for (uint16_t k = 0; k < nlocals; ++k) locals.push_back(read_type());
+                uint16_t nstack = r2();
+                for (uint16_t k = 0; k < nstack; ++k) stack.push_back(read_type());
+            } else {
+                fail(0, fmt::format("reserved stack map frame type {}", type));
+            }
+            bci = bci < 0 ? delta : bci + delta + 1;
+            if ((size_t)bci >= code.size() || !starts[(size_t)bci]) fail((size_t)bci, "stack map frame is not at an instruction");
+            State frame;
+            frame.locals = expand(locals, method.max_locals, "max_locals");
+            frame.locals.resize(method.max_locals, VType::TOP);
+            frame.stack = expand(stack, method.max_stack, "max_stack");
+            frames[(uint32_t)bci] = std::move(frame);
+        }
+        if (p != stack_map.size()) fail(0, "trailing bytes in StackMapTable");
+    }
+
+    // state能否赋给声明的帧：栈高度相同且每项可赋给帧中的类型，帧中非TOP的局部变量同样可赋
+    bool assignable(const State& from, const State& to) const {
+        if (from.stack.size() != to.stack.size()) return false;
+        for (size_t i = 0; i < to.stack.size(); ++i) {
+            if (!assignable(from.stack[i], to.stack[i])) return false;
+        }
+        for (size_t i = 0; i < to.locals.size(); ++i) {
+            if (to.locals[i] != VType::TOP && !assignable(from.locals[i], to.locals[i])) return false;
+        }
+        return true;
+    }
+
+    // 没有声明帧的位置合并两条路径的状态，返回是否有变化。引用类型合并为公共父类型，
+    // 其他类型不同（包括不同的未初始化对象）的局部变量变为TOP，栈上则是错误
+    bool merge(size_t bci, State& into, const State& from) const {
+        if (into.stack.size() != from.stack.size()) fail(bci, "inconsistent stack height");
+        bool changed = false;
+        for (size_t i = 0; i < into.stack.size(); ++i) {
+            if (into.stack[i] == from.stack[i]) continue;
+            VType joined = is_reference(into.stack[i]) && is_reference(from.stack[i])
+                ? join_reference(into.stack[i], from.stack[i]) : VType::TOP;
+            if (joined == VType::TOP) fail(bci, "inconsistent stack types");
+            if (joined != into.stack[i]) {
+                into.stack[i] = joined;
+                changed = true;
+            }
+        }
+        for (size_t i = 0; i < into.locals.size(); ++i) {
+            if (into.locals[i] == from.locals[i] || into.locals[i] == VType::TOP) continue;
+            VType joined = is_reference(into.locals[i]) && is_reference(from.locals[i])
+                ? join_reference(into.locals[i], from.locals[i]) : VType::TOP;
+            if (joined != into.locals[i]) {
+                into.locals[i] = joined;
+                changed = true;
+            }
+        }
+        // 只剩一半的long/double也变为TOP
+        for (size_t i = 0; i < into.locals.size(); ++i) {
+            VType t = into.locals[i];
+            bool broken = (is_wide(t) && (i + 1 >= into.locals.size() || into.locals[i + 1] != second_half(t))) ||
+                          (is_second_half(t) && (i == 0 || !is_wide(into.locals[i - 1])));
+            if (broken) {
+                into.locals[i] = VType::TOP;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    void propagate(size_t from_pc, uint32_t target, const State& state, bool jump) {
+        auto frame = frames.find(target);
+        if (frame != frames.end()) {
+            if (!assignable(state, frame->second)) fail(from_pc, fmt::format("state does not match stack map frame at {}", target));
+            if (!reached[target]) {
+                in[target] = frame->second;
+                reached[target] = true;
+                enqueue(target);
+            }
+            return;
+        }
+        // 版本51起跳转目标必须有StackMapTable帧（JVMS §4.10.1）
+        if (jump && cf.majorVer >= 51) fail(from_pc, fmt::format("no stack map frame at branch target {}", target));
+        if (!reached[target]) {
+            in[target] = state;
+            reached[target] = true;
+            enqueue(target);
+        } else if (merge(target, in[target], state)) {
+            enqueue(target);
+        }
+    }
+
+    void enqueue(uint32_t bci) {
+        if (queued[bci]) return;
+        queued[bci] = true;
+        worklist.push_back(bci);
+    }
+
+    void run_dataflow() {
+        in.assign(code.size(), State{});
+        reached.assign(code.size(), false);
+        queued.assign(code.size(), false);
+        propagate(0, 0, entry_state(), false);
+        while (!worklist.empty()) {
+            uint32_t pc = worklist.back();
+            worklist.pop_back();
+            queued[pc] = false;
+            step(pc);
+        }
+    }
+
+    void push(size_t pc, State& s, VType t) const {
+        s.stack.push_back(t);
+        if (is_wide(t)) s.stack.push_back(second_half(t));
+        if (s.stack.size() > method.max_stack) fail(pc, "operand stack overflow");
+    }
+
+    void pop(size_t pc, State& s, VType t) const {
+        if (is_wide(t)) {
+            if (s.stack.size() < 2 || s.stack.back() != second_half(t) || s.stack[s.stack.size() - 2] != t) {
+                fail(pc, "operand type mismatch");
+            }
+            s.stack.resize(s.stack.size() - 2);
+            return;
+        }
+        if (s.stack.empty()) fail(pc, "operand stack underflow");
+        if (!assignable(s.stack.back(), t)) fail(pc, "operand type mismatch");
+        s.stack.pop_back();
+    }
+
+    // 弹出一个引用并返回其类型
+    VType pop_reference(size_t pc, State& s) const {
+        if (s.stack.empty()) fail(pc, "operand stack underflow");
+        VType t = s.stack.back();
+        if (!is_reference(t)) fail(pc, "operand type mismatch");
+        s.stack.pop_back();
+        return t;
+    }
+
+    // 弹出数组操作的数组引用：必须是数组（或null），accepts判断数组类型是否符合指令；返回数组类型，null时为NULLREF
+    template <typename Accepts>
+    VType pop_array(size_t pc, State& s, Accepts accepts) const {
+        VType t = pop_reference(pc, s);
+        if (t != VType::NULLREF && (!is_array(t) || !accepts(*t.klass))) fail(pc, "array instruction on a value that is not a matching array");
+        return t;
+    }
+
+    // 常量池中index处的类引用对应的类型
+    VType class_type(size_t pc, uint16_t index) const {
+        return class_name_type(pc, cp_utf8(pc, cp_entry(pc, index, ConstantType::CLASS).class_name_index));
+    }
+
+    // t为REF时（aload）接受任何引用，压入局部变量中的实际类型
+    void load(size_t pc, State& s, size_t index, VType t) const {
+        size_t width = is_wide(t) ? 2 : 1;
+        if (index + width > s.locals.size()) fail(pc, fmt::format("local {} out of range", index));
+        if (t == VType::REF && is_reference(s.locals[index])) t = s.locals[index];
+        if (s.locals[index] != t || (width == 2 && s.locals[index + 1] != second_half(t))) {
+            fail(pc, fmt::format("local {} has the wrong type", index));
+        }
+        push(pc, s, t);
+    }
+
+    void store(size_t pc, State& s, size_t index, VType t) const {
+        size_t width = is_wide(t) ? 2 : 1;
+        if (index + width > s.locals.size()) fail(pc, fmt::format("local {} out of range", index));
+        if (t == VType::REF) {
+            t = pop_reference(pc, s);
+        } else {
+            pop(pc, s, t);
+        }
+        // 覆盖long/double的一半时，另一半失效
+        for (size_t i = index; i < index + width; ++i) {
+            if (is_wide(s.locals[i]) && i + 1 < s.locals.size()) s.locals[i + 1] = VType::TOP;
+            if (is_second_half(s.locals[i]) && i > 0) s.locals[i - 1] = VType::TOP;
+        }
+        s.locals[index] = t;
+        if (width == 2) s.locals[index + 1] = second_half(t);
+    }
+
+    // 栈顶n个槽位作为整体移动时不能拆开long/double
+    void check_group(size_t pc, const State& s, size_t n) const {
+        if (s.stack.size() < n) fail(pc, "operand stack underflow");
+        if (is_second_half(s.stack[s.stack.size() - n])) fail(pc, "instruction splits a long/double");
+    }
+
+    // dup系列：复制栈顶m个槽位，插到栈顶m+k个槽位之下
+    void dup(size_t pc, State& s, size_t m, size_t k) const {
+        check_group(pc, s, m);
+        check_group(pc, s, m + k);
+        size_t n = s.stack.size();
+        if (n + m > method.max_stack) fail(pc, "operand stack overflow");
+        VType top[2];
+        std::copy(s.stack.end() - m, s.stack.end(), top);
+        // 栈顶m+k个槽位整体上移m个位置，空出的位置放入复制的m个槽位
+        s.stack.resize(n + m);
+        std::copy_backward(s.stack.begin() + (n - m - k), s.stack.begin() + n, s.stack.end());
+        std::copy(top, top + m, s.stack.begin() + (n - m - k));
+    }
+
+    void apply_signature(size_t pc, State& s, const char* sig) const {
+        const char* arrow = sig;
+        while (*arrow != '>') ++arrow;
+        for (const char* c = arrow - 1; c >= sig; --c) pop(pc, s, letter_type(*c));
+        for (const char* c = arrow + 1; *c; ++c) push(pc, s, letter_type(*c));
+    }
+
+    // 方法调用，参数按描述符检查。invokevirtual/invokeinterface的接收者必须是方法引用的类型，
+    // invokespecial调用普通方法时必须是本类；调用<init>时接收者必须是未初始化的对象，
+    // 调用后它在局部变量和操作数栈上的所有副本都变为已初始化的类型
+    void invoke(size_t pc, State& s, uint8_t op, uint16_t class_index, uint16_t name_type_index) const {
+        const std::string& name = member_name(pc, name_type_index);
+        const std::string& desc = member_descriptor(pc, name_type_index);
+        MethodType mt;
+        if (!parse_method_type(desc, mt)) fail(pc, "malformed method descriptor " + desc);
+        bool is_init = name == "<init>";
+        if (!name.empty() && name[0] == '<' && !(is_init && op == 0xb7)) fail(pc, "invalid call of " + name);
+        if (is_init && !mt.returns_void) fail(pc, "<init> must return void");
+        for (auto it = mt.args.rbegin(); it != mt.args.rend(); ++it) pop(pc, s, *it);
+        if (is_init) {
+            VType receiver = pop_reference(pc, s);
+            VType owner = class_type(pc, class_index);
+            VType initialized;
+            if (receiver.tag == VType::UNINIT) {
+                initialized = class_type(pc, u2(receiver.bci + 1));
+                if (owner != initialized) fail(pc, "<init> of another class called on a new object");
+            } else if (receiver.tag == VType::UNINIT_THIS) {
+                if (owner != this_type && (cf.super_class == 0 || owner != class_type(pc, cf.super_class))) {
+                    fail(pc, "<init> of an unrelated class called on this");
+                }
+                initialized = this_type;
+            } else {
+                fail(pc, "<init> called on an initialized object");
+            }
+            for (VType& t : s.locals) {
+                if (t == receiver) t = initialized;
+            }
+            for (VType& t : s.stack) {
+                if (t == receiver) t = initialized;
+            }
+        } else if (op == 0xb7) {
+            pop(pc, s, this_type);
+        } else if (op != 0xb8) {
+            pop(pc, s, class_type(pc, class_index));
+        }
+        if (!mt.returns_void) push(pc, s, mt.ret);
+    }
+
+    VType field_type(size_t pc, const std::string& desc) const {
+        size_t p = 0;
+        VType t;
+        if (!parse_field_type(desc, p, t) || p != desc.size()) fail(pc, "malformed field descriptor " + desc);
+        return t;
+    }
+
+    // 执行一条指令的类型效果，并把结果传给后继
+    void step(size_t pc) {
+        const State before = in[pc];
+        State s = before;
+        uint8_t op = code[pc];
+        static const VType kinds[5] = {VType::INT, VType::LONG, VType::FLOAT, VType::DOUBLE, VType::REF};
+        bool falls_through = true;
+        switch (op) {
+        case 0x12: case 0x13: { // ldc ldc_w
+            uint16_t index = op == 0x12 ? u1(pc + 1) : u2(pc + 1);
+            if (index == 0 || index >= cp.size()) fail(pc, "bad constant pool index");
+            uint8_t tag = cp[index].tag;
+            if (tag == ConstantType::INTEGER) push(pc, s, VType::INT);
+            else if (tag == ConstantType::FLOAT) push(pc, s, VType::FLOAT);
+            else if (tag == ConstantType::STRING) push(pc, s, VType::ref(loader.klass("java/lang/String")));
+            else if (tag == ConstantType::CLASS) push(pc, s, VType::ref(loader.klass("java/lang/Class")));
+            else if (tag == ConstantType::METHOD_TYPE) push(pc, s, VType::ref(loader.klass("java/lang/invoke/MethodType")));
+            else if (tag == ConstantType::METHOD_HANDLE) push(pc, s, VType::ref(loader.klass("java/lang/invoke/MethodHandle")));
+            else fail(pc, "ldc of a non-loadable constant");
+            break;
+        }
+        case 0x14: { // ldc2_w
+            uint16_t index = u2(pc + 1);
+            if (index == 0 || index >= cp.size()) fail(pc, "bad constant pool index");
+            if (cp[index].tag == ConstantType::LONG) push(pc, s, VType::LONG);
+            else if (cp[index].tag == ConstantType::DOUBLE) push(pc, s, VType::DOUBLE);
+            else fail(pc, "ldc2_w of a non-wide constant");
+            break;
+        }
+        case 0x15: case 0x16: case 0x17: case 0x18: case 0x19:
+            load(pc, s, u1(pc + 1), kinds[op - 0x15]);
+            break;
+        case 0x36: case 0x37: case 0x38: case 0x39: case 0x3a:
+            store(pc, s, u1(pc + 1), kinds[op - 0x36]);
+            break;
+        case 0x57: check_group(pc, s, 1); s.stack.pop_back(); break; // pop
+        case 0x58: check_group(pc, s, 2); s.stack.resize(s.stack.size() - 2); break; // pop2
+        case 0x59: dup(pc, s, 1, 0); break;
+        case 0x5a: dup(pc, s, 1, 1); break;
+        case 0x5b: dup(pc, s, 1, 2); break;
+        case 0x5c: dup(pc, s, 2, 0); break;
+        case 0x5d: dup(pc, s, 2, 1); break;
+        case 0x5e: dup(pc, s, 2, 2); break;
+        case 0x5f: // swap
+            check_group(pc, s, 1);
+            check_group(pc, s, 2);
+            std::swap(s.stack[s.stack.size() - 1], s.stack[s.stack.size() - 2]);
+            break;
+        case 0x84: // iinc
+            load(pc, s, u1(pc + 1), VType::INT);
+            s.stack.pop_back();
+            break;
+        case 0xc4: { // wide
+            uint8_t inner = u1(pc + 1);
+            size_t index = u2(pc + 2);
+            if (inner == 0x84) {
+                load(pc, s, index, VType::INT);
+                s.stack.pop_back();
+            } else if (inner <= 0x19) {
+                load(pc, s, index, kinds[inner - 0x15]);
+            } else {
+                store(pc, s, index, kinds[inner - 0x36]);
+            }
+            break;
+        }
+        case 0xb2: case 0xb3: case 0xb4: case 0xb5: { // getstatic putstatic getfield putfield
+            const auto& ref = cp_entry(pc, u2(pc + 1), ConstantType::FIELD_REF);
+            VType t = field_type(pc, member_descriptor(pc, ref.fieldref_name_type_index));
+            if (op == 0xb3 || op == 0xb5) pop(pc, s, t);
+            if (op == 0xb4 || op == 0xb5) {
+                VType owner = class_type(pc, ref.fieldref_class_index);
+                // <init>在调用父类的<init>之前可以给本类的字段赋值（如内部类的this$0）
+                if (op == 0xb5 && owner == this_type && !s.stack.empty() && s.stack.back() == VType::UNINIT_THIS) {
+                    s.stack.pop_back();
+                } else {
+                    pop(pc, s, owner);
+                }
+            }
+            if (op == 0xb2 || op == 0xb4) push(pc, s, t);
+            break;
+        }
+        case 0xb6: case 0xb7: case 0xb8: { // invokevirtual invokespecial invokestatic
+            uint8_t alt = (op != 0xb6 && cf.majorVer >= 52) ? ConstantType::INTERFACE_METHOD_REF : 0;
+            const auto& ref = cp_entry(pc, u2(pc + 1), ConstantType::METHOD_REF, alt);
+            invoke(pc, s, op, ref.methodref_class_index, ref.methodref_name_type_index);
+            break;
+        }
+        case 0xb9: { // invokeinterface
+            const auto& ref = cp_entry(pc, u2(pc + 1), ConstantType::INTERFACE_METHOD_REF);
+            if (u1(pc + 3) == 0 || u1(pc + 4) != 0) fail(pc, "malformed invokeinterface");
+            invoke(pc, s, op, ref.methodref_class_index, ref.methodref_name_type_index);
+            break;
+        }
+        case 0xba: { // invokedynamic
+            const auto& ref = cp_entry(pc, u2(pc + 1), ConstantType::INVOKE_DYNAMIC);
+            if (u2(pc + 3) != 0) fail(pc, "malformed invokedynamic");
+            MethodType mt;
+            const std::string& desc = member_descriptor(pc, ref.name_and_type_index);
+            if (!parse_method_type(desc, mt)) fail(pc, "malformed method descriptor " + desc);
+            for (auto it = mt.args.rbegin(); it != mt.args.rend(); ++it) pop(pc, s, *it);
+            if (!mt.returns_void) push(pc, s, mt.ret);
+            break;
+        }
+        case 0xc5: { // multianewarray
+            VType t = class_type(pc, u2(pc + 1));
+            if (!is_array(t)) fail(pc, "multianewarray of a non-array type");
+            uint8_t dims = u1(pc + 3);
+            if (dims == 0) fail(pc, "multianewarray with zero dimensions");
+            const std::string& name = cp_utf8(pc, cp[u2(pc + 1)].class_name_index);
+            if (name.find_first_not_of('[') < dims) fail(pc, "multianewarray has more dimensions than its type");
+            for (uint8_t i = 0; i < dims; ++i) pop(pc, s, VType::INT);
+            push(pc, s, t);
+            break;
+        }
+        case 0xbb: { // new
+            if (is_array(class_type(pc, u2(pc + 1)))) fail(pc, "new of an array type");
+            // 这条new上一次创建、仍未初始化的对象不能再使用，否则两者调用<init>后无法区分
+            for (VType& t : s.locals) {
+                if (t == VType::uninit((uint32_t)pc)) t = VType::TOP;
+            }
+            for (VType t : s.stack) {
+                if (t == VType::uninit((uint32_t)pc)) fail(pc, "uninitialized object of the same new on the stack");
+            }
+            push(pc, s, VType::uninit((uint32_t)pc));
+            break;
+        }
+        case 0x01: // aconst_null
+            push(pc, s, VType::NULLREF);
+            break;
+        case 0x2e: case 0x2f: case 0x30: case 0x31: case 0x33: case 0x34: case 0x35: { // 基本类型数组的xaload
+            static const VType results[8] = {VType::INT, VType::LONG, VType::FLOAT, VType::DOUBLE, VType::TOP, VType::INT, VType::INT, VType::INT};
+            const char* name = primitive_arrays[op - 0x2e];
+            pop(pc, s, VType::INT);
+            pop_array(pc, s, [&](const Klass& a) { return a.name == name || (op == 0x33 && a.name == "[Z"); });
+            push(pc, s, results[op - 0x2e]);
+            break;
+        }
+        case 0x32: { // aaload
+            pop(pc, s, VType::INT);
+            VType a = pop_array(pc, s, [](const Klass& a) { return a.element != nullptr; });
+            push(pc, s, a == VType::NULLREF ? VType::NULLREF : VType::ref(*a.klass->element));
+            break;
+        }
+        case 0x4f: case 0x50: case 0x51: case 0x52: case 0x54: case 0x55: case 0x56: { // 基本类型数组的xastore
+            static const VType values[8] = {VType::INT, VType::LONG, VType::FLOAT, VType::DOUBLE, VType::TOP, VType::INT, VType::INT, VType::INT};
+            const char* name = primitive_arrays[op - 0x4f];
+            pop(pc, s, values[op - 0x4f]);
+            pop(pc, s, VType::INT);
+            pop_array(pc, s, [&](const Klass& a) { return a.name == name || (op == 0x54 && a.name == "[Z"); });
+            break;
+        }
+        case 0x53: // aastore，元素类型在执行时检查
+            pop(pc, s, VType::REF);
+            pop(pc, s, VType::INT);
+            pop_array(pc, s, [](const Klass& a) { return a.element != nullptr; });
+            break;
+        case 0xbe: // arraylength
+            pop_array(pc, s, [](const Klass&) { return true; });
+            push(pc, s, VType::INT);
+            break;
+        case 0xbc: { // newarray
+            static const char* const names[8] = {"[Z", "[C", "[F", "[D", "[B", "[S", "[I", "[J"};
+            uint8_t atype = u1(pc + 1);
+            if (atype < 4 || atype > 11) fail(pc, "invalid newarray type");
+            pop(pc, s, VType::INT);
+            push(pc, s, VType::ref(loader.klass(names[atype - 4])));
+            break;
+        }
+        case 0xbd: { // anewarray
+            VType element = class_type(pc, u2(pc + 1));
+            pop(pc, s, VType::INT);
+            push(pc, s, VType::ref(loader.array_klass(*element.klass)));
+            break;
+        }
+        case 0xc0: // checkcast
+            pop(pc, s, VType::REF);
+            push(pc, s, class_type(pc, u2(pc + 1)));
+            break;
+        case 0xb0: // areturn
+            if (own_type.returns_void || own_type.ret.tag != VType::REF) fail(pc, "return type does not match the method descriptor");
+            pop(pc, s, own_type.ret);
+            break;
+        default:
+            if (op >= 0x1a && op <= 0x2d) {
+                load(pc, s, (op - 0x1a) % 4, kinds[(op - 0x1a) / 4]);
+            } else if (op >= 0x3b && op <= 0x4e) {
+                store(pc, s, (op - 0x3b) % 4, kinds[(op - 0x3b) / 4]);
+            } else {
+                if (op == 0xc1) cp_entry(pc, u2(pc + 1), ConstantType::CLASS);
+                apply_signature(pc, s, signatures.sig[op]);
+            }
+            break;
+        }
+
+        if (op >= 0xac && op <= 0xb1 && op != 0xb0) { // xreturn，areturn已按描述符检查
+            static const VType returns[5] = {VType::INT, VType::LONG, VType::FLOAT, VType::DOUBLE, VType::REF};
+            bool ok = op == 0xb1 ? own_type.returns_void : (!own_type.returns_void && own_type.ret == returns[op - 0xac]);
+            if (!ok) fail(pc, "return type does not match the method descriptor");
+        }
+        if ((op >= 0xa7 && op <= 0xb1) || op == 0xbf || op == 0xc8) falls_through = false;
+
+        // 异常处理器：指令执行前后的局部变量都可能在处理器中看到
+        if (const HandlerRange* range = method.handlers_at(pc)) {
+            for (uint16_t i = 0; i < range->count; ++i) {
+                const auto& entry = method.exception_table[method.handlers[range->first + i]];
+                VType caught = entry.catch_type != 0 ? class_type(pc, entry.catch_type) : VType::ref(loader.klass("java/lang/Throwable"));
+                propagate(pc, entry.handler_pc, State{before.locals, {caught}}, true);
+                propagate(pc, entry.handler_pc, State{s.locals, {caught}}, true);
+            }
+        }
+        for (uint32_t target : branch_targets(pc)) propagate(pc, target, s, true);
+        if (falls_through) {
+            size_t next = pc + instruction_length(code, pc);
+            if (next >= code.size()) fail(pc, "execution falls off the end of code");
+            propagate(pc, (uint32_t)next, s, false);
+        }
+    }
+};
+
+// 验证缓存：第一行为格式版本，之后每行一个已验证class文件内容的SHA-256
+constexpr const char* CACHE_HEADER = "myJVMinCpp verifier cache v2";
+
+struct Cache {
+    std::mutex mutex;
+    bool loaded = false;
+    bool valid_header = false;
+    std::unordered_set<std::string> hashes;
+};
+
+Cache cache;
+
+const char* cache_path() {
+    const char* path = std::getenv("JVM_VERIFY_CACHE");
+    return path && *path ? path : nullptr;
+}
+
+void load_cache(const char* path) {
+    if (cache.loaded) return;
+    cache.loaded = true;
+    std::ifstream in(path);
+    std::string line;
+    if (!in.is_open() || !std::getline(in, line) || line != CACHE_HEADER) return;
+    cache.valid_header = true;
+    while (std::getline(in, line)) {
+        if (!line.empty()) cache.hashes.insert(line);
+    }
+}
+
+bool cached(const std::string& hash) {
+    const char* path = cache_path();
+    if (!path) return false;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    load_cache(path);
+    return cache.hashes.count(hash) != 0;
+}
+
+void remember(const std::string& hash) {
+    const char* path = cache_path();
+    if (!path) return;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    load_cache(path);
+    if (!cache.hashes.insert(hash).second) return;
+    // 文件不存在或格式版本不符时重写
+    std::ofstream out(path, cache.valid_header ? std::ios::app : std::ios::trunc);
+    if (!out.is_open()) return;
+    if (!cache.valid_header) {
+        out << CACHE_HEADER << "\n";
+        cache.valid_header = true;
+    }
+    out << hash << "\n";
+}
+
+} // namespace
+
+bool enabled() {
+    static const bool on = [] {
+        const char* env = std::getenv("JVM_VERIFY");
+        return !(env && std::string(env) == "0");
+    }();
+    return on;
+}
+
+bool needs_verification(const ClassInfo& cf) {
+    return enabled() && !cached(cf.content_hash);
+}
+
+void verify_method(ClassLoader& loader, const ClassInfo& cf, MethodInfo& method) {
+    std::string message;
+    try {
+        ClassFileParser::parse_code(method);
+        MethodVerifier(loader, cf, method, ClassFileParser::find_stack_map(method, cf.constant_pool)).verify();
+    } catch (const VerifyError& e) {
+        message = e.message;
+    } catch (const std::runtime_error& e) {
+        // 截断或格式错误的Code属性
+        message = e.what();
+    }
+    if (!message.empty()) {
+        fmt::print("java.lang.VerifyError: {}.{}{} {}\n", cf.constant_pool.get_class_name(cf.this_class), method.name, method.descriptor, message);
+        throw JavaRuntimeError("java/lang/VerifyError");
+    }
+}
+
+void class_verified(const ClassInfo& cf) {
+    remember(cf.content_hash);
+}
+
+} // namespace Verifier
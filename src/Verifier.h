@@ -0,0 +1,34 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+#include "classFileParser_types.h"
+
+class ClassLoader;
+
+// 字节码验证（JVMS §4.10）：每个方法在第一次链接（ClassLoader::link_method）时解码Code属性并做一次类型检查，
+// 检查通过的方法在执行时不会出现操作数栈溢出/下溢、类型不符的局部变量或操作数、跳到指令中间等情况。
+// 有StackMapTable的方法按其中声明的帧检查（跳转目标处的状态直接取自帧，每条指令只检查一遍），
+// 没有StackMapTable的旧版本class文件按数据流推导各指令处的类型。
+// 引用类型按具体的类检查：getfield/putfield的接收者必须是字段所属的类，invokevirtual/invokeinterface的接收者必须是方法所属的类，
+// 参数、字段值和返回值按描述符检查，分支合并时取沿父类链的公共父类，需要时加载（不初始化）相关的类，接口与Object一样接受任何对象。
+// new创建的对象和<init>中的this在调用<init>之前不能当作已初始化的对象使用。含jsr/ret的方法（只出现在版本51以前）只做结构检查。
+//
+// 类中所有方法都验证通过后，class文件按内容的SHA-256记入验证缓存文件（JVM_VERIFY_CACHE指定路径），
+// 之后的运行中内容未变的类的方法链接时不再验证。JVM_VERIFY=0关闭验证。
+namespace Verifier {
+
+bool enabled();
+
+// 类定义时调用：验证关闭或命中验证缓存时返回false，该类的方法链接时不需要验证
+bool needs_verification(const ClassInfo& cf);
+
+// 用ClassFileParser::parse_code解码方法的Code属性并验证，解码结果留在method中供链接使用；
+// 判断子类关系时通过loader加载（不初始化）用到的类。
+// 失败时打印原因并抛出java/lang/VerifyError（JavaRuntimeError）
+void verify_method(ClassLoader& loader, const ClassInfo& cf, MethodInfo& method);
+
+// 类中所有有Code属性的方法都已验证通过，记入验证缓存
+void class_verified(const ClassInfo& cf);
+
+} // namespace Verifier
+
+#endif // VERIFIER_H
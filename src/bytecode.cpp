@@ -0,0 +1,144 @@
+#include "bytecode.h"
+#include <algorithm>
+
+static const char* const OPCODE_NAMES[256] = {
+    "nop", "aconst_null", "iconst_m1", "iconst_0", "iconst_1", "iconst_2", "iconst_3", "iconst_4",
+    "iconst_5", "lconst_0", "lconst_1", "fconst_0", "fconst_1", "fconst_2", "dconst_0", "dconst_1",
+    "bipush", "sipush", "ldc", "ldc_w", "ldc2_w", "iload", "lload", "fload",
+    "dload", "aload", "iload_0", "iload_1", "iload_2", "iload_3", "lload_0", "lload_1",
+    "lload_2", "lload_3", "fload_0", "fload_1", "fload_2", "fload_3", "dload_0", "dload_1",
+    "dload_2", "dload_3", "aload_0", "aload_1", "aload_2", "aload_3", "iaload", "laload",
+    "faload", "daload", "aaload", "baload", "caload", "saload", "istore", "lstore",
+    "fstore", "dstore", "astore", "istore_0", "istore_1", "istore_2", "istore_3", "lstore_0",
+    "lstore_1", "lstore_2", "lstore_3", "fstore_0", "fstore_1", "fstore_2", "fstore_3", "dstore_0",
+    "dstore_1", "dstore_2", "dstore_3", "astore_0", "astore_1", "astore_2", "astore_3", "iastore",
+    "lastore", "fastore", "dastore", "aastore", "bastore", "castore", "sastore", "pop",
+    "pop2", "dup", "dup_x1", "dup_x2", "dup2", "dup2_x1", "dup2_x2", "swap",
+    "iadd", "ladd", "fadd", "dadd", "isub", "lsub", "fsub", "dsub",
+    "imul", "lmul", "fmul", "dmul", "idiv", "ldiv", "fdiv", "ddiv",
+    "irem", "lrem", "frem", "drem", "ineg", "lneg", "fneg", "dneg",
+    "ishl", "lshl", "ishr", "lshr", "iushr", "lushr", "iand", "land",
+    "ior", "lor", "ixor", "lxor", "iinc", "i2l", "i2f", "i2d",
+    "l2i", "l2f", "l2d", "f2i", "f2l", "f2d", "d2i", "d2l",
+    "d2f", "i2b", "i2c", "i2s", "lcmp", "fcmpl", "fcmpg", "dcmpl",
+    "dcmpg", "ifeq", "ifne", "iflt", "ifge", "ifgt", "ifle", "if_icmpeq",
+    "if_icmpne", "if_icmplt", "if_icmpge", "if_icmpgt", "if_icmple", "if_acmpeq", "if_acmpne", "goto",
+    "jsr", "ret", "tableswitch", "lookupswitch", "ireturn", "lreturn", "freturn", "dreturn",
+    "areturn", "return", "getstatic", "putstatic", "getfield", "putfield", "invokevirtual", "invokespecial",
+    "invokestatic", "invokeinterface", "invokedynamic", "new", "newarray", "anewarray", "arraylength", "athrow",
+    "checkcast", "instanceof", "monitorenter", "monitorexit", "wide", "multianewarray", "ifnull", "ifnonnull",
+    "goto_w", "jsr_w", "breakpoint", "unknown", "unknown", "unknown", "unknown", "unknown",
+    "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown",
+    "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown",
+    "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown",
+    "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown",
+    "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "unknown",
+    "unknown", "unknown", "unknown", "unknown", "unknown", "unknown", "impdep1", "impdep2",
+};
+
+const char* opcode_name(uint8_t opcode) {
+    return OPCODE_NAMES[opcode];
+}
+
+static int32_t read_s4(const std::vector<uint8_t>& code, size_t pc) {
+    return (int32_t)(((uint32_t)code[pc] << 24) | ((uint32_t)code[pc+1] << 16) | ((uint32_t)code[pc+2] << 8) | (uint32_t)code[pc+3]);
+}
+
+size_t instruction_length(const std::vector<uint8_t>& code, size_t pc) {
+    uint8_t opcode = code[pc];
+    switch (opcode) {
+    case 0x10: case 0x12: case 0xa9: case 0xbc: // bipush ldc ret newarray
+        return 2;
+    case 0x11: case 0x13: case 0x14: case 0x84: case 0xa7: case 0xa8: // sipush ldc_w ldc2_w iinc goto jsr
+    case 0xbb: case 0xbd: case 0xc0: case 0xc1: case 0xc6: case 0xc7: // new anewarray checkcast instanceof ifnull ifnonnull
+        return 3;
+    case 0xc5: // multianewarray
+        return 4;
+    case 0xb9: case 0xba: case 0xc8: case 0xc9: // invokeinterface invokedynamic goto_w jsr_w
+        return 5;
+    case 0xaa: { // tableswitch
+        size_t p = (pc + 4) & ~size_t(3);
+        int32_t low = read_s4(code, p + 4);
+        int32_t high = read_s4(code, p + 8);
+        return p + 12 + 4 * (size_t)((int64_t)high - low + 1) - pc;
+    }
+    case 0xab: { // lookupswitch
+        size_t p = (pc + 4) & ~size_t(3);
+        int32_t npairs = read_s4(code, p + 4);
+        return p + 8 + 8 * (size_t)npairs - pc;
+    }
+    case 0xc4: // wide: iinc带两个2字节操作数，其余为2字节局部变量下标
+        return code[pc + 1] == 0x84 ? 6 : 4;
+    default:
+        break;
+    }
+    if ((opcode >= 0x15 && opcode <= 0x19) || (opcode >= 0x36 && opcode <= 0x3a)) { // xload xstore
+        return 2;
+    }
+    if ((opcode >= 0x99 && opcode <= 0xa6) || (opcode >= 0xb2 && opcode <= 0xb8)) { // if* get/put/invoke*
+        return 3;
+    }
+    return 1;
+}
+
+uint32_t SwitchTable::target(int32_t key) const {
+    if (dense) {
+        uint64_t index = (uint64_t)((int64_t)key - low);
+        return index < targets.size() ? targets[index] : default_target;
+    }
+    auto it = std::lower_bound(keys.begin(), keys.end(), key);
+    return it != keys.end() && *it == key ? targets[it - keys.begin()] : default_target;
+}
+
+// lookupswitch的键覆盖的范围不超过键数的2倍时，改用直接跳转表，空位跳到default
+static void densify(SwitchTable& table) {
+    if (table.keys.empty()) return;
+    int64_t range = (int64_t)table.keys.back() - table.keys.front() + 1;
+    if (range > 2 * (int64_t)table.keys.size()) return;
+    std::vector<uint32_t> targets((size_t)range, table.default_target);
+    for (size_t i = 0; i < table.keys.size(); ++i) {
+        targets[(size_t)((int64_t)table.keys[i] - table.keys.front())] = table.targets[i];
+    }
+    table.dense = true;
+    table.low = table.keys.front();
+    table.keys.clear();
+    table.targets = std::move(targets);
+}
+
+std::vector<SwitchTable> decode_switch_tables(const std::vector<uint8_t>& code) {
+    std::vector<SwitchTable> tables;
+    for (size_t pc = 0; pc < code.size(); pc += instruction_length(code, pc)) {
+        uint8_t opcode = code[pc];
+        if (opcode != 0xaa && opcode != 0xab) continue;
+        // 操作数从下一个4字节对齐的位置开始
+        size_t p = (pc + 4) & ~size_t(3);
+        SwitchTable table;
+        table.bci = (uint32_t)pc;
+        table.default_target = (uint32_t)((int64_t)pc + read_s4(code, p));
+        table.dense = false;
+        table.low = 0;
+        if (opcode == 0xaa) {
+            table.dense = true;
+            table.low = read_s4(code, p + 4);
+            int32_t high = read_s4(code, p + 8);
+            for (int64_t i = 0; i < (int64_t)high - table.low + 1; ++i) {
+                table.targets.push_back((uint32_t)((int64_t)pc + read_s4(code, p + 12 + 4 * i)));
+            }
+        } else {
+            int32_t npairs = read_s4(code, p + 4);
+            std::vector<std::pair<int32_t, uint32_t>> pairs;
+            for (int32_t i = 0; i < npairs; ++i) {
+                pairs.push_back({read_s4(code, p + 8 + 8 * i), (uint32_t)((int64_t)pc + read_s4(code, p + 12 + 8 * i))});
+            }
+            // 规范要求键已排序，这里仍然排序一次，二分查找不依赖class文件的正确性
+            std::sort(pairs.begin(), pairs.end());
+            for (const auto& [key, target] : pairs) {
+                table.keys.push_back(key);
+                table.targets.push_back(target);
+            }
+            densify(table);
+        }
+        tables.push_back(std::move(table));
+    }
+    return tables;
+}
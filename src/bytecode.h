@@ -0,0 +1,29 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 字节码助记符，未定义的操作码返回"unknown"
+const char* opcode_name(uint8_t opcode);
+
+// 位于pc处的指令（含操作数）的字节长度，处理tableswitch/lookupswitch的对齐填充和wide前缀
+size_t instruction_length(const std::vector<uint8_t>& code, size_t pc);
+
+// 预解码的tableswitch/lookupswitch，跳转目标都换算成绝对bci。
+// tableswitch和键足够密集的lookupswitch用直接跳转表（targets[key - low]），其余按升序的keys二分查找
+struct SwitchTable {
+    uint32_t bci;
+    uint32_t default_target;
+    bool dense;
+    int32_t low;                   // dense时targets[0]对应的键
+    std::vector<int32_t> keys;     // 非dense时与targets一一对应，升序
+    std::vector<uint32_t> targets;
+
+    uint32_t target(int32_t key) const;
+};
+
+// 解码方法中所有的switch指令，按bci升序
+std::vector<SwitchTable> decode_switch_tables(const std::vector<uint8_t>& code);
+
+#endif // BYTECODE_H
@@ -1,5 +1,8 @@
 #include "classFileParser.h"
+#include "Sha256.h"
+#include <algorithm>
 #include <fstream>
+#include <iterator>
 
 // 辅助函数：大端序读取
 uint16_t read_u1(std::ifstream& in) {
@@ -20,12 +23,41 @@ uint32_t read_u4(std::ifstream& in) {
     return (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
 }
 
-std::optional<ClassInfo> ClassFileParser::parse(const std::string& filename) {
+// 把异常表的pc区间切分成互不重叠的小区间，每个区间按表中顺序记下覆盖它的处理器，抛出时只需二分查找
+static void build_handler_ranges(MethodInfo& method) {
+    method.handler_ranges.clear();
+    method.handlers.clear();
+    std::vector<uint16_t> bounds;
+    for (const auto& entry : method.exception_table) {
+        bounds.push_back(entry.start_pc);
+        bounds.push_back(entry.end_pc);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+        HandlerRange range{bounds[i], bounds[i + 1], (uint16_t)method.handlers.size(), 0};
+        for (size_t k = 0; k < method.exception_table.size(); ++k) {
+            const auto& entry = method.exception_table[k];
+            if (entry.start_pc <= range.start_pc && range.end_pc <= entry.end_pc) {
+                method.handlers.push_back((uint16_t)k);
+                ++range.count;
+            }
+        }
+        if (range.count != 0) method.handler_ranges.push_back(range);
+    }
+}
+
+std::unique_ptr<ClassInfo> ClassFileParser::parse(const std::string& filename) {
     std::ifstream in(filename, std::ios::binary);
     if (!in.is_open()) {
-        return {};
+        return nullptr;
     }
-    ClassInfo class_file;
+    auto class_file = std::make_unique<ClassInfo>();
+    // 读入整个文件计算哈希；方法只保留各自Code属性的副本，解析完后文件内容不再保留
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.clear();
+    in.seekg(0);
+    class_file->content_hash = sha256_hex(bytes.data(), bytes.size());
     // 读取魔数
     uint32_t magic = read_u4(in);
     if (magic != 0xCAFEBABE) {
@@ -33,9 +65,9 @@ std::optional<ClassInfo> ClassFileParser::parse(const std::string& filename) {
     }
 
     // 解析版本号
-    class_file.minorVer = read_u2(in); // minor
-    class_file.majorVer = read_u2(in); // major
-    fmt::print("ClassFile Ver {}.{} \n", class_file.majorVer, class_file.minorVer);
+    class_file->minorVer = read_u2(in); // minor
+    class_file->majorVer = read_u2(in); // major
+    fmt::print("ClassFile Ver {}.{} \n", class_file->majorVer, class_file->minorVer);
 
     // 解析常量池
     uint16_t cp_count = read_u2(in);
@@ -80,10 +112,10 @@ std::optional<ClassInfo> ClassFileParser::parse(const std::string& filename) {
             {
                 cp_info.longOrDouble_high_bytes = read_u4(in);
                 cp_info.longOrDouble_low_bytes = read_u4(in);
-                class_file.constant_pool.add_constant(cp_info);
+                class_file->constant_pool.add_constant(cp_info);
                 i++; // 跳过下一个无效槽
                 cp_info.tag = 0;
-                class_file.constant_pool.add_constant(cp_info);
+                class_file->constant_pool.add_constant(cp_info);
                 continue;
             }
             case 12: { // CONSTANT_NameAndType
@@ -115,20 +147,22 @@ std::optional<ClassInfo> ClassFileParser::parse(const std::string& filename) {
                 throw std::runtime_error("Unsupported constant pool tag: " + std::to_string(tag));
             }
         }
-        class_file.constant_pool.add_constant(std::move(cp_info));
+        class_file->constant_pool.add_constant(std::move(cp_info));
     }
     if(std::getenv("JVM_PRINT_CONSTANT")) {
-        class_file.constant_pool.print_all();
+        class_file->constant_pool.print_all();
     }
 
     // 解析访问标志、类名、父类名等
-    uint16_t access_flags= read_u2(in);
-    class_file.this_class = read_u2(in);
-    class_file.super_class = read_u2(in);
+    class_file->access_flags = read_u2(in);
+    class_file->this_class = read_u2(in);
+    class_file->super_class = read_u2(in);
 
     // 解析接口
     uint16_t interfaces_count = read_u2(in);
-    in.ignore(interfaces_count * 2);
+    for (int i = 0; i < interfaces_count; ++i) {
+        class_file->interfaces.push_back(read_u2(in));
+    }
 
     // 解析字段
     uint16_t fields_count = read_u2(in);
@@ -140,13 +174,13 @@ std::optional<ClassInfo> ClassFileParser::parse(const std::string& filename) {
 
         FieldInfo field;
         field.access_flags = field_access_flags;
-        field.name = class_file.constant_pool.get_utf8_str(field_name_index);
-        field.descriptor = class_file.constant_pool.get_utf8_str(field_descriptor_index);
+        field.name = class_file->constant_pool.get_utf8_str(field_name_index);
+        field.descriptor = class_file->constant_pool.get_utf8_str(field_descriptor_index);
 
         for (int j = 0; j < field_attributes_count; ++j) {
             uint16_t attribute_name_index = read_u2(in);
             uint32_t attribute_length = read_u4(in);
-            std::string attr_name = class_file.constant_pool.get_utf8_str(attribute_name_index);
+            std::string attr_name = class_file->constant_pool.get_utf8_str(attribute_name_index);
             if (attr_name == "ConstantValue") {
                 if (attribute_length != 2) {
                     throw std::runtime_error("Invalid ConstantValue attribute length");
@@ -159,7 +193,7 @@ std::optional<ClassInfo> ClassFileParser::parse(const std::string& filename) {
             }
         }
 
-        class_file.fields.push_back(std::move(field));
+        class_file->fields.push_back(std::move(field));
     }
 
     // 解析方法
@@ -171,62 +205,94 @@ std::optional<ClassInfo> ClassFileParser::parse(const std::string& filename) {
         method.access_flags = access_flags;
         uint16_t name_idx = read_u2(in);
         uint16_t desc_idx = read_u2(in);
-        method.name = class_file.constant_pool.get_utf8_str(name_idx);
-        method.descriptor = class_file.constant_pool.get_utf8_str(desc_idx);
+        method.name = class_file->constant_pool.get_utf8_str(name_idx);
+        method.descriptor = class_file->constant_pool.get_utf8_str(desc_idx);
 
         // fmt::print("parsing method {}\n", method.name);
 
-        // 解析属性
+        // 解析属性：Code只复制字节，其余忽略
         bool code_found = false;
         uint16_t attr_count = read_u2(in);
         for (int j = 0; j < attr_count; ++j) {
-            AttributeInfo attr = parseAttributeInfo(in, class_file.constant_pool);
-            if (attr.name == "Code") {
-                method.code = std::move(attr.code->code);
-                method.max_stack = attr.code->max_stack;
-                method.max_locals = attr.code->max_locals;
+            uint16_t attr_name_idx = read_u2(in);
+            uint32_t attr_len = read_u4(in);
+            if (class_file->constant_pool.get_utf8_str(attr_name_idx) == "Code") {
+                method.code_attribute.resize(attr_len);
+                in.read(reinterpret_cast<char*>(method.code_attribute.data()), attr_len);
+                method.has_code = true;
                 code_found = true;
+            } else {
+                in.ignore(attr_len);
             }
         }
         if (!code_found && (access_flags & ACC_NATIVE) == 0 && (access_flags & ACC_ABSTRACT) == 0) {
             fmt::print("Found a method {} without Code attribute\n", method.name);
             throw std::runtime_error("Found a method without Code attribute");
         }
-        class_file.methods.push_back(method);
+        class_file->methods.push_back(std::move(method));
     }
     return class_file;
 }
 
-AttributeInfo ClassFileParser::parseAttributeInfo(std::ifstream& in, const ConstantPool& cp) {
-    AttributeInfo attr;
-    uint16_t attr_name_idx = read_u2(in);
-    uint32_t attr_len = read_u4(in);
-    attr.name = cp.get_utf8_str(attr_name_idx);
-    if (attr.name == "Code") {
-        std::unique_ptr<CodeAttribute> code_attr = std::make_unique<CodeAttribute>();
-        code_attr->max_stack = read_u2(in);
-        code_attr->max_locals = read_u2(in);
-        uint32_t code_len = read_u4(in);
-        code_attr->code.resize(code_len);
-        in.read(reinterpret_cast<char*>(code_attr->code.data()), code_len);
-        // 异常表
-        uint16_t exception_table_len = read_u2(in);
-        for (int k = 0; k < exception_table_len; ++k) {
-            uint16_t start_pc = read_u2(in);
-            uint16_t end_pc = read_u2(in);
-            uint16_t handler_pc = read_u2(in);
-            uint16_t catch_type = read_u2(in);
-        }
-        // 属性
-        uint16_t subattributes_count = read_u2(in);
-        for (int i = 0; i < subattributes_count; ++i) {
-            AttributeInfo attr = parseAttributeInfo(in, cp);
+// 解码Code属性（JVMS §4.7.3）；StackMapTable等子属性不使用，不解析
+void ClassFileParser::parse_code(MethodInfo& method) {
+    const std::vector<uint8_t>& bytes = method.code_attribute;
+    if (bytes.size() < 12) {
+        throw std::runtime_error("Truncated Code attribute in method " + method.name);
+    }
+    size_t p = 0;
+    auto u2 = [&]() {
+        uint16_t v = (uint16_t)((bytes[p] << 8) | bytes[p + 1]);
+        p += 2;
+        return v;
+    };
+    method.max_stack = u2();
+    method.max_locals = u2();
+    uint32_t code_len = ((uint32_t)bytes[p] << 24) | ((uint32_t)bytes[p + 1] << 16) | ((uint32_t)bytes[p + 2] << 8) | bytes[p + 3];
+    p += 4;
+    if (code_len > bytes.size() - 12) {
+        throw std::runtime_error("Truncated Code attribute in method " + method.name);
+    }
+    method.code.assign(bytes.begin() + p, bytes.begin() + p + code_len);
+    p += code_len;
+    // 异常表
+    uint16_t exception_table_len = u2();
+    if (p + exception_table_len * 8u > bytes.size()) {
+        throw std::runtime_error("Truncated exception table in method " + method.name);
+    }
+    method.exception_table.resize(exception_table_len);
+    for (auto& entry : method.exception_table) {
+        entry.start_pc = u2();
+        entry.end_pc = u2();
+        entry.handler_pc = u2();
+        entry.catch_type = u2();
+    }
+    build_handler_ranges(method);
+}
+
+// 在Code属性的子属性中查找StackMapTable，返回其内容，没有时返回空
+std::vector<uint8_t> ClassFileParser::find_stack_map(const MethodInfo& method, const ConstantPool& cp) {
+    const std::vector<uint8_t>& bytes = method.code_attribute;
+    size_t end = bytes.size();
+    if (end < 12) return {};
+    auto u2 = [&](size_t p) { return (uint16_t)((bytes[p] << 8) | bytes[p + 1]); };
+    auto u4 = [&](size_t p) { return ((uint32_t)u2(p) << 16) | u2(p + 2); };
+    size_t p = 4;
+    p += 4 + (size_t)u4(p);
+    if (p + 2 > end) return {};
+    p += 2 + 8 * (size_t)u2(p);
+    if (p + 2 > end) return {};
+    uint16_t attr_count = u2(p);
+    p += 2;
+    for (int i = 0; i < attr_count && p + 6 <= end; ++i) {
+        uint16_t name_idx = u2(p);
+        uint32_t len = u4(p + 2);
+        p += 6;
+        if (len > end - p) return {};
+        if (name_idx < cp.size() && cp[name_idx].tag == ConstantType::UTF8 && cp[name_idx].utf8_str == "StackMapTable") {
+            return std::vector<uint8_t>(bytes.begin() + p, bytes.begin() + p + len);
         }
-        attr = AttributeInfo(attr.name, std::move(code_attr));
-    } else {
-        std::vector<uint8_t> unkown_info(attr_len);
-        in.read(reinterpret_cast<char*>(unkown_info.data()), attr_len);
-        attr = AttributeInfo(attr.name, unkown_info);
+        p += len;
     }
-    return attr;
+    return {};
 }
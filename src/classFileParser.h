@@ -1,14 +1,17 @@
 #ifndef CLASSFILEPARSER_H
 #define CLASSFILEPARSER_H
 #include "classFileParser_types.h"
-#include <optional>
+#include <memory>
 
 // Class文件解析器
 class ClassFileParser {
 public:
-    std::optional<ClassInfo> parse(const std::string& filename);
-private:
-    AttributeInfo parseAttributeInfo(std::ifstream& in, const ConstantPool& cp);
+    // 解析失败返回nullptr。ClassInfo含有锁，不可移动，因此在堆上构造
+    std::unique_ptr<ClassInfo> parse(const std::string& filename);
+    // 解码parse时记下位置的Code属性
+    static void parse_code(MethodInfo& method);
+    // Code属性中的StackMapTable，只在验证时使用
+    static std::vector<uint8_t> find_stack_map(const MethodInfo& method, const ConstantPool& cp);
 };
 
 #endif //CLASSFILEPARSER_H
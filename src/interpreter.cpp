@@ -6,9 +6,17 @@
 #include <functional>
 #include <limits>
 #include <cmath>
+#include <cstring>
+#include <new>
+#include <algorithm>
 #include "interpreter.h"
 #include "runtime.h"
 #include "NativeMethods.h"
+#include "ObjectMonitor.h"
+#include "Superinstructions.h"
+#include "bytecode.h"
+#include "TypeCheck.h"
+#include "TrapHandler.h"
 
 void installFrame(JVMContext& context, const ClassInfo& _class, const MethodInfo& _method, const std::vector<SlotT>& _args) {
     Frame frame(_method.max_locals, _method.max_stack, _class, _method);
@@ -26,6 +34,7 @@ uint16_t read_u2_from_code(const std::vector<uint8_t>& code, size_t pc) {
 MethodInfo* Interpreter::find_method(ClassInfo& cf, const std::string& name, const std::string& descriptor, std::string* found_in_which_parent_class) {
     for (auto& m : cf.methods) {
         if (m.name == name && m.descriptor == descriptor) {
+            class_loader.link_method(m);
             if(found_in_which_parent_class)
                 *found_in_which_parent_class = cf.constant_pool.get_class_name(cf.this_class);
             return &m;
@@ -36,48 +45,156 @@ MethodInfo* Interpreter::find_method(ClassInfo& cf, const std::string& name, con
         std::string super_name = cf.constant_pool.get_class_name(cf.super_class);
         if (super_name != "java/lang/Object") {
             ClassInfo& super_cf = load_class(super_name);
-            return find_method(super_cf, name, descriptor);
+            return find_method(super_cf, name, descriptor, found_in_which_parent_class);
         }
     }
     return nullptr;
 }
 
-// 解析方法描述符，返回参数个数
-int count_method_args(const std::string& desc) {
-    int count = 0;
-    bool inType = false;
+// 解析方法描述符，返回参数占用的槽位数（long/double占两个槽位）
+size_t count_method_arg_slots(const std::string& desc) {
+    size_t slots = 0;
     for (size_t i = 1; i < desc.size() && desc[i] != ')'; ++i) {
-        if (desc[i] == 'L') { // 对象类型
+        if (desc[i] == '[') {
+            // 数组是引用，跳过所有维度和元素类型
+            while (desc[i] == '[') ++i;
+            if (desc[i] == 'L') {
+                while (desc[i] != ';') ++i;
+            }
+            ++slots;
+        } else if (desc[i] == 'L') { // 对象类型
             while (desc[i] != ';') ++i;
-            ++count;
-        } else if (desc[i] == '[') {
-            // 跳过数组标记
+            ++slots;
+        } else if (desc[i] == 'J' || desc[i] == 'D') {
+            slots += 2;
         } else {
-            ++count; // 基本类型
+            ++slots; // 基本类型
         }
     }
-    return count;
+    return slots;
+}
+
+// 把native方法返回值压入操作数栈
+void push_native_value(OperandStack& stack, const NativeValue& value) {
+    if (value.kind == NativeValue::ONE_SLOT) {
+        stack.push(static_cast<SlotT>(value.bits));
+    } else if (value.kind == NativeValue::TWO_SLOT) {
+        stack.push_long(static_cast<LongT>(value.bits));
+    }
+}
+
+// 调用已解析的方法，参数为调用者操作数栈顶的arg_slots个槽位。
+// native方法直接以栈上的参数槽位调用，不创建Frame；普通方法弹出参数并压入新帧
+void invoke_method(JVMContext& context, Frame& caller, const ClassInfo& target_class, const MethodInfo& target_method, size_t arg_slots, Interpreter& interp) {
+    auto& stack = caller.operand_stack.stack;
+    if ((target_method.access_flags & ACC_NATIVE) != 0) {
+        if (!target_method.native_func) {
+            fmt::print("Native method {}.{}{} not implemented\n", target_class.constant_pool.get_class_name(target_class.this_class), target_method.name, target_method.descriptor);
+            exit(1);
+        }
+        NativeArgs args{stack.data() + stack.size() - arg_slots, arg_slots};
+        PROFILE_METHOD_ENTER(target_class, target_method);
+        NativeValue ret;
+        if ((target_method.access_flags & ACC_SYNCHRONIZED) != 0) {
+            // native同步方法没有帧，锁在调用前后加解
+            JVMObject& lock = interp.get_object((target_method.access_flags & ACC_STATIC) != 0 ? interp.class_mirror(*target_class.klass) : args[0]);
+            monitor_enter(lock);
+            try {
+                ret = target_method.native_func(args, interp);
+            } catch (...) {
+                monitor_exit(lock);
+                throw;
+            }
+            monitor_exit(lock);
+        } else {
+            ret = target_method.native_func(args, interp);
+        }
+        PROFILE_METHOD_EXIT();
+        stack.resize(stack.size() - arg_slots);
+        push_native_value(caller.operand_stack, ret);
+        return;
+    }
+    std::vector<SlotT> args(arg_slots);
+    for (int i = arg_slots - 1; i >= 0; --i) {
+        args[i] = caller.operand_stack.pop();
+        fmt::print("setup args[{}]={}\n", i, args[i]);
+    }
+    installFrame(context, target_class, target_method, args);
+    if ((target_method.access_flags & ACC_SYNCHRONIZED) != 0) interp.enter_method_monitor(context.current_frame());
 }
 
-// 分配引用类型数组
-RefT Interpreter::new_reference_array(const std::string& element_class_name, size_t len) {
-    std::string elem = element_class_name;
-    JVMArray arr(elem, len, 1);
-    RefT ref = (RefT)array_pool.size() + 1; // 简单生成引用（避免与对象池冲突）
-    array_pool.emplace(ref, std::move(arr));
-    return ref;
+// 分配数组
+RefT Interpreter::new_array(const Klass& array_klass, size_t len, size_t width_slots) {
+    return heap.make<JVMArray>(JVMArray::element_bytes(len, width_slots), &array_klass, len, width_slots);
+}
+
+// 多维数组：逐层创建，同一层的数组在TLAB中依次分配，元素紧跟在各自的头部后面，内存已清零。
+// 某一维长度为0时不再创建更深的层
+RefT Interpreter::new_multi_array(const std::string& descriptor, const std::vector<IntT>& counts) {
+    size_t dims = counts.size();
+    if (descriptor.size() <= dims || descriptor.find_first_not_of('[') < dims) {
+        fmt::print("multianewarray: {} has fewer than {} dimensions\n", descriptor, dims);
+        exit(1);
+    }
+    for (IntT count : counts) {
+        if (count < 0) throw JavaRuntimeError("java/lang/NegativeArraySizeException");
+    }
+    auto width_of = [&](size_t level) -> size_t {
+        if (level + 1 < dims) return 1;
+        char leaf = descriptor[level + 1];
+        return (leaf == 'J' || leaf == 'D') ? 2 : 1;
+    };
+    // 先算出所有层的总大小，放不下时在创建任何数组之前抛出
+    size_t total = 0;
+    size_t n = 1;
+    for (size_t i = 0; i < dims && n != 0; ++i) {
+        size_t bytes_per_array = sizeof(JVMArray) + JVMArray::element_bytes((size_t)counts[i], width_of(i));
+        if (bytes_per_array > (SIZE_MAX - total) / n) {
+            throw JavaRuntimeError("java/lang/OutOfMemoryError");
+        }
+        total += n * bytes_per_array;
+        n *= (size_t)counts[i];
+    }
+
+    RefT root = new_array(klass(descriptor), (size_t)counts[0], width_of(0));
+    std::vector<RefT> parents{root}; // 上一层的数组，它们的元素按顺序指向这一层新建的数组
+    std::vector<RefT> level;
+    for (size_t i = 1; i < dims && counts[i - 1] != 0; ++i) {
+        const Klass& array_klass = klass(descriptor.substr(i));
+        size_t len = (size_t)counts[i];
+        size_t width = width_of(i);
+        level.clear();
+        level.reserve(parents.size() * (size_t)counts[i - 1]);
+        for (RefT parent : parents) {
+            SlotT* parent_slots = get_array(parent).elems();
+            for (size_t k = 0; k < (size_t)counts[i - 1]; ++k) {
+                RefT ref = new_array(array_klass, len, width);
+                parent_slots[k] = ref;
+                level.push_back(ref);
+            }
+        }
+        parents.swap(level);
+    }
+    return root;
 }
 
 // 执行指定的方法
-std::optional<SlotT> Interpreter::execute(const std::string& class_name, const std::string& method_name, const std::string& method_desc, const std::vector<SlotT>& args) {
+std::optional<TwoSlotT> Interpreter::execute(const std::string& class_name, const std::string& method_name, const std::string& method_desc, const std::vector<SlotT>& args) {
     ClassInfo& cf = load_class(class_name);
     MethodInfo* method = find_method(cf, method_name, method_desc);
     if (!method) {
         fmt::print("[execute] cannot find method {}.{} {}\n", class_name, method_name, method_desc);
         return {};
     }
+    return execute_method(cf, *method, args);
+}
+
+std::optional<TwoSlotT> Interpreter::execute_method(ClassInfo& cf, const MethodInfo& method, const std::vector<SlotT>& args) {
     JVMContext context;
-    return _execute(context, cf, *method, args);
+    if (JVMContext::current) {
+        context.thread_ref = JVMContext::current->thread_ref;
+    }
+    return _execute(context, cf, method, args);
 }
 
 void Interpreter::init_opcode_table() {
@@ -89,8 +206,7 @@ void Interpreter::init_opcode_table() {
     opcode_table[0x00] = [](JVMContext& context, Frame&, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {};
     // aconst_null
     opcode_table[0x01] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
-        RefT constval = -1;
-        cur_frame.operand_stack.push(constval);
+        cur_frame.operand_stack.push(NULL_REF);
         fmt::print("aconst_null\n");
     };
     // iconst_m1
@@ -116,27 +232,27 @@ void Interpreter::init_opcode_table() {
         };
     }
     // fconst_0
-    opcode_table[0x0b] = [](JVMContext& context, Frame& frame, ...) {
+    opcode_table[0x0b] = [](JVMContext& context, Frame& frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         frame.operand_stack.push_float(0.0f);
         fmt::print("Put float 0.0 on the stack\n");
     };
     // fconst_1
-    opcode_table[0x0c] = [](JVMContext& context, Frame& frame, ...) {
+    opcode_table[0x0c] = [](JVMContext& context, Frame& frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         frame.operand_stack.push_float(1.0f);
         fmt::print("Put float 1.0 on the stack\n");
     };
     // fconst_2
-    opcode_table[0x0d] = [](JVMContext& context, Frame& frame, ...) {
+    opcode_table[0x0d] = [](JVMContext& context, Frame& frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         frame.operand_stack.push_float(2.0f);
         fmt::print("Put float 2.0 on the stack\n");
     };
     // dconst_0
-    opcode_table[0x0e] = [](JVMContext& context, Frame& frame, ...) {
+    opcode_table[0x0e] = [](JVMContext& context, Frame& frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         frame.operand_stack.push_double(0.0);
         fmt::print("Put double 0.0 on the stack\n");
     };
     // dconst_1
-    opcode_table[0x0f] = [](JVMContext& context, Frame& frame, ...) {
+    opcode_table[0x0f] = [](JVMContext& context, Frame& frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         frame.operand_stack.push_double(1.0);
         fmt::print("Put double 1.0 on the stack\n");
     };
@@ -668,14 +784,15 @@ void Interpreter::init_opcode_table() {
     opcode_table[0x6c] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         IntT v2 = cur_frame.operand_stack.pop();
         IntT v1 = cur_frame.operand_stack.pop();
-        cur_frame.operand_stack.push(v1 / v2);
+        // 除数为0由SIGFPE转换为ArithmeticException（隐式检查）；INT_MIN / -1同样会陷入，单独处理
+        cur_frame.operand_stack.push(v2 == -1 ? (IntT)(0u - (UIntT)v1) : TrapHandler::divide(v1, v2));
         fmt::print("idiv {} / {}\n", v1, v2);
     };
     // ldiv
     opcode_table[0x6d] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         LongT v2 = cur_frame.operand_stack.pop_long();
         LongT v1 = cur_frame.operand_stack.pop_long();
-        cur_frame.operand_stack.push_long(v1 / v2);
+        cur_frame.operand_stack.push_long(v2 == -1 ? (LongT)(0ull - (ULongT)v1) : TrapHandler::divide(v1, v2));
         fmt::print("ldiv {} / {}\n", v1, v2);
     };
     // fdiv
@@ -696,14 +813,14 @@ void Interpreter::init_opcode_table() {
     opcode_table[0x70] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         IntT v2 = cur_frame.operand_stack.pop();
         IntT v1 = cur_frame.operand_stack.pop();
-        cur_frame.operand_stack.push(v1 % v2);
+        cur_frame.operand_stack.push(v2 == -1 ? 0 : TrapHandler::remainder(v1, v2));
         fmt::print("irem {} % {}\n", v1, v2);
     };
     // lrem
     opcode_table[0x71] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
         LongT v2 = cur_frame.operand_stack.pop_long();
         LongT v1 = cur_frame.operand_stack.pop_long();
-        cur_frame.operand_stack.push_long(v1 % v2);
+        cur_frame.operand_stack.push_long(v2 == -1 ? 0 : TrapHandler::remainder(v1, v2));
         fmt::print("lrem {} % {}\n", v1, v2);
     };
     // frem
@@ -953,7 +1070,7 @@ void Interpreter::init_opcode_table() {
         LongT v2 = cur_frame.operand_stack.pop_long();
         LongT v1 = cur_frame.operand_stack.pop_long();
         IntT result = (v1 == v2) ? 0 : (v1 < v2 ? -1 : 1);
-        cur_frame.operand_stack.push_long(result);
+        cur_frame.operand_stack.push_int(result);
         fmt::print("lcmp {} {} => {}\n", v1, v2, result);
     };
     // fcmpl
@@ -1130,118 +1247,123 @@ void Interpreter::init_opcode_table() {
         pc = cur_frame.local_vars[idx];
         fmt::print("ret {}\n", idx); // todo: implement
     };
-    // tableswitch
-    opcode_table[0xaa] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter&) {
-        fmt::print("tableswitch not implemented\n");
-        exit(1);
+    // tableswitch: 跳转表在类加载时预解码，直接按键下标
+    opcode_table[0xaa] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
+        IntT key = cur_frame.operand_stack.pop_int();
+        pc = cur_frame.method_info.switch_at(pc - 1).target(key);
+        fmt::print("tableswitch key {} -> {}\n", key, pc);
     };
-    // lookupswitch
-    opcode_table[0xab] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter&) {
-        fmt::print("lookupswitch not implemented\n");
-        exit(1);
+    // lookupswitch: 预解码为有序的键数组二分查找，键密集时同样用直接跳转表
+    opcode_table[0xab] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
+        IntT key = cur_frame.operand_stack.pop_int();
+        pc = cur_frame.method_info.switch_at(pc - 1).target(key);
+        fmt::print("lookupswitch key {} -> {}\n", key, pc);
     };
     // ireturn
     opcode_table[0xac] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
         int32_t ret = cur_frame.operand_stack.pop();
+        interp.exit_method_monitor(cur_frame);
         context.pop_frame();
         if (!context.empty()) {
             context.current_frame().operand_stack.push(ret);
         }
     };
-    // lreturn, freturn, dreturn, areturn
-    opcode_table[0xad] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) { 
-        int32_t ret = cur_frame.operand_stack.pop();
+    // lreturn: 返回值占两个槽位
+    opcode_table[0xad] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
+        LongT ret = cur_frame.operand_stack.pop_long();
+        interp.exit_method_monitor(cur_frame);
         context.pop_frame();
         if (!context.empty()) {
-            context.current_frame().operand_stack.push(ret);
+            context.current_frame().operand_stack.push_long(ret);
         }
     };
-    opcode_table[0xae] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) { 
+    // freturn
+    opcode_table[0xae] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) { 
         int32_t ret = cur_frame.operand_stack.pop();
+        interp.exit_method_monitor(cur_frame);
         context.pop_frame();
         if (!context.empty()) {
             context.current_frame().operand_stack.push(ret);
         }
     };
-    opcode_table[0xaf] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
-        int32_t ret = cur_frame.operand_stack.pop();
+    // dreturn: 返回值占两个槽位
+    opcode_table[0xaf] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
+        LongT ret = cur_frame.operand_stack.pop_long();
+        interp.exit_method_monitor(cur_frame);
         context.pop_frame();
         if (!context.empty()) {
-            context.current_frame().operand_stack.push(ret);
+            context.current_frame().operand_stack.push_long(ret);
         }
     };
-    opcode_table[0xb0] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
+    // areturn
+    opcode_table[0xb0] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
         int32_t ret = cur_frame.operand_stack.pop();
+        interp.exit_method_monitor(cur_frame);
         context.pop_frame();
         if (!context.empty()) {
             context.current_frame().operand_stack.push(ret);
         }
     };
     // return
-    opcode_table[0xb1] = [](JVMContext& context, Frame&, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
+    opcode_table[0xb1] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
+        interp.exit_method_monitor(cur_frame);
         context.pop_frame();
 
         fmt::print("return\n");
     };
-    // getstatic
+    // getstatic：解析过的字段直接读所属类的槽位
     opcode_table[0xb2] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
         uint16_t idx = (code[pc] << 8) | code[pc+1];
         pc += 2;
-
-        auto& fieldref = cf.constant_pool[idx];
-        ConstIdxT class_idx = fieldref.fieldref_class_index;
-        ConstIdxT name_type_idx = fieldref.fieldref_name_type_index;
-
-        std::string class_name = cf.constant_pool.get_class_name(class_idx);
-        auto [field_name, field_desc] = cf.constant_pool.get_name_and_type(name_type_idx);
-
-        fmt::print("getstatic: class_name:{} field_name:{} field_desc:{}\n", class_name, field_name, field_desc);
-        SlotT v = interp.getstatic(class_name, field_name, field_desc);
-
-        cur_frame.operand_stack.push(v);
+        const FieldInfo* field = cf.resolved_static_fields[idx].load(std::memory_order_acquire);
+        if (!field) field = &interp.resolve_static_field(cf, idx);
+        TwoSlotT v = 0;
+        for (uint8_t i = 0; i < field->width; ++i) {
+            SlotT slot = field->static_value[i].load(std::memory_order_relaxed);
+            cur_frame.operand_stack.push(slot);
+            v = (v << SLOT_WIDTH) | slot;
+        }
+        fmt::print("[getstatic] static field {}.{}: {}\n", cf.constant_pool.get_class_name(cf.constant_pool[idx].fieldref_class_index), field->name, v);
     };
     // putstatic
     opcode_table[0xb3] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
         uint16_t idx = (code[pc] << 8) | code[pc+1];
         pc += 2;
-
-        auto& fieldref = cf.constant_pool[idx];
-        ConstIdxT class_idx = fieldref.fieldref_class_index;
-        ConstIdxT name_type_idx = fieldref.fieldref_name_type_index;
-
-        std::string class_name = cf.constant_pool.get_class_name(class_idx);
-        auto [field_name, field_desc] = cf.constant_pool.get_name_and_type(name_type_idx);
-
-        SlotT v = cur_frame.operand_stack.pop();
-
-        fmt::print("putstatic: class_name:{} field_name:{} field_desc:{} val:{}\n", class_name, field_name, field_desc, v);
-        interp.putstatic(class_name, field_name, field_desc, v);
+        const FieldInfo* field = cf.resolved_static_fields[idx].load(std::memory_order_acquire);
+        if (!field) field = &interp.resolve_static_field(cf, idx);
+        TwoSlotT v = 0;
+        for (uint8_t i = field->width; i-- > 0;) {
+            SlotT slot = cur_frame.operand_stack.pop();
+            field->static_value[i].store(slot, std::memory_order_relaxed);
+            v |= (TwoSlotT)slot << (SLOT_WIDTH * (field->width - 1 - i));
+        }
+        fmt::print("[putstatic] static field {}.{}: {}\n", cf.constant_pool.get_class_name(cf.constant_pool[idx].fieldref_class_index), field->name, v);
     };
     // getfield
     opcode_table[0xb4] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
-        int16_t idx = (code[pc] << 8) | code[pc+1];
+        uint16_t idx = (code[pc] << 8) | code[pc+1];
         pc += 2;
-        // 解析字段名和类型
-        const ConstantPoolInfo& fieldref = cf.constant_pool[idx];
-        uint16_t name_type_idx = fieldref.fieldref_name_type_index;
-        auto [field_name, field_desc] = cf.constant_pool.get_name_and_type(name_type_idx);
+        const FieldInfo* field = cf.resolved_fields[idx].load(std::memory_order_acquire);
+        if (!field) field = &interp.resolve_field(cf, idx);
         RefT obj_ref = cur_frame.operand_stack.pop();
-        SlotT val = interp.get_field(obj_ref, field_name);
-        cur_frame.operand_stack.push(val);
-        fmt::print("getfield: get obj:{} field:{} val:{}\n", obj_ref, field_name, val);
+        const SlotT* slots = interp.field_slots(obj_ref, *field);
+        cur_frame.operand_stack.push(slots[0]);
+        if (field->width == 2) cur_frame.operand_stack.push(slots[1]);
+        fmt::print("getfield: get obj:{} field:{} val:{}\n", obj_ref, field->name, slots[0]);
     };
     // putfield
     opcode_table[0xb5] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
-        int16_t idx = (code[pc] << 8) | code[pc+1];
+        uint16_t idx = (code[pc] << 8) | code[pc+1];
         pc += 2;
-        // 解析字段名和类型
-        const ConstantPoolInfo& fieldref = cf.constant_pool[idx];
-        uint16_t name_type_idx = fieldref.fieldref_name_type_index;
-        auto [field_name, field_desc] = cf.constant_pool.get_name_and_type(name_type_idx);
-        int32_t val = cur_frame.operand_stack.pop();
+        const FieldInfo* field = cf.resolved_fields[idx].load(std::memory_order_acquire);
+        if (!field) field = &interp.resolve_field(cf, idx);
+        SlotT low = field->width == 2 ? cur_frame.operand_stack.pop() : 0;
+        SlotT val = cur_frame.operand_stack.pop();
         RefT obj_ref = cur_frame.operand_stack.pop();
-        interp.put_field(obj_ref, field_name, val);
-        fmt::print("putfield: set obj:{} field:{} val:{}\n", obj_ref, field_name, val);
+        SlotT* slots = interp.field_slots(obj_ref, *field);
+        slots[0] = val;
+        if (field->width == 2) slots[1] = low;
+        fmt::print("putfield: set obj:{} field:{} val:{}\n", obj_ref, field->name, val);
     };
     // invokevirtual
     opcode_table[0xb6] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
@@ -1255,20 +1377,16 @@ void Interpreter::init_opcode_table() {
 
         fmt::print("[invokevirtual] classname:{} method_name:{} method_desc:{}\n", class_name.c_str(), method_name.c_str(), method_desc.c_str());
 
-        // 弹出参数
-        size_t arg_count = count_method_args(method_desc);
-        arg_count++; // obj ref
-        std::vector<SlotT> args(arg_count);
-        for (int i = arg_count - 1; i >= 0; --i) {
-            args[i] = cur_frame.operand_stack.pop();
-            fmt::print("setup args[{}]={}\n", i, args[i]);
-        }
-        fmt::print("objref {} \n", args[0]);
+        size_t arg_slots = count_method_arg_slots(method_desc);
+        arg_slots++; // obj ref
+        // 读取接收者的类名，null时由隐式null检查抛出NullPointerException
+        RefT objref = cur_frame.operand_stack.stack[cur_frame.operand_stack.size() - arg_slots];
+        fmt::print("objref {} class {}\n", objref, interp.get_object(objref).klass->name);
         ClassInfo& target_class = interp.load_class(class_name);
         MethodInfo* target_method = interp.find_method(target_class, method_name, method_desc);
         if (target_method) {
-            // 设置新帧并压入被调用栈
-            installFrame(context, target_class, *target_method, args);
+            // 设置新帧并压入被调用栈；继承来的方法使用声明它的类的常量池
+            invoke_method(context, cur_frame, *target_method->owner, *target_method, arg_slots, interp);
         } else {
             fmt::print("invokevirtual invaid method");
             exit(1);
@@ -1285,21 +1403,17 @@ void Interpreter::init_opcode_table() {
         auto [method_name, method_desc] = cf.constant_pool.get_name_and_type(name_type_idx);
         fmt::print("[invokespecial] idx{} classname:{} method_name:{} method_desc:{}\n", idx, class_name, method_name, method_desc);
 
-        // 弹出参数
-        size_t arg_count = count_method_args(method_desc);
-        arg_count++; // object ref
-        std::vector<SlotT> args(arg_count);
-        for (int i = arg_count - 1; i >= 0; --i) {
-            args[i] = cur_frame.operand_stack.pop();
-            fmt::print("setup args[{}]={}\n", i, args[i]);
-        }
-        if (args[0]==0) return;
-        fmt::print("objref {} \n", args[0]);
+        size_t arg_slots = count_method_arg_slots(method_desc);
+        arg_slots++; // object ref
+        RefT objref = cur_frame.operand_stack.stack[cur_frame.operand_stack.size() - arg_slots];
+        // 接收者为null时由读取对象头的隐式null检查抛出NullPointerException
+        interp.get_object(objref);
+        fmt::print("objref {} \n", objref);
 
         ClassInfo& target_class = interp.load_class(class_name);
         MethodInfo* target_method = interp.find_method(target_class, method_name, method_desc);
         if (target_method) {
-            installFrame(context, target_class, *target_method, args);
+            invoke_method(context, cur_frame, *target_method->owner, *target_method, arg_slots, interp);
         } else {
             fmt::print("invokespecial invaid method");
             exit(1);
@@ -1309,29 +1423,10 @@ void Interpreter::init_opcode_table() {
     opcode_table[0xb8] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
         uint16_t idx = (code[pc] << 8) | code[pc+1];
         pc += 2;
-        const ConstantPoolInfo& methodref = cf.constant_pool[idx];
-        uint16_t class_idx = methodref.methodref_class_index;
-        uint16_t name_type_idx = methodref.methodref_name_type_index;
-        std::string class_name = cf.constant_pool.get_utf8_str(cf.constant_pool[class_idx].class_name_index);
-        auto [method_name, method_desc] = cf.constant_pool.get_name_and_type(name_type_idx);
-        fmt::print("[invokestatic] classname:{} method_name:{} method_desc:{}\n", class_name.c_str(), method_name.c_str(), method_desc.c_str());
-
-        // 弹出参数
-        size_t arg_count = count_method_args(method_desc);
-        std::vector<SlotT> args(arg_count);
-        for (int i = arg_count - 1; i >= 0; --i) {
-            args[i] = cur_frame.operand_stack.pop();
-            fmt::print("setup args[{}]={}\n", i, args[i]);
-        }
-
-        ClassInfo& target_class = interp.load_class(class_name);
-        MethodInfo* target_method = interp.find_method(target_class, method_name, method_desc);
-        if (target_method) {
-            installFrame(context, target_class, *target_method, args);
-        } else {
-            fmt::print("invokestatic invaid method");
-            exit(1);
-        }
+        // 解析过且类已初始化的调用点直接调用，不再经过load_class
+        const MethodInfo* target_method = cf.resolved_static_methods[idx].load(std::memory_order_acquire);
+        if (!target_method) target_method = &interp.resolve_static_method(cf, idx);
+        invoke_method(context, cur_frame, *target_method->owner, *target_method, count_method_arg_slots(target_method->descriptor), interp);
     };
     // invokeinterface
     opcode_table[0xb9] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
@@ -1347,10 +1442,12 @@ void Interpreter::init_opcode_table() {
         uint16_t idx = (static_cast<uint16_t>(code[pc]) << 8) | code[pc+1]; // 常量池索引（2字节，大端序）
         pc += 2;
 
-        std::string class_name = cf.constant_pool.get_class_name(idx);
-        RefT obj_ref = interp.new_object(class_name);
+        // 解析过且类已初始化的new只需按实例模板分配
+        const Klass* klass = cf.resolved_classes[idx].load(std::memory_order_acquire);
+        if (!klass) klass = &interp.resolve_class(cf, idx);
+        RefT obj_ref = interp.new_object(*klass);
         cur_frame.operand_stack.push(obj_ref);
-        fmt::print("alloc new object {} for class {}\n", obj_ref, class_name);
+        fmt::print("alloc new object {} for class {}\n", obj_ref, klass->name);
     };
     // invokedynamic
     opcode_table[0xba] = [](JVMContext& context, Frame&, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
@@ -1361,7 +1458,7 @@ void Interpreter::init_opcode_table() {
     opcode_table[0xbc] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter& interp) {
         uint8_t atype = code[pc++];
         IntT count = cur_frame.operand_stack.pop_int();
-        if (count < 0) { fmt::print("newarray: NegativeArraySizeException size={}\n", count); exit(1); }
+        if (count < 0) throw JavaRuntimeError("java/lang/NegativeArraySizeException");
         size_t width = 1; std::string elem_type;
         switch (atype) {
             case 4: elem_type = "Z"; break; // boolean
@@ -1374,9 +1471,7 @@ void Interpreter::init_opcode_table() {
             case 11: elem_type = "J"; width = 2; break; // long
             default: fmt::print("newarray: unsupported atype {}\n", (int)atype); exit(1);
         }
-        JVMArray arr(elem_type, (size_t)count, width);
-        RefT ref = (RefT)interp.array_pool.size() + 1;
-        interp.array_pool.emplace(ref, std::move(arr));
+        RefT ref = interp.new_array(*interp.primitive_array_klasses[atype], (size_t)count, width);
         cur_frame.operand_stack.push_ref(ref);
         fmt::print("newarray: type {} size {} => ref {}\n", elem_type, count, ref);
     };
@@ -1384,12 +1479,15 @@ void Interpreter::init_opcode_table() {
     opcode_table[0xbd] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
         uint16_t idx = (static_cast<uint16_t>(code[pc]) << 8) | code[pc+1];
         pc += 2;
-        std::string element_class_name = cf.constant_pool.get_class_name(idx);
         IntT count = cur_frame.operand_stack.pop_int();
-        if (count < 0) { fmt::print("anewarray: NegativeArraySizeException size={}\n", count); exit(1); }
-        RefT array_ref = interp.new_reference_array(element_class_name, (size_t)count);
+        if (count < 0) throw JavaRuntimeError("java/lang/NegativeArraySizeException");
+        // 元素类型不需要初始化，new已解析过同一常量池项时直接使用其结果
+        const Klass* element = cf.resolved_classes[idx].load(std::memory_order_acquire);
+        if (!element) element = &interp.klass(cf.constant_pool.get_class_name(idx));
+        const Klass& array_klass = interp.class_loader.array_klass(*element);
+        RefT array_ref = interp.new_array(array_klass, (size_t)count, 1);
         cur_frame.operand_stack.push_ref(array_ref);
-        fmt::print("anewarray: type {} size {} => ref {}\n", element_class_name, count, array_ref);
+        fmt::print("anewarray: type {} size {} => ref {}\n", array_klass.name, count, array_ref);
     };
     // arraylength
     opcode_table[0xbe] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
@@ -1399,54 +1497,45 @@ void Interpreter::init_opcode_table() {
         fmt::print("arraylength: arrayref={} len={}\n", arrayref, (int)arr.len);
     };
     // athrow
-    opcode_table[0xbf] = [](JVMContext& context, Frame&, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
-        fmt::print("athrow not implemented\n");
-        exit(1);
+    opcode_table[0xbf] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
+        RefT ref = cur_frame.operand_stack.pop_ref();
+        // 抛出null时，读取类名触发隐式null检查，改为抛出NullPointerException
+        fmt::print("athrow: {} ({})\n", ref, interp.get_object(ref).klass->name);
+        interp.fill_in_stack_trace(context, ref, false);
+        throw JavaThrowable(ref);
     };
     // checkcast
-    opcode_table[0xc0] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter&) {
-        size_t idx = (((uint16_t)code[pc]) << 8) | (uint16_t)code[pc+1];
+    opcode_table[0xc0] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
+        RefT objref = cur_frame.operand_stack.stack.back();
+        size_t bci = pc - 1;
         pc += 2;
-        fmt::print("checkcast: idx={}\n", idx);
-        // TODO: 实现类型检查
+        // null可以转换为任何引用类型
+        if (objref != NULL_REF && !interp.passes_type_check(cur_frame, bci, objref)) {
+            throw JavaRuntimeError("java/lang/ClassCastException");
+        }
+        fmt::print("checkcast: {}\n", objref);
     };
     // instanceof
-    opcode_table[0xc1] = [](JVMContext& context, Frame&, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
-        fmt::print("instanceof not implemented\n");
-        exit(1);
+    opcode_table[0xc1] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
+        RefT objref = cur_frame.operand_stack.pop_ref();
+        size_t bci = pc - 1;
+        pc += 2;
+        IntT result = objref != NULL_REF && interp.passes_type_check(cur_frame, bci, objref) ? 1 : 0;
+        cur_frame.operand_stack.push_int(result);
+        fmt::print("instanceof: {} => {}\n", objref, result);
     };
     // monitorenter
     opcode_table[0xc2] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
         RefT objref = cur_frame.operand_stack.pop_ref();
-        // if (objref == 0 || objref == (RefT)-1) {
-        //     fmt::print("monitorenter: NullPointerException (objref={})\n", objref);
-        //     exit(1);
-        // }
-        auto it = interp.object_monitor_info.find(objref);
-        if (it == interp.object_monitor_info.end()) {
-            interp.object_monitor_info.emplace(objref, Monitor{objref});
-            it = interp.object_monitor_info.find(objref);
-        }
-        it->second.count += 1;
-        fmt::print("monitorenter: objref={} count={}\n", objref, it->second.count);
+        // null由访问锁字时的隐式null检查处理
+        monitor_enter(interp.get_object(objref));
+        fmt::print("monitorenter: objref={}\n", objref);
     };
     // monitorexit
     opcode_table[0xc3] = [](JVMContext& context, Frame& cur_frame, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter& interp) {
         RefT objref = cur_frame.operand_stack.pop_ref();
-        // if (objref == 0 || objref == (RefT)-1) {
-        //     fmt::print("monitorexit: NullPointerException (objref={})\n", objref);
-        //     exit(1);
-        // }
-        auto it = interp.object_monitor_info.find(objref);
-        if (it == interp.object_monitor_info.end() || it->second.count <= 0) {
-            fmt::print("monitorexit: IllegalMonitorStateException (objref={})\n", objref);
-            exit(1);
-        }
-        it->second.count -= 1;
-        fmt::print("monitorexit: objref={} count={}\n", objref, it->second.count);
-        if (it->second.count == 0) {
-            interp.object_monitor_info.erase(it);
-        }
+        if (!monitor_exit(interp.get_object(objref))) throw JavaRuntimeError("java/lang/IllegalMonitorStateException");
+        fmt::print("monitorexit: objref={}\n", objref);
     };
     // wide
     opcode_table[0xc4] = [](JVMContext& context, Frame&, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
@@ -1454,9 +1543,18 @@ void Interpreter::init_opcode_table() {
         exit(1);
     };
     // multianewarray
-    opcode_table[0xc5] = [](JVMContext& context, Frame&, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&) {
-        fmt::print("multianewarray not implemented\n");
-        exit(1);
+    opcode_table[0xc5] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
+        uint16_t idx = (static_cast<uint16_t>(code[pc]) << 8) | code[pc+1];
+        uint8_t dims = code[pc+2];
+        pc += 3;
+        const std::string& descriptor = cf.constant_pool.get_class_name(idx);
+        std::vector<IntT> counts(dims);
+        for (size_t i = dims; i-- > 0;) {
+            counts[i] = cur_frame.operand_stack.pop_int();
+        }
+        RefT array_ref = interp.new_multi_array(descriptor, counts);
+        cur_frame.operand_stack.push_ref(array_ref);
+        fmt::print("multianewarray: type {} dims {} => ref {}\n", descriptor, dims, array_ref);
     };
     // ifnull
     opcode_table[0xc6] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter&) {
@@ -1504,97 +1602,724 @@ void Interpreter::init_opcode_table() {
     };
 }
 
-std::optional<SlotT> Interpreter::_execute(JVMContext& context, ClassInfo& entry_class, const MethodInfo& entry_method, const std::vector<SlotT>& entry_args) {
-    if (opcode_table.empty()) init_opcode_table();
+void Interpreter::init_super_table() {
+    super_table.resize(SUPER_COUNT);
+    // iload x; iload y; <iop>; istore z
+    super_table[SUPER_ILOAD_ILOAD_IOP_ISTORE] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter&) {
+        size_t bci = pc - 1;
+        size_t second = bci + instruction_length(code, bci);
+        size_t third = second + instruction_length(code, second);
+        uint32_t v1 = (uint32_t)(IntT)cur_frame.local_vars[int_load_index(code, bci)];
+        uint32_t v2 = (uint32_t)(IntT)cur_frame.local_vars[int_load_index(code, second)];
+        uint32_t result;
+        switch (code[third]) {
+        case 0x60: result = v1 + v2; break;
+        case 0x64: result = v1 - v2; break;
+        case 0x68: result = v1 * v2; break;
+        case 0x7e: result = v1 & v2; break;
+        case 0x80: result = v1 | v2; break;
+        default: result = v1 ^ v2; break;
+        }
+        int dst = int_store_index(code, third + 1);
+        cur_frame.local_vars[dst] = (IntT)result;
+        pc = third + 1 + instruction_length(code, third + 1);
+        fmt::print("{} fused: local{} = {}\n", opcode_name(code[third]), dst, (IntT)result);
+    };
+    // iload x; iload y; if_icmp<cond>
+    super_table[SUPER_ILOAD_ILOAD_IF_ICMP] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter&) {
+        size_t bci = pc - 1;
+        size_t second = bci + instruction_length(code, bci);
+        size_t third = second + instruction_length(code, second);
+        IntT v1 = cur_frame.local_vars[int_load_index(code, bci)];
+        IntT v2 = cur_frame.local_vars[int_load_index(code, second)];
+        bool taken;
+        switch (code[third]) {
+        case 0x9f: taken = v1 == v2; break;
+        case 0xa0: taken = v1 != v2; break;
+        case 0xa1: taken = v1 < v2; break;
+        case 0xa2: taken = v1 >= v2; break;
+        case 0xa3: taken = v1 > v2; break;
+        default: taken = v1 <= v2; break;
+        }
+        int16_t offset = (int16_t)((code[third + 1] << 8) | code[third + 2]);
+        pc = taken ? (size_t)((int)third + offset) : third + 3;
+        fmt::print("{} fused: {} {} taken={}\n", opcode_name(code[third]), v1, v2, taken);
+    };
+    // aload_0; getfield
+    super_table[SUPER_ALOAD_0_GETFIELD] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
+        uint16_t idx = (code[pc + 1] << 8) | code[pc + 2];
+        pc += 3;
+        const FieldInfo* field = cf.resolved_fields[idx].load(std::memory_order_acquire);
+        if (!field) field = &interp.resolve_field(cf, idx);
+        RefT obj_ref = cur_frame.local_vars[0];
+        const SlotT* slots = interp.field_slots(obj_ref, *field);
+        cur_frame.operand_stack.push(slots[0]);
+        if (field->width == 2) cur_frame.operand_stack.push(slots[1]);
+        fmt::print("getfield fused: get obj:{} field:{} val:{}\n", obj_ref, field->name, slots[0]);
+    };
+    // iinc; goto
+    super_table[SUPER_IINC_GOTO] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter&) {
+        size_t idx = code[pc];
+        cur_frame.local_vars[idx] += (IntT)(int8_t)code[pc + 1];
+        int16_t offset = (int16_t)((code[pc + 3] << 8) | code[pc + 4]);
+        pc = (size_t)((int)pc + 2 + offset); // goto位于pc+2
+    };
+    // 计数循环中已证明下标不越界的xaload
+    super_table[SUPER_ARRAY_LOAD_UNCHECKED] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter& interp) {
+        OpCodeT opcode = code[pc - 1];
+        PROFILE_OPCODE(opcode);
+        IntT index = cur_frame.operand_stack.pop_int();
+        RefT arrayref = cur_frame.operand_stack.pop_ref();
+        JVMArray& arr = interp.get_array(arrayref);
+        switch (opcode) {
+        case 0x2f: case 0x31: { // laload daload
+            cur_frame.operand_stack.push_long((LongT)arr.get_twoslot_unchecked(index));
+            break;
+        }
+        case 0x33: cur_frame.operand_stack.push_int((ByteT)arr.get_slot_unchecked(index)); break;  // baload
+        case 0x34: cur_frame.operand_stack.push_int((CharT)arr.get_slot_unchecked(index)); break;  // caload
+        case 0x35: cur_frame.operand_stack.push_int((ShortT)arr.get_slot_unchecked(index)); break; // saload
+        default: cur_frame.operand_stack.push(arr.get_slot_unchecked(index)); break;               // iaload faload aaload
+        }
+        fmt::print("{} unchecked: arrayref={}, index={}\n", opcode_name(opcode), arrayref, index);
+    };
+    // 计数循环中已证明下标不越界的xastore
+    super_table[SUPER_ARRAY_STORE_UNCHECKED] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo&, Interpreter& interp) {
+        OpCodeT opcode = code[pc - 1];
+        PROFILE_OPCODE(opcode);
+        if (opcode == 0x50 || opcode == 0x52) { // lastore dastore
+            TwoSlotT value = (TwoSlotT)cur_frame.operand_stack.pop_long();
+            IntT index = cur_frame.operand_stack.pop_int();
+            RefT arrayref = cur_frame.operand_stack.pop_ref();
+            interp.get_array(arrayref).put_twoslot_unchecked(index, value);
+            fmt::print("{} unchecked: arrayref={}, index={}\n", opcode_name(opcode), arrayref, index);
+            return;
+        }
+        SlotT value = cur_frame.operand_stack.pop();
+        IntT index = cur_frame.operand_stack.pop_int();
+        RefT arrayref = cur_frame.operand_stack.pop_ref();
+        switch (opcode) {
+        case 0x54: value = (SlotT)(ByteT)value; break;  // bastore
+        case 0x55: value = (SlotT)(CharT)value; break;  // castore
+        case 0x56: value = (SlotT)(ShortT)value; break; // sastore
+        default: break;
+        }
+        interp.get_array(arrayref).put_slot_unchecked(index, value);
+        fmt::print("{} unchecked: arrayref={}, index={}, value={}\n", opcode_name(opcode), arrayref, index, (IntT)value);
+    };
+    // 向量化循环的循环头：SIMD核执行完剩余的迭代后，原来的循环头比较直接退出循环
+    super_table[SUPER_VECTOR_LOOP] = [](JVMContext& context, Frame& cur_frame, size_t& pc, const std::vector<uint8_t>& code, const ClassInfo& cf, Interpreter& interp) {
+        size_t bci = pc - 1;
+        const VectorLoop& loop = cur_frame.method_info.vector_loop_at(bci);
+        IntT from = (IntT)cur_frame.local_vars[loop.index];
+        if (run_vector_loop(loop, cur_frame, interp)) {
+            fmt::print("[vector] loop at {} ran iterations {}..{}\n", bci, from, (IntT)cur_frame.local_vars[loop.index]);
+        }
+        if (loop.replaced != SUPER_NONE) {
+            interp.super_table[loop.replaced](context, cur_frame, pc, code, cf, interp);
+        } else {
+            PROFILE_OPCODE(code[bci]);
+            interp.opcode_table[code[bci]](context, cur_frame, pc, code, cf, interp);
+        }
+    };
+}
+
+std::optional<TwoSlotT> Interpreter::_execute(JVMContext& context, ClassInfo& entry_class, const MethodInfo& entry_method, const std::vector<SlotT>& entry_args) {
+    if ((entry_method.access_flags & ACC_NATIVE) != 0) {
+        // native入口方法直接调用，不创建Frame
+        if (!entry_method.native_func) {
+            fmt::print("Native method {}{} not implemented\n", entry_method.name, entry_method.descriptor);
+            exit(1);
+        }
+        NativeValue ret = entry_method.native_func(NativeArgs{entry_args.data(), entry_args.size()}, *this);
+        if (ret.kind == NativeValue::VOID) return {};
+        // long/double返回完整的64位，单槽位的值只取低32位
+        return ret.kind == NativeValue::TWO_SLOT ? ret.bits : static_cast<SlotT>(ret.bits);
+    }
+    JVMContext* outer_context = JVMContext::current;
+    JVMContext::current = &context;
     installFrame(context, entry_class, entry_method, entry_args);
-    while (!context.empty()) {
+    try {
+        if ((entry_method.access_flags & ACC_SYNCHRONIZED) != 0) enter_method_monitor(context.current_frame());
+        run(context, 0);
+    } catch (...) {
+        JVMContext::current = outer_context;
+        throw;
+    }
+    JVMContext::current = outer_context;
+    return {};
+}
+
+void Interpreter::run(JVMContext& context, size_t base_depth) {
+    // 异常处理只在抛出时发生，正常执行不经过这里的任何代码
+    while (true) {
+        RefT throwable;
+        try {
+            interpret(context, base_depth);
+            return;
+        } catch (const JavaThrowable& e) {
+            throwable = e.ref;
+        } catch (const JavaRuntimeError& e) {
+            throwable = new_object(e.class_name);
+            fmt::print("[exception] throw {}\n", e.class_name);
+            fill_in_stack_trace(context, throwable);
+        }
+        if (!unwind(context, throwable, base_depth)) throw JavaThrowable(throwable);
+    }
+}
+
+bool Interpreter::unwind(JVMContext& context, RefT throwable, size_t base_depth) {
+    const Klass& thrown = *get_object(throwable).klass;
+    const std::string& class_name = thrown.name;
+    class_loader.link_supers(thrown);
+    auto catches = [&](const ClassInfo& cf, uint16_t catch_type) {
+        const Klass& handler_klass = klass(cf.constant_pool.get_class_name(catch_type));
+        class_loader.link_supers(handler_klass);
+        return is_subtype_of(thrown, handler_klass);
+    };
+    while (context.call_stack.size() > base_depth) {
+        Frame& frame = context.current_frame();
+        const MethodInfo& method = frame.method_info;
+        // pc已越过抛出异常的指令的操作码（调用者帧中为调用指令的下一条），pc-1落在该指令内
+        const HandlerRange* range = frame.pc > 0 ? method.handlers_at(frame.pc - 1) : nullptr;
+        for (size_t k = 0; range && k < range->count; ++k) {
+            const ExceptionTable& entry = method.exception_table[method.handlers[range->first + k]];
+            if (entry.catch_type == 0 || catches(frame.class_info, entry.catch_type)) {
+                frame.operand_stack.stack.clear();
+                frame.operand_stack.push_ref(throwable);
+                frame.pc = entry.handler_pc;
+                fmt::print("[exception] {} caught in {} at {}\n", class_name, method.name, entry.handler_pc);
+                return true;
+            }
+        }
+        // 异常离开同步方法时释放其锁（JVMS §2.11.10），当前线程已不持有时忽略
+        if (frame.monitor != NULL_REF) monitor_exit(get_object(frame.monitor));
+        context.pop_frame();
+    }
+    return false;
+}
+
+void Interpreter::interpret(JVMContext& context, size_t base_depth) {
+    bool jit_resume = false; // 刚从编译代码退出，当前指令必须解释执行
+    while (context.call_stack.size() > base_depth) {
         Frame& cur_frame = context.current_frame();
         auto &pc = cur_frame.pc;
         auto &code = cur_frame.method_info.code;
         auto &classinfo = cur_frame.class_info;
         auto &methodinfo = cur_frame.method_info;
+        if (pc == 0 && !jit_resume && jit.enabled()) { // 方法入口
+            uint32_t invocations = methodinfo.invocation_count.fetch_add(1, std::memory_order_relaxed) + 1;
+            const JitCode* opt_code = methodinfo.opt_code.load(std::memory_order_acquire);
+            if (!opt_code && jit.should_optimize(methodinfo, invocations)) {
+                jit.compile_optimized(classinfo, methodinfo, class_loader);
+                opt_code = methodinfo.opt_code.load(std::memory_order_acquire);
+            }
+            // 第二层代码只能从空操作数栈进入
+            const JitCode* jit_code = opt_code && cur_frame.operand_stack.stack.empty() ? opt_code : methodinfo.jit_code.load(std::memory_order_acquire);
+            if (!jit_code && invocations >= jit.invocation_threshold() && !methodinfo.jit_failed.load(std::memory_order_relaxed)) {
+                jit.compile(classinfo, methodinfo);
+                jit_code = methodinfo.jit_code.load(std::memory_order_acquire);
+            }
+            if (jit_code) {
+                jit_run(context, cur_frame, *jit_code);
+                jit_resume = true;
+                continue;
+            }
+        }
+        if (!jit_resume && register_vm) {
+            const RegisterCode* reg_code = register_code(classinfo, methodinfo);
+            if (reg_code && reg_code->can_enter(pc, cur_frame.operand_stack.stack.size())) {
+                // 退出处的指令由解释器执行
+                jit_resume = true;
+                if (reg_run(cur_frame, *reg_code)) {
+                    uint32_t backedges = methodinfo.backedge_count.load(std::memory_order_relaxed);
+                    if (const JitCode* osr_code = jit.osr_entry(classinfo, methodinfo, (uint32_t)pc, class_loader, backedges)) {
+                        jit_run(context, cur_frame, *osr_code);
+                    } else {
+                        jit_resume = false; // 循环头可以直接回到寄存器代码
+                    }
+                }
+                continue;
+            }
+        }
+        jit_resume = false;
         auto &cp = classinfo.constant_pool;
         auto &class_name = classinfo.constant_pool.get_class_name(classinfo.this_class);
         auto &method_name = methodinfo.name;
         auto &method_desc = methodinfo.descriptor;
         fmt::print("[execute className:{} method: {}] ", class_name, method_name);
 
-        // 检查native方法
-        if ((cur_frame.method_info.access_flags & ACC_NATIVE) != 0) {
-            // native method
-            auto func = find_native(class_name, method_name, method_desc);
-            if (func) {
-                std::optional<SlotT> ret = func(cur_frame, *this);
-                context.pop_frame();
-                if (ret) {
-                    context.current_frame().operand_stack.push(ret.value());
+        if (pc >= code.size()) {
+            fmt::print("pc reach code end but no return");
+            exit(1);
+        }
+        size_t depth = context.call_stack.size();
+        size_t bci = pc;
+        OpCodeT opcode = code[pc++];
+        fmt::print("pc 0x{:x} op 0x{:x} \n", pc, opcode);
+        const auto& supers = methodinfo.superinstructions;
+        if (!supers.empty() && supers[bci] != SUPER_NONE) {
+            super_table[supers[bci]](context, cur_frame, pc, code, classinfo, *this);
+        } else {
+            PROFILE_OPCODE(opcode);
+            opcode_table[opcode](context, cur_frame, pc, code, classinfo, *this);
+        }
+        cur_frame.pc = pc;
+        // 回边：当前帧仍在栈顶且跳转到了前面的指令。计数超过阈值后从循环头转入编译代码（OSR）
+        if (context.call_stack.size() == depth && pc <= bci && jit.enabled()) {
+            uint32_t backedges = methodinfo.backedge_count.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (backedges >= jit.backedge_threshold()) {
+                if (const JitCode* osr_code = jit.osr_entry(classinfo, methodinfo, (uint32_t)pc, class_loader, backedges)) {
+                    jit_run(context, cur_frame, *osr_code);
+                    jit_resume = true;
                 }
-            } else {
-                fmt::print("Native method {}.{}{} not implemented\n", class_name, method_name, method_desc);
-                exit(1);
             }
-        } else {
-            // normal method
-            if (pc >= code.size()) {
-                fmt::print("pc reach code end but no return");
-                exit(1);
+        }
+    }
+}
+
+const RegisterCode* Interpreter::register_code(const ClassInfo& class_info, const MethodInfo& method) {
+    if (const RegisterCode* code = method.reg_code.load(std::memory_order_acquire)) return code;
+    if (method.reg_failed.load(std::memory_order_relaxed)) return nullptr;
+    std::lock_guard<std::mutex> lock(reg_mutex);
+    if (const RegisterCode* code = method.reg_code.load(std::memory_order_acquire)) return code;
+    if (method.reg_failed.load(std::memory_order_relaxed)) return nullptr;
+    std::string name = class_info.constant_pool.get_class_name(class_info.this_class) + "." + method.name + method.descriptor;
+    std::string reason;
+    std::unique_ptr<RegisterCode> code = translate_register_code(class_info, method, reason);
+    if (!code) {
+        fmt::print("[regvm] cannot translate {}: {}\n", name, reason);
+        method.reg_failed.store(true, std::memory_order_relaxed);
+        return nullptr;
+    }
+    fmt::print("[regvm] translated {}: {} bytes of bytecode -> {} register instructions, {} registers\n",
+               name, method.code.size(), code->insts.size(), code->num_regs);
+    method.reg_code.store(code.get(), std::memory_order_release);
+    reg_codes.push_back(std::move(code));
+    return reg_codes.back().get();
+}
+
+bool Interpreter::reg_run(Frame& frame, const RegisterCode& reg_code) {
+    // 寄存器代码执行到退出为止，不会嵌套，每个线程一份寄存器数组
+    static thread_local std::vector<SlotT> regs;
+    auto& locals = frame.local_vars.vars;
+    auto& stack = frame.operand_stack.stack;
+    regs.resize(reg_code.num_regs);
+    std::copy(locals.begin(), locals.end(), regs.begin());
+    std::copy(stack.begin(), stack.end(), regs.begin() + reg_code.num_locals);
+    std::copy(reg_code.constants.begin(), reg_code.constants.end(), regs.begin() + reg_code.num_locals + reg_code.num_stack);
+    SlotT* r = regs.data();
+    auto get_long = [r](uint16_t i) { return (LongT)(((uint64_t)r[i] << 32) | r[i + 1]); };
+    auto set_long = [r](uint16_t i, LongT v) {
+        r[i] = (SlotT)((uint64_t)v >> 32);
+        r[i + 1] = (SlotT)(uint64_t)v;
+    };
+    const uint32_t hot = std::max<uint32_t>(jit.backedge_threshold(), 1);
+    const std::vector<RInst>& insts = reg_code.insts;
+    size_t ip = reg_code.entries[frame.pc];
+    uint32_t exit_bci = 0;
+    uint16_t exit_depth = 0;
+    bool hot_exit = false;
+    bool running = true;
+    auto exit_at = [&](uint32_t bci, uint16_t depth) {
+        exit_bci = bci;
+        exit_depth = depth;
+        running = false;
+    };
+    auto jump = [&](const RInst& in) {
+        // 回边计数达到阈值（及其10倍，第二层）时在循环头退出，由解释器转入编译代码
+        if (in.backward && jit.enabled()) {
+            uint32_t backedges = frame.method_info.backedge_count.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (backedges == hot || backedges == hot * 10) {
+                hot_exit = true;
+                exit_at(in.target, reg_code.entry_depth[in.target]);
+                return;
             }
-            OpCodeT opcode = code[pc++];
-            fmt::print("pc 0x{:x} op 0x{:x} \n", pc, opcode);
-            opcode_table[opcode](context, cur_frame, pc, code, classinfo, *this);
-            cur_frame.pc = pc;
+        }
+        ip = (size_t)in.imm;
+    };
+    while (running) {
+        const RInst& in = insts[ip++];
+        switch (in.op) {
+        case ROp::Mov: r[in.a] = r[in.b]; break;
+        // int运算按32位补码回绕
+        case ROp::IAdd: r[in.a] = r[in.b] + r[in.c]; break;
+        case ROp::ISub: r[in.a] = r[in.b] - r[in.c]; break;
+        case ROp::IMul: r[in.a] = r[in.b] * r[in.c]; break;
+        case ROp::IDiv: case ROp::IRem: {
+            IntT v1 = (IntT)r[in.b];
+            IntT v2 = (IntT)r[in.c];
+            if (v2 == 0) { // 由解释器执行这条指令
+                exit_at(in.bci, in.depth);
+                break;
+            }
+            if (in.op == ROp::IDiv) r[in.a] = v2 == -1 ? 0u - (SlotT)v1 : (SlotT)(v1 / v2);
+            else r[in.a] = v2 == -1 ? 0 : (SlotT)(v1 % v2);
+            break;
+        }
+        case ROp::IAnd: r[in.a] = r[in.b] & r[in.c]; break;
+        case ROp::IOr: r[in.a] = r[in.b] | r[in.c]; break;
+        case ROp::IXor: r[in.a] = r[in.b] ^ r[in.c]; break;
+        case ROp::IShl: r[in.a] = r[in.b] << (r[in.c] & 0x1f); break;
+        case ROp::IShr: r[in.a] = (SlotT)((IntT)r[in.b] >> (r[in.c] & 0x1f)); break;
+        case ROp::IUshr: r[in.a] = r[in.b] >> (r[in.c] & 0x1f); break;
+        case ROp::INeg: r[in.a] = 0u - r[in.b]; break;
+        case ROp::LAdd: set_long(in.a, (LongT)((uint64_t)get_long(in.b) + (uint64_t)get_long(in.c))); break;
+        case ROp::LSub: set_long(in.a, (LongT)((uint64_t)get_long(in.b) - (uint64_t)get_long(in.c))); break;
+        case ROp::LMul: set_long(in.a, (LongT)((uint64_t)get_long(in.b) * (uint64_t)get_long(in.c))); break;
+        case ROp::LDiv: case ROp::LRem: {
+            LongT v1 = get_long(in.b);
+            LongT v2 = get_long(in.c);
+            if (v2 == 0) {
+                exit_at(in.bci, in.depth);
+                break;
+            }
+            if (in.op == ROp::LDiv) set_long(in.a, v2 == -1 ? (LongT)(0 - (uint64_t)v1) : v1 / v2);
+            else set_long(in.a, v2 == -1 ? 0 : v1 % v2);
+            break;
+        }
+        case ROp::LAnd: set_long(in.a, get_long(in.b) & get_long(in.c)); break;
+        case ROp::LOr: set_long(in.a, get_long(in.b) | get_long(in.c)); break;
+        case ROp::LXor: set_long(in.a, get_long(in.b) ^ get_long(in.c)); break;
+        case ROp::LShl: set_long(in.a, (LongT)((uint64_t)get_long(in.b) << (r[in.c] & 0x3f))); break;
+        case ROp::LShr: set_long(in.a, get_long(in.b) >> (r[in.c] & 0x3f)); break;
+        case ROp::LUshr: set_long(in.a, (LongT)((uint64_t)get_long(in.b) >> (r[in.c] & 0x3f))); break;
+        case ROp::LNeg: set_long(in.a, (LongT)(0 - (uint64_t)get_long(in.b))); break;
+        case ROp::I2L: set_long(in.a, (IntT)r[in.b]); break;
+        case ROp::L2I: r[in.a] = r[in.b + 1]; break;
+        case ROp::I2B: r[in.a] = (SlotT)(IntT)(int8_t)r[in.b]; break;
+        case ROp::I2C: r[in.a] = (SlotT)(uint16_t)r[in.b]; break;
+        case ROp::I2S: r[in.a] = (SlotT)(IntT)(int16_t)r[in.b]; break;
+        case ROp::LCmp: {
+            LongT v1 = get_long(in.b);
+            LongT v2 = get_long(in.c);
+            r[in.a] = (SlotT)(v1 < v2 ? -1 : v1 > v2 ? 1 : 0);
+            break;
+        }
+        case ROp::IInc: r[in.a] += (SlotT)in.imm; break;
+        case ROp::If: {
+            IntT v1 = (IntT)r[in.b];
+            IntT v2 = (IntT)r[in.c];
+            bool taken;
+            switch (in.cond) {
+            case RC_EQ: taken = v1 == v2; break;
+            case RC_NE: taken = v1 != v2; break;
+            case RC_LT: taken = v1 < v2; break;
+            case RC_GE: taken = v1 >= v2; break;
+            case RC_GT: taken = v1 > v2; break;
+            default: taken = v1 <= v2; break;
+            }
+            if (taken) jump(in);
+            break;
+        }
+        case ROp::Goto: jump(in); break;
+        case ROp::Exit: exit_at(in.bci, in.depth); break;
         }
     }
-    return {};
+    std::copy(regs.begin(), regs.begin() + locals.size(), locals.begin());
+    stack.assign(regs.begin() + reg_code.num_locals, regs.begin() + reg_code.num_locals + exit_depth);
+    frame.pc = exit_bci;
+    return hot_exit;
+}
+
+void Interpreter::interpret_one(JVMContext& context, Frame& frame, size_t bci) {
+    size_t depth = context.call_stack.size();
+    const auto& code = frame.method_info.code;
+    size_t pc = bci + 1;
+    frame.pc = bci;
+    opcode_table[code[bci]](context, frame, pc, code, frame.class_info, *this);
+    frame.pc = pc;
+    run(context, depth);
+}
+
+void Interpreter::jit_run(JVMContext& context, Frame& frame, const JitCode& jit_code) {
+    auto& stack = frame.operand_stack.stack;
+    JitFrameState state{};
+    state.locals = frame.local_vars.vars.data();
+    state.sp = stack.size();
+    state.frame = &frame;
+    state.context = &context;
+    state.interp = this;
+    stack.resize(std::max<size_t>(frame.method_info.max_stack, state.sp));
+    state.stack = stack.data();
+    jit_code.run(state, frame.pc);
+    stack.resize(state.sp);
+    frame.pc = state.bci;
+    if (state.pending) {
+        // 与解释器一致：pc越过抛出异常的指令的操作码，用于查找异常处理器
+        frame.pc = state.bci + 1;
+        std::rethrow_exception(state.pending);
+    }
+}
+
+void Interpreter::run_class_initializer(ClassInfo& cf, const MethodInfo& clinit) {
+    try {
+        execute_method(cf, clinit, {});
+    } catch (const JavaThrowable& e) {
+        const Klass& thrown = *get_object(e.ref).klass;
+        const Klass& error = klass("java/lang/Error");
+        class_loader.link_supers(thrown);
+        class_loader.link_supers(error);
+        if (is_subtype_of(thrown, error)) throw;
+        fmt::print("[exception] {} in <clinit> of {}\n", thrown.name, cf.klass->name);
+        RefT wrapped = new_object("java/lang/ExceptionInInitializerError");
+        if (JVMContext::current) fill_in_stack_trace(*JVMContext::current, wrapped);
+        throw JavaThrowable(wrapped);
+    }
 }
 
-// 分配新对象，返回对象引用（索引）
-RefT Interpreter::new_object(const std::string& class_name) {
-    JVMObject obj;
-    obj.class_name = class_name;
-    object_pool.push_back(obj);
-    return object_pool.size() - 1; // 返回对象在池中的索引
+RefT Interpreter::class_mirror(const Klass& klass) {
+    RefT mirror = klass.mirror.load(std::memory_order_acquire);
+    if (mirror == NULL_REF) {
+        RefT created = new_object("java/lang/Class");
+        if (klass.mirror.compare_exchange_strong(mirror, created, std::memory_order_acq_rel)) mirror = created;
+    }
+    return mirror;
+}
+
+void Interpreter::enter_method_monitor(Frame& frame) {
+    const MethodInfo& method = frame.method_info;
+    RefT lock = (method.access_flags & ACC_STATIC) != 0 ? class_mirror(*frame.class_info.klass) : frame.local_vars[0];
+    monitor_enter(get_object(lock));
+    frame.monitor = lock;
 }
 
-// 设置对象字段
-void Interpreter::put_field(RefT obj_ref, const std::string& field, SlotT value) {
-    if (obj_ref >= 0 && obj_ref < object_pool.size()) {
-        object_pool[obj_ref].fields[field] = value;
+void Interpreter::release_method_monitor(Frame& frame) {
+    RefT lock = frame.monitor;
+    frame.monitor = NULL_REF; // 抛出异常后展开时不再释放
+    if (!monitor_exit(get_object(lock))) throw JavaRuntimeError("java/lang/IllegalMonitorStateException");
+}
+
+bool Interpreter::passes_type_check(const Frame& frame, size_t bci, RefT obj_ref) {
+    const Klass& s = *get_object(obj_ref).klass;
+    const TypeCheckSite& site = frame.method_info.type_check_site_at(bci);
+    // 与上一次通过检查的类型相同时直接通过
+    if (site.last.load(std::memory_order_relaxed) == &s) return true;
+    const Klass* t = site.target.load(std::memory_order_acquire);
+    if (!t) {
+        t = &klass(frame.class_info.constant_pool.get_class_name(read_u2_from_code(frame.method_info.code, bci + 1)));
+        class_loader.link_supers(*t);
+        site.target.store(t, std::memory_order_release);
+    }
+    class_loader.link_supers(s);
+    if (!is_subtype_of(s, *t)) return false;
+    site.last.store(&s, std::memory_order_relaxed);
+    return true;
+}
+
+void Interpreter::fill_in_stack_trace(JVMContext& context, RefT throwable, bool overwrite) {
+    std::lock_guard<std::mutex> lock(backtrace_mutex);
+    auto [it, inserted] = backtraces.try_emplace(throwable);
+    if (!inserted && !overwrite) return;
+    it->second.clear();
+    for (auto frame = context.call_stack.rbegin(); frame != context.call_stack.rend(); ++frame) {
+        it->second.push_back({&frame->class_info, &frame->method_info, frame->pc});
+    }
+}
+
+std::vector<std::string> Interpreter::stack_trace(RefT throwable) {
+    std::vector<BacktraceEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(backtrace_mutex);
+        auto it = backtraces.find(throwable);
+        if (it == backtraces.end()) return {};
+        entries = it->second;
+    }
+    std::vector<std::string> lines;
+    for (const auto& entry : entries) {
+        // 记录的pc已越过当前指令的操作码，找出包含pc-1的指令的起点
+        const auto& code = entry.method->code;
+        size_t bci = 0;
+        while (entry.pc > 0 && bci + instruction_length(code, bci) < entry.pc) {
+            bci += instruction_length(code, bci);
+        }
+        std::string class_name = entry.class_info->constant_pool.get_class_name(entry.class_info->this_class);
+        std::replace(class_name.begin(), class_name.end(), '/', '.');
+        lines.push_back(fmt::format("{}.{}{} (bci {})", class_name, entry.method->name, entry.method->descriptor, bci));
     }
+    return lines;
 }
 
-// 获取对象字段
-SlotT Interpreter::get_field(RefT obj_ref, const std::string& field) {
-    if (obj_ref >= 0 && obj_ref < object_pool.size()) {
-        return object_pool[obj_ref].fields[field];
+void Interpreter::report_uncaught(RefT throwable, const std::string& thread_name) {
+    std::string class_name = get_object(throwable).klass->name;
+    std::replace(class_name.begin(), class_name.end(), '/', '.');
+    fmt::print("Exception in thread \"{}\" {}\n", thread_name, class_name);
+    for (const auto& line : stack_trace(throwable)) {
+        fmt::print("\tat {}\n", line);
+    }
+}
+
+// 解析实例字段引用（JVMS §5.4.3.2）：先在引用的类中查找，再依次查找父类。
+// 字段在对象中的位置在类初始化前已确定，解析结果总是记入cf的解析缓存
+const FieldInfo& Interpreter::resolve_field(const ClassInfo& cf, uint16_t index) {
+    const ConstantPoolInfo& fieldref = cf.constant_pool[index];
+    const std::string& class_name = cf.constant_pool.get_class_name(fieldref.fieldref_class_index);
+    auto [field_name, field_desc] = cf.constant_pool.get_name_and_type(fieldref.fieldref_name_type_index);
+    const ClassInfo* owner = &load_class(class_name);
+    while (true) {
+        for (const FieldInfo& field : owner->fields) {
+            if ((field.access_flags & ACC_STATIC) != 0 || field.name != field_name || field.descriptor != field_desc) continue;
+            cf.resolved_fields[index].store(&field, std::memory_order_release);
+            return field;
+        }
+        if (owner->super_class == 0) break;
+        std::string super_name = owner->constant_pool.get_class_name(owner->super_class);
+        if (super_name == "java/lang/Object") break;
+        owner = &load_class(super_name);
+    }
+    fmt::print("[resolve_field] 找不到实例字段:  {}.{} {}\n", class_name, field_name, field_desc);
+    exit(1);
+}
+
+// 解析new的类引用并初始化该类（JVMS §5.5）；该类已初始化时记入cf的解析缓存
+const Klass& Interpreter::resolve_class(const ClassInfo& cf, uint16_t index) {
+    const ClassInfo& cls = load_class(cf.constant_pool.get_class_name(index));
+    if (cls.init_state.load(std::memory_order_acquire) == ClassInitState::INITIALIZED) {
+        cf.resolved_classes[index].store(cls.klass, std::memory_order_release);
+    }
+    return *cls.klass;
+}
+
+// 解析静态字段引用（JVMS §5.4.3.2）：先在引用的类中查找，再依次查找父类；
+// 字段所属的类已初始化时记入cf的解析缓存，之后不再解析，正在初始化时（<clinit>中的访问）每次都重新解析
+const FieldInfo& Interpreter::resolve_static_field(const ClassInfo& cf, uint16_t index) {
+    const ConstantPoolInfo& fieldref = cf.constant_pool[index];
+    const std::string& class_name = cf.constant_pool.get_class_name(fieldref.fieldref_class_index);
+    auto [field_name, field_desc] = cf.constant_pool.get_name_and_type(fieldref.fieldref_name_type_index);
+    const ClassInfo* owner = &load_class(class_name);
+    while (true) {
+        for (const FieldInfo& field : owner->fields) {
+            if ((field.access_flags & ACC_STATIC) == 0 || field.name != field_name || field.descriptor != field_desc) continue;
+            if (owner->init_state.load(std::memory_order_acquire) == ClassInitState::INITIALIZED) {
+                cf.resolved_static_fields[index].store(&field, std::memory_order_release);
+            }
+            return field;
+        }
+        if (owner->super_class == 0) break;
+        std::string super_name = owner->constant_pool.get_class_name(owner->super_class);
+        if (super_name == "java/lang/Object") break;
+        owner = &load_class(super_name);
     }
-    return 0;
+    fmt::print("[resolve_static_field] 找不到静态字段:  {}.{} {}\n", class_name, field_name, field_desc);
+    exit(1);
 }
 
-// 获取类静态字段
-SlotT Interpreter::getstatic(const std::string& class_name, const std::string& field_name, const std::string& field_desc) {
-    const ClassInfo& cf = load_class(class_name);
-    auto iter = cf.staticVars.find(field_name);
-    if (iter ==  cf.staticVars.end()) {
-        fmt::print("[getstatic] 找不到静态字段:  {}.{} {}\n", class_name, field_name, field_desc);
+// 解析invokestatic的方法引用并初始化声明方法的类；该类已初始化时记入cf的解析缓存
+const MethodInfo& Interpreter::resolve_static_method(const ClassInfo& cf, uint16_t index) {
+    const ConstantPoolInfo& methodref = cf.constant_pool[index];
+    const std::string& class_name = cf.constant_pool.get_class_name(methodref.methodref_class_index);
+    auto [method_name, method_desc] = cf.constant_pool.get_name_and_type(methodref.methodref_name_type_index);
+    fmt::print("[invokestatic] classname:{} method_name:{} method_desc:{}\n", class_name, method_name, method_desc);
+    MethodInfo* method = find_method(load_class(class_name), method_name, method_desc);
+    if (!method) {
+        fmt::print("invokestatic invaid method");
         exit(1);
     }
-    auto& [k, v] = *iter;
-    fmt::print("[getstatic] static field {}.{}: {}\n", class_name, field_name, v);
-    return v;
+    if (method->owner->init_state.load(std::memory_order_acquire) == ClassInitState::INITIALIZED) {
+        cf.resolved_static_methods[index].store(method, std::memory_order_release);
+    }
+    return *method;
+}
+
+// 类初始化时先写入带ConstantValue属性的静态字段（JVMS §5.5第6步），再执行<clinit>
+void Interpreter::initialize_constant_fields(ClassInfo& cf) {
+    for (const FieldInfo& field : cf.fields) {
+        if ((field.access_flags & ACC_STATIC) == 0 || !field.has_constant_value) continue;
+        const ConstantPoolInfo& cpe = cf.constant_pool[field.constantvalue_index];
+        switch (cpe.tag) {
+        case ConstantType::INTEGER:
+        case ConstantType::FLOAT:
+            field.static_value[0].store(cpe.integerOrFloat, std::memory_order_relaxed);
+            break;
+        case ConstantType::LONG:
+        case ConstantType::DOUBLE:
+            field.static_value[0].store(cpe.longOrDouble_high_bytes, std::memory_order_relaxed);
+            field.static_value[1].store(cpe.longOrDouble_low_bytes, std::memory_order_relaxed);
+            break;
+        case ConstantType::STRING:
+            // 与ldc相同，字符串对象不带内容
+            field.static_value[0].store(new_object("java/lang/String"), std::memory_order_relaxed);
+            break;
+        default:
+            fmt::print("[initialize_constant_fields] 不支持的常量类型 tag={}\n", (int)cpe.tag);
+            exit(1);
+        }
+    }
 }
 
-// 赋值类静态字段
-void Interpreter::putstatic(const std::string& class_name, const std::string& field_name, const std::string& field_desc, SlotT value) {
+// 启动Java线程：每个线程有独立的JVMContext和调用栈
+void Interpreter::start_thread(RefT thread_ref) {
+    const std::string class_name = get_object(thread_ref).klass->name;
     ClassInfo& cf = load_class(class_name);
-    cf.staticVars[field_name] = value;
-    fmt::print("[putstatic] static field {}.{}: {}\n", class_name, field_name, value);
-    // auto iter = cf.staticVars.find(field_name);
-    // if (iter ==  cf.staticVars.end()) {
-    //     fmt::print("[putstatic] 找不到静态字段:  {}.{} {}\n", class_name, field_name, field_desc);
-    //     exit(1);
-    // }
-    // auto& [k, v] = *iter;
-    // v = value;
+    std::string declaring_class = class_name;
+    MethodInfo* run = find_method(cf, "run", "()V", &declaring_class);
+    if (!run) {
+        fmt::print("[start_thread] cannot find method {}.run()V\n", class_name);
+        exit(1);
+    }
+    ClassInfo& run_class = load_class(declaring_class);
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    auto& slot = threads[thread_ref];
+    if (slot) {
+        fmt::print("[start_thread] IllegalThreadStateException: thread {} already started\n", thread_ref);
+        exit(1);
+    }
+    slot = std::make_unique<JavaThread>();
+    JavaThread* thread = slot.get();
+    thread->thread_ref = thread_ref;
+    thread->os_thread = std::thread([this, thread, &run_class, run]() {
+        JVMContext context;
+        context.thread_ref = thread->thread_ref;
+        std::vector<SlotT> args{thread->thread_ref};
+        try {
+            _execute(context, run_class, *run, args);
+        } catch (const JavaThrowable& e) {
+            report_uncaught(e.ref, std::to_string(thread->thread_ref));
+        } catch (const std::exception& e) {
+            fmt::print("Exception in thread {}: {}\n", thread->thread_ref, e.what());
+        }
+        // 线程结束时唤醒在Thread.join()中等待该线程对象的线程
+        JVMObject& thread_obj = get_object(thread->thread_ref);
+        monitor_enter(thread_obj);
+        thread->alive.store(false, std::memory_order_release);
+        monitor_notify(thread_obj, true);
+        monitor_exit(thread_obj);
+    });
+    fmt::print("[start_thread] thread {} started\n", thread_ref);
+}
+
+bool Interpreter::is_thread_alive(RefT thread_ref) {
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    auto it = threads.find(thread_ref);
+    if (it == threads.end()) {
+        // 未经start_thread启动的线程中，只有当前线程（如主线程）是存活的
+        return JVMContext::current && JVMContext::current->thread_ref == thread_ref;
+    }
+    return it->second->alive.load(std::memory_order_acquire);
+}
+
+RefT Interpreter::current_thread() {
+    JVMContext* context = JVMContext::current;
+    if (context->thread_ref == NULL_REF) {
+        context->thread_ref = new_object("java/lang/Thread");
+    }
+    return context->thread_ref;
 }
 
+void Interpreter::join_threads() {
+    // 被等待的线程可能继续启动新线程，直到没有可join的线程为止
+    while (true) {
+        std::vector<JavaThread*> pending;
+        {
+            std::lock_guard<std::mutex> lock(threads_mutex);
+            for (auto& [ref, thread] : threads) {
+                if (thread->os_thread.joinable()) pending.push_back(thread.get());
+            }
+        }
+        if (pending.empty()) return;
+        for (JavaThread* thread : pending) {
+            thread->os_thread.join();
+        }
+    }
+}
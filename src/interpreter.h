@@ -10,75 +10,176 @@
 #include <string>
 #include <optional>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
 #include "runtime.h"
 #include "ClassLoader.h"
+#include "Heap.h"
+#include "Jit.h"
+#include "RegisterCode.h"
 
-struct Monitor {
-    RefT objref;
-    int count;
-    Monitor(RefT objref) : objref(objref), count(0) {}
+// 方法描述符中参数占用的槽位数（long/double占两个槽位），不含接收者
+size_t count_method_arg_slots(const std::string& desc);
+
+// 由Thread.start0启动的Java线程
+struct JavaThread {
+    RefT thread_ref = NULL_REF;
+    std::atomic<bool> alive{true};
+    std::thread os_thread;
 };
 
 class Interpreter {
 public:
     ClassLoader class_loader; 
-    Interpreter() : object_pool(42)
-     {}
+    Interpreter() {
+        init_opcode_table();
+        init_super_table();
+        for (int atype = 4; atype <= 11; ++atype) {
+            primitive_array_klasses[atype] = &klass(std::string("[") + "ZCFDBSIJ"[atype - 4]);
+        }
+        const char* regvm = std::getenv("JVM_REGVM");
+        register_vm = regvm && std::string(regvm) == "1";
+    }
+    ~Interpreter() {
+        join_threads();
+    }
     // 执行指定方法
-    std::optional<SlotT> execute(const std::string& class_name, const std::string& method_name, const std::string& method_desc, const std::vector<SlotT>& args);
+    std::optional<TwoSlotT> execute(const std::string& class_name, const std::string& method_name, const std::string& method_desc, const std::vector<SlotT>& args);
     // 根据方法名和描述符查找方法
     MethodInfo* find_method(ClassInfo& cf, const std::string& name, const std::string& descriptor, std::string* found_in_which_parent_class = nullptr);
-    // 分配新对象，返回对象引用（索引）
-    RefT new_object(const std::string &class_name);
-    // 分配引用类型数组，返回数组引用
-    RefT new_reference_array(const std::string& element_class_name, size_t len);
+    // 按类型中的实例模板分配新对象，返回对象引用（句柄）
+    RefT new_object(const Klass& klass) { return heap.make_instance(klass); }
+    // 按类名分配新对象（运行时创建的String、异常等）：有class文件时先解析该类以使用其实例模板，否则对象没有实例字段
+    RefT new_object(const std::string &class_name) { return new_object(class_loader.defined_klass(class_name)); }
+    // 分配数组，array_klass为数组类型，width_slots为每个元素占用的槽位数
+    RefT new_array(const Klass& array_klass, size_t len, size_t width_slots);
+    // multianewarray：descriptor为数组类型描述符，counts为前counts.size()维的长度
+    RefT new_multi_array(const std::string& descriptor, const std::vector<IntT>& counts);
     // 获取数组引用
-    JVMArray& get_array(RefT ref) { return array_pool.at(ref); }
-    // 根据对象引用获取对象索引
-    JVMObject& get_object(RefT ref) {
-        // 检查索引合法性
-        if (ref < 0 || ref >= object_pool.size()) {
-            throw std::out_of_range("Invalid object reference");
+    JVMArray& get_array(RefT ref) { return static_cast<JVMArray&>(heap.get(ref)); }
+    // 根据对象引用获取对象
+    JVMObject& get_object(RefT ref) { return heap.get(ref); }
+    // 解析cf常量池中index处getfield/putfield的字段引用，返回实例字段（其slot是字段在对象中的位置）
+    const FieldInfo& resolve_field(const ClassInfo& cf, uint16_t index);
+    // 对象中字段的槽位；对象没有这个字段时（类不匹配）抛出IncompatibleClassChangeError
+    SlotT* field_slots(RefT obj_ref, const FieldInfo& field) {
+        JVMObject& obj = get_object(obj_ref);
+        if (field.slot + field.width > obj.field_count()) {
+            throw JavaRuntimeError("java/lang/IncompatibleClassChangeError");
         }
-        return object_pool[ref];
+        return obj.fields() + field.slot;
     }
-    // 设置对象字段
-    void put_field(RefT obj_ref, const std::string& field, SlotT value);
-    // 获取对象字段
-    SlotT get_field(RefT obj_ref, const std::string& field);
-    // 获取类静态字段
-    SlotT getstatic(const std::string& class_name, const std::string& field_name, const std::string& field_desc);
-    // 赋值类静态字段
-    void putstatic(const std::string& class_name, const std::string& field_name, const std::string& field_desc, SlotT value);
+    // new解析到的类，已初始化时记入cf的解析缓存
+    const Klass& resolve_class(const ClassInfo& cf, uint16_t index);
+    // 类名（数组为描述符）对应的运行时类型
+    const Klass& klass(const std::string& name) { return class_loader.klass(name); }
+    // 解析cf常量池中index处的静态字段引用，返回字段（其static_value指向所属类的槽位）
+    const FieldInfo& resolve_static_field(const ClassInfo& cf, uint16_t index);
+    // 解析cf常量池中index处invokestatic的方法引用
+    const MethodInfo& resolve_static_method(const ClassInfo& cf, uint16_t index);
     // 浅克隆
     RefT shallow_clone_object(RefT objref) {
         const JVMObject& obj = get_object(objref);
-        RefT new_obj_ref = new_object(obj.class_name);
+        RefT new_obj_ref = new_object(*obj.klass);
         JVMObject& new_obj = get_object(new_obj_ref);
-        new_obj.fields.reserve(obj.fields.size());
-        for (const auto& [key, value]: obj.fields) {
-            new_obj.fields[key] = value;
-        }
+        std::copy(obj.fields(), obj.fields() + obj.field_count(), new_obj.fields());
         return new_obj_ref;
     }
+    // 启动新的OS线程，在独立的JVMContext中执行thread_ref对象的run()方法
+    void start_thread(RefT thread_ref);
+    // 线程是否仍在运行
+    bool is_thread_alive(RefT thread_ref);
+    // 当前线程对应的java/lang/Thread对象
+    RefT current_thread();
+    // 等待所有Java线程结束
+    void join_threads();
+    // 解释执行frame中bci处的一条指令，若是方法调用则执行被调方法直到返回（供编译代码回调）
+    void interpret_one(JVMContext& context, Frame& frame, size_t bci);
+    // 记录异常对象当前的调用栈，只保存每帧的方法和pc；overwrite为false时保留已有的记录（重新抛出）
+    void fill_in_stack_trace(JVMContext& context, RefT throwable, bool overwrite = true);
+    // 需要时才把记录的调用栈格式化成文本，栈顶在前
+    std::vector<std::string> stack_trace(RefT throwable);
+    // 打印线程中未捕获的异常及调用栈
+    void report_uncaught(RefT throwable, const std::string& thread_name);
+    // 类型对应的java/lang/Class对象，每个类型只有一个，第一次使用时创建
+    RefT class_mirror(const Klass& klass);
+    // 同步方法：进入时锁住this（静态方法为类的Class对象）并记在帧中
+    void enter_method_monitor(Frame& frame);
+    // 返回时释放同步方法持有的锁；当前线程已不持有该锁时抛出IllegalMonitorStateException
+    void exit_method_monitor(Frame& frame) {
+        if (frame.monitor != NULL_REF) release_method_monitor(frame);
+    }
+    // frame的方法中bci处的checkcast/instanceof，obj_ref（非null）的类型是否为常量池中的目标类型或其子类型
+    bool passes_type_check(const Frame& frame, size_t bci, RefT obj_ref);
 private:
-    // 对象池，包含堆对象和
-    std::vector<JVMObject> object_pool;
-    std::unordered_map<RefT, Monitor> object_monitor_info;
-    std::unordered_map<RefT, JVMArray> array_pool;
+    void release_method_monitor(Frame& frame);
+    // 堆，包含对象和数组
+    Heap heap;
+    // newarray的数组类型，按atype（4~11）
+    const Klass* primitive_array_klasses[12] = {};
+    std::mutex threads_mutex; // 保护threads
+    std::unordered_map<RefT, std::unique_ptr<JavaThread>> threads;
 
     using OpcodeHandler = std::function<void(JVMContext&, Frame&, size_t&, const std::vector<uint8_t>&, const ClassInfo&, Interpreter&)>;
     std::vector<OpcodeHandler> opcode_table;
     void init_opcode_table();
+    // 超级指令的处理函数，按SuperOp编号；与普通指令相同，进入时pc指向序列第一条指令的操作数
+    std::vector<OpcodeHandler> super_table;
+    void init_super_table();
     void execute_instruction(const std::vector<ConstantPoolInfo>& constant_pool, const std::vector<uint8_t>& code, size_t& pc, std::vector<SlotT>& stack, std::vector<SlotT>& locals);
-    std::optional<SlotT> _execute(JVMContext& context, ClassInfo& cf, const MethodInfo& method, const std::vector<SlotT>& args);
+    std::optional<TwoSlotT> _execute(JVMContext& context, ClassInfo& cf, const MethodInfo& method, const std::vector<SlotT>& args);
+    // 解释执行，直到调用栈深度降到base_depth；Java异常在这里按异常表展开，base_depth以上没有处理器时继续向外抛出
+    void run(JVMContext& context, size_t base_depth);
+    void interpret(JVMContext& context, size_t base_depth);
+    // 自栈顶向下查找能处理异常的帧并跳转到处理器，途经的帧出栈；直到base_depth都没有找到时返回false
+    bool unwind(JVMContext& context, RefT throwable, size_t base_depth);
+
+    // 异常对象的调用栈记录，只在抛出异常时写入
+    struct BacktraceEntry {
+        const ClassInfo* class_info;
+        const MethodInfo* method;
+        size_t pc;
+    };
+    std::mutex backtrace_mutex;
+    std::unordered_map<RefT, std::vector<BacktraceEntry>> backtraces;
+
+    Jit jit;
+    // 在frame上从frame.pc处执行编译代码，返回时frame.pc为解释器继续执行的位置
+    void jit_run(JVMContext& context, Frame& frame, const JitCode& jit_code);
+
+    // 寄存器形式的执行方式（JVM_REGVM=1）
+    bool register_vm = false;
+    std::mutex reg_mutex; // 保护reg_codes和翻译过程
+    std::vector<std::unique_ptr<RegisterCode>> reg_codes;
+    // 返回方法的寄存器代码，第一次调用时翻译，不能翻译时返回nullptr
+    const RegisterCode* register_code(const ClassInfo& class_info, const MethodInfo& method);
+    // 在frame上从frame.pc处执行寄存器代码，返回时frame.pc为解释器继续执行的位置；
+    // 回边计数达到JIT阈值时在循环头退出并返回true，由解释器尝试OSR
+    bool reg_run(Frame& frame, const RegisterCode& reg_code);
+
+    // 写入类中带ConstantValue属性的静态字段
+    void initialize_constant_fields(ClassInfo& cf);
+
+    // 在新的JVMContext中执行方法，嵌套执行（如<clinit>）仍属于当前Java线程
+    std::optional<TwoSlotT> execute_method(ClassInfo& cf, const MethodInfo& method, const std::vector<SlotT>& args);
+    // 执行<clinit>：抛出的异常不是Error时包装为ExceptionInInitializerError（JVMS §5.5第11步）
+    void run_class_initializer(ClassInfo& cf, const MethodInfo& clinit);
 
     ClassInfo& load_class(const std::string& class_name) {
-        return class_loader.load_class(class_name, [this](const std::string& loaded_class_name){
-            // 执行已加载类的<clinit>方法初始化类的类变量和静态块。
-            // 注意，class_loader除了加载class_name还会加载基类，因此loaded_class_name!=class_name
-            std::vector<SlotT> args;
-            this->execute(loaded_class_name, "<clinit>", "()V", args);
+        // 已初始化的类不构造初始化回调
+        if (ClassInfo* initialized = class_loader.find_loaded_class(class_name)) return *initialized;
+        return class_loader.load_class(class_name, [this](ClassInfo& loaded_class){
+            // 执行类自身声明的<clinit>方法初始化类的类变量和静态块，父类由class_loader先行初始化
+            initialize_constant_fields(loaded_class);
+            for (auto& method : loaded_class.methods) {
+                if (method.name == "<clinit>" && method.descriptor == "()V") {
+                    class_loader.link_method(method);
+                    run_class_initializer(loaded_class, method);
+                    break;
+                }
+            }
         });
     }
 };
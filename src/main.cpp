@@ -4,6 +4,9 @@
 #include "classFileParser.h"
 #include "interpreter.h"
 #include "NativeMethods.h"
+#include "Profiler.h"
+#include "Sampler.h"
+#include "TrapHandler.h"
 #include <filesystem>
 
 int main(int argc, char* argv[]) {
@@ -24,8 +27,14 @@ int main(int argc, char* argv[]) {
     }
     fmt::print("class_name: {}\n", class_name);
 
+    int status = 0; // main抛出未捕获的异常或虚拟机出错时以1退出
     try {
         register_builtin_natives();
+        TrapHandler::install();
+#ifdef JVM_PROFILING
+        Profiler::init();
+#endif
+        Sampler::start_from_env();
         // 获取 input_file 所在目录
         std::filesystem::path input_path(input_file);
         std::string input_dir = input_path.has_parent_path() ? input_path.parent_path().string() : "";
@@ -45,10 +54,19 @@ int main(int argc, char* argv[]) {
         interpreter.class_loader.print_search_dirs();
         fmt::print("Interpreter running\n");
         std::vector<SlotT> args(1);
-        interpreter.execute(class_name, "main", "([Ljava/lang/String;)V", args);
+        try {
+            interpreter.execute(class_name, "main", "([Ljava/lang/String;)V", args);
+        } catch (const JavaThrowable& e) {
+            interpreter.report_uncaught(e.ref, "main");
+            status = 1;
+        }
+        // 等待main启动的所有线程结束
+        interpreter.join_threads();
+        Sampler::stop();
         fmt::print("Main done\n");
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
+        status = 1;
     }
-    return 0;
+    return status;
 }
\ No newline at end of file
@@ -1,13 +1,23 @@
 #ifndef RUNTIME_H
 #define RUNTIME_H
 #include "constantPool.h"
+#include "Profiler.h"
+#include "Sampler.h"
+#include "bytecode.h"
+#include "Vectorizer.h"
 #include <vector>
 #include <cstdint>
 #include <string>
 #include <memory>
-#include <stack>
+#include <deque>
+#include <algorithm>
+#include <exception>
 #include <map>
 #include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 using ByteT = int8_t;
 using ShortT = int16_t;
 using IntT = int32_t;
@@ -24,16 +34,163 @@ using LocalIdxT = size_t;
 using OpCodeT = uint8_t;
 const size_t SLOT_WIDTH = 32;
 
+const uint16_t ACC_STATIC = 0x0008;
+const uint16_t ACC_SYNCHRONIZED = 0x0020;
 const uint16_t ACC_NATIVE = 0x0100;
+const uint16_t ACC_INTERFACE = 0x0200;
 const uint16_t ACC_ABSTRACT = 0x0400;
 
+class Interpreter;
+
+// native方法参数：直接指向调用者操作数栈顶的参数槽位，不复制参数也不创建Frame
+struct NativeArgs {
+    const SlotT* slots;
+    size_t count;
+    SlotT operator[](size_t i) const { return slots[i]; }
+    IntT get_int(size_t i) const { return static_cast<IntT>(slots[i]); }
+    RefT get_ref(size_t i) const { return slots[i]; }
+    LongT get_long(size_t i) const {
+        return static_cast<LongT>(((TwoSlotT)slots[i] << SLOT_WIDTH) | slots[i+1]);
+    }
+    FloatT get_float(size_t i) const {
+        union { FloatT f; UIntT u; } u;
+        u.u = slots[i];
+        return u.f;
+    }
+    DoubleT get_double(size_t i) const {
+        union { DoubleT d; TwoSlotT l; } u;
+        u.l = static_cast<TwoSlotT>(get_long(i));
+        return u.d;
+    }
+};
+
+// native方法返回值：带类型宽度（void/单槽位/双槽位）
+struct NativeValue {
+    enum Kind : uint8_t { VOID, ONE_SLOT, TWO_SLOT };
+    Kind kind = VOID;
+    TwoSlotT bits = 0;
+    static NativeValue none() { return {}; }
+    static NativeValue of_slot(SlotT v) { return {ONE_SLOT, v}; }
+    static NativeValue of_int(IntT v) { return of_slot(static_cast<SlotT>(v)); }
+    static NativeValue of_ref(RefT v) { return of_slot(v); }
+    static NativeValue of_float(FloatT v) {
+        union { FloatT f; UIntT u; } u;
+        u.f = v;
+        return of_slot(u.u);
+    }
+    static NativeValue of_long(LongT v) { return {TWO_SLOT, static_cast<TwoSlotT>(v)}; }
+    static NativeValue of_double(DoubleT v) {
+        union { DoubleT d; TwoSlotT l; } u;
+        u.d = v;
+        return {TWO_SLOT, u.l};
+    }
+};
+
+using NativeMethodFunc = NativeValue (*)(NativeArgs, Interpreter&);
+
+struct JitCode;
+struct RegisterCode;
+struct ClassInfo;
+struct Klass;
+
+// 可复制的原子变量：MethodInfo存放在vector中需要可复制，复制只发生在类发布之前，只拷贝当前值
+template <typename T>
+struct CopyableAtomic : std::atomic<T> {
+    CopyableAtomic() : std::atomic<T>(T{}) {}
+    CopyableAtomic(const CopyableAtomic& other) : std::atomic<T>(other.load(std::memory_order_relaxed)) {}
+    CopyableAtomic& operator=(const CopyableAtomic& other) {
+        this->store(other.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+};
+
+// checkcast/instanceof调用点的缓存（TypeCheck.h）
+struct TypeCheckSite {
+    uint32_t bci = 0;
+    mutable CopyableAtomic<const Klass*> target; // 解析到的目标类型
+    mutable CopyableAtomic<const Klass*> last;   // 上一次通过检查的对象类型
+};
+
+// 异常表项，catch_type为0表示捕获任意异常（finally）
+struct ExceptionTable {
+    uint16_t start_pc;
+    uint16_t end_pc;
+    uint16_t handler_pc;
+    uint16_t catch_type;
+};
+
+// 异常表按pc切分成互不重叠的区间，按start_pc排序；handlers[first, first+count)是覆盖该区间的处理器（异常表下标），保持表中的匹配顺序
+struct HandlerRange {
+    uint16_t start_pc;
+    uint16_t end_pc;
+    uint16_t first;
+    uint16_t count;
+};
+
 struct MethodInfo {
     uint16_t access_flags;
     std::string name;
     std::string descriptor;
+    const ClassInfo* owner = nullptr; // 声明该方法的类，类定义时设置
     std::vector<uint8_t> code;
-    uint16_t max_stack;
-    uint16_t max_locals;
+    uint16_t max_stack = 0;
+    uint16_t max_locals = 0;
+    // Code属性延迟解码：类加载时只复制Code属性本身的字节，class文件随后释放；方法第一次被解析时
+    // 由ClassLoader::link_method解码code、max_stack/max_locals和异常表，之后释放这份副本
+    std::vector<uint8_t> code_attribute;
+    bool has_code = false; // 有未解码的Code属性
+    mutable CopyableAtomic<bool> linked;
+    NativeMethodFunc native_func = nullptr; // 类加载时为ACC_NATIVE方法绑定
+    // JIT：调用/回边计数超过阈值后编译，jit_code发布后解释器在方法入口转入编译代码
+    mutable CopyableAtomic<uint32_t> invocation_count;
+    mutable CopyableAtomic<uint32_t> backedge_count;
+    mutable CopyableAtomic<JitCode*> jit_code;
+    mutable CopyableAtomic<bool> jit_failed;
+    // 第二层优化编译的代码，只在操作数栈为空的方法入口进入
+    mutable CopyableAtomic<JitCode*> opt_code;
+    mutable CopyableAtomic<bool> opt_failed;
+    // 寄存器形式的内部字节码（RegisterCode.h），JVM_REGVM=1时第一次执行前翻译
+    mutable CopyableAtomic<RegisterCode*> reg_code;
+    mutable CopyableAtomic<bool> reg_failed;
+    // 超级指令表（Superinstructions.h），与code等长，空表示没有
+    std::vector<uint8_t> superinstructions;
+    // 预解码的switch指令（bytecode.h），按bci升序，类加载时生成
+    std::vector<SwitchTable> switch_tables;
+    // 向量化的循环（Vectorizer.h），按循环头bci升序
+    std::vector<VectorLoop> vector_loops;
+    // checkcast/instanceof调用点（TypeCheck.h），按bci升序，方法链接时生成
+    std::vector<TypeCheckSite> type_check_sites;
+    // 异常表，只在抛出异常时查找，正常执行路径不访问
+    std::vector<ExceptionTable> exception_table;
+    std::vector<HandlerRange> handler_ranges;
+    std::vector<uint16_t> handlers;
+
+    // bci处switch指令的跳转表
+    const SwitchTable& switch_at(size_t bci) const {
+        return *std::lower_bound(switch_tables.begin(), switch_tables.end(), bci,
+                                 [](const SwitchTable& t, size_t pc) { return t.bci < pc; });
+    }
+
+    // 循环头在bci处的向量化循环
+    const VectorLoop& vector_loop_at(size_t bci) const {
+        return *std::lower_bound(vector_loops.begin(), vector_loops.end(), bci,
+                                 [](const VectorLoop& l, size_t pc) { return l.header < pc; });
+    }
+
+    // bci处的checkcast/instanceof调用点
+    const TypeCheckSite& type_check_site_at(size_t bci) const {
+        return *std::lower_bound(type_check_sites.begin(), type_check_sites.end(), bci,
+                                 [](const TypeCheckSite& s, size_t pc) { return s.bci < pc; });
+    }
+
+    // 覆盖bci的处理器区间（二分查找），没有时返回nullptr
+    const HandlerRange* handlers_at(size_t bci) const {
+        auto it = std::upper_bound(handler_ranges.begin(), handler_ranges.end(), bci,
+                                   [](size_t pc, const HandlerRange& r) { return pc < r.start_pc; });
+        if (it == handler_ranges.begin()) return nullptr;
+        --it;
+        return bci < it->end_pc ? &*it : nullptr;
+    }
 };
 
 struct FieldInfo {
@@ -42,15 +199,51 @@ struct FieldInfo {
     std::string descriptor;
     bool has_constant_value = false;
     uint16_t constantvalue_index = 0; // index into constant pool
+    // 静态字段在所属类static_slots中的位置，类链接时分配；实例字段在对象字段槽位中的位置，类初始化前分配（排在父类字段之后）。
+    // long/double占两个槽位，高32位在前
+    uint16_t slot = 0;
+    uint8_t width = 1;
+    CopyableAtomic<SlotT>* static_value = nullptr; // 指向所属类的static_slots[slot]
+};
+
+// 类初始化状态（JVMS §5.5）
+enum class ClassInitState : uint8_t {
+    LOADED,            // 已加载，尚未初始化
+    BEING_INITIALIZED, // 某个线程正在执行<clinit>
+    INITIALIZED,
+    ERRONEOUS,         // <clinit>执行失败
 };
 
+struct Klass;
+
 struct ClassInfo {
     ConstantPool constant_pool;
     std::vector<MethodInfo> methods;
     std::vector<FieldInfo> fields;
     uint16_t majorVer, minorVer;
+    uint16_t access_flags = 0;
     ConstIdxT this_class, super_class;
-    std::unordered_map<std::string, RefT> staticVars;
+    std::vector<ConstIdxT> interfaces; // 直接实现的接口
+    // 静态字段的存储，按FieldInfo::slot排列，类链接后不再改变大小
+    std::vector<CopyableAtomic<SlotT>> static_slots;
+    // getstatic/putstatic解析到的字段，按常量池下标；字段所属的类初始化完成后才填入，之后直接读写槽位
+    mutable std::vector<CopyableAtomic<const FieldInfo*>> resolved_static_fields;
+    // invokestatic解析到的方法，按常量池下标；与静态字段相同，声明方法的类初始化完成后才填入，之后调用不再检查类初始化
+    mutable std::vector<CopyableAtomic<const MethodInfo*>> resolved_static_methods;
+    // getfield/putfield解析到的实例字段，按常量池下标；实例字段的布局在类初始化前确定，解析后即可填入
+    mutable std::vector<CopyableAtomic<const FieldInfo*>> resolved_fields;
+    // new解析到的类，按常量池下标；类初始化完成后才填入
+    mutable std::vector<CopyableAtomic<const Klass*>> resolved_classes;
+    Klass* klass = nullptr; // 本类的运行时类型，类解析时关联
+    std::string content_hash; // class文件内容的SHA-256（十六进制），验证缓存的键
+    mutable std::mutex link_mutex; // 本类方法的链接（Code属性解码、验证和链接时的分析）
+    mutable size_t unverified_methods = 0; // 还需在链接时验证的方法数，由link_mutex保护
+
+    std::atomic<ClassInitState> init_state{ClassInitState::LOADED};
+    // 以下由init_mutex保护；等待其他线程初始化本类的线程只在本类的init_cv上阻塞
+    std::thread::id init_thread;
+    std::mutex init_mutex;
+    std::condition_variable init_cv;
 };
 
 class LocalVars {
@@ -170,74 +363,147 @@ struct Frame {
     size_t pc; // 程序计数器
     const ClassInfo& class_info;
     const MethodInfo& method_info;
+    RefT monitor = 0; // 同步方法进入时锁住的对象（this或类的Class对象），返回或异常退出该帧时释放
     Frame(size_t max_locals, size_t max_stack, const ClassInfo &class_info, const MethodInfo& method_info) : local_vars(max_locals), operand_stack(), pc(0), method_info(method_info), class_info(class_info)  {}
 };
 
+// null引用
+const RefT NULL_REF = 0;
+
+// 正在传播的Java异常。athrow和运行时异常都以C++异常抛出，由Interpreter::run在抛出时按异常表逐帧展开，
+// 正常执行路径上没有任何登记或检查（零开销）
+struct JavaThrowable : std::exception {
+    RefT ref;
+    explicit JavaThrowable(RefT ref) : ref(ref) {}
+    const char* what() const noexcept override { return "uncaught Java exception"; }
+};
+
+// 运行时检查（null访问、数组越界、整数除零等）发现的异常，只带异常类名，不在检查处分配对象；
+// 由Interpreter::run创建异常对象并记录调用栈，之后与athrow相同
+struct JavaRuntimeError : std::exception {
+    const char* class_name;
+    explicit JavaRuntimeError(const char* class_name) : class_name(class_name) {}
+    const char* what() const noexcept override { return class_name; }
+};
+
+// 对象都由Heap在TLAB中构造。对象头只有锁字和类指针（没有虚函数表），实例字段槽位紧跟在对象头后面，
+// 槽位数由类型决定（Klass::field_slots，按FieldInfo::slot排列；数组为0）
 struct JVMObject {
-    std::string class_name;
-    std::unordered_map<std::string, RefT> fields; // 字段名到值的映射
+    std::atomic<uintptr_t> lock_word{0}; // 锁字，编码见ObjectMonitor.h
+    const Klass* klass;
+    explicit JVMObject(const Klass* klass) : klass(klass) {}
+    SlotT* fields() { return reinterpret_cast<SlotT*>(this + 1); }
+    const SlotT* fields() const { return reinterpret_cast<const SlotT*>(this + 1); }
+    uint32_t field_count() const;
 };
+static_assert(sizeof(JVMObject) == 2 * sizeof(void*), "object header is the lock word and the klass pointer");
 
+// 数组对象：元素槽位与实例字段一样紧跟在头部后面，在TLAB中随对象一起分配，内存已清零
 struct JVMArray: JVMObject {
     size_t len;
     size_t element_width_slots; // 1 for 32-bit/ref/char/short/byte/boolean; 2 for long/double
-    std::vector<SlotT> elems; // stored in slots, size = len * element_width_slots
-    JVMArray(std::string &elem_class_name, size_t len)
-    : len(len), element_width_slots(1), elems(len)
-    {
-        class_name = "[]";
-        class_name += elem_class_name;
-    }
-    JVMArray(const std::string &elem_class_name, size_t len, size_t width_slots)
-    : len(len), element_width_slots(width_slots), elems(len * width_slots)
-    {
-        class_name = "[]";
-        class_name += elem_class_name;
-    }
+    // klass是数组类型，如[I、[Ljava/lang/String;
+    JVMArray(const Klass* klass, size_t len, size_t width_slots)
+    : JVMObject(klass), len(len), element_width_slots(width_slots)
+    {}
+    // 头部之后需要的元素内存（Heap::make的extra_bytes）
+    static size_t element_bytes(size_t len, size_t width_slots) { return len * width_slots * sizeof(SlotT); }
+    // len * element_width_slots个槽位
+    SlotT* elems() { return reinterpret_cast<SlotT*>(this + 1); }
+    const SlotT* elems() const { return reinterpret_cast<const SlotT*>(this + 1); }
     SlotT get_slot(size_t index) {
         if (index >= len) {
-            fmt::print("JVMArray {} get_slot index {} out of range {}", (void*)this, index, len);
-            exit(1);
+            throw JavaRuntimeError("java/lang/ArrayIndexOutOfBoundsException");
         }
-        return elems[index * element_width_slots];
+        return get_slot_unchecked(index);
     }
     void put_slot(size_t index, SlotT value) {
         if (index >= len) {
-            fmt::print("JVMArray {} put_slot index {} out of range {}", (void*)this, index, len);
-            exit(1);
+            throw JavaRuntimeError("java/lang/ArrayIndexOutOfBoundsException");
         }
-        elems[index * element_width_slots] = value;
+        put_slot_unchecked(index, value);
     }
     TwoSlotT get_twoslot(size_t index) {
         if (index >= len) {
-            fmt::print("JVMArray {} get_twoslot index {} out of range {}", (void*)this, index, len);
-            exit(1);
+            throw JavaRuntimeError("java/lang/ArrayIndexOutOfBoundsException");
         }
-        SlotT high = elems[index * element_width_slots];
-        SlotT low = elems[index * element_width_slots + 1];
-        return ((TwoSlotT)high << SLOT_WIDTH) | low;
+        return get_twoslot_unchecked(index);
     }
     void put_twoslot(size_t index, TwoSlotT value) {
         if (index >= len) {
-            fmt::print("JVMArray {} put_twoslot index {} out of range {}", (void*)this, index, len);
-            exit(1);
+            throw JavaRuntimeError("java/lang/ArrayIndexOutOfBoundsException");
         }
-        elems[index * element_width_slots] = (SlotT)(value >> SLOT_WIDTH);
-        elems[index * element_width_slots + 1] = (SlotT)(value & 0xFFFFFFFF);
+        put_twoslot_unchecked(index, value);
+    }
+    // 调用方已证明index < len（计数循环的越界检查消除，BoundsCheck.h）
+    SlotT get_slot_unchecked(size_t index) const {
+        return elems()[index * element_width_slots];
+    }
+    void put_slot_unchecked(size_t index, SlotT value) {
+        elems()[index * element_width_slots] = value;
+    }
+    TwoSlotT get_twoslot_unchecked(size_t index) const {
+        SlotT high = elems()[index * element_width_slots];
+        SlotT low = elems()[index * element_width_slots + 1];
+        return ((TwoSlotT)high << SLOT_WIDTH) | low;
+    }
+    void put_twoslot_unchecked(size_t index, TwoSlotT value) {
+        elems()[index * element_width_slots] = (SlotT)(value >> SLOT_WIDTH);
+        elems()[index * element_width_slots + 1] = (SlotT)(value & 0xFFFFFFFF);
     }
 };
 
+// 运行时类型，对象头中的类指针指向它。每个类名一个，每种数组类型也各有一个，
+// 由ClassLoader在类表项中创建，之后地址不变，同一类型的比较只需比较指针
+struct Klass {
+    std::string name;                // 如java/lang/String；数组为描述符，如[I、[[Ljava/lang/String;
+    const ClassInfo* info = nullptr; // 类解析后填入；数组和没有class文件的类（运行时创建的异常等）为nullptr
+    const Klass* super = nullptr;    // 父类，类初始化前填入；数组为java/lang/Object
+    const Klass* element = nullptr;  // 数组的元素类型，基本类型数组为nullptr
+    mutable std::atomic<const Klass*> array{nullptr}; // 以本类型为元素的数组类型，第一次用到时填入
+    mutable std::atomic<RefT> mirror{0};               // getClass返回的java/lang/Class对象，第一次调用时创建
+    // 子类型检查用的父类型（TypeCheck.h），由ClassLoader::link_supers在类初始化前或第一次检查前填入
+    static constexpr uint32_t DISPLAY_SIZE = 8;
+    std::atomic<bool> supers_linked{false};
+    bool is_interface = false;
+    bool primary = false; // 可以只查主父类表：有class文件、不是接口或数组、深度小于DISPLAY_SIZE的类
+    uint32_t depth = 0;   // 父类链的长度，java/lang/Object为0
+    const Klass* primary_supers[DISPLAY_SIZE] = {}; // primary_supers[d]为深度为d的祖先，本类深度小于DISPLAY_SIZE时包括本类
+    std::vector<const Klass*> secondary_supers;     // 其余父类型：所有接口、深度不小于DISPLAY_SIZE的类、没有class文件的类
+    mutable std::atomic<const Klass*> secondary_super_cache{nullptr}; // 上一次在secondary_supers中找到的类型
+    // 实例模板：类初始化前按实例字段布局算出，new只需在线程的TLAB中移动指针分配instance_size字节，再写入对象头；
+    // TLAB的内存在申请时已清零，字段槽位不用再初始化
+    uint32_t field_slots = 0; // 实例字段（含父类）占用的槽位数
+    size_t instance_size = sizeof(JVMObject);
+    explicit Klass(const std::string& name) : name(name) {}
+    bool is_array() const { return name[0] == '['; }
+};
+
+inline uint32_t JVMObject::field_count() const { return klass->field_slots; }
+
+// 每个Java线程拥有独立的JVMContext（调用栈）
 class JVMContext {
 public:
-    std::stack<Frame> call_stack;
+    // 当前OS线程正在执行的JVMContext
+    inline static thread_local JVMContext* current = nullptr;
+    // 对应的java/lang/Thread对象，主线程在首次调用currentThread时创建
+    RefT thread_ref = NULL_REF;
+    std::deque<Frame> call_stack; // 栈顶在末尾，抛出异常时从栈顶向下遍历
     void push_frame(const Frame& frame) { 
         // printf("push frame of %s\n", frame.method.name.c_str());
-        call_stack.push(frame);
+        PROFILE_METHOD_ENTER(frame.class_info, frame.method_info);
+        call_stack.push_back(frame);
+        Frame& top = call_stack.back();
+        Sampler::shadow_push(top.class_info, top.method_info, &top.pc);
+    }
+    void pop_frame() {
+        PROFILE_METHOD_EXIT();
+        Sampler::shadow_pop();
+        call_stack.pop_back();
     }
-    void pop_frame() { call_stack.pop(); }
     Frame& current_frame() { 
         // printf("top frame is %s\n", call_stack.top().method.name.c_str());
-        return call_stack.top();
+        return call_stack.back();
      }
     bool empty() const { return call_stack.empty(); }
 };
@@ -0,0 +1,127 @@
+#ifndef X86ASSEMBLER_H
+#define X86ASSEMBLER_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+// 模板JIT和优化编译器共用的x86-64指令编码
+namespace x64 {
+
+enum Reg : int { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+                 R8 = 8, R9, R10, R11, R12, R13, R14, R15 };
+enum Cond : uint8_t { CC_E = 0x4, CC_NE = 0x5, CC_L = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G = 0xf };
+
+// 只包含编译器用到的指令的x86-64汇编器
+class Assembler {
+public:
+    std::vector<uint8_t> buf;
+
+    size_t pos() const { return buf.size(); }
+    void u8(uint8_t v) { buf.push_back(v); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; ++i) u8((uint8_t)(v >> (8 * i))); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; ++i) u8((uint8_t)(v >> (8 * i))); }
+    void patch_rel32(size_t at, size_t target) {
+        int32_t rel = (int32_t)((int64_t)target - (int64_t)(at + 4));
+        std::memcpy(&buf[at], &rel, 4);
+    }
+
+    // opcode reg, [base+disp]
+    void op_mem(std::initializer_list<uint8_t> opcode, bool w, int reg, int base, int32_t disp) {
+        rex(w, reg, base);
+        for (uint8_t b : opcode) u8(b);
+        int mod = (disp == 0 && (base & 7) != RBP) ? 0 : (disp >= -128 && disp <= 127 ? 1 : 2);
+        u8((uint8_t)(mod << 6 | (reg & 7) << 3 | (base & 7)));
+        if ((base & 7) == RSP) u8(0x24); // rsp/r12作基址需要SIB
+        if (mod == 1) u8((uint8_t)(int8_t)disp);
+        else if (mod == 2) u32((uint32_t)disp);
+    }
+    // opcode reg, rm（寄存器直接寻址）
+    void op_reg(std::initializer_list<uint8_t> opcode, bool w, int reg, int rm) {
+        rex(w, reg, rm);
+        for (uint8_t b : opcode) u8(b);
+        u8((uint8_t)(0xc0 | (reg & 7) << 3 | (rm & 7)));
+    }
+
+    void load32(Reg dst, Reg base, int32_t disp) { op_mem({0x8b}, false, dst, base, disp); }
+    void load64(Reg dst, Reg base, int32_t disp) { op_mem({0x8b}, true, dst, base, disp); }
+    void store32(Reg base, int32_t disp, Reg src) { op_mem({0x89}, false, src, base, disp); }
+    void store64(Reg base, int32_t disp, Reg src) { op_mem({0x89}, true, src, base, disp); }
+    void store32_imm(Reg base, int32_t disp, int32_t imm) { op_mem({0xc7}, false, 0, base, disp); u32((uint32_t)imm); }
+    void mov64(Reg dst, Reg src) { op_reg({0x89}, true, src, dst); }
+    void mov32_imm(Reg dst, uint32_t imm) { rex(false, 0, dst); u8((uint8_t)(0xb8 + (dst & 7))); u32(imm); }
+    void mov64_imm(Reg dst, uint64_t imm) { rex(true, 0, dst); u8((uint8_t)(0xb8 + (dst & 7))); u64(imm); }
+    void add64_imm(Reg dst, int32_t imm) { alu64_imm(0, dst, imm); }
+    void sub64_imm(Reg dst, int32_t imm) { alu64_imm(5, dst, imm); }
+    // 0x01 add, 0x09 or, 0x21 and, 0x29 sub, 0x31 xor
+    void alu32_mem_reg(uint8_t op, Reg base, int32_t disp, Reg src) { op_mem({op}, false, src, base, disp); }
+    void alu64(uint8_t op, Reg dst, Reg src) { op_reg({op}, true, src, dst); }
+    void add_mem_imm32(Reg base, int32_t disp, int32_t imm) { op_mem({0x81}, false, 0, base, disp); u32((uint32_t)imm); }
+    void cmp32_mem(Reg reg, Reg base, int32_t disp) { op_mem({0x3b}, false, reg, base, disp); }
+    void cmp32_imm8(Reg reg, int8_t imm) { op_reg({0x83}, false, 7, reg); u8((uint8_t)imm); }
+    void cmp_mem_imm8(Reg base, int32_t disp, int8_t imm) { op_mem({0x83}, false, 7, base, disp); u8((uint8_t)imm); }
+    void cmp_mem_imm32(Reg base, int32_t disp, int32_t imm) { op_mem({0x81}, false, 7, base, disp); u32((uint32_t)imm); }
+    void cmp64(Reg a, Reg b) { op_reg({0x39}, true, b, a); }
+    void cmp64_imm8(Reg reg, int8_t imm) { op_reg({0x83}, true, 7, reg); u8((uint8_t)imm); }
+    void test32(Reg a, Reg b) { op_reg({0x85}, false, b, a); }
+    void test64(Reg a, Reg b) { op_reg({0x85}, true, b, a); }
+    void imul32(Reg dst, Reg src) { op_reg({0x0f, 0xaf}, false, dst, src); }
+    void imul64(Reg dst, Reg src) { op_reg({0x0f, 0xaf}, true, dst, src); }
+    void neg_mem32(Reg base, int32_t disp) { op_mem({0xf7}, false, 3, base, disp); }
+    void neg64(Reg reg) { op_reg({0xf7}, true, 3, reg); }
+    // 按cl移位：ext 4=shl 5=shr 7=sar
+    void shift_mem32_cl(int ext, Reg base, int32_t disp) { op_mem({0xd3}, false, ext, base, disp); }
+    void shift64_cl(int ext, Reg reg) { op_reg({0xd3}, true, ext, reg); }
+    void shift64_imm(int ext, Reg reg, uint8_t imm) { op_reg({0xc1}, true, ext, reg); u8(imm); }
+    // 64位值在槽位中高位在前，与小端序相反，读写时交换两半
+    void swap_halves(Reg reg) { shift64_imm(0, reg, 32); } // rol reg, 32
+    void cdq() { u8(0x99); }
+    void cqo() { u8(0x48); u8(0x99); }
+    void idiv32(Reg reg) { op_reg({0xf7}, false, 7, reg); }
+    void idiv64(Reg reg) { op_reg({0xf7}, true, 7, reg); }
+    void movsxd(Reg dst, Reg src) { op_reg({0x63}, true, dst, src); }
+    void movsx8_mem(Reg dst, Reg base, int32_t disp) { op_mem({0x0f, 0xbe}, false, dst, base, disp); }
+    void movzx16_mem(Reg dst, Reg base, int32_t disp) { op_mem({0x0f, 0xb7}, false, dst, base, disp); }
+    void movsx16_mem(Reg dst, Reg base, int32_t disp) { op_mem({0x0f, 0xbf}, false, dst, base, disp); }
+    void setcc(Cond cc, Reg dst) { op_reg({0x0f, (uint8_t)(0x90 + cc)}, false, 0, dst); }
+    void movzx8(Reg dst, Reg src) { op_reg({0x0f, 0xb6}, false, dst, src); }
+    void mov32(Reg dst, Reg src) { op_reg({0x89}, false, src, dst); } // 高32位清零
+    // 0x01 add, 0x09 or, 0x21 and, 0x29 sub, 0x31 xor
+    void alu32(uint8_t op, Reg dst, Reg src) { op_reg({op}, false, src, dst); }
+    void cmp32(Reg a, Reg b) { op_reg({0x39}, false, b, a); }
+    void cmp32_imm(Reg reg, int32_t imm) { op_reg({0x81}, false, 7, reg); u32((uint32_t)imm); }
+    void neg32(Reg reg) { op_reg({0xf7}, false, 3, reg); }
+    void shift32_cl(int ext, Reg reg) { op_reg({0xd3}, false, ext, reg); }
+    // 寄存器间的符号/零扩展，src只能是RAX..RBX（没有REX前缀时低8位寄存器的编码）
+    void movsx8(Reg dst, Reg src) { op_reg({0x0f, 0xbe}, false, dst, src); }
+    void movzx16(Reg dst, Reg src) { op_reg({0x0f, 0xb7}, false, dst, src); }
+    void movsx16(Reg dst, Reg src) { op_reg({0x0f, 0xbf}, false, dst, src); }
+    void push(Reg reg) { rex(false, 0, reg); u8((uint8_t)(0x50 + (reg & 7))); }
+    void pop(Reg reg) { rex(false, 0, reg); u8((uint8_t)(0x58 + (reg & 7))); }
+    void call(Reg reg) { op_reg({0xff}, false, 2, reg); }
+    void jmp(Reg reg) { op_reg({0xff}, false, 4, reg); }
+    void ret() { u8(0xc3); }
+    // 跳转，返回rel32的位置供回填
+    size_t jcc(Cond cc) { u8(0x0f); u8((uint8_t)(0x80 + cc)); u32(0); return pos() - 4; }
+    size_t jmp() { u8(0xe9); u32(0); return pos() - 4; }
+
+private:
+    void rex(bool w, int reg, int base) {
+        uint8_t r = (uint8_t)(0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((base & 8) ? 1 : 0));
+        if (r != 0x40) u8(r);
+    }
+    void alu64_imm(int ext, Reg dst, int32_t imm) {
+        if (imm >= -128 && imm <= 127) {
+            op_reg({0x83}, true, ext, dst);
+            u8((uint8_t)(int8_t)imm);
+        } else {
+            op_reg({0x81}, true, ext, dst);
+            u32((uint32_t)imm);
+        }
+    }
+};
+
+} // namespace x64
+
+#endif // X86ASSEMBLER_H
@@ -0,0 +1,34 @@
+public class AllocBenchTest {
+    static class Base {
+        int a;
+        long b;
+    }
+
+    static class Node extends Base {
+        int a; // 遮蔽Base.a
+        double d;
+    }
+
+    // 分配n个短命对象，返回各字段之和
+    static long churn(int n) {
+        long s = 0;
+        for (int i = 0; i < n; i++) {
+            Node o = new Node();
+            o.a = i;
+            ((Base) o).a = i * 3;
+            o.b = (long) i << 33;
+            o.d = i;
+            s += (o.b >>> 32) + (o.a - ((Base) o).a) + (int) o.d;
+        }
+        return s;
+    }
+
+    public static void main(String[] args) {
+        int n = 200000;
+        long start = System.nanoTime();
+        long s = churn(n);
+        long elapsed = System.nanoTime() - start;
+        System.out.println(s); // 19999900000
+        System.out.println(n * 1000000000L / (elapsed + 1) + " allocations/s");
+    }
+}
@@ -0,0 +1,61 @@
+public class BoundsCheckTest {
+    static int sum(int[] a) {
+        int s = 0;
+        for (int i = 0; i < a.length; i++) {
+            s += a[i];
+        }
+        return s;
+    }
+
+    static void bump(int[] a) {
+        for (int i = 0; i < a.length; i++) {
+            a[i] += i;
+        }
+    }
+
+    static long lfill(long[] a) {
+        long s = 0;
+        for (int i = 0; i < a.length; i++) {
+            a[i] = (long) i << 3;
+            s += a[i];
+        }
+        return s;
+    }
+
+    static int bsum(byte[] arr) {
+        int s = 0;
+        for (byte x : arr) {
+            s += x;
+        }
+        return s;
+    }
+
+    // a[i + 1]不是计数循环的下标，仍然检查
+    static int shift(int[] a) {
+        int s = 0;
+        try {
+            for (int i = 0; i < a.length; i++) {
+                s += a[i + 1];
+            }
+        } catch (ArrayIndexOutOfBoundsException e) {
+            s += 1000;
+        }
+        return s;
+    }
+
+    public static void main(String[] args) {
+        int[] a = new int[10];
+        long[] l = new long[10];
+        byte[] b = new byte[12];
+        int sa = 0, sd = 0;
+        long sl = 0;
+        for (int k = 0; k < 30; k++) {
+            bump(a);
+            sa = sum(a);
+            sl = lfill(l);
+            b[5] = (byte) k;
+            sd = shift(a);
+        }
+        System.out.println(sa + " " + sl + " " + bsum(b) + " " + sd); // 1350 360 29 2350
+    }
+}
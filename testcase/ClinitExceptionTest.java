@@ -0,0 +1,28 @@
+public class ClinitExceptionTest {
+    static class Bad {
+        static int v = 1 / zero();
+
+        static int zero() {
+            return 0;
+        }
+
+        static int get() {
+            return v;
+        }
+    }
+
+    public static void main(String[] args) {
+        // <clinit>抛出的ArithmeticException包装为ExceptionInInitializerError
+        try {
+            Bad.get();
+        } catch (Error e) {
+            System.out.println(e instanceof ExceptionInInitializerError); // true
+        }
+        // 初始化失败的类处于错误状态，再次使用时抛出NoClassDefFoundError
+        try {
+            Bad.get();
+        } catch (NoClassDefFoundError e) {
+            System.out.println("no class def"); // no class def
+        }
+    }
+}
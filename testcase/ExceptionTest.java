@@ -0,0 +1,45 @@
+public class ExceptionTest {
+    static class MyException extends RuntimeException {
+    }
+
+    static int thrower(int x) {
+        if (x % 3 == 0) throw new MyException();
+        if (x % 3 == 1) {
+            Object o = null;
+            o.hashCode(); // NullPointerException
+        }
+        return x * 2;
+    }
+
+    static int mid(int x) {
+        try {
+            return thrower(x) + 1;
+        } catch (MyException e) {
+            return 100;
+        }
+    }
+
+    public static void main(String[] args) {
+        int a = mid(2);   // 5
+        int b = mid(0);   // 100
+        int c;
+        try {
+            c = mid(1);
+        } catch (RuntimeException e) {
+            c = -1;
+        }
+        int s = 0;
+        for (int i = 0; i < 3000; i++) {
+            try {
+                s += thrower(i);
+            } catch (MyException e) {
+                s += 7;
+            } catch (Throwable t) {
+                s += 3;
+            } finally {
+                s++;
+            }
+        }
+        System.out.println(a + " " + b + " " + c + " " + s); // 5 100 -1 3014000
+    }
+}
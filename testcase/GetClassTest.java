@@ -0,0 +1,24 @@
+public class GetClassTest {
+    static class Base {
+    }
+
+    static class Sub extends Base {
+    }
+
+    static int same(Object a, Object b) {
+        return a.getClass() == b.getClass() ? 1 : 0;
+    }
+
+    public static void main(String[] args) {
+        int[][] grid = new int[2][3];
+        int r = same(new Base(), new Base());           // 1
+        r = r * 10 + same(new Base(), new Sub());       // 0
+        r = r * 10 + same(new int[3], new int[5]);      // 1
+        r = r * 10 + same(new int[3], new long[3]);     // 0
+        r = r * 10 + same(new Base[2], new Base[1]);    // 1
+        r = r * 10 + same(new Base[2], new Sub[2]);     // 0
+        r = r * 10 + same(grid[1], new int[4]);         // 1
+        r = r * 10 + same(grid, new int[1][]);          // 1
+        System.out.println(r); // 10101011
+    }
+}
@@ -0,0 +1,24 @@
+public class InitOrderTest {
+    static class Base {
+        static Base instance = new Derived();
+        int x = 7;
+    }
+
+    static class Derived extends Base {
+        long y = 5;
+    }
+
+    public static void main(String[] args) {
+        // 先访问Derived：初始化父类Base时其<clinit>创建Derived对象，这时Derived还没有初始化
+        Derived d = new Derived();
+        System.out.println(d.x + d.y); // 12
+        System.out.println(Base.instance.x); // 7
+        try {
+            int zero = 0;
+            System.out.println(1 / zero);
+        } catch (ArithmeticException e) {
+            // 虚拟机抛出的异常对象按Throwable的实例模板分配
+            System.out.println(e.getMessage() == null); // true
+        }
+    }
+}
@@ -0,0 +1,53 @@
+public class MultiArrayTest {
+    static int grid(int n, int m) {
+        int[][] g = new int[n][m];
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < m; j++) {
+                g[i][j] = i * j + 1;
+            }
+        }
+        int s = 0;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < m; j++) {
+                s += g[i][j];
+            }
+        }
+        return s;
+    }
+
+    static int cube() {
+        long[][][] c = new long[3][4][5];
+        c[2][3][4] = 1L << 40;
+        c[0][0][0] = 7;
+        return (int) ((c[2][3][4] >> 20) + c[0][0][0] + c[1][2][3]) + c.length * 100 + c[1].length * 10 + c[1][1].length;
+    }
+
+    public static void main(String[] args) {
+        int a = grid(50, 40);            // 957500
+        int b = cube();                  // 1048928
+        String[][] s = new String[6][];
+        int c = s.length * 10 + (s[5] == null ? 1 : 0); // 61
+        int d;
+        try {
+            int[][] bad = new int[2][-1];
+            d = bad.length;
+        } catch (NegativeArraySizeException e) {
+            d = 99;
+        }
+        // 一维数组的负长度同样抛出异常
+        int e = 0;
+        try {
+            int[] bad = new int[d - 100];
+            e = bad.length;
+        } catch (NegativeArraySizeException ex) {
+            e += 1;
+        }
+        try {
+            Object[] bad = new Object[d - 100];
+            e = bad.length;
+        } catch (NegativeArraySizeException ex) {
+            e += 2;
+        }
+        System.out.println(a + " " + b + " " + c + " " + d + " " + e); // 957500 1048928 61 99 3
+    }
+}
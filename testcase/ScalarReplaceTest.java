@@ -0,0 +1,52 @@
+public class ScalarReplaceTest {
+    static class Point {
+        int x;
+        int y;
+
+        Point(int x, int y) {
+            this.x = x;
+            this.y = y;
+        }
+
+        int dot(Point o) {
+            return x * o.x + y * o.y;
+        }
+    }
+
+    static class A {
+        int x = 1;
+    }
+
+    static class B extends A {
+        int x = 2; // 遮蔽A.x，两个字段各自独立
+    }
+
+    // 两个Point都不逃逸，优化编译后字段放在寄存器中
+    static int points(int n) {
+        int s = 0;
+        for (int i = 0; i < n; i++) {
+            Point p = new Point(i, i * 2);
+            Point q = new Point(1, 2);
+            p.x += q.y;
+            s += p.dot(q);
+        }
+        return s;
+    }
+
+    static int hidden() {
+        B b = new B();
+        return b.x * 10 + ((A) b).x;
+    }
+
+    public static void main(String[] args) {
+        int s = 0;
+        int h = 0;
+        // 调用足够多次，进入优化编译层
+        for (int i = 0; i < 2000; i++) {
+            s = points(10);
+            h = hidden();
+        }
+        System.out.println(s); // 245
+        System.out.println(h); // 21
+    }
+}
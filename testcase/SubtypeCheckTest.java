@@ -0,0 +1,70 @@
+public class SubtypeCheckTest {
+    interface Shape {
+    }
+
+    interface Polygon extends Shape {
+    }
+
+    static class A {
+    }
+
+    static class B extends A implements Polygon {
+    }
+
+    static class C extends B {
+    }
+
+    static class D extends C {
+    }
+
+    static class E extends D {
+    }
+
+    static class F extends E {
+    }
+
+    static class G extends F {
+    }
+
+    static class H extends G {
+    }
+
+    static class K extends H {
+    }
+
+    static int isB(Object o) {
+        return o instanceof B ? 1 : 0;
+    }
+
+    static int isShape(Object o) {
+        return o instanceof Shape ? 1 : 0;
+    }
+
+    static int isPolygonArray(Object o) {
+        return o instanceof Polygon[] ? 1 : 0;
+    }
+
+    static int castToC(Object o) {
+        try {
+            C c = (C) o;
+            return 1;
+        } catch (ClassCastException e) {
+            return 0;
+        }
+    }
+
+    public static void main(String[] args) {
+        Object[] objs = { new A(), new B(), new K(), new int[2], new C[1], null };
+        int r = 0;
+        // 同一调用点先后看到不同的类型，检查每个调用点的缓存
+        for (int round = 0; round < 2; round++) {
+            r = 0;
+            for (Object o : objs) {
+                r = r * 16 + isB(o) * 8 + isShape(o) * 4 + isPolygonArray(o) * 2 + castToC(o);
+            }
+        }
+        System.out.println(Integer.toHexString(r)); // cd021
+        System.out.println(objs[3] instanceof Cloneable); // true
+        System.out.println(objs[4] instanceof Object[]); // true
+    }
+}
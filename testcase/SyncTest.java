@@ -0,0 +1,24 @@
+public class SyncTest {
+    static final Object LOCK = new Object();
+    static int count = 0;
+
+    static class Counter extends Thread {
+        public void run() {
+            for (int i = 0; i < 1000; i++) {
+                synchronized (LOCK) {
+                    count++;
+                }
+            }
+        }
+    }
+
+    public static void main(String[] args) throws InterruptedException {
+        Counter[] counters = new Counter[4];
+        for (int i = 0; i < 4; i++) {
+            counters[i] = new Counter();
+            counters[i].start();
+        }
+        for (int i = 0; i < 4; i++) counters[i].join();
+        System.out.println(count); // 4000
+    }
+}
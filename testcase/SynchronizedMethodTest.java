@@ -0,0 +1,59 @@
+public class SynchronizedMethodTest {
+    // 单元素的阻塞队列：put/take都是同步方法，在this上wait/notifyAll
+    static class Slot {
+        private int value;
+        private boolean full;
+
+        synchronized void put(int v) throws InterruptedException {
+            while (full) wait();
+            value = v;
+            full = true;
+            notifyAll();
+        }
+
+        synchronized int take() throws InterruptedException {
+            while (!full) wait();
+            full = false;
+            notifyAll();
+            return value;
+        }
+
+        synchronized int divide(int d) {
+            return value / d;
+        }
+    }
+
+    static int total = 0;
+
+    static synchronized void add(int v) {
+        total += v;
+    }
+
+    public static void main(String[] args) throws InterruptedException {
+        final Slot slot = new Slot();
+        Thread producer = new Thread() {
+            public void run() {
+                try {
+                    for (int i = 1; i <= 100; i++) slot.put(i);
+                } catch (InterruptedException e) {
+                }
+            }
+        };
+        producer.start();
+        for (int i = 0; i < 100; i++) add(slot.take());
+        producer.join();
+        System.out.println(total); // 5050
+
+        // 同步方法抛出异常后锁已释放，不持有锁时notify抛出IllegalMonitorStateException
+        try {
+            slot.divide(0);
+        } catch (ArithmeticException e) {
+            System.out.println("divide by zero");
+        }
+        try {
+            slot.notify();
+        } catch (IllegalMonitorStateException e) {
+            System.out.println("not owner");
+        }
+    }
+}
@@ -0,0 +1,25 @@
+public class ThreadTest {
+    static long[] sums = new long[4];
+
+    static class Worker extends Thread {
+        private final int id;
+        Worker(int id) { this.id = id; }
+        public void run() {
+            long s = 0;
+            for (int i = 0; i < 100000; i++) s += i;
+            sums[id] = s;
+        }
+    }
+
+    public static void main(String[] args) {
+        Worker[] workers = new Worker[4];
+        for (int i = 0; i < 4; i++) {
+            workers[i] = new Worker(i);
+            workers[i].start();
+        }
+        for (int i = 0; i < 4; i++) {
+            while (workers[i].isAlive()) Thread.yield();
+        }
+        for (int i = 0; i < 4; i++) System.out.println(sums[i]); // 4999950000
+    }
+}
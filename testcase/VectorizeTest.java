@@ -0,0 +1,83 @@
+public class VectorizeTest {
+    static int isum(int[] a) {
+        int s = 0;
+        for (int i = 0; i < a.length; i++) {
+            s += a[i];
+        }
+        return s;
+    }
+
+    static long lsum(long[] a) {
+        long s = 0;
+        for (int i = 0; i < a.length; i++) {
+            s += a[i];
+        }
+        return s;
+    }
+
+    static int dot(int[] a, int[] b) {
+        int s = 0;
+        for (int i = 0; i < a.length; i++) {
+            s += a[i] * b[i];
+        }
+        return s;
+    }
+
+    static void scale(float[] d, float[] s, float k) {
+        for (int i = 0; i < d.length; i++) {
+            d[i] = s[i] * k;
+        }
+    }
+
+    static void addin(double[] d, double[] s) {
+        for (int i = 0; i < d.length; i++) {
+            d[i] += s[i];
+        }
+    }
+
+    // 浮点归约按顺序相加，不向量化
+    static float fsum(float[] a) {
+        float s = 0;
+        for (int i = 0; i < a.length; i++) {
+            s += a[i];
+        }
+        return s;
+    }
+
+    static int hash(int[] a) {
+        int h = 0;
+        for (int v : a) {
+            h ^= v;
+        }
+        return h;
+    }
+
+    public static void main(String[] args) {
+        int n = 1003;
+        int[] a = new int[n];
+        int[] b = new int[n];
+        long[] l = new long[n];
+        float[] f = new float[n];
+        float[] g = new float[n];
+        double[] d = new double[n];
+        double[] e = new double[n];
+        for (int i = 0; i < n; i++) {
+            a[i] = i * 7 - 500;
+            b[i] = i % 3;
+            l[i] = ((long) i << 40) | i;
+            g[i] = i % 5;
+            e[i] = i * 0.25;
+        }
+        scale(f, g, 1.5f);
+        addin(d, e);
+        addin(d, e);
+        int shortDot;
+        try {
+            shortDot = dot(a, new int[10]);
+        } catch (ArrayIndexOutOfBoundsException ex) {
+            shortDot = -1;
+        }
+        System.out.println(isum(a) + " " + (lsum(l) >>> 40) + " " + dot(a, b) + " " + fsum(f) + " "
+                + d[n - 1] + " " + hash(a) + " " + shortDot); // 3016021 502503 3014183 3004.5 501.0 1717 -1
+    }
+}
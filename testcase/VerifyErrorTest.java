@@ -0,0 +1,27 @@
+// VerifyHolder先按继承VerifyBase的版本编译，run_all_tests.sh再用verify/VerifyHolder.java重新编译，
+// 新版本不再继承VerifyBase：read()对VerifyHolder对象读取VerifyBase.ref，验证时应抛出VerifyError，
+// 而不是把int字段x当作引用读出
+class VerifyBase {
+    Object ref;
+}
+
+class VerifyHolder extends VerifyBase {
+    int x;
+}
+
+public class VerifyErrorTest {
+    static Object read() {
+        VerifyHolder h = new VerifyHolder();
+        h.x = 0x7fff0000;
+        VerifyBase b = h;
+        return b.ref;
+    }
+
+    public static void main(String[] args) {
+        try {
+            System.out.println(read() == null); // 未重新编译VerifyHolder时为true
+        } catch (VerifyError e) {
+            System.out.println("VerifyError"); // VerifyError
+        }
+    }
+}
@@ -4,6 +4,8 @@ cd "$(dirname "$0")"
 
 # 编译所有 Java 测试用例
 javac *.java
+# VerifyErrorTest：换成不再继承VerifyBase的VerifyHolder，制造验证时才能发现的类型错误
+javac -d . verify/VerifyHolder.java
 
 # 运行所有测试用例
 JVM=../build/myJVMinCpp
@@ -21,6 +23,15 @@ for cls in *.java; do
     echo "========================="
 done
 
+# JIT：阈值为0时每个方法首次调用即编译，用同一组用例检查编译代码
+for cls in *.java; do
+    name="${cls%.java}"
+    echo "===== Running $name (JIT) ====="
+    JVM_JIT_THRESHOLD=0 "$JVM" "$name" || fail=1
+    echo
+    echo "========================="
+done
+
 if [ $fail -eq 0 ]; then
     echo "所有测试用例运行完毕，无异常退出。"
 else
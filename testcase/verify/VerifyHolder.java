@@ -0,0 +1,4 @@
+// VerifyErrorTest用：与VerifyErrorTest.java中的VerifyHolder同名，但不再继承VerifyBase
+class VerifyHolder {
+    int x;
+}